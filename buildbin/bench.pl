@@ -0,0 +1,236 @@
+#!/usr/bin/perl
+
+# Licensed to the Apache Software Foundation (ASF) under one or more
+# contributor license agreements.  See the NOTICE file distributed with
+# this work for additional information regarding copyright ownership.
+# The ASF licenses this file to You under the Apache License, Version 2.0
+# (the "License"); you may not use this file except in compliance with
+# the License.  You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+use strict;
+use warnings;
+
+use Getopt::Long;
+use File::Spec::Functions qw( rel2abs catfile devnull );
+use File::Temp qw( tempdir );
+use File::Path qw( rmtree );
+use JSON::PP;
+use POSIX qw( ceil );
+use Time::HiRes qw( time );
+
+# Process command line arguments.
+my $charmonize = './charmonize';
+my $cc         = 'cc';
+my $runs       = 5;
+my $jobs_list  = '1,4';
+my $caches     = 'none,cold,warm';
+my $drop_caches;
+my $outfile;
+GetOptions(
+    'charmonize=s' => \$charmonize,
+    'cc=s'         => \$cc,
+    'runs=i'       => \$runs,
+    'jobs=s'       => \$jobs_list,
+    'cache=s'      => \$caches,
+    'drop-caches'  => \$drop_caches,
+    'out=s'        => \$outfile,
+) or die usage();
+die usage() if $runs < 1;
+$charmonize = rel2abs($charmonize);
+$outfile    = rel2abs($outfile) if defined $outfile;
+die "Can't execute '$charmonize'\n" unless -x $charmonize;
+my @jobs   = split /,/, $jobs_list;
+my @caches = split /,/, $caches;
+for (@caches) {
+    die usage() unless /^(none|cold|warm)$/;
+}
+
+sub usage {
+    return <<END_USAGE;
+Usage:
+
+    bench.pl [--charmonize=PATH] [--cc=CC] [--runs=N] [--jobs=LIST]
+             [--cache=LIST] [--drop-caches] [--out=FILE] [-- ARGS]
+
+    * charmonize -- The charmonize executable.  Defaults to ./charmonize.
+    * cc -- The compiler command passed on to charmonize.
+    * runs -- How many times to run each scenario.  Defaults to 5.
+    * jobs -- A comma separated list of values for --jobs.  Defaults to
+      "1,4".
+    * cache -- A comma separated list of probe cache states: "none" runs
+      without a cache, "cold" with an empty one, "warm" with one filled by
+      an earlier run.  Defaults to all three.
+    * drop-caches -- Drop the operating system's file cache before every
+      run.  Needs permission to write /proc/sys/vm/drop_caches.
+    * out -- Write the report here instead of to stdout.
+
+    Any ARGS are passed on to charmonize.
+
+END_USAGE
+}
+
+# Every scenario runs charmonize from the same scratch directory, traced,
+# so that compiles and spawned processes can be counted per module.
+my $work_dir  = tempdir( 'charm_bench_XXXXXX', TMPDIR => 1, CLEANUP => 1 );
+my $cache_dir = catfile( $work_dir, 'cache' );
+my @scenarios;
+
+for my $jobs (@jobs) {
+    for my $cache (@caches) {
+        my @times;
+        my %modules;
+        my ( @compiles, @spawns );
+
+        # A warm-up run fills the probe cache and, unless it gets dropped,
+        # the file cache.
+        rmtree($cache_dir);
+        run_charmonize( $jobs, $cache eq 'none' ? undef : $cache_dir );
+
+        for ( 1 .. $runs ) {
+            rmtree($cache_dir) if $cache eq 'cold';
+            drop_caches() if $drop_caches;
+            my ( $elapsed, $events ) = run_charmonize( $jobs,
+                $cache eq 'none' ? undef : $cache_dir );
+            push @times, $elapsed;
+
+            my %counts = count_events($events);
+            my ( $compiles, $spawns ) = ( 0, 0 );
+            for my $module ( keys %counts ) {
+                my $stats = $modules{$module} ||= {};
+                push @{ $stats->{$_} }, $counts{$module}{$_}
+                    for qw( compiles spawns seconds );
+                $compiles += $counts{$module}{compiles};
+                $spawns   += $counts{$module}{spawns};
+            }
+            push @compiles, $compiles;
+            push @spawns,   $spawns;
+        }
+
+        my %module_report;
+        for my $module ( keys %modules ) {
+            $module_report{$module} = {
+                map { $_ => median( $modules{$module}{$_} ) }
+                    qw( compiles spawns seconds )
+            };
+        }
+        push @scenarios, {
+            jobs        => $jobs + 0,
+            probe_cache => $cache,
+            file_cache  => $drop_caches ? 'cold' : 'warm',
+            runs        => $runs,
+            wall        => {
+                median => median( \@times ),
+                p95    => percentile( \@times, 95 ),
+                min    => ( sort { $a <=> $b } @times )[0],
+                max    => ( sort { $a <=> $b } @times )[-1],
+            },
+            compiles => median( \@compiles ),
+            spawns   => median( \@spawns ),
+            modules  => \%module_report,
+        };
+    }
+}
+
+my $report = JSON::PP->new->canonical->pretty->encode(
+    {   charmonize => $charmonize,
+        cc         => $cc,
+        scenarios  => \@scenarios,
+    }
+);
+if ($outfile) {
+    open my $fh, '>', $outfile or die "Can't open '$outfile': $!";
+    print $fh $report;
+    close $fh or die "Error when closing '$outfile': $!";
+}
+else {
+    print $report;
+}
+
+# Run charmonize once and return the elapsed wall time in seconds and the
+# events from its trace.
+sub run_charmonize {
+    my ( $jobs, $cache ) = @_;
+    my $trace = catfile( $work_dir, 'trace.json' );
+    my @command = (
+        $charmonize, "--cc=$cc", '--enable-c', "--jobs=$jobs",
+        "--trace=$trace",
+    );
+    push @command, "--cache-dir=$cache" if defined $cache;
+    push @command, @ARGV;
+
+    my $start = time;
+    my $pid = fork;
+    die "fork failed: $!" unless defined $pid;
+    if ( !$pid ) {
+        chdir $work_dir or die "Can't chdir to '$work_dir': $!";
+        open STDOUT, '>', devnull();
+        exec @command or die "Can't exec '$charmonize': $!";
+    }
+    waitpid( $pid, 0 );
+    my $elapsed = time - $start;
+    die "charmonize failed: @command\n" if $?;
+
+    my $events = decode_json( slurp($trace) )->{traceEvents};
+    unlink $trace, "$trace.txt";
+    return ( $elapsed, $events );
+}
+
+# Tally compiles (including links), spawned processes and elapsed time by
+# module.
+sub count_events {
+    my $events = shift;
+    my %counts;
+    for my $event (@$events) {
+        my $module = $event->{args}{module} || '(init)';
+        my $counts = $counts{$module}
+            ||= { compiles => 0, spawns => 0, seconds => 0 };
+        my $cat = $event->{cat};
+        if ( $cat eq 'compile' || $cat eq 'link' ) {
+            $counts->{compiles}++;
+        }
+        elsif ( $cat eq 'exec' ) {
+            $counts->{spawns}++;
+        }
+        elsif ( $cat eq 'module' ) {
+            $counts->{seconds} += $event->{dur} / 1_000_000;
+        }
+    }
+    return %counts;
+}
+
+sub drop_caches {
+    system('sync');
+    open my $fh, '>', '/proc/sys/vm/drop_caches'
+        or die "Can't drop file caches: $!\n";
+    print $fh "3\n";
+    close $fh or die "Can't drop file caches: $!\n";
+}
+
+sub median {
+    return percentile( shift, 50 );
+}
+
+# Nearest-rank percentile.
+sub percentile {
+    my ( $values, $pct ) = @_;
+    my @sorted = sort { $a <=> $b } @$values;
+    my $rank = ceil( @sorted * $pct / 100 );
+    $rank = 1 if $rank < 1;
+    return $sorted[ $rank - 1 ];
+}
+
+sub slurp {
+    my $path = shift;
+    open( my $fh, '<', $path ) or die "Can't open '$path': $!";
+    local $/;
+    return <$fh>;
+}
+
@@ -0,0 +1,538 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* fakecc -- a scriptable stand-in for a C compiler.
+ *
+ * fakecc passes its arguments on to a real compiler, but first consults a
+ * table of rules which make the compiler look like something else: a
+ * compiler which rejects some constructs, which defines different macros,
+ * which takes MSVC or Sun C style options, or whose executables print
+ * canned output.  That way probe logic can be exercised against exotic
+ * platforms with nothing but the local toolchain:
+ *
+ *     FAKECC_RULES=rules.txt ./charmonize --cc=./fakecc --enable-c
+ *
+ * The rules file named by FAKECC_RULES holds one rule per line.  Blank lines
+ * and lines starting with '#' are ignored.
+ *
+ *     cc COMMAND            The real compiler.  Defaults to $FAKECC_CC, or
+ *                           "cc".
+ *     style gnu|msvc|sun    The option syntax to accept.  MSVC and Sun C
+ *                           options are translated for the real compiler,
+ *                           which must take GCC style options.
+ *     define NAME [VALUE]   Predefine a macro.
+ *     undef NAME            Remove a predefined macro.
+ *     hide NAME             Hide a predefined macro from the sources being
+ *                           compiled, but not from system headers, which
+ *                           may not work without it (__GNUC__, say), and
+ *                           from macro dumps made with -dM.
+ *     fail TEXT             Fail to compile any source containing TEXT.
+ *     replace FROM TO       Replace the word FROM with TO (the rest of the
+ *                           line) in every source before compiling it.
+ *     print WORD TEXT       Executables built from sources containing WORD
+ *                           print TEXT (the rest of the line, in which \n
+ *                           stands for a newline) instead of doing anything
+ *                           else.
+ *     empty WORD            Object files compiled from sources containing
+ *                           WORD are left empty, as if the compiler kept
+ *                           their contents somewhere else.
+ *
+ * If FAKECC_LOG names a file, every invocation is appended to it along with
+ * its exit status.  Sources piped in through stdin are always rejected, so
+ * that the source can be inspected.
+ *
+ * fakecc needs a POSIX shell to run the real compiler and the executables
+ * created by "print" rules.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define FAKECC_MAX_RULES 200
+#define FAKECC_MAX_LINE  1000
+
+#define FAKECC_STYLE_GNU  0
+#define FAKECC_STYLE_MSVC 1
+#define FAKECC_STYLE_SUN  2
+
+typedef struct {
+    char *op;
+    char *word;
+    char *rest;
+} fakecc_Rule;
+
+static struct {
+    fakecc_Rule  rules[FAKECC_MAX_RULES];
+    int          num_rules;
+    const char  *cc;
+    int          style;
+    char        *command;
+    size_t       command_len;
+    size_t       command_cap;
+    const char  *source;
+    const char  *output;
+    int          links;
+} fakecc;
+
+/* Read the rules file named by FAKECC_RULES, if any.
+ */
+static void
+S_load_rules(void);
+
+/* Translate the option at argv[i] and add it to the command.  Return the
+ * index of the last argument used.
+ */
+static int
+S_add_option(char **argv, int i, int argc);
+
+/* Add [text], and then [arg], to the command being built.
+ */
+static void
+S_append(const char *text, const char *arg);
+
+static char*
+S_slurp(const char *path);
+
+static void
+S_spew(const char *path, const char *content);
+
+/* Return [source] with the word [from] replaced by [to] throughout.
+ */
+static char*
+S_replace(const char *source, const char *from, const char *to);
+
+/* Replace the executable at [path] with a script which prints [text].
+ */
+static void
+S_write_printer(const char *path, const char *text);
+
+/* Append a line describing this invocation to FAKECC_LOG.
+ */
+static void
+S_log(int argc, char **argv, const char *result);
+
+static char*
+S_strdup(const char *string);
+
+int
+main(int argc, char **argv) {
+    char *source   = NULL;
+    char *modified = NULL;
+    int   dump_macros = 0;
+    int   status;
+    int   i;
+
+    S_load_rules();
+    fakecc.links = 1;
+    S_append(fakecc.cc, NULL);
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-dM") == 0) { dump_macros = 1; }
+    }
+    for (i = 0; i < fakecc.num_rules; i++) {
+        fakecc_Rule *rule = &fakecc.rules[i];
+        if (strcmp(rule->op, "define") == 0) {
+            S_append(" -D", rule->word);
+            if (rule->rest[0] != '\0') { S_append("=", rule->rest); }
+        }
+        else if (strcmp(rule->op, "undef") == 0
+                 || (dump_macros && strcmp(rule->op, "hide") == 0)
+                ) {
+            /* A macro dump includes no system headers. */
+            S_append(" -U", rule->word);
+        }
+    }
+    for (i = 1; i < argc; i++) {
+        i = S_add_option(argv, i, argc);
+    }
+
+    if (fakecc.source == NULL || strcmp(fakecc.source, "-") == 0) {
+        S_log(argc, argv, "no source file");
+        return 1;
+    }
+    source = S_slurp(fakecc.source);
+    if (source == NULL) {
+        S_log(argc, argv, "can't read source");
+        return 1;
+    }
+
+    /* Apply the rules which look at the source. */
+    for (i = 0; i < fakecc.num_rules; i++) {
+        fakecc_Rule *rule = &fakecc.rules[i];
+        if (strcmp(rule->op, "fail") == 0) {
+            char *text = S_strdup(rule->word);
+            int   found;
+            if (rule->rest[0] != '\0') {
+                free(text);
+                text = (char*)malloc(strlen(rule->word)
+                                     + strlen(rule->rest) + 2);
+                sprintf(text, "%s %s", rule->word, rule->rest);
+            }
+            found = strstr(source, text) != NULL;
+            free(text);
+            if (found) {
+                S_log(argc, argv, "failed by rule");
+                free(source);
+                return 1;
+            }
+        }
+        else if (strcmp(rule->op, "replace") == 0
+                 || strcmp(rule->op, "hide") == 0
+                ) {
+            char *hidden = NULL;
+            char *replaced;
+            if (strcmp(rule->op, "hide") == 0) {
+                hidden = (char*)malloc(strlen(rule->word) + 20);
+                sprintf(hidden, "FAKECC_HIDDEN_%s", rule->word);
+            }
+            replaced = S_replace(modified ? modified : source, rule->word,
+                                 hidden ? hidden : rule->rest);
+            if (replaced != NULL) {
+                free(modified);
+                modified = replaced;
+            }
+            free(hidden);
+        }
+    }
+
+    if (modified != NULL) {
+        S_spew(fakecc.source, modified);
+        free(modified);
+    }
+    status = system(fakecc.command);
+    status = status == 0 ? 0 : 1;
+
+    if (status == 0 && !fakecc.links && fakecc.output != NULL) {
+        for (i = 0; i < fakecc.num_rules; i++) {
+            fakecc_Rule *rule = &fakecc.rules[i];
+            if (strcmp(rule->op, "empty") == 0
+                && strstr(source, rule->word) != NULL
+               ) {
+                S_spew(fakecc.output, "");
+                break;
+            }
+        }
+    }
+    if (status == 0 && fakecc.links && fakecc.output != NULL) {
+        for (i = 0; i < fakecc.num_rules; i++) {
+            fakecc_Rule *rule = &fakecc.rules[i];
+            if (strcmp(rule->op, "print") == 0
+                && strstr(source, rule->word) != NULL
+               ) {
+                S_write_printer(fakecc.output, rule->rest);
+                break;
+            }
+        }
+    }
+
+    S_log(argc, argv, status == 0 ? "0" : "1");
+    free(source);
+    return status;
+}
+
+static void
+S_load_rules(void) {
+    const char *path = getenv("FAKECC_RULES");
+    char        line[FAKECC_MAX_LINE];
+    FILE       *file;
+
+    fakecc.cc = getenv("FAKECC_CC");
+    if (fakecc.cc == NULL || fakecc.cc[0] == '\0') {
+        fakecc.cc = "cc";
+    }
+    if (path == NULL || path[0] == '\0') {
+        return;
+    }
+    file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "fakecc: can't open '%s'\n", path);
+        exit(2);
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        fakecc_Rule *rule;
+        char        *op   = line + strspn(line, " \t");
+        char        *word;
+        char        *rest;
+
+        line[strcspn(line, "\r\n")] = '\0';
+        if (op[0] == '\0' || op[0] == '#') { continue; }
+        if (fakecc.num_rules == FAKECC_MAX_RULES) {
+            fprintf(stderr, "fakecc: too many rules in '%s'\n", path);
+            exit(2);
+        }
+
+        /* Split the line into the op, one word, and the rest. */
+        word = op + strcspn(op, " \t");
+        if (*word != '\0') { *word++ = '\0'; }
+        word += strspn(word, " \t");
+        rest = word + strcspn(word, " \t");
+        if (*rest != '\0') { *rest++ = '\0'; }
+        rest += strspn(rest, " \t");
+
+        rule = &fakecc.rules[fakecc.num_rules++];
+        rule->op   = S_strdup(op);
+        rule->word = S_strdup(word);
+        rule->rest = S_strdup(rest);
+
+        if (strcmp(op, "cc") == 0) {
+            char *command = (char*)malloc(strlen(word) + strlen(rest) + 2);
+            sprintf(command, "%s%s%s", word, rest[0] ? " " : "", rest);
+            fakecc.cc = command;
+        }
+        else if (strcmp(op, "style") == 0) {
+            fakecc.style = strcmp(word, "msvc") == 0 ? FAKECC_STYLE_MSVC
+                           : strcmp(word, "sun") == 0 ? FAKECC_STYLE_SUN
+                           : FAKECC_STYLE_GNU;
+        }
+    }
+    fclose(file);
+}
+
+static int
+S_add_option(char **argv, int i, int argc) {
+    const char *arg  = argv[i];
+    const char *next = i + 1 < argc ? argv[i + 1] : NULL;
+    size_t      len  = strlen(arg);
+
+    if (len > 2 && strcmp(arg + len - 2, ".c") == 0) {
+        fakecc.source = arg;
+        S_append(" ", arg);
+        return i;
+    }
+    if (strcmp(arg, "-") == 0) {
+        fakecc.source = arg;
+        return i;
+    }
+
+    if (fakecc.style == FAKECC_STYLE_MSVC && arg[0] == '/') {
+        if (strcmp(arg, "/c") == 0) {
+            fakecc.links = 0;
+            S_append(" -c", NULL);
+        }
+        else if (strncmp(arg, "/Fo", 3) == 0 || strncmp(arg, "/Fe", 3) == 0) {
+            fakecc.output = arg + 3;
+            S_append(" -o ", arg + 3);
+        }
+        else if (strncmp(arg, "/D", 2) == 0) {
+            S_append(" -D", arg[2] ? arg + 2 : next);
+            if (!arg[2]) { i++; }
+        }
+        else if (strncmp(arg, "/I", 2) == 0) {
+            S_append(" -I", arg[2] ? arg + 2 : next);
+            if (!arg[2]) { i++; }
+        }
+        else if (strcmp(arg, "/E") == 0 || strcmp(arg, "/EP") == 0) {
+            fakecc.links = 0;
+            S_append(" -E", NULL);
+        }
+        else if (strcmp(arg, "/Zs") == 0) {
+            fakecc.links = 0;
+            S_append(" -fsyntax-only", NULL);
+        }
+        else if (strcmp(arg, "/O2") == 0) { S_append(" -O2", NULL); }
+        else if (strcmp(arg, "/Od") == 0) { S_append(" -O0", NULL); }
+        else if (strcmp(arg, "/WX") == 0) { S_append(" -Werror", NULL); }
+        else if (strcmp(arg, "/DLL") == 0) { S_append(" -shared", NULL); }
+        /* Anything else -- /nologo, /MD, /W3 -- doesn't matter here. */
+        return i;
+    }
+
+    if (fakecc.style == FAKECC_STYLE_SUN) {
+        if (strcmp(arg, "-xe") == 0) {
+            fakecc.links = 0;
+            S_append(" -fsyntax-only", NULL);
+            return i;
+        }
+        else if (strncmp(arg, "-xO", 3) == 0) {
+            S_append(" -O2", NULL);
+            return i;
+        }
+        else if (strcmp(arg, "-errwarn=%all") == 0) {
+            S_append(" -Werror", NULL);
+            return i;
+        }
+        else if (strcmp(arg, "-KPIC") == 0) {
+            S_append(" -fPIC", NULL);
+            return i;
+        }
+        else if (strcmp(arg, "-xldscope=hidden") == 0) {
+            S_append(" -fvisibility=hidden", NULL);
+            return i;
+        }
+        else if (strcmp(arg, "-xalias_level=any") == 0) {
+            S_append(" -fno-strict-aliasing", NULL);
+            return i;
+        }
+        else if (strcmp(arg, "-G") == 0) {
+            S_append(" -shared", NULL);
+            return i;
+        }
+        else if (strcmp(arg, "-h") == 0 && next != NULL) {
+            S_append(" -Wl,-soname,", next);
+            return i + 1;
+        }
+        else if (strncmp(arg, "-x", 2) == 0) {
+            return i;
+        }
+    }
+
+    if (strcmp(arg, "-c") == 0
+        || strcmp(arg, "-E") == 0
+        || strcmp(arg, "-fsyntax-only") == 0
+       ) {
+        fakecc.links = 0;
+    }
+    else if (strcmp(arg, "-o") == 0 && next != NULL) {
+        fakecc.output = next;
+        S_append(" -o ", next);
+        return i + 1;
+    }
+    S_append(" ", arg);
+    return i;
+}
+
+static void
+S_append(const char *text, const char *arg) {
+    size_t text_len = strlen(text);
+    size_t arg_len  = arg ? strlen(arg) : 0;
+    size_t needed   = fakecc.command_len + text_len + arg_len + 1;
+
+    if (needed > fakecc.command_cap) {
+        fakecc.command_cap = needed * 2;
+        fakecc.command = (char*)realloc(fakecc.command, fakecc.command_cap);
+    }
+    memcpy(fakecc.command + fakecc.command_len, text, text_len);
+    fakecc.command_len += text_len;
+    if (arg_len) {
+        memcpy(fakecc.command + fakecc.command_len, arg, arg_len);
+        fakecc.command_len += arg_len;
+    }
+    fakecc.command[fakecc.command_len] = '\0';
+}
+
+static char*
+S_slurp(const char *path) {
+    FILE   *file = fopen(path, "rb");
+    char   *content;
+    size_t  len = 0;
+    size_t  cap = 4096;
+    size_t  got;
+
+    if (file == NULL) { return NULL; }
+    content = (char*)malloc(cap);
+    while ((got = fread(content + len, 1, cap - len - 1, file)) > 0) {
+        len += got;
+        if (len + 1 == cap) {
+            cap *= 2;
+            content = (char*)realloc(content, cap);
+        }
+    }
+    fclose(file);
+    content[len] = '\0';
+    return content;
+}
+
+static void
+S_spew(const char *path, const char *content) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "fakecc: can't write '%s'\n", path);
+        exit(2);
+    }
+    fputs(content, file);
+    fclose(file);
+}
+
+static char*
+S_replace(const char *source, const char *from, const char *to) {
+    size_t      from_len = strlen(from);
+    size_t      to_len   = strlen(to);
+    size_t      count    = 0;
+    const char *ptr;
+    char       *result;
+    char       *out;
+
+    if (from_len == 0) { return NULL; }
+    for (ptr = strstr(source, from); ptr; ptr = strstr(ptr + from_len, from)) {
+        count++;
+    }
+    if (count == 0) { return NULL; }
+
+    result = (char*)malloc(strlen(source) + count * to_len + 1);
+    out    = result;
+    while ((ptr = strstr(source, from)) != NULL) {
+        memcpy(out, source, (size_t)(ptr - source));
+        out += ptr - source;
+        memcpy(out, to, to_len);
+        out += to_len;
+        source = ptr + from_len;
+    }
+    strcpy(out, source);
+    return result;
+}
+
+static void
+S_write_printer(const char *path, const char *text) {
+    FILE *file = fopen(path, "w");
+    const unsigned char *ptr;
+
+    if (file == NULL) {
+        fprintf(stderr, "fakecc: can't write '%s'\n", path);
+        exit(2);
+    }
+
+    /* Octal escapes get any byte through printf unscathed. */
+    fprintf(file, "#!/bin/sh\nprintf '");
+    for (ptr = (const unsigned char*)text; *ptr != '\0'; ptr++) {
+        if (ptr[0] == '\\' && ptr[1] == 'n') {
+            fprintf(file, "\\012");
+            ptr++;
+        }
+        else {
+            fprintf(file, "\\%03o", (unsigned)*ptr);
+        }
+    }
+    fprintf(file, "'\n");
+    fclose(file);
+    chmod(path, 0755);
+}
+
+static void
+S_log(int argc, char **argv, const char *result) {
+    const char *path = getenv("FAKECC_LOG");
+    FILE       *file;
+    int         i;
+
+    if (path == NULL || path[0] == '\0') { return; }
+    file = fopen(path, "a");
+    if (file == NULL) { return; }
+    fprintf(file, "%s:", result);
+    for (i = 1; i < argc; i++) {
+        fprintf(file, " %s", argv[i]);
+    }
+    fprintf(file, "\n");
+    fclose(file);
+}
+
+static char*
+S_strdup(const char *string) {
+    char *copy = (char*)malloc(strlen(string) + 1);
+    strcpy(copy, string);
+    return copy;
+}
+
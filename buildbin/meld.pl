@@ -69,15 +69,28 @@ if ( !@probes ) {
 my @core = qw(
     SharedLibrary
     CFlags
+    Cache
     Compiler
     ConfWriter
     ConfWriterC
     ConfWriterPerl
     ConfWriterPython
     ConfWriterRuby
+    Features
+    FuncCheck
     HeaderChecker
     Make
+    Memo
     OperatingSystem
+    OpLog
+    ProbeBatch
+    ProbeProgram
+    ProbeQueue
+    ProbeTable
+    Profile
+    Scratch
+    Trace
+    Types
     Util
 );
 
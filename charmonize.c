@@ -121,19 +121,22 @@ int main(int argc, const char **argv) {
         chaz_Probe_init(&args);
     }
 
-    /* Run probe modules. */
-    chaz_DirManip_run();
-    chaz_Headers_run();
-    chaz_AtomicOps_run();
-    chaz_FuncMacro_run();
-    chaz_Booleans_run();
-    chaz_Integers_run();
-    chaz_Floats_run();
-    chaz_LargeFiles_run();
-    chaz_Memory_run();
-    chaz_SymbolVisibility_run();
-    chaz_UnusedVars_run();
-    chaz_VariadicMacros_run();
+    /* Run probe modules.  AtomicOps and LargeFiles look at headers which
+     * Headers checks. */
+    chaz_Probe_add_module("DirManip", chaz_DirManip_run, NULL);
+    chaz_Probe_add_module("Headers", chaz_Headers_run, NULL);
+    chaz_Probe_add_module("AtomicOps", chaz_AtomicOps_run, "Headers");
+    chaz_Probe_add_module("FuncMacro", chaz_FuncMacro_run, NULL);
+    chaz_Probe_add_module("Booleans", chaz_Booleans_run, NULL);
+    chaz_Probe_add_module("Integers", chaz_Integers_run, NULL);
+    chaz_Probe_add_module("Floats", chaz_Floats_run, NULL);
+    chaz_Probe_add_module("LargeFiles", chaz_LargeFiles_run, "Headers");
+    chaz_Probe_add_module("Memory", chaz_Memory_run, NULL);
+    chaz_Probe_add_module("SymbolVisibility", chaz_SymbolVisibility_run,
+                          NULL);
+    chaz_Probe_add_module("UnusedVars", chaz_UnusedVars_run, NULL);
+    chaz_Probe_add_module("VariadicMacros", chaz_VariadicMacros_run, NULL);
+    chaz_Probe_run_modules();
 
     /* Write custom postamble. */
     chaz_ConfWriter_append_conf(
@@ -117,11 +117,12 @@ sub test_block {
     my $obj = $self->objectify($c_test_case);
     my $test_obj
         = $self->pathify( $self->objectify("src/Charmonizer/Test.c") );
+    # Tests may call into the Core modules directly.
     my $link_command = $self->build_link_command(
-        objects => [ $obj, $test_obj ],
+        objects => [ $obj, $test_obj, '$(CORE_OBJS)' ],
         target  => '$@',
     );
-    return qq|$exe: $test_obj $obj\n\t$link_command|;
+    return qq|$exe: $test_obj $obj \$(CORE_OBJS)\n\t$link_command|;
 }
 
 sub clean_rule { confess "abstract method" }
@@ -146,6 +147,30 @@ sub meld_rule_win {
         . qq|--files=\$(FILES) --out=\$(OUT)|;
 }
 
+sub fakecc_rule { confess "abstract method" }
+
+# The fake compiler used by the tests needs a POSIX shell.
+sub fakecc_rule_posix {
+    return <<"EOF";
+\$(FAKECC): buildbin/fakecc.c
+\t\$(CC) \$(CFLAGS) buildbin/fakecc.c -o \$@
+EOF
+}
+
+sub fakecc_rule_win { '' }
+
+sub bench_rule { confess "abstract method" }
+
+sub bench_rule_posix {
+    qq|bench: \$(PROGNAME)\n\t\$(PERL) buildbin/bench.pl |
+        . qq|--charmonize=./\$(PROGNAME) --cc=\$(CC) \$(BENCH_ARGS)|;
+}
+
+sub bench_rule_win {
+    qq|bench: \$(PROGNAME)\n\t\$(PERL) buildbin\\bench.pl |
+        . qq|--charmonize=\$(PROGNAME) --cc=\$(CC) \$(BENCH_ARGS)|;
+}
+
 sub charmony_h_rule { confess "abstract method" }
 
 sub charmony_h_rule_posix {
@@ -189,12 +214,17 @@ sub gen_makefile {
     my $meld_rule             = $self->meld_rule;
     my $charmony_h_rule       = $self->charmony_h_rule;
     my $test_rule             = $self->test_rule;
+    my $bench_rule            = $self->bench_rule;
+    my $fakecc_rule           = $self->fakecc_rule;
+    my $fakecc                = $fakecc_rule ? 'fakecc' : '';
     my $progname_link_command = $self->build_link_command(
         objects => ['$(OBJS)'],
         target  => '$(PROGNAME)',
     );
     my $clean_rule  = $self->clean_rule;
     my $objs        = join " ", map { $self->objectify($_) } @$c_files;
+    my $core_objs   = join " ", map { $self->objectify($_) }
+        grep { /Core[\\\/]/ } @$c_files;
     my $test_objs   = join " ", map { $self->objectify($_) } @$c_tests;
     my $test_blocks = join "\n\n",
         map { $self->test_block($_) } @$c_test_cases;
@@ -230,17 +260,21 @@ CHARMONY_H= charmony.h
 PROBES=
 FILES=
 OUT=
+BENCH_ARGS=
 PERL=/usr/bin/perl
+FAKECC= $fakecc
 
 TESTS= $test_execs
 
 OBJS= $objs
 
+CORE_OBJS= $core_objs
+
 TEST_OBJS= $test_objs
 
 HEADERS= $headers
 
-CLEANABLE= \$(OBJS) \$(PROGNAME) \$(CHARMONY_H) \$(TEST_OBJS) \$(TESTS) $self->{extra_clean}
+CLEANABLE= \$(OBJS) \$(PROGNAME) \$(CHARMONY_H) \$(TEST_OBJS) \$(TESTS) \$(FAKECC) $self->{extra_clean}
 
 $c2o_rule
 
@@ -257,12 +291,15 @@ $charmony_h_rule
 
 \$(TEST_OBJS): \$(CHARMONY_H)
 
-tests: \$(TESTS)
+tests: \$(TESTS) \$(FAKECC)
 
 $test_blocks
 
+$fakecc_rule
 $test_rule
 
+$bench_rule
+
 $clean_rule
 
 EOT
@@ -287,6 +324,8 @@ sub clean_rule      { shift->clean_rule_posix }
 sub meld_rule       { shift->meld_rule_posix }
 sub charmony_h_rule { shift->charmony_h_rule_posix }
 sub test_rule       { shift->test_rule_posix }
+sub bench_rule      { shift->bench_rule_posix }
+sub fakecc_rule     { shift->fakecc_rule_posix }
 sub pathify         { shift->unixify(@_) }
 
 package Charmonizer::Build::Makefile::MSVC;
@@ -322,6 +361,8 @@ sub clean_rule      { shift->clean_rule_win }
 sub meld_rule       { shift->meld_rule_win }
 sub charmony_h_rule { shift->charmony_h_rule_win }
 sub test_rule       { shift->test_rule_win }
+sub bench_rule      { shift->bench_rule_win }
+sub fakecc_rule     { shift->fakecc_rule_win }
 
 package Charmonizer::Build::Makefile::MinGW;
 BEGIN { our @ISA = qw( Charmonizer::Build::Makefile ) }
@@ -342,6 +383,8 @@ sub clean_rule      { shift->clean_rule_win }
 sub meld_rule       { shift->meld_rule_win }
 sub charmony_h_rule { shift->charmony_h_rule_win }
 sub test_rule       { shift->test_rule_win }
+sub bench_rule      { shift->bench_rule_win }
+sub fakecc_rule     { shift->fakecc_rule_win }
 
 ### actual script follows
 package main;
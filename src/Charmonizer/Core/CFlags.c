@@ -156,6 +156,46 @@ chaz_CFlags_enable_optimization(chaz_CFlags *flags) {
     chaz_CFlags_append(flags, string);
 }
 
+int
+chaz_CFlags_check_syntax_only(chaz_CFlags *flags) {
+    const char *string;
+    if (flags->style == CHAZ_CFLAGS_STYLE_MSVC) {
+        string = "/Zs";
+    }
+    else if (flags->style == CHAZ_CFLAGS_STYLE_GNU) {
+        string = "-fsyntax-only";
+    }
+    else if (flags->style == CHAZ_CFLAGS_STYLE_SUN_C) {
+        string = "-xe";
+    }
+    else {
+        /* POSIX */
+        return false;
+    }
+    chaz_CFlags_append(flags, string);
+    return true;
+}
+
+void
+chaz_CFlags_preprocess_only(chaz_CFlags *flags) {
+    if (flags->style == CHAZ_CFLAGS_STYLE_MSVC) {
+        chaz_CFlags_append(flags, "/E");
+    }
+    else {
+        chaz_CFlags_append(flags, "-E");
+    }
+}
+
+void
+chaz_CFlags_compile_quickly(chaz_CFlags *flags) {
+    if (flags->style == CHAZ_CFLAGS_STYLE_MSVC) {
+        chaz_CFlags_append(flags, "/Od");
+    }
+    else if (flags->style == CHAZ_CFLAGS_STYLE_GNU) {
+        chaz_CFlags_append(flags, "-O0 -g0 -pipe");
+    }
+}
+
 void
 chaz_CFlags_enable_debugging(chaz_CFlags *flags) {
     if (flags->style == CHAZ_CFLAGS_STYLE_GNU
@@ -64,6 +64,24 @@ chaz_CFlags_add_include_dir(chaz_CFlags *flags, const char *dir);
 void
 chaz_CFlags_enable_optimization(chaz_CFlags *flags);
 
+/* Add flags which make the compiler check the source without producing any
+ * output.  Return false, adding nothing, if there's no such mode.
+ */
+int
+chaz_CFlags_check_syntax_only(chaz_CFlags *flags);
+
+/* Add flags which make the compiler only preprocess the source, writing the
+ * result to stdout.
+ */
+void
+chaz_CFlags_preprocess_only(chaz_CFlags *flags);
+
+/* Add flags which minimize compile time at the expense of the output: no
+ * optimization and no debugging info.
+ */
+void
+chaz_CFlags_compile_quickly(chaz_CFlags *flags);
+
 void
 chaz_CFlags_disable_strict_aliasing(chaz_CFlags *flags);
 
@@ -0,0 +1,220 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "Charmonizer/Core/Cache.h"
+#include "Charmonizer/Core/OperatingSystem.h"
+#include "Charmonizer/Core/Util.h"
+
+/* Version tag at the start of every entry.  Bump it if the format changes. */
+#define CHAZ_CACHE_MAGIC "CHZ3"
+
+static struct {
+    char *dir;
+    int   serial;
+} chaz_Cache = { NULL, 0 };
+
+/* Return the path of the entry for [key] in a newly allocated string.
+ */
+static char*
+chaz_Cache_path(const char *key);
+
+/* Multiply the 64-bit hash held in [hi] and [lo] by the FNV prime, modulo
+ * 2^64.
+ */
+static void
+chaz_Cache_fnv_multiply(unsigned long *hi, unsigned long *lo);
+
+void
+chaz_Cache_init(const char *dir) {
+    FILE *probe_fh;
+    char *probe_path;
+
+    if (dir == NULL || dir[0] == '\0') { return; }
+    if (chaz_Util_verbosity) {
+        printf("Using probe cache in '%s'...\n", dir);
+    }
+
+    /* Create the directory if necessary and make sure it's writable. */
+    chaz_Cache.dir = chaz_Util_strdup(dir);
+    probe_path = chaz_Cache_path("_charm_probe");
+    probe_fh = fopen(probe_path, "wb");
+    if (probe_fh == NULL) {
+        chaz_OS_mkdir(dir);
+        probe_fh = fopen(probe_path, "wb");
+    }
+    if (probe_fh == NULL) {
+        chaz_Util_warn("Can't write to cache directory '%s', cache disabled",
+                       dir);
+        free(chaz_Cache.dir);
+        chaz_Cache.dir = NULL;
+    }
+    else {
+        fclose(probe_fh);
+        remove(probe_path);
+    }
+    free(probe_path);
+}
+
+void
+chaz_Cache_clean_up(void) {
+    free(chaz_Cache.dir);
+    chaz_Cache.dir = NULL;
+}
+
+int
+chaz_Cache_enabled(void) {
+    return chaz_Cache.dir != NULL;
+}
+
+char*
+chaz_Cache_key(const char *part, ...) {
+    /* A 64-bit FNV-1a hash, kept in two 32-bit halves since C89 has no
+     * 64-bit integer type. */
+    unsigned long hash_hi = 0xCBF29CE4UL;
+    unsigned long hash_lo = 0x84222325UL;
+    char *key = (char*)malloc(17);
+    va_list args;
+
+    va_start(args, part);
+    while (part != NULL) {
+        /* Hash the terminating NUL as well, so that ("ab", "c") and
+         * ("a", "bc") produce different keys. */
+        size_t len = strlen(part) + 1;
+        size_t i;
+        for (i = 0; i < len; i++) {
+            hash_lo ^= (unsigned char)part[i];
+            chaz_Cache_fnv_multiply(&hash_hi, &hash_lo);
+        }
+        part = va_arg(args, const char*);
+    }
+    va_end(args);
+
+    sprintf(key, "%08lx%08lx", hash_hi, hash_lo);
+    return key;
+}
+
+static void
+chaz_Cache_fnv_multiply(unsigned long *hi, unsigned long *lo) {
+    /* The prime is 2^40 + 0x1B3.  Multiply the low half by 0x1B3 sixteen
+     * bits at a time, so that nothing overflows 32 bits, and carry into
+     * the high half, which also gets the low half shifted up by 40. */
+    unsigned long low16  = (*lo & 0xFFFFUL) * 0x1B3UL;
+    unsigned long high16 = (*lo >> 16) * 0x1B3UL + (low16 >> 16);
+    unsigned long new_lo = ((high16 & 0xFFFFUL) << 16) | (low16 & 0xFFFFUL);
+
+    *hi = (*hi * 0x1B3UL + (high16 >> 16) + (*lo << 8)) & 0xFFFFFFFFUL;
+    *lo = new_lo;
+}
+
+static char*
+chaz_Cache_path(const char *key) {
+    return chaz_Util_join("", chaz_Cache.dir, chaz_OS_dir_sep(), key, NULL);
+}
+
+int
+chaz_Cache_fetch(const char *key, int *result, char **output,
+                 size_t *output_len) {
+    char          *path;
+    FILE          *fh;
+    char           magic[5];
+    int            stored_result;
+    int            has_output;
+    unsigned long  stored_len;
+    int            hit = false;
+
+    if (!chaz_Cache.dir) { return false; }
+
+    path = chaz_Cache_path(key);
+    fh = fopen(path, "rb");
+    free(path);
+    if (fh == NULL) { return false; }
+
+    if (fscanf(fh, "%4s %d %d %lu", magic, &stored_result, &has_output,
+               &stored_len) == 4
+        && strcmp(magic, CHAZ_CACHE_MAGIC) == 0
+        && fgetc(fh) == '\n'
+       ) {
+        char *buf = (char*)malloc(stored_len + 1);
+        if (fread(buf, 1, stored_len, fh) == stored_len) {
+            buf[stored_len] = '\0';
+            hit = true;
+            *result = stored_result;
+            if (output_len) { *output_len = stored_len; }
+
+            /* An empty output is still an output: only a probe which
+             * produced none at all gets NULL. */
+            if (output && has_output) {
+                *output = buf;
+                buf = NULL;
+            }
+            else if (output) {
+                *output = NULL;
+            }
+        }
+        free(buf);
+    }
+    fclose(fh);
+
+    if (hit && chaz_Util_verbosity >= 2) {
+        printf("Probe cache hit: %s\n", key);
+    }
+    return hit;
+}
+
+void
+chaz_Cache_store(const char *key, int result, const char *output,
+                 size_t output_len) {
+    char *path;
+    char *temp_path;
+    char  suffix[60];
+    FILE *fh;
+    int   failed;
+
+    if (!chaz_Cache.dir) { return; }
+    if (output == NULL) { output_len = 0; }
+
+    /* Write to a file only this process knows about, then rename it into
+     * place so that readers never see a partial entry. */
+    path = chaz_Cache_path(key);
+    sprintf(suffix, ".tmp%d_%d_%lu", chaz_OS_pid(), ++chaz_Cache.serial,
+            (unsigned long)time(NULL));
+    temp_path = chaz_Util_join("", path, suffix, NULL);
+    fh = fopen(temp_path, "wb");
+    if (fh == NULL) {
+        free(temp_path);
+        free(path);
+        return;
+    }
+    fprintf(fh, "%s %d %d %lu\n", CHAZ_CACHE_MAGIC, result,
+            output != NULL, (unsigned long)output_len);
+    failed = output_len && fwrite(output, 1, output_len, fh) != output_len;
+    failed = fclose(fh) != 0 || failed;
+
+    /* Losing the race to another process is fine, since its entry has the
+     * same content.  rename() can't replace existing files on Windows. */
+    if (failed || rename(temp_path, path) != 0) {
+        remove(temp_path);
+    }
+
+    free(temp_path);
+    free(path);
+}
+
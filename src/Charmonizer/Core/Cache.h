@@ -0,0 +1,77 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Charmonizer/Core/Cache.h -- persistent, content-addressed probe results.
+ *
+ * Probe results are stored on disk, one file per result, under a name
+ * derived from a hash of everything which can influence the result.  Entries
+ * are never modified in place: each one is written to a private temporary
+ * file and then renamed into position, so several processes may share one
+ * cache directory.
+ */
+
+#ifndef H_CHAZ_CACHE
+#define H_CHAZ_CACHE
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "Charmonizer/Core/Defines.h"
+
+/* Enable the cache, storing entries in [dir], which is created if
+ * necessary.  If [dir] is NULL or empty, the cache stays disabled.
+ */
+void
+chaz_Cache_init(const char *dir);
+
+void
+chaz_Cache_clean_up(void);
+
+/* Return true if the cache is enabled.
+ */
+int
+chaz_Cache_enabled(void);
+
+/* Hash a NULL-terminated list of strings into a newly allocated key.
+ */
+char*
+chaz_Cache_key(const char *part, ...);
+
+/* Look up [key].  On a hit, return true, store the result code in [result]
+ * and -- if [output] is not NULL -- a newly allocated copy of the stored
+ * output in [output].  An output which was stored as NULL is returned as
+ * NULL; an empty one as an empty string.
+ */
+int
+chaz_Cache_fetch(const char *key, int *result, char **output,
+                 size_t *output_len);
+
+/* Store a result code and an optional output under [key].  A NULL
+ * [output], which usually means that the probe failed, is kept apart from
+ * an empty one.
+ */
+void
+chaz_Cache_store(const char *key, int result, const char *output,
+                 size_t output_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H_CHAZ_CACHE */
+
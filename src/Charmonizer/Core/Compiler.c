@@ -14,31 +14,133 @@
  * limitations under the License.
  */
 
+#include <ctype.h>
 #include <string.h>
 #include <stdlib.h>
 #include "Charmonizer/Core/Util.h"
+#include "Charmonizer/Core/Cache.h"
 #include "Charmonizer/Core/Compiler.h"
 #include "Charmonizer/Core/ConfWriter.h"
+#include "Charmonizer/Core/Memo.h"
 #include "Charmonizer/Core/OperatingSystem.h"
+#include "Charmonizer/Core/Scratch.h"
+#include "Charmonizer/Core/Trace.h"
 
-/* Detect macros which may help to identify some compilers.
+/* Identify the compiler with a single run of its preprocessor, filling the
+ * predefined macro table.  Also find out whether the compiler can read
+ * source code from stdin.
  */
 static void
-chaz_CC_detect_known_compilers(void);
+chaz_CC_identify(void);
+
+/* Preprocess [source] -- from stdin if [path] is NULL -- adding [flags], and
+ * parse the output into the macro table.  Return the number of macros found
+ * and store the raw output in [output].
+ */
+static size_t
+chaz_CC_read_macros(const char *path, const char *source, const char *flags,
+                    char **output);
+
+/* Parse a line of preprocessor output: either a #define from a macro dump
+ * or a line of the source built by chaz_CC_identify.
+ */
+static void
+chaz_CC_parse_macro_line(const char *line, size_t len);
+
+static int
+chaz_CC_compare_macros(const void *va, const void *vb);
+
+/* Return the value of a numeric macro, or 0 if it isn't defined.
+ */
+static int
+chaz_CC_macro_int(const char *name);
+
+/* Identify the compiler precisely enough that probe results may be shared
+ * between runs via the probe cache.  [macro_output] is the output of the
+ * preprocessor run which identified it.
+ */
+static void
+chaz_CC_compute_fingerprint(const char *macro_output);
+
+/* Compile [code] into an executable or object, with flags that make the
+ * compiler go faster if [quick] is true.
+ */
+static int
+chaz_CC_build_exe(const char *source_path, const char *exe_name,
+                  const char *code, int quick);
+static int
+chaz_CC_build_obj(const char *source_path, const char *obj_name,
+                  const char *code, int quick);
+
+/* Write [code] to [source_path] and run the compiler on it, adding
+ * [local_cflags] after all other flags.  Remove the source file afterwards
+ * and return the compiler's exit status.  The run is traced as an event of
+ * [category].  If [output] isn't NULL, the compiler's output is captured
+ * into a newly allocated buffer stored there.
+ */
+static int
+chaz_CC_run_compiler(const char *source_path, const char *code,
+                     chaz_CFlags *local_cflags, const char *category,
+                     char **output, size_t *output_len);
+
+/* Return the part of [code] which tells probes apart in a trace: whatever
+ * follows the #include lines at the top.
+ */
+static const char*
+chaz_CC_trace_name(const char *code);
+
+/* Collect the marker strings in the object file [obj_file] for
+ * chaz_CC_compile_and_extract.
+ */
+static void
+chaz_CC_scan_markers(const char *obj_file, char **output,
+                     size_t *output_len);
+
+/* Return true if probes may take the shortcuts of the fast probe mode,
+ * which needs the cflags style to be known.
+ */
+static int
+chaz_CC_fast(void);
+
+/* Return true if probe results of kind [kind] go into the probe cache.
+ */
+static int
+chaz_CC_cacheable(int kind);
+
+/* Return a newly allocated probe cache key for [source].
+ */
+static char*
+chaz_CC_cache_key(int kind, const char *source);
+
+/* Return a copy of [source] without indentation, trailing whitespace or
+ * blank lines, so that the same probe written out differently by two
+ * modules gets the same key.
+ */
+static char*
+chaz_CC_normalize_source(const char *source);
 
 /* Temporary files. */
-#define CHAZ_CC_TRY_SOURCE_PATH  "_charmonizer_try.c"
 #define CHAZ_CC_TRY_BASENAME     "_charmonizer_try"
-#define CHAZ_CC_TARGET_PATH      "_charmonizer_target"
+#define CHAZ_CC_IDENT_BASENAME   "_charmonizer_ident"
+
+/* A predefined macro. */
+typedef struct chaz_CC_Macro {
+    char *name;
+    char *value;
+} chaz_CC_Macro;
 
 /* Static vars. */
 static struct {
     char     *cc_command;
     char     *cflags;
-    char     *try_exe_name;
+    char     *fingerprint;
     char      obj_ext[10];
     char      gcc_version_str[30];
     int       cflags_style;
+    int       style_detected;
+    int       stdin_source;
+    int       probe_mode;
+    int       can_run;
     int       intval___GNUC__;
     int       intval___GNUC_MINOR__;
     int       intval___GNUC_PATCHLEVEL__;
@@ -47,18 +149,42 @@ static struct {
     int       intval___SUNPRO_C;
     chaz_CFlags *extra_cflags;
     chaz_CFlags *temp_cflags;
+    chaz_CC_Macro *macros;
+    size_t    num_macros;
+    size_t    cap_macros;
+    int       macros_complete;
 } chaz_CC = {
     NULL, NULL, NULL,
     "", "",
-    0, 0, 0, 0, 0, 0, 0,
-    NULL, NULL
+    0, 0, 0, CHAZ_CC_PROBE_MODE_FAST, 1,
+    0, 0, 0, 0, 0, 0,
+    NULL, NULL,
+    NULL, 0, 0, 0
+};
+
+/* Macros looked up when the compiler can't dump all of its predefined
+ * macros.
+ */
+static const char *const chaz_CC_ident_macros[] = {
+    "__GNUC__", "__GNUC_MINOR__", "__GNUC_PATCHLEVEL__", "__VERSION__",
+    "__clang__", "__clang_major__", "__clang_minor__",
+    "_MSC_VER", "_MSC_FULL_VER", "_MSC_EXTENSIONS", "__SUNPRO_C",
+    "__INTEL_COMPILER",
+    "__STDC__", "__STDC_VERSION__", "__cplusplus",
+    "_WIN32", "_WIN64", "__CYGWIN__", "__MINGW32__", "__APPLE__", "__MACH__",
+    "__linux__", "__unix__", "__sun", "__FreeBSD__", "__NetBSD__",
+    "__OpenBSD__",
+    "_LP64", "__LP64__", "__CHAR_BIT__", "__SIZEOF_INT__",
+    "__SIZEOF_LONG__", "__SIZEOF_POINTER__", "__BYTE_ORDER__",
+    "__ORDER_LITTLE_ENDIAN__", "__ORDER_BIG_ENDIAN__",
+    "_M_IX86", "_M_X64", "_M_ARM", "_M_ARM64", "__i386__", "__x86_64__",
+    "__aarch64__", "__arm__", "__sparc", "__powerpc__", "__powerpc64__",
+    "__s390__", "__s390x__", "__mips__", "__riscv",
+    NULL
 };
 
 void
 chaz_CC_init(const char *compiler_command, const char *compiler_flags) {
-    const char *code = "int main() { return 0; }\n";
-    int compile_succeeded = 0;
-
     if (chaz_Util_verbosity) { printf("Creating compiler object...\n"); }
 
     /* Assign, init. */
@@ -67,29 +193,7 @@ chaz_CC_init(const char *compiler_command, const char *compiler_flags) {
     chaz_CC.extra_cflags = NULL;
     chaz_CC.temp_cflags  = NULL;
 
-    /* Set names for the targets which we "try" to compile. */
-    chaz_CC.try_exe_name
-        = chaz_Util_join("", CHAZ_CC_TRY_BASENAME, chaz_OS_exe_ext(), NULL);
-
-    /* If we can't compile anything, game over. */
-    if (chaz_Util_verbosity) {
-        printf("Trying to compile a small test file...\n");
-    }
-    /* Try MSVC argument style. */
-    strcpy(chaz_CC.obj_ext, ".obj");
-    chaz_CC.cflags_style = CHAZ_CFLAGS_STYLE_MSVC;
-    compile_succeeded = chaz_CC_test_compile(code);
-    if (!compile_succeeded) {
-        /* Try POSIX argument style. */
-        strcpy(chaz_CC.obj_ext, ".o");
-        chaz_CC.cflags_style = CHAZ_CFLAGS_STYLE_POSIX;
-        compile_succeeded = chaz_CC_test_compile(code);
-    }
-    if (!compile_succeeded) {
-        chaz_Util_die("Failed to compile a small test file");
-    }
-
-    chaz_CC_detect_known_compilers();
+    chaz_CC_identify();
 
     if (chaz_CC.intval___GNUC__) {
         chaz_CC.cflags_style = CHAZ_CFLAGS_STYLE_GNU;
@@ -103,61 +207,350 @@ chaz_CC_init(const char *compiler_command, const char *compiler_flags) {
     else {
         chaz_CC.cflags_style = CHAZ_CFLAGS_STYLE_POSIX;
     }
+    strcpy(chaz_CC.obj_ext, chaz_CC.intval__MSC_VER ? ".obj" : ".o");
     chaz_CC.extra_cflags = chaz_CFlags_new(chaz_CC.cflags_style);
     chaz_CC.temp_cflags  = chaz_CFlags_new(chaz_CC.cflags_style);
-}
 
-static const char chaz_CC_detect_macro_code[] =
-    CHAZ_QUOTE(  #include <stdio.h>             )
-    CHAZ_QUOTE(  int main() {                   )
-    CHAZ_QUOTE(  #ifndef %s                     )
-    CHAZ_QUOTE(  #error "nope"                  )
-    CHAZ_QUOTE(  #endif                         )
-    CHAZ_QUOTE(      printf("%%d", %s);         )
-    CHAZ_QUOTE(      return 0;                  )
-    CHAZ_QUOTE(  }                              );
+    /* Only now is it safe to pick compiler options based on the style. */
+    chaz_CC.style_detected = true;
 
-static int
-chaz_CC_detect_macro(const char *macro) {
-    size_t size = sizeof(chaz_CC_detect_macro_code)
-                  + (strlen(macro) * 2)
-                  + 20;
-    char *code = (char*)malloc(size);
-    int retval = 0;
-    char *output;
-    size_t len;
-    sprintf(code, chaz_CC_detect_macro_code, macro, macro);
-    output = chaz_CC_capture_output(code, &len);
-    if (output) {
-        retval = atoi(output);
-        free(output);
+    /* Identification only ran the preprocessor.  If we can't compile and
+     * link anything, game over. */
+    if (chaz_Util_verbosity) {
+        printf("Trying to compile a small test file...\n");
+    }
+    if (!chaz_CC_test_link("int main() { return 0; }\n")) {
+        chaz_Util_die("Failed to compile a small test file");
     }
-    free(code);
-    return retval;
 }
 
 static void
-chaz_CC_detect_known_compilers(void) {
-    chaz_CC.intval___GNUC__  = chaz_CC_detect_macro("__GNUC__");
+chaz_CC_identify(void) {
+    char   *path   = chaz_Scratch_path(CHAZ_CC_IDENT_BASENAME ".c");
+    char   *output = NULL;
+    char   *source;
+    size_t  source_len = 1;
+    size_t  num_found  = 0;
+    size_t  i;
+
+    if (chaz_Util_verbosity) { printf("Identifying the compiler...\n"); }
+
+    /* Each line names a macro in quotes, which protect it from the
+     * preprocessor, followed by the macro itself, which gets replaced by its
+     * value if it's defined. */
+    for (i = 0; chaz_CC_ident_macros[i] != NULL; i++) {
+        source_len += strlen(chaz_CC_ident_macros[i]) * 2 + 20;
+    }
+    source = (char*)malloc(source_len);
+    source[0] = '\0';
+    for (i = 0; chaz_CC_ident_macros[i] != NULL; i++) {
+        const char *macro = chaz_CC_ident_macros[i];
+        sprintf(source + strlen(source), "chaz_macro \"%s\" %s\n", macro,
+                macro);
+    }
+
+    /* GCC and compatible compilers dump all of their predefined macros,
+     * reading the source from stdin where they can.  Others ignore or
+     * reject -dM, in which case the plain preprocessor output will do. */
+    if (chaz_OS_can_pipe()) {
+        num_found = chaz_CC_read_macros(NULL, source, "-dM -E", &output);
+        if (num_found > 0 && chaz_CC.macros_complete) {
+            chaz_CC.stdin_source = true;
+        }
+        else {
+            num_found = 0;
+        }
+    }
+    if (num_found == 0) {
+        chaz_Util_write_file(path, source);
+        num_found = chaz_CC_read_macros(path, source, "-dM -E", &output);
+        if (num_found == 0) {
+            num_found = chaz_CC_read_macros(path, source, "-E", &output);
+        }
+        chaz_Util_remove_and_verify(path);
+    }
+    if (num_found == 0) {
+        chaz_Util_die("Failed to run the preprocessor of '%s'",
+                      chaz_CC.cc_command);
+    }
+    qsort(chaz_CC.macros, chaz_CC.num_macros, sizeof(chaz_CC_Macro),
+          chaz_CC_compare_macros);
+
+    chaz_CC.intval___GNUC__ = chaz_CC_macro_int("__GNUC__");
     if (chaz_CC.intval___GNUC__) {
         chaz_CC.intval___GNUC_MINOR__
-            = chaz_CC_detect_macro("__GNUC_MINOR__");
+            = chaz_CC_macro_int("__GNUC_MINOR__");
         chaz_CC.intval___GNUC_PATCHLEVEL__
-            = chaz_CC_detect_macro("__GNUC_PATCHLEVEL__");
+            = chaz_CC_macro_int("__GNUC_PATCHLEVEL__");
         sprintf(chaz_CC.gcc_version_str, "%d.%d.%d", chaz_CC.intval___GNUC__,
                 chaz_CC.intval___GNUC_MINOR__,
                 chaz_CC.intval___GNUC_PATCHLEVEL__);
     }
-    chaz_CC.intval__MSC_VER   = chaz_CC_detect_macro("_MSC_VER");
-    chaz_CC.intval___clang__  = chaz_CC_detect_macro("__clang__");
-    chaz_CC.intval___SUNPRO_C = chaz_CC_detect_macro("__SUNPRO_C");
+    chaz_CC.intval__MSC_VER   = chaz_CC_macro_int("_MSC_VER");
+    chaz_CC.intval___clang__  = chaz_CC_macro_int("__clang__");
+    chaz_CC.intval___SUNPRO_C = chaz_CC_macro_int("__SUNPRO_C");
+
+    if (chaz_Cache_enabled()) {
+        chaz_CC_compute_fingerprint(output);
+    }
+
+    free(output);
+    free(source);
+    free(path);
+}
+
+static size_t
+chaz_CC_read_macros(const char *path, const char *source, const char *flags,
+                    char **output) {
+    char   *command;
+    size_t  output_len = 0;
+    size_t  i;
+    int     status = 0;
+
+    for (i = 0; i < chaz_CC.num_macros; i++) {
+        free(chaz_CC.macros[i].name);
+        free(chaz_CC.macros[i].value);
+    }
+    chaz_CC.num_macros      = 0;
+    chaz_CC.macros_complete = false;
+    free(*output);
+    *output = NULL;
+
+    if (path) {
+        command = chaz_Util_join(" ", chaz_CC.cc_command, chaz_CC.cflags,
+                                 flags, path, NULL);
+        *output = chaz_OS_run_and_capture(command, &output_len);
+    }
+    else {
+        command = chaz_Util_join(" ", chaz_CC.cc_command, chaz_CC.cflags,
+                                 "-x c - -x none", flags, NULL);
+        status = chaz_OS_run_piped(command, source, strlen(source), output,
+                                   &output_len);
+    }
+    free(command);
+    if (*output == NULL || status != 0) { return 0; }
+
+    for (i = 0; i < output_len; ) {
+        size_t len = 0;
+        while (i + len < output_len && (*output)[i + len] != '\n') { len++; }
+        chaz_CC_parse_macro_line(*output + i, len);
+        i += len + 1;
+    }
+
+    return chaz_CC.num_macros;
+}
+
+static void
+chaz_CC_parse_macro_line(const char *line, size_t len) {
+    const char *end = line + len;
+    const char *name;
+    const char *name_end;
+    const char *value;
+    size_t      name_len;
+    size_t      value_len;
+    int         from_dump = false;
+    chaz_CC_Macro *macro;
+
+    while (line < end && isspace((unsigned char)*line)) { line++; }
+    while (end > line && isspace((unsigned char)end[-1])) { end--; }
+
+    if (end - line > 8 && strncmp(line, "#define ", 8) == 0) {
+        name = line + 8;
+        name_end = name;
+        while (name_end < end
+               && (isalnum((unsigned char)*name_end) || *name_end == '_')
+              ) {
+            name_end++;
+        }
+        /* Skip function-like macros. */
+        if (name_end < end && *name_end == '(') { return; }
+        value = name_end;
+        from_dump = true;
+    }
+    else if (end - line > 12 && strncmp(line, "chaz_macro \"", 12) == 0) {
+        name = line + 12;
+        name_end = name;
+        while (name_end < end && *name_end != '"') { name_end++; }
+        if (name_end == end) { return; }
+        value = name_end + 1;
+    }
+    else {
+        return;
+    }
+    while (value < end && isspace((unsigned char)*value)) { value++; }
+    name_len  = (size_t)(name_end - name);
+    value_len = (size_t)(end - value);
+    if (name_len == 0) { return; }
+
+    /* An undefined macro comes out of the preprocessor unchanged. */
+    if (!from_dump
+        && value_len == name_len
+        && strncmp(value, name, name_len) == 0
+       ) {
+        return;
+    }
+
+    if (from_dump) { chaz_CC.macros_complete = true; }
+    if (chaz_CC.num_macros == chaz_CC.cap_macros) {
+        chaz_CC.cap_macros = chaz_CC.cap_macros ? chaz_CC.cap_macros * 2 : 64;
+        chaz_CC.macros
+            = (chaz_CC_Macro*)realloc(chaz_CC.macros,
+                                      chaz_CC.cap_macros
+                                      * sizeof(chaz_CC_Macro));
+    }
+    macro = &chaz_CC.macros[chaz_CC.num_macros++];
+    macro->name = (char*)malloc(name_len + 1);
+    memcpy(macro->name, name, name_len);
+    macro->name[name_len] = '\0';
+    macro->value = (char*)malloc(value_len + 1);
+    memcpy(macro->value, value, value_len);
+    macro->value[value_len] = '\0';
+}
+
+static int
+chaz_CC_compare_macros(const void *va, const void *vb) {
+    const chaz_CC_Macro *a = (const chaz_CC_Macro*)va;
+    const chaz_CC_Macro *b = (const chaz_CC_Macro*)vb;
+    return strcmp(a->name, b->name);
+}
+
+const char*
+chaz_CC_macro_value(const char *name) {
+    chaz_CC_Macro  key;
+    chaz_CC_Macro *found;
+    if (chaz_CC.num_macros == 0) { return NULL; }
+    key.name  = (char*)name;
+    key.value = NULL;
+    found = (chaz_CC_Macro*)bsearch(&key, chaz_CC.macros, chaz_CC.num_macros,
+                                    sizeof(chaz_CC_Macro),
+                                    chaz_CC_compare_macros);
+    return found ? found->value : NULL;
+}
+
+int
+chaz_CC_macros_complete(void) {
+    return chaz_CC.macros_complete;
+}
+
+static int
+chaz_CC_macro_int(const char *name) {
+    const char *value = chaz_CC_macro_value(name);
+    return value ? (int)strtol(value, NULL, 0) : 0;
+}
+
+static void
+chaz_CC_compute_fingerprint(const char *macro_output) {
+    char   *version = NULL;
+    size_t  len;
+
+    /* A complete macro dump includes the compiler's version.  Otherwise
+     * ask for it. */
+    if (!chaz_CC.macros_complete) {
+        char *command = chaz_Util_join(" ", chaz_CC.cc_command, "--version",
+                                       NULL);
+        version = chaz_OS_run_and_capture(command, &len);
+        free(command);
+    }
+    chaz_CC.fingerprint = chaz_Cache_key(chaz_CC.cc_command, chaz_CC.cflags,
+                                         macro_output ? macro_output : "",
+                                         version ? version : "", NULL);
+    free(version);
+}
+
+static int
+chaz_CC_cacheable(int kind) {
+    /* Output captured without running anything isn't worth keeping. */
+    return chaz_CC.fingerprint != NULL
+           && (chaz_CC.can_run || kind != CHAZ_CC_PROBE_CAPTURE);
+}
+
+static char*
+chaz_CC_cache_key(int kind, const char *source) {
+    const char *extra_cflags_string = "";
+    const char *temp_cflags_string  = "";
+    char *normalized = chaz_CC_normalize_source(source);
+    char *key;
+    char style[20];
+    if (chaz_CC.extra_cflags) {
+        extra_cflags_string = chaz_CFlags_get_string(chaz_CC.extra_cflags);
+    }
+    if (chaz_CC.temp_cflags) {
+        temp_cflags_string = chaz_CFlags_get_string(chaz_CC.temp_cflags);
+    }
+    sprintf(style, "%d %d %d", kind, chaz_CC.cflags_style, chaz_CC_fast());
+    key = chaz_Cache_key(style,
+                         chaz_CC.fingerprint ? chaz_CC.fingerprint : "",
+                         chaz_CC.obj_ext, extra_cflags_string,
+                         temp_cflags_string, normalized, NULL);
+    free(normalized);
+    return key;
+}
+
+static char*
+chaz_CC_normalize_source(const char *source) {
+    char *normalized = (char*)malloc(strlen(source) + 1);
+    char *end = normalized;
+    while (*source != '\0') {
+        const char *line_end = source + strcspn(source, "\n");
+        const char *last     = line_end;
+        while (source < line_end && isspace((unsigned char)*source)) {
+            source++;
+        }
+        while (last > source && isspace((unsigned char)last[-1])) {
+            last--;
+        }
+        if (last > source) {
+            memcpy(end, source, (size_t)(last - source));
+            end += last - source;
+            *end++ = '\n';
+        }
+        source = *line_end == '\n' ? line_end + 1 : line_end;
+    }
+    *end = '\0';
+    return normalized;
+}
+
+int
+chaz_CC_cache_fetch(int kind, const char *source, int *succeeded,
+                    char **output, size_t *output_len) {
+    char *key = chaz_CC_cache_key(kind, source);
+    int   hit = chaz_Memo_fetch(kind, key, succeeded, output, output_len);
+    if (!hit && chaz_CC_cacheable(kind)) {
+        hit = chaz_Cache_fetch(key, succeeded, output, output_len);
+        if (hit) {
+            chaz_Memo_store(kind, key, *succeeded, output ? *output : NULL,
+                            output ? *output_len : 0);
+        }
+    }
+    free(key);
+    return hit;
+}
+
+void
+chaz_CC_cache_store(int kind, const char *source, int succeeded,
+                    const char *output, size_t output_len) {
+    char *key = chaz_CC_cache_key(kind, source);
+    chaz_Memo_store(kind, key, succeeded, output, output_len);
+    if (chaz_CC_cacheable(kind)) {
+        chaz_Cache_store(key, succeeded, output, output_len);
+    }
+    free(key);
 }
 
 void
 chaz_CC_clean_up(void) {
+    size_t i;
+    for (i = 0; i < chaz_CC.num_macros; i++) {
+        free(chaz_CC.macros[i].name);
+        free(chaz_CC.macros[i].value);
+    }
+    free(chaz_CC.macros);
+    chaz_CC.macros     = NULL;
+    chaz_CC.num_macros = 0;
+    chaz_CC.cap_macros = 0;
     free(chaz_CC.cc_command);
     free(chaz_CC.cflags);
-    free(chaz_CC.try_exe_name);
+    free(chaz_CC.fingerprint);
     chaz_CFlags_destroy(chaz_CC.extra_cflags);
     chaz_CFlags_destroy(chaz_CC.temp_cflags);
 }
@@ -165,35 +558,22 @@ chaz_CC_clean_up(void) {
 int
 chaz_CC_compile_exe(const char *source_path, const char *exe_name,
                     const char *code) {
+    return chaz_CC_build_exe(source_path, exe_name, code, false);
+}
+
+static int
+chaz_CC_build_exe(const char *source_path, const char *exe_name,
+                  const char *code, int quick) {
     chaz_CFlags *local_cflags = chaz_CFlags_new(chaz_CC.cflags_style);
-    const char *extra_cflags_string = "";
-    const char *temp_cflags_string  = "";
-    const char *local_cflags_string;
     char *exe_file = chaz_Util_join("", exe_name, chaz_OS_exe_ext(), NULL);
-    char *command;
     int result;
 
-    /* Write the source file. */
-    chaz_Util_write_file(source_path, code);
-
-    /* Prepare and run the compiler command. */
-    if (chaz_CC.extra_cflags) {
-        extra_cflags_string = chaz_CFlags_get_string(chaz_CC.extra_cflags);
-    }
-    if (chaz_CC.temp_cflags) {
-        temp_cflags_string = chaz_CFlags_get_string(chaz_CC.temp_cflags);
+    if (quick) {
+        chaz_CFlags_compile_quickly(local_cflags);
     }
     chaz_CFlags_set_output_exe(local_cflags, exe_file);
-    local_cflags_string = chaz_CFlags_get_string(local_cflags);
-    command = chaz_Util_join(" ", chaz_CC.cc_command, chaz_CC.cflags,
-                             source_path, extra_cflags_string,
-                             temp_cflags_string, local_cflags_string, NULL);
-    if (chaz_Util_verbosity < 2) {
-        chaz_OS_run_quietly(command);
-    }
-    else {
-        system(command);
-    }
+    chaz_CC_run_compiler(source_path, code, local_cflags, CHAZ_TRACE_LINK,
+                         NULL, NULL);
 
     if (chaz_CC.intval__MSC_VER) {
         /* Zap MSVC junk. */
@@ -208,14 +588,10 @@ chaz_CC_compile_exe(const char *source_path, const char *exe_name,
         free(junk);
     }
 
-    /* See if compilation was successful.  Remove the source file. */
+    /* See if compilation was successful. */
     result = chaz_Util_can_open_file(exe_file);
-    if (!chaz_Util_remove_and_verify(source_path)) {
-        chaz_Util_die("Failed to remove '%s'", source_path);
-    }
 
     chaz_CFlags_destroy(local_cflags);
-    free(command);
     free(exe_file);
     return result;
 }
@@ -223,16 +599,48 @@ chaz_CC_compile_exe(const char *source_path, const char *exe_name,
 int
 chaz_CC_compile_obj(const char *source_path, const char *obj_name,
                     const char *code) {
+    return chaz_CC_build_obj(source_path, obj_name, code, false);
+}
+
+static int
+chaz_CC_build_obj(const char *source_path, const char *obj_name,
+                  const char *code, int quick) {
     chaz_CFlags *local_cflags = chaz_CFlags_new(chaz_CC.cflags_style);
+    char *obj_file = chaz_Util_join("", obj_name, chaz_CC.obj_ext, NULL);
+    int result;
+
+    if (quick) {
+        chaz_CFlags_compile_quickly(local_cflags);
+    }
+    chaz_CFlags_set_output_obj(local_cflags, obj_file);
+    chaz_CC_run_compiler(source_path, code, local_cflags,
+                         CHAZ_TRACE_COMPILE, NULL, NULL);
+
+    /* See if compilation was successful. */
+    result = chaz_Util_can_open_file(obj_file);
+
+    chaz_CFlags_destroy(local_cflags);
+    free(obj_file);
+    return result;
+}
+
+static int
+chaz_CC_run_compiler(const char *source_path, const char *code,
+                     chaz_CFlags *local_cflags, const char *category,
+                     char **output, size_t *output_len) {
     const char *extra_cflags_string = "";
     const char *temp_cflags_string  = "";
-    const char *local_cflags_string;
-    char *obj_file = chaz_Util_join("", obj_name, chaz_CC.obj_ext, NULL);
+    const char *source_arg = chaz_CC.stdin_source
+                             ? "-x c - -x none"
+                             : source_path;
     char *command;
-    int result;
+    double start;
+    int status;
 
-    /* Write the source file. */
-    chaz_Util_write_file(source_path, code);
+    /* Write the source file, unless the compiler gets it through stdin. */
+    if (!chaz_CC.stdin_source) {
+        chaz_Util_write_file(source_path, code);
+    }
 
     /* Prepare and run the compiler command. */
     if (chaz_CC.extra_cflags) {
@@ -241,79 +649,439 @@ chaz_CC_compile_obj(const char *source_path, const char *obj_name,
     if (chaz_CC.temp_cflags) {
         temp_cflags_string = chaz_CFlags_get_string(chaz_CC.temp_cflags);
     }
-    chaz_CFlags_set_output_obj(local_cflags, obj_file);
-    local_cflags_string = chaz_CFlags_get_string(local_cflags);
     command = chaz_Util_join(" ", chaz_CC.cc_command, chaz_CC.cflags,
-                             source_path, extra_cflags_string,
-                             temp_cflags_string, local_cflags_string, NULL);
-    if (chaz_Util_verbosity < 2) {
-        chaz_OS_run_quietly(command);
+                             source_arg, extra_cflags_string,
+                             temp_cflags_string,
+                             chaz_CFlags_get_string(local_cflags), NULL);
+    start = chaz_Trace_now();
+    if (output != NULL && chaz_CC.stdin_source) {
+        status = chaz_OS_run_piped(command, code, strlen(code), output,
+                                   output_len);
+    }
+    else if (output != NULL) {
+        *output = chaz_OS_run_and_capture_status(command, output_len,
+                                                 &status);
+    }
+    else if (chaz_CC.stdin_source) {
+        char   *shown = NULL;
+        size_t  shown_len;
+        status = chaz_OS_run_piped(command, code, strlen(code),
+                                   chaz_Util_verbosity < 2 ? NULL : &shown,
+                                   &shown_len);
+        if (shown != NULL) {
+            fwrite(shown, 1, shown_len, stdout);
+            free(shown);
+        }
+    }
+    else if (chaz_Util_verbosity < 2) {
+        status = chaz_OS_run_quietly(command);
     }
     else {
-        system(command);
+        status = chaz_OS_run(command);
     }
+    chaz_Trace_event(category, chaz_CC_trace_name(code), start, status);
+    free(command);
 
-    /* See if compilation was successful.  Remove the source file. */
-    result = chaz_Util_can_open_file(obj_file);
-    if (!chaz_Util_remove_and_verify(source_path)) {
+    /* Remove the source file. */
+    if (!chaz_CC.stdin_source
+        && !chaz_Util_remove_and_verify(source_path)
+       ) {
         chaz_Util_die("Failed to remove '%s'", source_path);
     }
+    return status;
+}
 
-    chaz_CFlags_destroy(local_cflags);
-    free(command);
-    free(obj_file);
-    return result;
+static const char*
+chaz_CC_trace_name(const char *code) {
+    const char *ptr = code;
+    while (*ptr != '\0') {
+        if (isspace((unsigned char)*ptr)) {
+            ptr++;
+        }
+        else if (strncmp(ptr, "#include", 8) == 0) {
+            ptr += strcspn(ptr, "\n");
+        }
+        else {
+            return ptr;
+        }
+    }
+    return code;
+}
+
+static int
+chaz_CC_fast(void) {
+    return chaz_CC.probe_mode == CHAZ_CC_PROBE_MODE_FAST
+           && chaz_CC.style_detected;
+}
+
+void
+chaz_CC_set_probe_mode(int mode) {
+    if (mode != CHAZ_CC_PROBE_MODE_FAST && mode != CHAZ_CC_PROBE_MODE_FULL) {
+        chaz_Util_die("Unknown probe mode %d", mode);
+    }
+    chaz_CC.probe_mode = mode;
+}
+
+int
+chaz_CC_get_probe_mode(void) {
+    return chaz_CC.probe_mode;
 }
 
 int
 chaz_CC_test_compile(const char *source) {
+    char *basename = chaz_Scratch_path(CHAZ_CC_TRY_BASENAME);
+    int   retval   = chaz_CC_test_compile_named(basename, source);
+    free(basename);
+    return retval;
+}
+
+int
+chaz_CC_test_compile_named(const char *basename, const char *source) {
     int compile_succeeded;
-    char *try_obj_name
-        = chaz_Util_join("", CHAZ_CC_TRY_BASENAME, chaz_CC.obj_ext, NULL);
-    if (!chaz_Util_remove_and_verify(try_obj_name)) {
-        chaz_Util_die("Failed to delete file '%s'", try_obj_name);
-    }
-    compile_succeeded = chaz_CC_compile_obj(CHAZ_CC_TRY_SOURCE_PATH,
-                                            CHAZ_CC_TRY_BASENAME, source);
-    chaz_Util_remove_and_verify(try_obj_name);
-    free(try_obj_name);
+    char *source_path;
+    chaz_CFlags *local_cflags;
+
+    if (chaz_CC_cache_fetch(CHAZ_CC_PROBE_COMPILE, source,
+                            &compile_succeeded, NULL, NULL)) {
+        return compile_succeeded;
+    }
+
+    source_path  = chaz_Util_join("", basename, ".c", NULL);
+    local_cflags = chaz_CFlags_new(chaz_CC.cflags_style);
+    if (chaz_CC_fast() && chaz_CFlags_check_syntax_only(local_cflags)) {
+        /* Nothing gets written, so go by the exit status. */
+        compile_succeeded
+            = chaz_CC_run_compiler(source_path, source, local_cflags,
+                                   CHAZ_TRACE_COMPILE, NULL, NULL) == 0;
+    }
+    else {
+        char *try_obj_name
+            = chaz_Util_join("", basename, chaz_CC.obj_ext, NULL);
+        if (!chaz_Util_remove_and_verify(try_obj_name)) {
+            chaz_Util_die("Failed to delete file '%s'", try_obj_name);
+        }
+        compile_succeeded = chaz_CC_build_obj(source_path, basename, source,
+                                              chaz_CC_fast());
+        chaz_Util_remove_and_verify(try_obj_name);
+        free(try_obj_name);
+    }
+    chaz_CFlags_destroy(local_cflags);
+    free(source_path);
+
+    chaz_CC_cache_store(CHAZ_CC_PROBE_COMPILE, source, compile_succeeded,
+                        NULL, 0);
     return compile_succeeded;
 }
 
+int
+chaz_CC_test_preprocess(const char *source) {
+    char *basename = chaz_Scratch_path(CHAZ_CC_TRY_BASENAME);
+    int   retval   = chaz_CC_test_preprocess_named(basename, source);
+    free(basename);
+    return retval;
+}
+
+int
+chaz_CC_test_preprocess_named(const char *basename, const char *source) {
+    int succeeded;
+    char *source_path;
+    chaz_CFlags *local_cflags;
+
+    if (!chaz_CC_fast()) {
+        return chaz_CC_test_compile_named(basename, source);
+    }
+    if (chaz_CC_cache_fetch(CHAZ_CC_PROBE_PREPROCESS, source, &succeeded,
+                            NULL, NULL)) {
+        return succeeded;
+    }
+
+    source_path  = chaz_Util_join("", basename, ".c", NULL);
+    local_cflags = chaz_CFlags_new(chaz_CC.cflags_style);
+    chaz_CFlags_preprocess_only(local_cflags);
+    succeeded = chaz_CC_run_compiler(source_path, source, local_cflags,
+                                     CHAZ_TRACE_COMPILE, NULL, NULL) == 0;
+    chaz_CFlags_destroy(local_cflags);
+    free(source_path);
+
+    chaz_CC_cache_store(CHAZ_CC_PROBE_PREPROCESS, source, succeeded, NULL, 0);
+    return succeeded;
+}
+
 char*
-chaz_CC_capture_output(const char *source, size_t *output_len) {
-    char *captured_output = NULL;
+chaz_CC_preprocess(const char *source, size_t *output_len) {
+    char *output = NULL;
+    char *basename;
+    char *source_path;
+    chaz_CFlags *local_cflags;
+    int succeeded;
+
+    *output_len = 0;
+    if (chaz_CC_cache_fetch(CHAZ_CC_PROBE_PREPROCESS_OUTPUT, source,
+                            &succeeded, &output, output_len)) {
+        return output;
+    }
+
+    basename     = chaz_Scratch_path(CHAZ_CC_TRY_BASENAME);
+    source_path  = chaz_Util_join("", basename, ".c", NULL);
+    local_cflags = chaz_CFlags_new(chaz_CC.cflags_style);
+    chaz_CFlags_preprocess_only(local_cflags);
+    succeeded = chaz_CC_run_compiler(source_path, source, local_cflags,
+                                     CHAZ_TRACE_COMPILE, &output,
+                                     output_len) == 0;
+    if (!succeeded) {
+        free(output);
+        output      = NULL;
+        *output_len = 0;
+    }
+    chaz_CFlags_destroy(local_cflags);
+    free(source_path);
+    free(basename);
+
+    chaz_CC_cache_store(CHAZ_CC_PROBE_PREPROCESS_OUTPUT, source, succeeded,
+                        output, *output_len);
+    return output;
+}
+
+int
+chaz_CC_test_link(const char *source) {
+    char *basename = chaz_Scratch_path(CHAZ_CC_TRY_BASENAME);
+    int   retval   = chaz_CC_test_link_named(basename, source);
+    free(basename);
+    return retval;
+}
+
+int
+chaz_CC_test_link_named(const char *basename, const char *source) {
+    int succeeded;
+    char *source_path;
+    char *exe_file;
+
+    if (chaz_CC_cache_fetch(CHAZ_CC_PROBE_LINK, source, &succeeded,
+                            NULL, NULL)) {
+        return succeeded;
+    }
+
+    source_path = chaz_Util_join("", basename, ".c", NULL);
+    exe_file    = chaz_Util_join("", basename, chaz_OS_exe_ext(), NULL);
+    if (!chaz_Util_remove_and_verify(exe_file)) {
+        chaz_Util_die("Failed to delete file '%s'", exe_file);
+    }
+    succeeded = chaz_CC_build_exe(source_path, basename, source,
+                                  chaz_CC_fast());
+    chaz_Util_remove_and_verify(exe_file);
+    free(source_path);
+    free(exe_file);
+
+    chaz_CC_cache_store(CHAZ_CC_PROBE_LINK, source, succeeded, NULL, 0);
+    return succeeded;
+}
+
+void
+chaz_CC_set_can_run(int can_run) {
+    chaz_CC.can_run = can_run;
+}
+
+int
+chaz_CC_can_run(void) {
+    return chaz_CC.can_run;
+}
+
+int
+chaz_CC_compile_and_run(const char *basename, const char *source,
+                        const char *output_path) {
+    char *source_path = chaz_Util_join("", basename, ".c", NULL);
+    char *exe_file = chaz_Util_join("", basename, chaz_OS_exe_ext(), NULL);
     int compile_succeeded;
 
     /* Clear out previous versions and test to make sure removal worked. */
-    if (!chaz_Util_remove_and_verify(chaz_CC.try_exe_name)) {
-        chaz_Util_die("Failed to delete file '%s'", chaz_CC.try_exe_name);
+    if (!chaz_Util_remove_and_verify(exe_file)) {
+        chaz_Util_die("Failed to delete file '%s'", exe_file);
+    }
+    if (!chaz_Util_remove_and_verify(output_path)) {
+        chaz_Util_die("Failed to delete file '%s'", output_path);
     }
-    if (!chaz_Util_remove_and_verify(CHAZ_CC_TARGET_PATH)) {
-        chaz_Util_die("Failed to delete file '%s'", CHAZ_CC_TARGET_PATH);
+
+    /* Attempt compilation; if successful, run app. */
+    compile_succeeded = chaz_CC_build_exe(source_path, basename, source,
+                                          chaz_CC_fast());
+    if (compile_succeeded && chaz_CC.can_run) {
+        chaz_OS_run_local_redirected(exe_file, output_path);
     }
 
-    /* Attempt compilation; if successful, run app and slurp output. */
-    compile_succeeded = chaz_CC_compile_exe(CHAZ_CC_TRY_SOURCE_PATH,
-                                            CHAZ_CC_TRY_BASENAME, source);
+    /* Remove the source and the executable. */
+    chaz_Util_remove_and_verify(source_path);
+    chaz_Util_remove_and_verify(exe_file);
+
+    free(source_path);
+    free(exe_file);
+    return compile_succeeded;
+}
+
+int
+chaz_CC_compile_and_capture(const char *basename, const char *source,
+                            char **output, size_t *output_len) {
+    char *output_path;
+    int   compile_succeeded;
+
+    *output     = NULL;
+    *output_len = 0;
+
+    /* Capture output through a pipe if possible.  There's nothing to capture
+     * if the executable can't be run. */
+    if (chaz_OS_can_pipe() || !chaz_CC.can_run) {
+        char *source_path = chaz_Util_join("", basename, ".c", NULL);
+        char *exe_file = chaz_Util_join("", basename, chaz_OS_exe_ext(),
+                                        NULL);
+        if (!chaz_Util_remove_and_verify(exe_file)) {
+            chaz_Util_die("Failed to delete file '%s'", exe_file);
+        }
+        compile_succeeded = chaz_CC_build_exe(source_path, basename, source,
+                                              chaz_CC_fast());
+        if (compile_succeeded && chaz_CC.can_run) {
+            *output = chaz_OS_run_local_and_capture(exe_file, output_len);
+        }
+        chaz_Util_remove_and_verify(exe_file);
+        free(source_path);
+        free(exe_file);
+        return compile_succeeded;
+    }
+
+    output_path = chaz_Util_join("", basename, ".out", NULL);
+    compile_succeeded = chaz_CC_compile_and_run(basename, source,
+                                                output_path);
     if (compile_succeeded) {
-        chaz_OS_run_local_redirected(chaz_CC.try_exe_name,
-                                     CHAZ_CC_TARGET_PATH);
-        captured_output = chaz_Util_slurp_file(CHAZ_CC_TARGET_PATH,
-                                               output_len);
+        *output = chaz_Util_slurp_file(output_path, output_len);
     }
-    else {
-        *output_len = 0;
+    chaz_Util_remove_and_verify(output_path);
+    free(output_path);
+    return compile_succeeded;
+}
+
+int
+chaz_CC_compile_and_extract(const char *basename, const char *source,
+                            char **output, size_t *output_len) {
+    char *source_path;
+    char *obj_file;
+    int   compile_succeeded;
+
+    *output     = NULL;
+    *output_len = 0;
+    if (chaz_CC_cache_fetch(CHAZ_CC_PROBE_EXTRACT, source,
+                            &compile_succeeded, output, output_len)) {
+        return compile_succeeded;
+    }
+
+    source_path = chaz_Util_join("", basename, ".c", NULL);
+    obj_file    = chaz_Util_join("", basename, chaz_CC.obj_ext, NULL);
+    if (!chaz_Util_remove_and_verify(obj_file)) {
+        chaz_Util_die("Failed to delete file '%s'", obj_file);
+    }
+    compile_succeeded = chaz_CC_build_obj(source_path, basename, source,
+                                          chaz_CC_fast());
+    if (compile_succeeded) {
+        chaz_CC_scan_markers(obj_file, output, output_len);
+    }
+    chaz_Util_remove_and_verify(source_path);
+    chaz_Util_remove_and_verify(obj_file);
+    free(source_path);
+    free(obj_file);
+
+    chaz_CC_cache_store(CHAZ_CC_PROBE_EXTRACT, source, compile_succeeded,
+                        *output, *output_len);
+    return compile_succeeded;
+}
+
+static void
+chaz_CC_scan_markers(const char *obj_file, char **output,
+                     size_t *output_len) {
+    const size_t mark_len = strlen(CHAZ_CC_MARKER);
+    FILE   *file = fopen(obj_file, "rb");
+    char   *bytes;
+    char   *found = NULL;
+    size_t  found_len = 0;
+    size_t  len;
+    size_t  i;
+    long    size;
+
+    if (file == NULL) { return; }
+    if (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) <= 0) {
+        fclose(file);
+        return;
+    }
+    rewind(file);
+    bytes = (char*)malloc((size_t)size);
+    len   = fread(bytes, 1, (size_t)size, file);
+    fclose(file);
+
+    for (i = 0; i + mark_len < len; i++) {
+        size_t end;
+        if (bytes[i] != CHAZ_CC_MARKER[0]
+            || memcmp(bytes + i, CHAZ_CC_MARKER, mark_len) != 0
+           ) {
+            continue;
+        }
+
+        /* Take everything up to the closing bracket. */
+        for (end = i + mark_len; end < len; end++) {
+            if (bytes[end] == ']' || !isprint((unsigned char)bytes[end])) {
+                break;
+            }
+        }
+        if (end == len || bytes[end] != ']') { continue; }
+        end++;
+        found = (char*)realloc(found, found_len + (end - i) + 2);
+        memcpy(found + found_len, bytes + i, end - i);
+        found_len += end - i;
+        found[found_len++] = '\n';
+        found[found_len] = '\0';
+        i = end - 1;
     }
 
-    /* Remove all the files we just created. */
-    chaz_Util_remove_and_verify(CHAZ_CC_TRY_SOURCE_PATH);
-    chaz_Util_remove_and_verify(chaz_CC.try_exe_name);
-    chaz_Util_remove_and_verify(CHAZ_CC_TARGET_PATH);
+    free(bytes);
+    *output     = found;
+    *output_len = found_len;
+}
+
+char*
+chaz_CC_capture_output(const char *source, size_t *output_len) {
+    char *captured_output = NULL;
+    char *basename;
+    int   compile_succeeded;
+
+    if (chaz_CC_cache_fetch(CHAZ_CC_PROBE_CAPTURE, source,
+                            &compile_succeeded, &captured_output,
+                            output_len)) {
+        return captured_output;
+    }
+
+    basename = chaz_Scratch_path(CHAZ_CC_TRY_BASENAME);
+    compile_succeeded = chaz_CC_compile_and_capture(basename, source,
+                                                    &captured_output,
+                                                    output_len);
+    free(basename);
+
+    chaz_CC_cache_store(CHAZ_CC_PROBE_CAPTURE, source, compile_succeeded,
+                        captured_output, *output_len);
 
     return captured_output;
 }
 
+int
+chaz_CC_test_output(const char *source) {
+    char   *output;
+    size_t  output_len;
+
+    if (!chaz_CC.can_run) {
+        return chaz_CC_test_link(source);
+    }
+    output = chaz_CC_capture_output(source, &output_len);
+    if (output == NULL) {
+        return false;
+    }
+    free(output);
+    return true;
+}
+
 const char*
 chaz_CC_get_cc(void) {
     return chaz_CC.cc_command;
@@ -366,6 +1134,32 @@ chaz_CC_sun_c_version_num(void) {
     return chaz_CC.intval___SUNPRO_C;
 }
 
+int
+chaz_CC_traits(void) {
+    int traits = 0;
+
+    if (chaz_CC.intval___GNUC__)   { traits |= CHAZ_CC_GNU; }
+    if (chaz_CC.intval___clang__)  { traits |= CHAZ_CC_CLANG; }
+    if (chaz_CC.intval__MSC_VER)   { traits |= CHAZ_CC_MSVC; }
+    if (chaz_CC.intval___SUNPRO_C) { traits |= CHAZ_CC_SUN_C; }
+    if (chaz_CC_macro_value("_WIN32") != NULL
+        || chaz_CC_macro_value("__CYGWIN__") != NULL
+       ) {
+        traits |= CHAZ_CC_WINDOWS;
+    }
+
+    /* Clang accepts __int64 and friends with -fms-extensions, which
+     * announces itself. */
+    if ((traits & (CHAZ_CC_GNU | CHAZ_CC_SUN_C))
+        && !(traits & (CHAZ_CC_WINDOWS | CHAZ_CC_MSVC))
+        && chaz_CC_macro_value("_MSC_EXTENSIONS") == NULL
+       ) {
+        traits |= CHAZ_CC_NO_MS_EXT;
+    }
+
+    return traits;
+}
+
 const char*
 chaz_CC_link_command() {
     if (chaz_CC.intval__MSC_VER) {
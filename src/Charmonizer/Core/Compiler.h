@@ -28,6 +28,28 @@ extern "C" {
 #include "Charmonizer/Core/Defines.h"
 #include "Charmonizer/Core/CFlags.h"
 
+/* Kinds of probe results kept in the probe cache.
+ */
+#define CHAZ_CC_PROBE_COMPILE     1
+#define CHAZ_CC_PROBE_CAPTURE     2
+#define CHAZ_CC_PROBE_PREPROCESS  3
+#define CHAZ_CC_PROBE_LINK        4
+#define CHAZ_CC_PROBE_EXTRACT     5
+#define CHAZ_CC_PROBE_PREPROCESS_OUTPUT 6
+
+/* Every string collected by chaz_CC_compile_and_extract starts with this.
+ */
+#define CHAZ_CC_MARKER "CHZ_VAL["
+
+/* Probe modes.  In the fast mode, which is the default, probes use the
+ * cheapest compiler invocation which can answer them: a syntax check when
+ * nothing needs to be built, and no optimization or debugging info when an
+ * object or executable is needed.  The full mode compiles every probe with
+ * the user's flags untouched, for probes whose answers may depend on them.
+ */
+#define CHAZ_CC_PROBE_MODE_FAST  1
+#define CHAZ_CC_PROBE_MODE_FULL  2
+
 /* Attempt to compile and link an executable.  Return true if the executable
  * file exists after the attempt.
  */
@@ -48,6 +70,92 @@ chaz_CC_compile_obj(const char *source_path, const char *obj_path,
 int
 chaz_CC_test_compile(const char *source);
 
+/* Like chaz_CC_test_compile, but name all scratch files after [basename].
+ * Probes with distinct basenames may run at the same time.
+ */
+int
+chaz_CC_test_compile_named(const char *basename, const char *source);
+
+/* Return true if the supplied source code gets through the preprocessor.
+ * Falls back to a test compile until the cflags style is known.
+ */
+int
+chaz_CC_test_preprocess(const char *source);
+
+int
+chaz_CC_test_preprocess_named(const char *basename, const char *source);
+
+/* Run the supplied source code through the preprocessor and return the
+ * output, which may include diagnostics, or NULL if the preprocessor fails.
+ */
+char*
+chaz_CC_preprocess(const char *source, size_t *output_len);
+
+/* Return true if the supplied source code compiles and links into an
+ * executable.  Nothing is run.
+ */
+int
+chaz_CC_test_link(const char *source);
+
+int
+chaz_CC_test_link_named(const char *basename, const char *source);
+
+/* Allow or forbid running probe executables.  When running is forbidden --
+ * because the compiler targets another machine, say -- executables are
+ * still built, but chaz_CC_compile_and_run and chaz_CC_compile_and_capture
+ * produce no output.  Must be called before chaz_CC_init.
+ */
+void
+chaz_CC_set_can_run(int can_run);
+
+/* Return true if probe executables may be run.
+ */
+int
+chaz_CC_can_run(void);
+
+/* Set the probe mode to CHAZ_CC_PROBE_MODE_FAST or CHAZ_CC_PROBE_MODE_FULL.
+ * It applies to every probe until it is set again, so a probe which needs
+ * the full mode should save the current mode and restore it afterwards.
+ * The mode is part of the probe cache key.
+ */
+void
+chaz_CC_set_probe_mode(int mode);
+
+int
+chaz_CC_get_probe_mode(void);
+
+/* Attempt to compile the supplied source code into an executable named after
+ * [basename].  If successful, run it, capturing stdout and stderr to the file
+ * at [output_path].  Return true if the compilation succeeded.  Everything
+ * but the output file is removed afterwards.  If probe executables may not
+ * be run, no output file is created.
+ */
+int
+chaz_CC_compile_and_run(const char *basename, const char *source,
+                        const char *output_path);
+
+/* Attempt to compile the supplied source code into an executable named after
+ * [basename].  If successful, run it and store its output (stdout and
+ * stderr) in a newly allocated buffer in [output], or NULL if there was
+ * none.  Return true if the compilation succeeded.  The output comes through
+ * a pipe where the system allows it, leaving no files behind.
+ */
+int
+chaz_CC_compile_and_capture(const char *basename, const char *source,
+                            char **output, size_t *output_len);
+
+/* Compile [source] into an object file named after [basename] and collect
+ * the strings embedded in it which start with CHAZ_CC_MARKER, one per line,
+ * into a newly allocated buffer stored in [output] -- or NULL if there were
+ * none.  Nothing is linked or run, so this works for any target, but it
+ * finds nothing when the object file doesn't hold plain data (with link
+ * time optimization, for instance).  Return true if the compilation
+ * succeeded.
+ */
+int
+chaz_CC_compile_and_extract(const char *basename, const char *source,
+                            char **output, size_t *output_len);
+
 /* Attempt to compile the supplied source code.  If successful, capture the
  * output of the program and return a pointer to a newly allocated buffer.
  * If the compilation fails, return NULL.  The length of the captured
@@ -56,6 +164,27 @@ chaz_CC_test_compile(const char *source);
 char*
 chaz_CC_capture_output(const char *source, size_t *output_len);
 
+/* Return true if the program in [source] builds and prints something when
+ * run.  If probe executables may not be run, return true if it links.
+ */
+int
+chaz_CC_test_output(const char *source);
+
+/* Look up the result of a probe of the given kind for [source] in the memo
+ * and then in the probe cache, taking the compiler and all current flags
+ * into account.  See chaz_Cache_fetch.
+ */
+int
+chaz_CC_cache_fetch(int kind, const char *source, int *succeeded,
+                    char **output, size_t *output_len);
+
+/* Store the result of a probe in the memo and, unless it's disabled, in the
+ * probe cache.
+ */
+void
+chaz_CC_cache_store(int kind, const char *source, int succeeded,
+                    const char *output, size_t output_len);
+
 /** Initialize the compiler environment.
  */
 void
@@ -108,6 +237,39 @@ chaz_CC_msvc_version_num(void);
 int
 chaz_CC_sun_c_version_num(void);
 
+/* Traits of the compiler and its target, as returned by chaz_CC_traits.
+ */
+#define CHAZ_CC_GNU        0x01  /* Defines __GNUC__, as clang does too. */
+#define CHAZ_CC_CLANG      0x02
+#define CHAZ_CC_MSVC       0x04
+#define CHAZ_CC_SUN_C      0x08
+#define CHAZ_CC_WINDOWS    0x10  /* Targets Windows or Cygwin. */
+#define CHAZ_CC_NO_MS_EXT  0x20  /* A GNU or Sun compiler which targets
+                                  * neither, and doesn't accept Microsoft's
+                                  * extensions. */
+
+/* Return the traits of the compiler, ORed together.  Probes use them to
+ * skip what the compiler can't possibly support, so only what is known for
+ * sure counts: an unidentified compiler has none.
+ */
+int
+chaz_CC_traits(void);
+
+/* Return the value of the macro [name] as predefined by the compiler, or
+ * NULL if it isn't defined.  A macro defined without a value has the value
+ * "".  The macros were all found by a single run of the preprocessor in
+ * chaz_CC_init, so asking costs nothing.
+ */
+const char*
+chaz_CC_macro_value(const char *name);
+
+/* Return true if the compiler dumped all of its predefined macros.  If not,
+ * chaz_CC_macro_value only knows a list of well-known ones: those which
+ * identify the compiler, the platform and the data model.
+ */
+int
+chaz_CC_macros_complete(void);
+
 const char*
 chaz_CC_link_command(void);
 
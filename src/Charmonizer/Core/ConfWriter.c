@@ -16,6 +16,8 @@
 
 #include "Charmonizer/Core/Util.h"
 #include "Charmonizer/Core/ConfWriter.h"
+#include "Charmonizer/Core/OpLog.h"
+#include "Charmonizer/Core/Trace.h"
 #include <stdarg.h>
 #include <stdio.h>
 
@@ -25,6 +27,15 @@ static struct {
     size_t num_writers;
 } chaz_CW;
 
+/* Pass the start and end of a module on to the writers.  Replaying a log
+ * calls these directly, since the module has already been traced.
+ */
+static void
+chaz_ConfWriter_announce_module(const char *module_name);
+
+static void
+chaz_ConfWriter_finish_module(void);
+
 void
 chaz_ConfWriter_init(void) {
     chaz_CW.num_writers = 0;
@@ -43,7 +54,13 @@ void
 chaz_ConfWriter_append_conf(const char *fmt, ...) {
     va_list args;
     size_t i;
-    
+
+    if (chaz_OpLog_recording()) {
+        va_start(args, fmt);
+        chaz_OpLog_vformat(CHAZ_CONFWRITER_OP_APPEND, fmt, args);
+        va_end(args);
+        return;
+    }
     for (i = 0; i < chaz_CW.num_writers; i++) {
         va_start(args, fmt);
         chaz_CW.writers[i]->vappend_conf(fmt, args);
@@ -54,6 +71,10 @@ chaz_ConfWriter_append_conf(const char *fmt, ...) {
 void
 chaz_ConfWriter_add_def(const char *sym, const char *value) {
     size_t i;
+    if (chaz_OpLog_recording()) {
+        chaz_OpLog_write(CHAZ_CONFWRITER_OP_DEF, 2, sym, value);
+        return;
+    }
     for (i = 0; i < chaz_CW.num_writers; i++) {
         chaz_CW.writers[i]->add_def(sym, value);
     }
@@ -62,6 +83,10 @@ chaz_ConfWriter_add_def(const char *sym, const char *value) {
 void
 chaz_ConfWriter_add_global_def(const char *sym, const char *value) {
     size_t i;
+    if (chaz_OpLog_recording()) {
+        chaz_OpLog_write(CHAZ_CONFWRITER_OP_GLOBAL_DEF, 2, sym, value);
+        return;
+    }
     for (i = 0; i < chaz_CW.num_writers; i++) {
         chaz_CW.writers[i]->add_global_def(sym, value);
     }
@@ -70,6 +95,10 @@ chaz_ConfWriter_add_global_def(const char *sym, const char *value) {
 void
 chaz_ConfWriter_add_typedef(const char *type, const char *alias) {
     size_t i;
+    if (chaz_OpLog_recording()) {
+        chaz_OpLog_write(CHAZ_CONFWRITER_OP_TYPEDEF, 2, type, alias);
+        return;
+    }
     for (i = 0; i < chaz_CW.num_writers; i++) {
         chaz_CW.writers[i]->add_typedef(type, alias);
     }
@@ -78,6 +107,10 @@ chaz_ConfWriter_add_typedef(const char *type, const char *alias) {
 void
 chaz_ConfWriter_add_global_typedef(const char *type, const char *alias) {
     size_t i;
+    if (chaz_OpLog_recording()) {
+        chaz_OpLog_write(CHAZ_CONFWRITER_OP_GLOBAL_TYPEDEF, 2, type, alias);
+        return;
+    }
     for (i = 0; i < chaz_CW.num_writers; i++) {
         chaz_CW.writers[i]->add_global_typedef(type, alias);
     }
@@ -86,6 +119,10 @@ chaz_ConfWriter_add_global_typedef(const char *type, const char *alias) {
 void
 chaz_ConfWriter_add_sys_include(const char *header) {
     size_t i;
+    if (chaz_OpLog_recording()) {
+        chaz_OpLog_write(CHAZ_CONFWRITER_OP_SYS_INCLUDE, 1, header);
+        return;
+    }
     for (i = 0; i < chaz_CW.num_writers; i++) {
         chaz_CW.writers[i]->add_sys_include(header);
     }
@@ -94,6 +131,10 @@ chaz_ConfWriter_add_sys_include(const char *header) {
 void
 chaz_ConfWriter_add_local_include(const char *header) {
     size_t i;
+    if (chaz_OpLog_recording()) {
+        chaz_OpLog_write(CHAZ_CONFWRITER_OP_LOCAL_INCLUDE, 1, header);
+        return;
+    }
     for (i = 0; i < chaz_CW.num_writers; i++) {
         chaz_CW.writers[i]->add_local_include(header);
     }
@@ -101,6 +142,17 @@ chaz_ConfWriter_add_local_include(const char *header) {
 
 void
 chaz_ConfWriter_start_module(const char *module_name) {
+    chaz_Trace_start_module(module_name);
+    if (chaz_OpLog_recording()) {
+        /* Announced when the log is replayed. */
+        chaz_OpLog_write(CHAZ_CONFWRITER_OP_START_MODULE, 1, module_name);
+        return;
+    }
+    chaz_ConfWriter_announce_module(module_name);
+}
+
+static void
+chaz_ConfWriter_announce_module(const char *module_name) {
     size_t i;
     if (chaz_Util_verbosity > 0) {
         printf("Running %s module...\n", module_name);
@@ -112,6 +164,16 @@ chaz_ConfWriter_start_module(const char *module_name) {
 
 void
 chaz_ConfWriter_end_module(void) {
+    chaz_Trace_end_module();
+    if (chaz_OpLog_recording()) {
+        chaz_OpLog_write(CHAZ_CONFWRITER_OP_END_MODULE, 0);
+        return;
+    }
+    chaz_ConfWriter_finish_module();
+}
+
+static void
+chaz_ConfWriter_finish_module(void) {
     size_t i;
     for (i = 0; i < chaz_CW.num_writers; i++) {
         chaz_CW.writers[i]->end_module();
@@ -124,3 +186,40 @@ chaz_ConfWriter_add_writer(chaz_ConfWriter *writer) {
     chaz_CW.num_writers++;
 }
 
+int
+chaz_ConfWriter_replay(char op, const char **fields, int num_fields) {
+    switch (op) {
+        case CHAZ_CONFWRITER_OP_APPEND:
+            chaz_ConfWriter_append_conf("%s", fields[0]);
+            break;
+        case CHAZ_CONFWRITER_OP_DEF:
+            chaz_ConfWriter_add_def(fields[0], fields[1]);
+            break;
+        case CHAZ_CONFWRITER_OP_GLOBAL_DEF:
+            chaz_ConfWriter_add_global_def(fields[0], fields[1]);
+            break;
+        case CHAZ_CONFWRITER_OP_TYPEDEF:
+            chaz_ConfWriter_add_typedef(fields[0], fields[1]);
+            break;
+        case CHAZ_CONFWRITER_OP_GLOBAL_TYPEDEF:
+            chaz_ConfWriter_add_global_typedef(fields[0], fields[1]);
+            break;
+        case CHAZ_CONFWRITER_OP_SYS_INCLUDE:
+            chaz_ConfWriter_add_sys_include(fields[0]);
+            break;
+        case CHAZ_CONFWRITER_OP_LOCAL_INCLUDE:
+            chaz_ConfWriter_add_local_include(fields[0]);
+            break;
+        case CHAZ_CONFWRITER_OP_START_MODULE:
+            chaz_ConfWriter_announce_module(fields[0]);
+            break;
+        case CHAZ_CONFWRITER_OP_END_MODULE:
+            chaz_ConfWriter_finish_module();
+            break;
+        default:
+            return false;
+    }
+    (void)num_fields;
+    return true;
+}
+
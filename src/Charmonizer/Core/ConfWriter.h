@@ -30,6 +30,20 @@ extern "C" {
 
 struct chaz_ConfWriter;
 
+/* Operation codes for ConfWriter calls recorded by chaz_OpLog.  While a log
+ * is being recorded, ConfWriter calls go into it instead of the writers.
+ */
+#define CHAZ_CONFWRITER_OP_APPEND          'A'
+#define CHAZ_CONFWRITER_OP_DEF             'D'
+#define CHAZ_CONFWRITER_OP_GLOBAL_DEF      'd'
+#define CHAZ_CONFWRITER_OP_TYPEDEF         'T'
+#define CHAZ_CONFWRITER_OP_GLOBAL_TYPEDEF  't'
+#define CHAZ_CONFWRITER_OP_SYS_INCLUDE     'I'
+#define CHAZ_CONFWRITER_OP_LOCAL_INCLUDE   'i'
+#define CHAZ_CONFWRITER_OP_START_MODULE    'S'
+#define CHAZ_CONFWRITER_OP_END_MODULE      'E'
+#define CHAZ_CONFWRITER_OPS                "ADdTtIiSE"
+
 /* Initialize elements needed by ConfWriter.  Must be called before anything
  * else, but after os and compiler are initialized.
  */
@@ -90,6 +104,12 @@ chaz_ConfWriter_end_module(void);
 void
 chaz_ConfWriter_add_writer(struct chaz_ConfWriter *writer);
 
+/* Carry out an operation read back from an operation log.  Return false if
+ * [op] isn't a ConfWriter operation.
+ */
+int
+chaz_ConfWriter_replay(char op, const char **fields, int num_fields);
+
 typedef void
 (*chaz_ConfWriter_clean_up_t)(void);
 typedef void
@@ -107,10 +107,7 @@ chaz_ConfWriterC_enable(void) {
 static void
 chaz_ConfWriterC_open_charmony_h(const char *charmony_start) {
     /* Open the filehandle. */
-    chaz_ConfWriterC.fh = fopen("charmony.h", "w+");
-    if (chaz_ConfWriterC.fh == NULL) {
-        chaz_Util_die("Can't open 'charmony.h': %s", strerror(errno));
-    }
+    chaz_ConfWriterC.fh = chaz_Util_open_output("charmony.h");
 
     /* Print supplied text (if any) along with warning, open include guard. */
     if (charmony_start != NULL) {
@@ -130,9 +127,7 @@ static void
 chaz_ConfWriterC_clean_up(void) {
     /* Write the last bit of charmony.h and close. */
     fprintf(chaz_ConfWriterC.fh, "#endif /* H_CHARMONY */\n\n");
-    if (fclose(chaz_ConfWriterC.fh)) {
-        chaz_Util_die("Couldn't close 'charmony.h': %s", strerror(errno));
-    }
+    chaz_Util_close_output(chaz_ConfWriterC.fh, "charmony.h");
 }
 
 static void
@@ -75,10 +75,7 @@ chaz_ConfWriterPerl_enable(void) {
 static void
 chaz_ConfWriterPerl_open_config_pm(void) {
     /* Open the filehandle. */
-    chaz_CWPerl.fh = fopen("Charmony.pm", "w+");
-    if (chaz_CWPerl.fh == NULL) {
-        chaz_Util_die("Can't open 'Charmony.pm': %s", strerror(errno));
-    }
+    chaz_CWPerl.fh = chaz_Util_open_output("Charmony.pm");
 
     /* Start the module. */
     fprintf(chaz_CWPerl.fh,
@@ -100,9 +97,7 @@ static void
 chaz_ConfWriterPerl_clean_up(void) {
     /* Write the last bit of Charmony.pm and close. */
     fprintf(chaz_CWPerl.fh, "\n1;\n\n");
-    if (fclose(chaz_CWPerl.fh)) {
-        chaz_Util_die("Couldn't close 'Charmony.pm': %s", strerror(errno));
-    }
+    chaz_Util_close_output(chaz_CWPerl.fh, "Charmony.pm");
 }
 
 static void
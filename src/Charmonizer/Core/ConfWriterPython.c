@@ -75,10 +75,7 @@ chaz_ConfWriterPython_enable(void) {
 static void
 chaz_ConfWriterPython_open_config_py(void) {
     /* Open the filehandle. */
-    chaz_CWPython.fh = fopen("charmony.py", "w+");
-    if (chaz_CWPython.fh == NULL) {
-        chaz_Util_die("Can't open 'charmony.py': %s", strerror(errno));
-    }
+    chaz_CWPython.fh = chaz_Util_open_output("charmony.py");
 
     /* Start the module. */
     fprintf(chaz_CWPython.fh,
@@ -98,9 +95,7 @@ chaz_ConfWriterPython_open_config_py(void) {
 static void
 chaz_ConfWriterPython_clean_up(void) {
     /* No more code necessary to finish charmony.py, so just close. */
-    if (fclose(chaz_CWPython.fh)) {
-        chaz_Util_die("Couldn't close 'charmony.py': %s", strerror(errno));
-    }
+    chaz_Util_close_output(chaz_CWPython.fh, "charmony.py");
 }
 
 static void
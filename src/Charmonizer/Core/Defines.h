@@ -30,6 +30,16 @@ extern "C" {
 
 #define CHAZ_QUOTE(x) #x "\n"
 
+/* Hosts on which Charmonizer may call POSIX process functions such as fork()
+ * and waitpid() directly.  Everywhere else, only system() is used.  Define
+ * CHAZ_NO_POSIX_API to force the portable code paths.
+ */
+#if !defined(CHAZ_NO_POSIX_API) \
+    && (defined(__unix__) || defined(__unix) \
+        || (defined(__APPLE__) && defined(__MACH__)))
+  #define CHAZ_HAS_POSIX_API 1
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,196 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Charmonizer/Core/Features.h"
+#include "Charmonizer/Core/Compiler.h"
+#include "Charmonizer/Core/Util.h"
+
+/* Every answer comes out of the preprocessor on a line of its own, starting
+ * with this, followed by the index of the question and 0 or 1.
+ */
+#define CHAZ_FEATURES_MARKER "chaz_feature "
+
+typedef struct chaz_FeatureQuestion {
+    const char *query_macro;
+    char       *arg;
+    int         answer;
+} chaz_FeatureQuestion;
+
+struct chaz_Features {
+    chaz_FeatureQuestion *questions;
+    int                   num_questions;
+    int                   cap;
+};
+
+/* Add a question answered by [query_macro]([arg]), or by #if [arg] if
+ * [query_macro] is NULL.
+ */
+static int
+chaz_Features_add(chaz_Features *features, const char *query_macro,
+                  const char *arg);
+
+/* Return the source which asks all questions.
+ */
+static char*
+chaz_Features_source(chaz_Features *features);
+
+chaz_Features*
+chaz_Features_new(void) {
+    chaz_Features *features = (chaz_Features*)malloc(sizeof(chaz_Features));
+    features->questions     = NULL;
+    features->num_questions = 0;
+    features->cap           = 0;
+    return features;
+}
+
+void
+chaz_Features_destroy(chaz_Features *features) {
+    int i;
+    for (i = 0; i < features->num_questions; i++) {
+        free(features->questions[i].arg);
+    }
+    free(features->questions);
+    free(features);
+}
+
+int
+chaz_Features_add_builtin(chaz_Features *features, const char *name) {
+    return chaz_Features_add(features, "__has_builtin", name);
+}
+
+int
+chaz_Features_add_attribute(chaz_Features *features, const char *name) {
+    return chaz_Features_add(features, "__has_attribute", name);
+}
+
+int
+chaz_Features_add_c_attribute(chaz_Features *features, const char *name) {
+    return chaz_Features_add(features, "__has_c_attribute", name);
+}
+
+int
+chaz_Features_add_feature(chaz_Features *features, const char *name) {
+    return chaz_Features_add(features, "__has_feature", name);
+}
+
+int
+chaz_Features_add_expr(chaz_Features *features, const char *expr) {
+    return chaz_Features_add(features, NULL, expr);
+}
+
+static int
+chaz_Features_add(chaz_Features *features, const char *query_macro,
+                  const char *arg) {
+    chaz_FeatureQuestion *question;
+    if (features->num_questions == features->cap) {
+        features->cap = features->cap ? features->cap * 2 : 8;
+        features->questions
+            = (chaz_FeatureQuestion*)realloc(features->questions,
+                                             features->cap
+                                             * sizeof(chaz_FeatureQuestion));
+    }
+    question = &features->questions[features->num_questions];
+    question->query_macro = query_macro;
+    question->arg         = chaz_Util_strdup(arg);
+    question->answer      = CHAZ_FEATURES_UNKNOWN;
+    return features->num_questions++;
+}
+
+void
+chaz_Features_run(chaz_Features *features) {
+    const size_t marker_len = strlen(CHAZ_FEATURES_MARKER);
+    char   *source;
+    char   *output;
+    char   *line;
+    size_t  output_len;
+
+    if (features->num_questions == 0) { return; }
+
+    source = chaz_Features_source(features);
+    output = chaz_CC_preprocess(source, &output_len);
+    for (line = output; line != NULL && *line != '\0'; ) {
+        int index;
+        int yes;
+        line += strspn(line, " \t");
+        if (strncmp(line, CHAZ_FEATURES_MARKER, marker_len) == 0
+            && sscanf(line + marker_len, "%d %d", &index, &yes) == 2
+            && index >= 0 && index < features->num_questions
+           ) {
+            features->questions[index].answer
+                = yes ? CHAZ_FEATURES_YES : CHAZ_FEATURES_NO;
+        }
+        line = strchr(line, '\n');
+        if (line != NULL) { line++; }
+    }
+
+    free(output);
+    free(source);
+}
+
+static char*
+chaz_Features_source(chaz_Features *features) {
+    static const char query_code[] =
+        CHAZ_QUOTE(  #if defined(%s)                 )
+        CHAZ_QUOTE(  #if %s(%s)                      )
+        CHAZ_QUOTE(  chaz_feature %d 1               )
+        CHAZ_QUOTE(  #else                           )
+        CHAZ_QUOTE(  chaz_feature %d 0               )
+        CHAZ_QUOTE(  #endif                          )
+        CHAZ_QUOTE(  #endif                          );
+    static const char expr_code[] =
+        CHAZ_QUOTE(  #if %s                          )
+        CHAZ_QUOTE(  chaz_feature %d 1               )
+        CHAZ_QUOTE(  #else                           )
+        CHAZ_QUOTE(  chaz_feature %d 0               )
+        CHAZ_QUOTE(  #endif                          );
+    size_t needed = 1;
+    char  *source;
+    char  *end;
+    int    i;
+
+    for (i = 0; i < features->num_questions; i++) {
+        needed += sizeof(query_code) + 2 * strlen("__has_c_attribute")
+                  + strlen(features->questions[i].arg) + 40;
+    }
+    source = (char*)malloc(needed);
+    end = source;
+    *end = '\0';
+    for (i = 0; i < features->num_questions; i++) {
+        chaz_FeatureQuestion *question = &features->questions[i];
+        if (question->query_macro) {
+            sprintf(end, query_code, question->query_macro,
+                    question->query_macro, question->arg, i, i);
+        }
+        else {
+            sprintf(end, expr_code, question->arg, i, i);
+        }
+        end += strlen(end);
+    }
+
+    return source;
+}
+
+int
+chaz_Features_answer(chaz_Features *features, int question) {
+    if (question < 0 || question >= features->num_questions) {
+        chaz_Util_die("Invalid feature question %d", question);
+    }
+    return features->questions[question].answer;
+}
+
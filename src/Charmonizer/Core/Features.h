@@ -0,0 +1,100 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Charmonizer/Core/Features.h -- ask the compiler about its capabilities.
+ *
+ * Many compilers answer questions about themselves in the preprocessor:
+ * __has_builtin, __has_attribute, __has_c_attribute and __has_feature tell
+ * whether a builtin function, an attribute or a language feature is
+ * supported, and version macros such as __GNUC__ tell the rest.  A
+ * chaz_Features object collects any number of such questions and answers
+ * them all with a single run of the preprocessor, without compiling,
+ * linking or running anything.
+ *
+ * A compiler which doesn't know one of the query macros can't answer the
+ * questions asked through it.  Those questions come back as
+ * CHAZ_FEATURES_UNKNOWN, and the caller should fall back to a real probe.
+ */
+
+#ifndef H_CHAZ_FEATURES
+#define H_CHAZ_FEATURES
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "Charmonizer/Core/Defines.h"
+
+/* Answers.
+ */
+#define CHAZ_FEATURES_UNKNOWN  -1
+#define CHAZ_FEATURES_NO        0
+#define CHAZ_FEATURES_YES       1
+
+typedef struct chaz_Features chaz_Features;
+
+chaz_Features*
+chaz_Features_new(void);
+
+void
+chaz_Features_destroy(chaz_Features *features);
+
+/* Ask whether __has_builtin([name]) is true.  Return the index of the
+ * question.
+ */
+int
+chaz_Features_add_builtin(chaz_Features *features, const char *name);
+
+/* Ask whether __has_attribute([name]) is true, for a GNU style
+ * __attribute__.
+ */
+int
+chaz_Features_add_attribute(chaz_Features *features, const char *name);
+
+/* Ask whether __has_c_attribute([name]) is true, for a C23 style [[name]]
+ * attribute.
+ */
+int
+chaz_Features_add_c_attribute(chaz_Features *features, const char *name);
+
+/* Ask whether __has_feature([name]) is true.
+ */
+int
+chaz_Features_add_feature(chaz_Features *features, const char *name);
+
+/* Ask whether [expr], an expression for #if, is true.  Every compiler can
+ * answer these, which makes them the way to test version macros.
+ */
+int
+chaz_Features_add_expr(chaz_Features *features, const char *expr);
+
+/* Answer all questions added so far.  If the preprocessor fails -- on an
+ * invalid expression, say -- every answer is unknown.
+ */
+void
+chaz_Features_run(chaz_Features *features);
+
+/* Return CHAZ_FEATURES_YES, CHAZ_FEATURES_NO or CHAZ_FEATURES_UNKNOWN.
+ */
+int
+chaz_Features_answer(chaz_Features *features, int question);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H_CHAZ_FEATURES */
+
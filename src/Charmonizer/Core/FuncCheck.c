@@ -0,0 +1,220 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Charmonizer/Core/FuncCheck.h"
+#include "Charmonizer/Core/CFlags.h"
+#include "Charmonizer/Core/Compiler.h"
+#include "Charmonizer/Core/ConfWriter.h"
+#include "Charmonizer/Core/Memo.h"
+#include "Charmonizer/Core/Util.h"
+
+/* Return the memo key for [func] given [includes] and [libs].
+ */
+static char*
+chaz_FuncCheck_key(const char *func, const char *includes,
+                   const char *libs);
+
+/* Return true if funcs[0] through funcs[count-1] all link together.
+ */
+static int
+chaz_FuncCheck_link(const char **funcs, int count, const char *includes,
+                    const char *libs);
+
+/* Find out which of funcs[0] through funcs[count-1] link, splitting the
+ * set whenever a link test fails, and remember the answers.
+ */
+static void
+chaz_FuncCheck_bisect(const char **funcs, int count, const char *includes,
+                      const char *libs);
+
+static void
+chaz_FuncCheck_remember(const char *func, const char *includes,
+                        const char *libs, int found);
+
+int
+chaz_FuncCheck_has(const char *func, const char *includes,
+                   const char *libs) {
+    const char *funcs[2];
+    funcs[0] = func;
+    funcs[1] = NULL;
+    return chaz_FuncCheck_check_many(funcs, includes, libs);
+}
+
+int
+chaz_FuncCheck_check_many(const char **funcs, const char *includes,
+                          const char *libs) {
+    const char **unknown;
+    int num_unknown = 0;
+    int found_all   = true;
+    int found;
+    int i;
+
+    for (i = 0; funcs[i] != NULL; i++) {}
+    unknown = (const char**)malloc((i + 1) * sizeof(char*));
+    for (i = 0; funcs[i] != NULL; i++) {
+        char *key = chaz_FuncCheck_key(funcs[i], includes, libs);
+        if (!chaz_Memo_fetch(CHAZ_MEMO_FUNCTION, key, &found, NULL, NULL)) {
+            unknown[num_unknown++] = funcs[i];
+        }
+        free(key);
+    }
+    if (num_unknown > 0) {
+        chaz_FuncCheck_bisect(unknown, num_unknown, includes, libs);
+    }
+    free(unknown);
+
+    for (i = 0; funcs[i] != NULL; i++) {
+        char *key = chaz_FuncCheck_key(funcs[i], includes, libs);
+        if (!chaz_Memo_fetch(CHAZ_MEMO_FUNCTION, key, &found, NULL, NULL)
+            || !found
+           ) {
+            found_all = false;
+        }
+        free(key);
+    }
+    return found_all;
+}
+
+int
+chaz_FuncCheck_define_many(const char **funcs, const char *includes,
+                           const char *libs) {
+    int num_found = 0;
+    int i;
+
+    chaz_FuncCheck_check_many(funcs, includes, libs);
+    for (i = 0; funcs[i] != NULL; i++) {
+        if (chaz_FuncCheck_has(funcs[i], includes, libs)) {
+            char *macro = chaz_Util_join("", "HAS_", funcs[i], NULL);
+            char *ptr;
+            for (ptr = macro; *ptr != '\0'; ptr++) {
+                *ptr = toupper((unsigned char)*ptr);
+            }
+            chaz_ConfWriter_add_def(macro, NULL);
+            free(macro);
+            num_found++;
+        }
+    }
+    return num_found;
+}
+
+static char*
+chaz_FuncCheck_key(const char *func, const char *includes,
+                   const char *libs) {
+    return chaz_Util_join("\t", func, includes ? includes : "",
+                          libs ? libs : "", NULL);
+}
+
+static void
+chaz_FuncCheck_bisect(const char **funcs, int count, const char *includes,
+                      const char *libs) {
+    int half = count / 2;
+    int i;
+
+    if (chaz_FuncCheck_link(funcs, count, includes, libs)) {
+        for (i = 0; i < count; i++) {
+            chaz_FuncCheck_remember(funcs[i], includes, libs, true);
+        }
+    }
+    else if (count == 1) {
+        chaz_FuncCheck_remember(funcs[0], includes, libs, false);
+    }
+    else {
+        chaz_FuncCheck_bisect(funcs, half, includes, libs);
+        chaz_FuncCheck_bisect(funcs + half, count - half, includes, libs);
+    }
+}
+
+static int
+chaz_FuncCheck_link(const char **funcs, int count, const char *includes,
+                    const char *libs) {
+    static const char decl_code[]  = "char %s(void);\n";
+    static const char entry_code[] = "    (chaz_func_t)%s,\n";
+    static const char main_code[] =
+        CHAZ_QUOTE(  };                                            )
+        CHAZ_QUOTE(  int main() {                                  )
+        CHAZ_QUOTE(      int i;                                    )
+        CHAZ_QUOTE(      for (i = 0; i < %d; i++) {                )
+        CHAZ_QUOTE(          if (chaz_funcs[i] == 0) { return 1; } )
+        CHAZ_QUOTE(      }                                         )
+        CHAZ_QUOTE(      return 0;                                 )
+        CHAZ_QUOTE(  }                                             );
+    chaz_CFlags *temp_cflags = chaz_CC_get_temp_cflags();
+    size_t  needed = 200 + sizeof(main_code);
+    char   *source;
+    char   *end;
+    int     succeeded;
+    int     i;
+
+    if (includes) { needed += strlen(includes); }
+    for (i = 0; i < count; i++) {
+        needed += 2 * strlen(funcs[i]) + sizeof(decl_code)
+                  + sizeof(entry_code);
+    }
+    source = (char*)malloc(needed);
+    end = source;
+    *end = '\0';
+
+    /* Taking the address of each function makes the linker resolve it,
+     * without having to know how to call it. */
+    if (includes && includes[0] != '\0') {
+        sprintf(end, "%s\n", includes);
+        end += strlen(end);
+    }
+    else {
+        for (i = 0; i < count; i++) {
+            sprintf(end, decl_code, funcs[i]);
+            end += strlen(end);
+        }
+    }
+    strcpy(end, "typedef void (*chaz_func_t)(void);\n"
+                "static chaz_func_t volatile chaz_funcs[] = {\n");
+    end += strlen(end);
+    for (i = 0; i < count; i++) {
+        sprintf(end, entry_code, funcs[i]);
+        end += strlen(end);
+    }
+    sprintf(end, main_code, count);
+
+    if (libs) {
+        char *copy = chaz_Util_strdup(libs);
+        char *lib  = strtok(copy, " ");
+        while (lib != NULL) {
+            chaz_CFlags_add_external_library(temp_cflags, lib);
+            lib = strtok(NULL, " ");
+        }
+        free(copy);
+    }
+    succeeded = chaz_CC_test_link(source);
+    if (libs) {
+        chaz_CFlags_clear(temp_cflags);
+    }
+
+    free(source);
+    return succeeded;
+}
+
+static void
+chaz_FuncCheck_remember(const char *func, const char *includes,
+                        const char *libs, int found) {
+    char *key = chaz_FuncCheck_key(func, includes, libs);
+    chaz_Memo_store(CHAZ_MEMO_FUNCTION, key, found, NULL, 0);
+    free(key);
+}
+
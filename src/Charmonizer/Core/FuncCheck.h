@@ -0,0 +1,64 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Charmonizer/Core/FuncCheck.h -- find out which library functions link.
+ *
+ * A function is available if a program which takes its address compiles
+ * and links, after some #include lines and against some libraries.  Many
+ * functions are checked with a single link test: if it fails, the set is
+ * split in half and each half is retried, so K missing functions among N
+ * cost O(K log N) links rather than N.  Every answer is remembered for the
+ * rest of the run, and link tests go through the probe cache.
+ */
+
+#ifndef H_CHAZ_FUNC_CHECK
+#define H_CHAZ_FUNC_CHECK
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "Charmonizer/Core/Defines.h"
+
+/* Return true if [func] links.  [includes] (which may be NULL) holds the
+ * #include lines which declare it; without them, the function is declared
+ * as "char func(void);" the way Autoconf does.  [libs] (which may be NULL)
+ * is a space-separated list of libraries to link against, such as "m".
+ */
+int
+chaz_FuncCheck_has(const char *func, const char *includes,
+                   const char *libs);
+
+/* Check all the functions in a null-terminated array, with link tests as
+ * described above.  Return true if every function was found.
+ */
+int
+chaz_FuncCheck_check_many(const char **funcs, const char *includes,
+                          const char *libs);
+
+/* Like chaz_FuncCheck_check_many, also writing HAS_<FUNC> to the config for
+ * every function which was found.  Return the number found.
+ */
+int
+chaz_FuncCheck_define_many(const char **funcs, const char *includes,
+                           const char *libs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H_CHAZ_FUNC_CHECK */
+
@@ -17,117 +17,214 @@
 #include "Charmonizer/Core/HeaderChecker.h"
 #include "Charmonizer/Core/Compiler.h"
 #include "Charmonizer/Core/ConfWriter.h"
+#include "Charmonizer/Core/Memo.h"
+#include "Charmonizer/Core/OpLog.h"
+#include "Charmonizer/Core/ProbeBatch.h"
 #include "Charmonizer/Core/Util.h"
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
-typedef struct chaz_CHeader {
-    const char  *name;
-    int          exists;
-} chaz_CHeader;
-
-/* Keep a sorted, dynamically-sized array of names of all headers we've
- * checked for so far.
- */
 static struct {
-    int            cache_size;
-    chaz_CHeader **header_cache;
-} chaz_HeadCheck = { 0, NULL };
+    int            no_has_include;
+    int            confirming;
+} chaz_HeadCheck = { false, false };
 
-/* Comparison function to feed to qsort, bsearch, etc.
+/* Headers which probes commonly ask about, discovered together by
+ * chaz_HeadCheck_init.
  */
-static int
-chaz_HeadCheck_compare_headers(const void *vptr_a, const void *vptr_b);
-
-/* Run a test compilation and return a new chaz_CHeader object encapsulating
- * the results.
+static const char *const chaz_HeadCheck_well_known[] = {
+    "alloca.h", "assert.h", "cpio.h", "ctype.h", "direct.h", "dirent.h",
+    "errno.h", "fcntl.h", "float.h", "grp.h", "intrin.h", "inttypes.h",
+    "io.h", "libkern/OSAtomic.h", "limits.h", "locale.h", "malloc.h",
+    "math.h", "pcre.h", "pcreposix.h", "process.h", "pthread.h", "pwd.h",
+    "regex.h", "setjmp.h", "signal.h", "stdarg.h", "stdbool.h", "stddef.h",
+    "stdint.h", "stdio.h", "stdlib.h", "string.h", "sys/atomic.h",
+    "sys/mman.h", "sys/stat.h", "sys/times.h", "sys/types.h",
+    "sys/utsname.h", "sys/wait.h", "tar.h", "termios.h", "time.h",
+    "unistd.h", "utime.h", "windows.h",
+    NULL
+};
+
+/* Run a test compilation and return true if the header exists.
  */
-static chaz_CHeader*
+static int
 chaz_HeadCheck_discover_header(const char *header_name);
 
-/* Extend the cache, add this chaz_CHeader object to it, and sort.
+/* Add a header to the register.
  */
 static void
-chaz_HeadCheck_add_to_cache(chaz_CHeader *header);
+chaz_HeadCheck_add_to_cache(const char *header_name, int exists);
 
-/* Like add_to_cache, but takes a individual elements instead of a
- * chaz_CHeader* and checks if header exists in array first.
+/* Return the source which asks __has_include about each of [count] headers,
+ * or NULL if a header name would break the directive.
  */
-static void
-chaz_HeadCheck_maybe_add_to_cache(const char *header_name, int exists);
+static char*
+chaz_HeadCheck_has_include_source(const char **header_names, int count);
 
 void
 chaz_HeadCheck_init(void) {
-    chaz_CHeader *null_header = (chaz_CHeader*)malloc(sizeof(chaz_CHeader));
-
-    /* Create terminating record for the dynamic array of chaz_CHeader
-     * objects. */
-    null_header->name   = NULL;
-    null_header->exists = false;
-    chaz_HeadCheck.header_cache    = (chaz_CHeader**)malloc(sizeof(void*));
-    *(chaz_HeadCheck.header_cache) = null_header;
-    chaz_HeadCheck.cache_size = 1;
+    /* Fill the register up front, so that probe modules -- which may run
+     * in child processes -- all start out knowing the usual headers. */
+    chaz_HeadCheck_discover_headers((const char**)chaz_HeadCheck_well_known);
 }
 
 int
 chaz_HeadCheck_check_header(const char *header_name) {
-    chaz_CHeader  *header;
-    chaz_CHeader   key;
-    chaz_CHeader  *fake = &key;
-    chaz_CHeader **header_ptr;
-
-    /* Fake up a key to feed to bsearch; see if the header's already there. */
-    key.name = header_name;
-    key.exists = false;
-    header_ptr = (chaz_CHeader**)bsearch(&fake, chaz_HeadCheck.header_cache,
-                                         chaz_HeadCheck.cache_size,
-                                         sizeof(void*),
-                                         chaz_HeadCheck_compare_headers);
+    int exists;
 
     /* If it's not there, go try a test compile. */
-    if (header_ptr == NULL) {
-        header = chaz_HeadCheck_discover_header(header_name);
-        chaz_HeadCheck_add_to_cache(header);
-    }
-    else {
-        header = *header_ptr;
+    if (!chaz_HeadCheck_lookup(header_name, &exists)) {
+        exists = chaz_HeadCheck_discover_header(header_name);
+        chaz_HeadCheck_add_to_cache(header_name, exists);
     }
 
-    return header->exists;
+    return exists;
 }
 
 int
 chaz_HeadCheck_check_many_headers(const char **header_names) {
-    static const char test_code[] = "int main() { return 0; }\n";
-    int success;
+    chaz_ProbeBatch *batch = chaz_ProbeBatch_new();
+    int success = true;
     int i;
-    char *code_buf;
-    size_t needed = sizeof(test_code) + 20;
 
-    /* Build the source code string. */
     for (i = 0; header_names[i] != NULL; i++) {
-        needed += strlen(header_names[i]);
-        needed += sizeof("#include <>\n");
+        chaz_ProbeBatch_add_header(batch, header_names[i]);
     }
-    code_buf = (char*)malloc(needed);
-    code_buf[0] = '\0';
+    chaz_ProbeBatch_run(batch);
     for (i = 0; header_names[i] != NULL; i++) {
-        strcat(code_buf, "#include <");
-        strcat(code_buf, header_names[i]);
-        strcat(code_buf, ">\n");
+        if (!chaz_ProbeBatch_succeeded(batch, i)) {
+            success = false;
+        }
     }
-    strcat(code_buf, test_code);
 
-    /* If the code compiles, bulk add all header names to the cache. */
-    success = chaz_CC_test_compile(code_buf);
-    if (success) {
-        for (i = 0; header_names[i] != NULL; i++) {
-            chaz_HeadCheck_maybe_add_to_cache(header_names[i], true);
+    chaz_ProbeBatch_destroy(batch);
+    return success;
+}
+
+int
+chaz_HeadCheck_discover_headers(const char **header_names) {
+    const char **unknown;
+    const char **found;
+    char   *source;
+    char   *output;
+    char   *line;
+    size_t  output_len;
+    int    *exists;
+    int     num_unknown = 0;
+    int     num_found   = 0;
+    int     num_answers = 0;
+    int     exists_dummy;
+    int     i;
+
+    /* The batch which confirms what we found asks us first; leave its
+     * headers to it. */
+    if (chaz_HeadCheck.no_has_include || chaz_HeadCheck.confirming) {
+        return false;
+    }
+    for (i = 0; header_names[i] != NULL; i++) {}
+    unknown = (const char**)malloc((i + 1) * sizeof(char*));
+    found   = (const char**)malloc((i + 1) * sizeof(char*));
+    exists  = (int*)calloc(i + 1, sizeof(int));
+    for (i = 0; header_names[i] != NULL; i++) {
+        if (!chaz_HeadCheck_lookup(header_names[i], &exists_dummy)) {
+            unknown[num_unknown++] = header_names[i];
+        }
+    }
+    if (num_unknown == 0) {
+        free(unknown);
+        free(found);
+        free(exists);
+        return true;
+    }
+
+    /* Every header gets a line saying whether it exists. */
+    source = chaz_HeadCheck_has_include_source(unknown, num_unknown);
+    output = source ? chaz_CC_preprocess(source, &output_len) : NULL;
+    for (line = output; line != NULL && *line != '\0'; ) {
+        int index;
+        int yes;
+        line += strspn(line, " \t");
+        if (strncmp(line, "chaz_has_header ", 16) == 0
+            && sscanf(line + 16, "%d %d", &index, &yes) == 2
+            && index >= 0 && index < num_unknown
+           ) {
+            exists[index] = yes;
+            num_answers++;
         }
+        line = strchr(line, '\n');
+        if (line != NULL) { line++; }
+    }
+    free(output);
+    free(source);
+
+    if (num_answers != num_unknown) {
+        chaz_HeadCheck.no_has_include = true;
+        free(unknown);
+        free(found);
+        free(exists);
+        return false;
     }
 
-    free(code_buf);
-    return success;
+    for (i = 0; i < num_unknown; i++) {
+        if (exists[i]) { found[num_found++] = unknown[i]; }
+        else           { chaz_HeadCheck_record(unknown[i], false); }
+    }
+
+    /* A header which exists may still refuse to be included.  The ones
+     * found get the same treatment as headers checked without
+     * __has_include: one compile for all of them, and bisection if that
+     * fails. */
+    if (num_found > 0) {
+        chaz_ProbeBatch *batch = chaz_ProbeBatch_new();
+        for (i = 0; i < num_found; i++) {
+            chaz_ProbeBatch_add_header(batch, found[i]);
+        }
+        chaz_HeadCheck.confirming = true;
+        chaz_ProbeBatch_run(batch);
+        chaz_HeadCheck.confirming = false;
+        chaz_ProbeBatch_destroy(batch);
+    }
+
+    free(unknown);
+    free(found);
+    free(exists);
+    return true;
+}
+
+static char*
+chaz_HeadCheck_has_include_source(const char **header_names, int count) {
+    static const char header_code[] =
+        CHAZ_QUOTE(  #if __has_include(<%s>)      )
+        CHAZ_QUOTE(  chaz_has_header %d 1         )
+        CHAZ_QUOTE(  #else                        )
+        CHAZ_QUOTE(  chaz_has_header %d 0         )
+        CHAZ_QUOTE(  #endif                       );
+    size_t needed = 100;
+    char  *source;
+    char  *end;
+    int    i;
+
+    for (i = 0; i < count; i++) {
+        /* Quotes or angle brackets would break the directive. */
+        if (strpbrk(header_names[i], "<>\"") != NULL) { return NULL; }
+        needed += sizeof(header_code) + strlen(header_names[i]) + 40;
+    }
+    source = (char*)malloc(needed);
+    strcpy(source, "#if defined(__has_include)\n");
+    end = source + strlen(source);
+    for (i = 0; i < count; i++) {
+        sprintf(end, header_code, header_names[i], i, i);
+        end += strlen(end);
+    }
+    strcpy(end, "#endif\n");
+    return source;
+}
+
+int
+chaz_HeadCheck_lookup(const char *header_name, int *exists) {
+    return chaz_Memo_fetch(CHAZ_MEMO_HEADER, header_name, exists,
+                           NULL, NULL);
 }
 
 int
@@ -151,70 +248,46 @@ chaz_HeadCheck_contains_member(const char *struct_name, const char *member,
 }
 
 static int
-chaz_HeadCheck_compare_headers(const void *vptr_a, const void *vptr_b) {
-    chaz_CHeader *const *const a = (chaz_CHeader*const*)vptr_a;
-    chaz_CHeader *const *const b = (chaz_CHeader*const*)vptr_b;
-
-    /* (NULL is "greater than" any string.) */
-    if ((*a)->name == NULL)      { return 1; }
-    else if ((*b)->name == NULL) { return -1; }
-    else                         { return strcmp((*a)->name, (*b)->name); }
-}
-
-static chaz_CHeader*
 chaz_HeadCheck_discover_header(const char *header_name) {
     static const char test_code[] = "int main() { return 0; }\n";
-    chaz_CHeader* header = (chaz_CHeader*)malloc(sizeof(chaz_CHeader));
     size_t  needed = strlen(header_name) + sizeof(test_code) + 50;
     char *include_test = (char*)malloc(needed);
-
-    /* Assign. */
-    header->name = chaz_Util_strdup(header_name);
+    int   exists;
 
     /* See whether code that tries to pull in this header compiles. */
     sprintf(include_test, "#include <%s>\n%s", header_name, test_code);
-    header->exists = chaz_CC_test_compile(include_test);
+    exists = chaz_CC_test_compile(include_test);
 
     free(include_test);
-    return header;
+    return exists;
 }
 
 static void
-chaz_HeadCheck_add_to_cache(chaz_CHeader *header) {
-    size_t amount;
-
-    /* Realloc array -- inefficient, but this isn't a bottleneck. */
-    amount = ++chaz_HeadCheck.cache_size * sizeof(void*);
-    chaz_HeadCheck.header_cache
-        = (chaz_CHeader**)realloc(chaz_HeadCheck.header_cache, amount);
-    chaz_HeadCheck.header_cache[chaz_HeadCheck.cache_size - 1] = header;
-
-    /* Keep the list of headers sorted. */
-    qsort(chaz_HeadCheck.header_cache, chaz_HeadCheck.cache_size,
-          sizeof(*(chaz_HeadCheck.header_cache)),
-          chaz_HeadCheck_compare_headers);
+chaz_HeadCheck_add_to_cache(const char *header_name, int exists) {
+    /* Let whoever replays the log know about the header, too. */
+    if (chaz_OpLog_recording()) {
+        chaz_OpLog_write(CHAZ_HEADCHECK_OP_HEADER, 2, header_name,
+                         exists ? "1" : "0");
+    }
+    chaz_Memo_store(CHAZ_MEMO_HEADER, header_name, exists, NULL, 0);
 }
 
-static void
-chaz_HeadCheck_maybe_add_to_cache(const char *header_name, int exists) {
-    chaz_CHeader *header;
-    chaz_CHeader  key;
-    chaz_CHeader *fake = &key;
-
-    /* Fake up a key and bsearch for it. */
-    key.name   = header_name;
-    key.exists = exists;
-    header = (chaz_CHeader*)bsearch(&fake, chaz_HeadCheck.header_cache,
-                                    chaz_HeadCheck.cache_size, sizeof(void*),
-                                    chaz_HeadCheck_compare_headers);
+void
+chaz_HeadCheck_record(const char *header_name, int exists) {
+    int known;
 
     /* We've already done the test compile, so skip that step and add it. */
-    if (header == NULL) {
-        header = (chaz_CHeader*)malloc(sizeof(chaz_CHeader));
-        header->name   = chaz_Util_strdup(header_name);
-        header->exists = exists;
-        chaz_HeadCheck_add_to_cache(header);
+    if (!chaz_HeadCheck_lookup(header_name, &known)) {
+        chaz_HeadCheck_add_to_cache(header_name, exists);
     }
 }
 
+int
+chaz_HeadCheck_replay(char op, const char **fields, int num_fields) {
+    if (op != CHAZ_HEADCHECK_OP_HEADER || num_fields != 2) {
+        return false;
+    }
+    chaz_HeadCheck_record(fields[0], fields[1][0] == '1');
+    return true;
+}
 
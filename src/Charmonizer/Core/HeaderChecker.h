@@ -26,7 +26,14 @@ extern "C" {
 
 #include "Charmonizer/Core/Defines.h"
 
-/* Bootstrap the HeadCheck.  Call this before anything else.
+/* Operation code under which newly registered headers are recorded by
+ * chaz_OpLog, with the header name and "1" or "0" as fields.
+ */
+#define CHAZ_HEADCHECK_OP_HEADER 'H'
+
+/* Bootstrap the HeadCheck.  Call this before anything else, but after
+ * chaz_CC_init: the headers which probes commonly ask about are discovered
+ * right away.
  */
 void
 chaz_HeadCheck_init(void);
@@ -37,13 +44,44 @@ chaz_HeadCheck_init(void);
 int
 chaz_HeadCheck_check_header(const char *header_name);
 
-/* Attempt to compile a file which pulls in all the headers specified by name
- * in a null-terminated array.  If the compile succeeds, add them all to the
- * internal register and return true.
+/* Check for all the headers specified by name in a null-terminated array,
+ * using a single test compile if they are all available and bisecting if
+ * not.  Every header in a unit which compiles counts as present.  Add each
+ * result to the internal register and return true if every header was
+ * found.
  */
 int
 chaz_HeadCheck_check_many_headers(const char **header_names);
 
+/* Find out which of the headers in a null-terminated array exist with a
+ * single run of the preprocessor, using __has_include, and add the results
+ * to the internal register.  The headers which exist are then compiled as
+ * chaz_HeadCheck_check_many_headers does, so both ways give the same
+ * answers.  Headers which are already there are skipped.  Return false if
+ * the compiler doesn't support __has_include, in which case the headers are
+ * left to be checked some other way.
+ */
+int
+chaz_HeadCheck_discover_headers(const char **header_names);
+
+/* If the header has already been checked for, store the result in [exists]
+ * and return true.  Return false without compiling anything otherwise.
+ */
+int
+chaz_HeadCheck_lookup(const char *header_name, int *exists);
+
+/* Add the result of a check made elsewhere to the internal register, unless
+ * the header is already there.
+ */
+void
+chaz_HeadCheck_record(const char *header_name, int exists);
+
+/* Register a header read back from an operation log.  Return false if [op]
+ * isn't a HeadCheck operation.
+ */
+int
+chaz_HeadCheck_replay(char op, const char **fields, int num_fields);
+
 /* Return true if the member is present in the struct. */
 int
 chaz_HeadCheck_contains_member(const char *struct_name, const char *member,
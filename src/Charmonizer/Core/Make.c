@@ -18,8 +18,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include "Charmonizer/Core/Make.h"
+#include "Charmonizer/Core/Cache.h"
 #include "Charmonizer/Core/Compiler.h"
 #include "Charmonizer/Core/OperatingSystem.h"
+#include "Charmonizer/Core/Scratch.h"
 #include "Charmonizer/Core/Util.h"
 
 struct chaz_MakeVar {
@@ -67,7 +69,7 @@ static int
 chaz_Make_detect(const char *make1, ...);
 
 static int
-chaz_Make_audition(const char *make);
+chaz_Make_audition(const char *make, const char *makefile_path);
 
 static chaz_MakeRule*
 S_new_rule(const char *target, const char *prereq);
@@ -116,39 +118,80 @@ static int
 chaz_Make_detect(const char *make1, ...) {
     va_list args;
     const char *candidate;
+    const char *path_env = getenv("PATH");
+    char *candidates = chaz_Util_strdup(make1);
+    char *cache_key;
+    char *cached_make = NULL;
     int found = 0;
     const char makefile_content[] = "foo:\n\techo \"foo!\"\n";
-    chaz_Util_write_file("_charm_Makefile", makefile_content);
+    char *makefile_path;
+
+    /* Consult the probe cache, which is keyed by the candidates and the
+     * search path. */
+    va_start(args, make1);
+    while (NULL != (candidate = va_arg(args, const char*))) {
+        char *joined = chaz_Util_join(" ", candidates, candidate, NULL);
+        free(candidates);
+        candidates = joined;
+    }
+    va_end(args);
+    cache_key = chaz_Cache_key("make", candidates, path_env ? path_env : "",
+                               NULL);
+    free(candidates);
+    if (chaz_Cache_fetch(cache_key, &found, &cached_make, NULL)) {
+        free(cache_key);
+        if (found && cached_make) {
+            chaz_Make.make_command = cached_make;
+            return 1;
+        }
+        free(cached_make);
+        return 0;
+    }
+
+    makefile_path = chaz_Scratch_path("_charm_Makefile");
+    chaz_Util_write_file(makefile_path, makefile_content);
 
     /* Audition candidates. */
-    found = chaz_Make_audition(make1);
+    found = chaz_Make_audition(make1, makefile_path);
     va_start(args, make1);
     while (!found && (NULL != (candidate = va_arg(args, const char*)))) {
-        found = chaz_Make_audition(candidate);
+        found = chaz_Make_audition(candidate, makefile_path);
     }
     va_end(args);
 
-    chaz_Util_remove_and_verify("_charm_Makefile");
+    chaz_Util_remove_and_verify(makefile_path);
+    free(makefile_path);
+
+    if (found) {
+        chaz_Cache_store(cache_key, found, chaz_Make.make_command,
+                         strlen(chaz_Make.make_command));
+    }
+    else {
+        chaz_Cache_store(cache_key, found, NULL, 0);
+    }
+    free(cache_key);
 
     return found;
 }
 
 static int
-chaz_Make_audition(const char *make) {
+chaz_Make_audition(const char *make, const char *makefile_path) {
     int succeeded = 0;
-    char *command = chaz_Util_join(" ", make, "-f", "_charm_Makefile", NULL);
+    char *command = chaz_Util_join(" ", make, "-f", makefile_path, NULL);
+    char *output_path = chaz_Scratch_path("_charm_foo");
 
-    chaz_Util_remove_and_verify("_charm_foo");
-    chaz_OS_run_redirected(command, "_charm_foo");
-    if (chaz_Util_can_open_file("_charm_foo")) {
+    chaz_Util_remove_and_verify(output_path);
+    chaz_OS_run_redirected(command, output_path);
+    if (chaz_Util_can_open_file(output_path)) {
         size_t len;
-        char *content = chaz_Util_slurp_file("_charm_foo", &len);
+        char *content = chaz_Util_slurp_file(output_path, &len);
         if (NULL != strstr(content, "foo!")) {
             succeeded = 1;
         }
         free(content);
     }
-    chaz_Util_remove_and_verify("_charm_foo");
+    chaz_Util_remove_and_verify(output_path);
+    free(output_path);
 
     if (succeeded) {
         chaz_Make.make_command = chaz_Util_strdup(make);
@@ -455,10 +498,7 @@ chaz_MakeFile_write(chaz_MakeFile *makefile) {
     FILE   *out;
     size_t  i;
 
-    out = fopen("Makefile", "w");
-    if (!out) {
-        chaz_Util_die("Can't open Makefile\n");
-    }
+    out = chaz_Util_open_output("Makefile");
 
     for (i = 0; makefile->vars[i]; i++) {
         chaz_MakeVar *var = makefile->vars[i];
@@ -483,7 +523,7 @@ chaz_MakeFile_write(chaz_MakeFile *makefile) {
         fprintf(out, "\t$(CC) $(CFLAGS) -c $< -o $@\n\n");
     }
 
-    fclose(out);
+    chaz_Util_close_output(out, "Makefile");
 }
 
 void
@@ -0,0 +1,191 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "Charmonizer/Core/Memo.h"
+#include "Charmonizer/Core/Util.h"
+
+/* The table doubles when it gets more than this many percent full.
+ */
+#define CHAZ_MEMO_MAX_LOAD 70
+
+typedef struct chaz_MemoEntry {
+    char          *key;
+    unsigned long  hash;
+    int            kind;
+    int            result;
+    char          *output;
+    size_t         output_len;
+} chaz_MemoEntry;
+
+/* An open-addressing hash table with linear probing.  Entries are never
+ * removed, so an empty slot ends every search.
+ */
+static struct {
+    chaz_MemoEntry *slots;
+    size_t          num_slots;
+    size_t          num_entries;
+    long            hits;
+    long            misses;
+} chaz_Memo = { NULL, 0, 0, 0, 0 };
+
+static unsigned long
+chaz_Memo_hash(int kind, const char *key);
+
+/* Return the slot holding [kind] and [key], or the empty slot where they
+ * belong.  The table must not be full.
+ */
+static chaz_MemoEntry*
+chaz_Memo_find(int kind, const char *key, unsigned long hash);
+
+static void
+chaz_Memo_grow(void);
+
+void
+chaz_Memo_clean_up(void) {
+    size_t i;
+    for (i = 0; i < chaz_Memo.num_slots; i++) {
+        free(chaz_Memo.slots[i].key);
+        free(chaz_Memo.slots[i].output);
+    }
+    free(chaz_Memo.slots);
+    chaz_Memo.slots       = NULL;
+    chaz_Memo.num_slots   = 0;
+    chaz_Memo.num_entries = 0;
+    chaz_Memo.hits        = 0;
+    chaz_Memo.misses      = 0;
+}
+
+int
+chaz_Memo_fetch(int kind, const char *key, int *result, char **output,
+                size_t *output_len) {
+    chaz_MemoEntry *entry;
+
+    if (output) {
+        *output     = NULL;
+        *output_len = 0;
+    }
+    if (chaz_Memo.num_entries == 0) {
+        chaz_Memo.misses++;
+        return false;
+    }
+    entry = chaz_Memo_find(kind, key, chaz_Memo_hash(kind, key));
+    if (entry->key == NULL) {
+        chaz_Memo.misses++;
+        return false;
+    }
+
+    chaz_Memo.hits++;
+    *result = entry->result;
+    if (output && entry->output != NULL) {
+        *output = (char*)malloc(entry->output_len + 1);
+        memcpy(*output, entry->output, entry->output_len);
+        (*output)[entry->output_len] = '\0';
+        *output_len = entry->output_len;
+    }
+    return true;
+}
+
+void
+chaz_Memo_store(int kind, const char *key, int result, const char *output,
+                size_t output_len) {
+    unsigned long   hash = chaz_Memo_hash(kind, key);
+    chaz_MemoEntry *entry;
+
+    if ((chaz_Memo.num_entries + 1) * 100
+        > chaz_Memo.num_slots * CHAZ_MEMO_MAX_LOAD
+       ) {
+        chaz_Memo_grow();
+    }
+    entry = chaz_Memo_find(kind, key, hash);
+    if (entry->key == NULL) {
+        entry->key  = chaz_Util_strdup(key);
+        entry->hash = hash;
+        entry->kind = kind;
+        chaz_Memo.num_entries++;
+    }
+    else {
+        free(entry->output);
+    }
+    entry->result     = result;
+    entry->output     = NULL;
+    entry->output_len = 0;
+    if (output != NULL) {
+        entry->output = (char*)malloc(output_len + 1);
+        memcpy(entry->output, output, output_len);
+        entry->output[output_len] = '\0';
+        entry->output_len = output_len;
+    }
+}
+
+long
+chaz_Memo_hits(void) {
+    return chaz_Memo.hits;
+}
+
+long
+chaz_Memo_misses(void) {
+    return chaz_Memo.misses;
+}
+
+static unsigned long
+chaz_Memo_hash(int kind, const char *key) {
+    /* 32-bit FNV-1a, starting with the kind. */
+    unsigned long hash = 2166136261UL;
+    hash = ((hash ^ (unsigned long)(kind & 0xFF)) * 16777619UL)
+           & 0xFFFFFFFFUL;
+    while (*key != '\0') {
+        hash = ((hash ^ (unsigned char)*key++) * 16777619UL) & 0xFFFFFFFFUL;
+    }
+    return hash;
+}
+
+static chaz_MemoEntry*
+chaz_Memo_find(int kind, const char *key, unsigned long hash) {
+    size_t mask = chaz_Memo.num_slots - 1;
+    size_t i    = (size_t)hash & mask;
+    while (1) {
+        chaz_MemoEntry *entry = &chaz_Memo.slots[i];
+        if (entry->key == NULL
+            || (entry->hash == hash
+                && entry->kind == kind
+                && strcmp(entry->key, key) == 0)
+           ) {
+            return entry;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+static void
+chaz_Memo_grow(void) {
+    chaz_MemoEntry *old_slots     = chaz_Memo.slots;
+    size_t          old_num_slots = chaz_Memo.num_slots;
+    size_t          i;
+
+    chaz_Memo.num_slots = old_num_slots ? old_num_slots * 2 : 64;
+    chaz_Memo.slots = (chaz_MemoEntry*)calloc(chaz_Memo.num_slots,
+                                              sizeof(chaz_MemoEntry));
+    for (i = 0; i < old_num_slots; i++) {
+        chaz_MemoEntry *old = &old_slots[i];
+        if (old->key != NULL) {
+            *chaz_Memo_find(old->kind, old->key, old->hash) = *old;
+        }
+    }
+    free(old_slots);
+}
+
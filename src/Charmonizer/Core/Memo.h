@@ -0,0 +1,81 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Charmonizer/Core/Memo.h -- remember probe results for the rest of a run.
+ *
+ * The memo is an in-memory hash table of probe results, keyed by the kind
+ * of probe and a string which identifies everything the result depends on.
+ * It sits in front of the persistent probe cache: asking the same question
+ * twice during a run costs a single lookup, whether or not a cache
+ * directory is in use.
+ *
+ * Probe modules which run in child processes start out with a copy of
+ * their parent's memo.  What they learn stays in the child.
+ */
+
+#ifndef H_CHAZ_MEMO
+#define H_CHAZ_MEMO
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "Charmonizer/Core/Defines.h"
+
+/* Kinds of results kept by modules other than chaz_CC, which numbers the
+ * kinds of its probes from 1.
+ */
+#define CHAZ_MEMO_HEADER    100
+#define CHAZ_MEMO_FUNCTION  101
+#define CHAZ_MEMO_SIZEOF    102
+#define CHAZ_MEMO_ALIGNOF   103
+
+/* Free all entries and reset the counters.
+ */
+void
+chaz_Memo_clean_up(void);
+
+/* Look up the result of kind [kind] stored under [key].  On a hit, return
+ * true, store the result code in [result] and -- if [output] is not NULL --
+ * a newly allocated copy of the stored output in [output].  An output which
+ * was stored as NULL is returned as NULL; an empty one as an empty string.
+ */
+int
+chaz_Memo_fetch(int kind, const char *key, int *result, char **output,
+                size_t *output_len);
+
+/* Store a result code and an optional output, replacing any earlier result
+ * stored under the same kind and key.
+ */
+void
+chaz_Memo_store(int kind, const char *key, int result, const char *output,
+                size_t output_len);
+
+/* Number of lookups which found a result, and which didn't.
+ */
+long
+chaz_Memo_hits(void);
+
+long
+chaz_Memo_misses(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H_CHAZ_MEMO */
+
@@ -0,0 +1,181 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Charmonizer/Core/OpLog.h"
+#include "Charmonizer/Core/Util.h"
+
+/* Fields are written as 'S' followed by the NUL-terminated string, or 'N'
+ * for NULL.  A newline ends the operation.
+ */
+#define CHAZ_OPLOG_STRING  'S'
+#define CHAZ_OPLOG_NULL    'N'
+#define CHAZ_OPLOG_END     '\n'
+
+static struct {
+    FILE *file;
+    char *path;
+} chaz_OpLog = { NULL, NULL };
+
+/* Write one field to the open log.
+ */
+static void
+chaz_OpLog_write_field(const char *field);
+
+/* Read the whole file at [path] in binary mode.
+ */
+static char*
+chaz_OpLog_slurp(const char *path, size_t *len);
+
+void
+chaz_OpLog_open(const char *path) {
+    if (chaz_OpLog.file != NULL) {
+        chaz_Util_die("Already recording to '%s'", chaz_OpLog.path);
+    }
+    chaz_OpLog.file = fopen(path, "wb");
+    if (chaz_OpLog.file == NULL) {
+        chaz_Util_die("Can't open '%s': %s", path, strerror(errno));
+    }
+    chaz_OpLog.path = chaz_Util_strdup(path);
+}
+
+void
+chaz_OpLog_close(void) {
+    if (chaz_OpLog.file == NULL) {
+        return;
+    }
+    if (fclose(chaz_OpLog.file) != 0) {
+        chaz_Util_die("Error when closing '%s': %s", chaz_OpLog.path,
+                      strerror(errno));
+    }
+    chaz_OpLog.file = NULL;
+    free(chaz_OpLog.path);
+    chaz_OpLog.path = NULL;
+}
+
+int
+chaz_OpLog_recording(void) {
+    return chaz_OpLog.file != NULL;
+}
+
+void
+chaz_OpLog_write(char op, int num_fields, ...) {
+    va_list args;
+    int i;
+
+    fputc(op, chaz_OpLog.file);
+    va_start(args, num_fields);
+    for (i = 0; i < num_fields; i++) {
+        chaz_OpLog_write_field(va_arg(args, const char*));
+    }
+    va_end(args);
+    fputc(CHAZ_OPLOG_END, chaz_OpLog.file);
+}
+
+void
+chaz_OpLog_vformat(char op, const char *fmt, va_list args) {
+    fputc(op, chaz_OpLog.file);
+    fputc(CHAZ_OPLOG_STRING, chaz_OpLog.file);
+    vfprintf(chaz_OpLog.file, fmt, args);
+    fputc('\0', chaz_OpLog.file);
+    fputc(CHAZ_OPLOG_END, chaz_OpLog.file);
+}
+
+static void
+chaz_OpLog_write_field(const char *field) {
+    if (field == NULL) {
+        fputc(CHAZ_OPLOG_NULL, chaz_OpLog.file);
+        return;
+    }
+    fputc(CHAZ_OPLOG_STRING, chaz_OpLog.file);
+    fwrite(field, 1, strlen(field) + 1, chaz_OpLog.file);
+}
+
+void
+chaz_OpLog_replay(const char *path, const char *ops,
+                  chaz_OpLog_handler_t handler) {
+    const char *fields[CHAZ_OPLOG_MAX_FIELDS];
+    size_t      len;
+    char       *log = chaz_OpLog_slurp(path, &len);
+    char       *ptr = log;
+    char       *end = log + len;
+
+    while (ptr < end) {
+        char op = *ptr++;
+        int  num_fields = 0;
+
+        while (ptr < end && *ptr != CHAZ_OPLOG_END) {
+            const char *field = NULL;
+            if (num_fields == CHAZ_OPLOG_MAX_FIELDS) {
+                chaz_Util_die("Corrupt operation log '%s'", path);
+            }
+            if (*ptr == CHAZ_OPLOG_STRING) {
+                field = ++ptr;
+                ptr = (char*)memchr(ptr, '\0', (size_t)(end - ptr));
+                if (ptr == NULL) {
+                    chaz_Util_die("Truncated operation log '%s'", path);
+                }
+            }
+            else if (*ptr != CHAZ_OPLOG_NULL) {
+                chaz_Util_die("Corrupt operation log '%s'", path);
+            }
+            ptr++;
+            fields[num_fields++] = field;
+        }
+        if (ptr == end) {
+            chaz_Util_die("Truncated operation log '%s'", path);
+        }
+        ptr++;
+
+        if (ops == NULL || strchr(ops, op) != NULL) {
+            handler(op, fields, num_fields);
+        }
+    }
+
+    free(log);
+}
+
+static char*
+chaz_OpLog_slurp(const char *path, size_t *len) {
+    FILE   *file = fopen(path, "rb");
+    char   *contents;
+    long    size;
+
+    if (file == NULL) {
+        chaz_Util_die("Can't open '%s': %s", path, strerror(errno));
+    }
+    if (fseek(file, 0, SEEK_END) != 0) {
+        chaz_Util_die("Can't read '%s': %s", path, strerror(errno));
+    }
+    size = ftell(file);
+    if (size < 0) {
+        chaz_Util_die("Can't read '%s': %s", path, strerror(errno));
+    }
+    rewind(file);
+    contents = (char*)malloc((size_t)size + 1);
+    *len = fread(contents, 1, (size_t)size, file);
+    if (*len != (size_t)size) {
+        chaz_Util_die("Can't read '%s'", path);
+    }
+    fclose(file);
+    contents[*len] = '\0';
+    return contents;
+}
+
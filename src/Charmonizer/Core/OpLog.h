@@ -0,0 +1,86 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Charmonizer/Core/OpLog.h -- record and replay configuration operations.
+ *
+ * While a log is being recorded, operations which would otherwise change
+ * shared state -- writing to the config files, registering a header with
+ * HeadCheck -- are appended to a file instead.  Another process can then
+ * replay them in whatever order it chooses.  This is how probe modules run
+ * in child processes hand their results back.
+ *
+ * Each operation is a single character naming it, followed by up to
+ * CHAZ_OPLOG_MAX_FIELDS string fields, any of which may be NULL.
+ */
+
+#ifndef H_CHAZ_OPLOG
+#define H_CHAZ_OPLOG
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdarg.h>
+#include "Charmonizer/Core/Defines.h"
+
+#define CHAZ_OPLOG_MAX_FIELDS 4
+
+/* Start recording operations to the file at [path], replacing anything in
+ * it.
+ */
+void
+chaz_OpLog_open(const char *path);
+
+/* Stop recording and close the file.
+ */
+void
+chaz_OpLog_close(void);
+
+/* Return true while operations are being recorded.
+ */
+int
+chaz_OpLog_recording(void);
+
+/* Record operation [op] with [num_fields] fields, passed as const char*
+ * arguments.
+ */
+void
+chaz_OpLog_write(char op, int num_fields, ...);
+
+/* Record operation [op] with a single field, formatted printf-style.
+ */
+void
+chaz_OpLog_vformat(char op, const char *fmt, va_list args);
+
+/* Called for every operation read back by chaz_OpLog_replay.
+ */
+typedef void
+(*chaz_OpLog_handler_t)(char op, const char **fields, int num_fields);
+
+/* Read the operations recorded in [path] and pass those listed in [ops] --
+ * or all of them, if [ops] is NULL -- to [handler], in the order they were
+ * recorded.
+ */
+void
+chaz_OpLog_replay(const char *path, const char *ops,
+                  chaz_OpLog_handler_t handler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H_CHAZ_OPLOG */
+
@@ -21,14 +21,38 @@
 #include <time.h>
 #include <errno.h>
 
+#include "Charmonizer/Core/Defines.h"
 #include "Charmonizer/Core/Compiler.h"
 #include "Charmonizer/Core/Util.h"
 #include "Charmonizer/Core/ConfWriter.h"
 #include "Charmonizer/Core/OperatingSystem.h"
+#include "Charmonizer/Core/Scratch.h"
+#include "Charmonizer/Core/Trace.h"
 
-#define CHAZ_OS_TARGET_PATH  "_charmonizer_target"
+#ifdef CHAZ_HAS_POSIX_API
+  #include <signal.h>
+  #include <sys/types.h>
+  #include <sys/resource.h>
+  #include <sys/select.h>
+  #include <sys/time.h>
+  #include <sys/wait.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+  #ifdef __STRICT_ANSI__
+    /* Strict ANSI modes hide kill() in <signal.h>. */
+    extern int kill(pid_t pid, int sig);
+  #endif
+#endif
+
+#define CHAZ_OS_TARGET_NAME  "_charmonizer_target"
 #define CHAZ_OS_NAME_MAX     31
 
+/* Default limits for probe executables: a minute of wall-clock time and
+ * 16 MB of output.
+ */
+#define CHAZ_OS_DEFAULT_TIMEOUT     60
+#define CHAZ_OS_DEFAULT_MAX_OUTPUT  (16L * 1024 * 1024)
+
 static struct {
     char name[CHAZ_OS_NAME_MAX+1];
     char dev_null[20];
@@ -37,7 +61,112 @@ static struct {
     char shared_lib_ext[7];
     char local_command_start[3];
     int  shell_type;
-} chaz_OS = { "", "", "", "", "", "", 0 };
+    const char *child_dir;
+    char *run_wrapper;
+
+    /* Limits for probe executables, zero meaning none. */
+    int   run_timeout;
+    long  run_cpu;
+    long  run_memory;
+    long  run_max_output;
+
+    /* Set while a probe executable runs, and why it was stopped, if it
+     * was. */
+    int   supervise;
+    char  stopped[80];
+
+    /* Both ends of the pipe which holds the token pool, or -1. */
+    int   token_fds[2];
+} chaz_OS = {
+    "", "", "", "", "", "", 0, NULL, NULL,
+    CHAZ_OS_DEFAULT_TIMEOUT, 0, 0, CHAZ_OS_DEFAULT_MAX_OUTPUT,
+    false, "",
+    { -1, -1 }
+};
+
+/* Run [command], sending stdout and stderr to [path] unless [path] is NULL.
+ * Return the exit status.
+ */
+static int
+chaz_OS_run_command(const char *command, const char *path);
+
+/* Rename and then remove a file, retrying for a while if either fails.
+ */
+static int
+chaz_OS_remove_with_retry(const char *name);
+
+/* Return [command] in a form which runs the executable it starts with from
+ * the scratch directory.  Sets chaz_OS.child_dir, which must be reset once
+ * the command has been run.
+ */
+static char*
+chaz_OS_local_command(const char *command);
+
+/* Report a probe executable which had to be stopped.  Return true if it
+ * was.
+ */
+static int
+chaz_OS_report_stopped(const char *command);
+
+#ifdef CHAZ_HAS_POSIX_API
+/* Split [command] into words the way the shell would.  Return NULL if the
+ * command uses anything beyond plain words and quoting, which means it needs
+ * a real shell.
+ */
+static char**
+chaz_OS_split_command(const char *command);
+
+static void
+chaz_OS_free_words(char **words);
+
+/* Run the program in argv[0] directly, without a shell.  Return false if no
+ * child process could be started; the caller should fall back to system().
+ */
+static int
+chaz_OS_exec(char **argv, const char *path, int *status);
+
+/* In a child which runs a supervised probe executable, start a process
+ * group of its own and apply the resource limits.  [to_file] tells whether
+ * stdout goes to a file, whose size is then capped.
+ */
+static void
+chaz_OS_limit_child(int to_file);
+
+/* Wait for child [pid] to exit and return its wait status in [wait_status].
+ * A supervised child is killed, along with its process group, once the
+ * timeout has passed.  Return true if the child was reaped.
+ */
+static int
+chaz_OS_wait_for(pid_t pid, int *wait_status, double deadline);
+
+/* Return the time by which a supervised child must be done, or 0 if there
+ * is no timeout.
+ */
+static double
+chaz_OS_deadline(void);
+
+/* Kill the process group of a supervised child.  The reason is formatted
+ * from [format] and [value].
+ */
+static void
+chaz_OS_stop_child(pid_t pid, const char *format, long value);
+
+/* Note why a supervised child was stopped, unless it's known already.
+ */
+static void
+chaz_OS_note_stopped(const char *format, long value);
+
+/* Find out whether a resource limit did a supervised child in.
+ */
+static void
+chaz_OS_check_signal(int wait_status);
+
+/* Implementation of chaz_OS_run_piped.
+ */
+static int
+chaz_OS_pipe_command(const char *command, const char *input,
+                     size_t input_len, char **output, size_t *output_len);
+#endif
 
 void
 chaz_OS_init(void) {
@@ -139,6 +268,14 @@ chaz_OS_shell_type(void) {
 
 int
 chaz_OS_remove(const char *name) {
+    if (chaz_OS.shell_type == CHAZ_OS_POSIX) {
+        return !remove(name);
+    }
+    return chaz_OS_remove_with_retry(name);
+}
+
+static int
+chaz_OS_remove_with_retry(const char *name) {
     /*
      * On Windows it can happen that another process, typically a
      * virus scanner, still has an open handle on the file. This can
@@ -192,11 +329,78 @@ chaz_OS_remove(const char *name) {
     return retval;
 }
 
+void
+chaz_OS_set_run_wrapper(const char *wrapper) {
+    free(chaz_OS.run_wrapper);
+    chaz_OS.run_wrapper = wrapper && wrapper[0] != '\0'
+                          ? chaz_Util_strdup(wrapper)
+                          : NULL;
+}
+
+const char*
+chaz_OS_run_wrapper(void) {
+    return chaz_OS.run_wrapper;
+}
+
+void
+chaz_OS_set_run_limits(int timeout, long cpu_seconds, long memory_mb,
+                       long max_output) {
+    if (timeout >= 0)     { chaz_OS.run_timeout    = timeout; }
+    if (cpu_seconds >= 0) { chaz_OS.run_cpu        = cpu_seconds; }
+    if (memory_mb >= 0)   { chaz_OS.run_memory     = memory_mb; }
+    if (max_output >= 0)  { chaz_OS.run_max_output = max_output; }
+}
+
+static int
+chaz_OS_report_stopped(const char *command) {
+    if (chaz_OS.stopped[0] == '\0') {
+        return false;
+    }
+    chaz_Util_warn("Probe '%s' %s; counting it as failed", command,
+                   chaz_OS.stopped);
+    chaz_OS.stopped[0] = '\0';
+    return true;
+}
+
+static char*
+chaz_OS_local_command(const char *command) {
+    const char *scratch_dir = chaz_Scratch_dir();
+    const char *start       = chaz_OS.local_command_start;
+    size_t      name_len    = strcspn(command, " ");
+
+    if (scratch_dir[0] != '\0') {
+        chaz_OS.child_dir = scratch_dir;
+    }
+
+    /* Executables which already come with a directory don't need one. */
+    if (memchr(command, '/', name_len) != NULL
+        || memchr(command, '\\', name_len) != NULL
+       ) {
+        start = "";
+    }
+    if (chaz_OS.run_wrapper != NULL) {
+        return chaz_Util_join("", chaz_OS.run_wrapper, " ", start, command,
+                              NULL);
+    }
+    return chaz_Util_join("", start, command, NULL);
+}
+
 int
 chaz_OS_run_local_redirected(const char *command, const char *path) {
-    char *local_command
-        = chaz_Util_join("", chaz_OS.local_command_start, command, NULL);
-    int retval = chaz_OS_run_redirected(local_command, path);
+    double start = chaz_Trace_now();
+    char *local_command = chaz_OS_local_command(command);
+    int retval;
+
+    chaz_OS.supervise = true;
+    retval = chaz_OS_run_redirected(local_command, path);
+    chaz_OS.supervise = false;
+    chaz_OS.child_dir = NULL;
+    if (chaz_OS_report_stopped(command)) {
+        /* Whatever it wrote doesn't count. */
+        chaz_Util_remove_and_verify(path);
+        retval = -1;
+    }
+    chaz_Trace_event(CHAZ_TRACE_RUN, command, start, retval);
     free(local_command);
     return retval;
 }
@@ -208,30 +412,655 @@ chaz_OS_run_quietly(const char *command) {
 
 int
 chaz_OS_run_redirected(const char *command, const char *path) {
-    int retval = 1;
-    char *quiet_command = NULL;
-    if (chaz_OS.shell_type == CHAZ_OS_POSIX
-        || chaz_OS.shell_type == CHAZ_OS_CMD_EXE
+    if (chaz_OS.shell_type != CHAZ_OS_POSIX
+        && chaz_OS.shell_type != CHAZ_OS_CMD_EXE
         ) {
-        quiet_command = chaz_Util_join(" ", command, ">", path, "2>&1", NULL);
-    }
-    else {
         chaz_Util_die("Don't know the shell type");
     }
-    retval = system(quiet_command);
-    free(quiet_command);
-    return retval;
+    return chaz_OS_run_command(command, path);
+}
+
+int
+chaz_OS_run(const char *command) {
+    return chaz_OS_run_command(command, NULL);
+}
+
+static int
+chaz_OS_run_command(const char *command, const char *path) {
+    double start  = chaz_Trace_now();
+    int    status = -1;
+    int    ran    = false;
+
+#ifdef CHAZ_HAS_POSIX_API
+    {
+        char **argv = chaz_OS_split_command(command);
+        if (argv != NULL) {
+            ran = chaz_OS_exec(argv, path, &status);
+            chaz_OS_free_words(argv);
+        }
+    }
+#endif
+
+    if (!ran) {
+        char *shell_command = path
+            ? chaz_Util_join(" ", command, ">", path, "2>&1", NULL)
+            : chaz_Util_strdup(command);
+        status = system(shell_command);
+#ifdef CHAZ_HAS_POSIX_API
+        status = status != -1 && WIFEXITED(status)
+                 ? WEXITSTATUS(status)
+                 : -1;
+#endif
+        free(shell_command);
+    }
+
+    chaz_Trace_event(CHAZ_TRACE_EXEC, command, start, status);
+    if (chaz_Util_verbosity >= 2) {
+        printf("Exit status %d after %.3f seconds: %s\n", status,
+               chaz_Trace_now() - start, command);
+    }
+    return status;
 }
 
+#ifdef CHAZ_HAS_POSIX_API
+
+static char**
+chaz_OS_split_command(const char *command) {
+    /* Characters which mean something to the shell outside of quotes. */
+    static const char shell_chars[] = "|&;<>()$`*?[]{}~#\n\r";
+    size_t      max_words  = strlen(command) / 2 + 2;
+    char      **words      = (char**)calloc(max_words, sizeof(char*));
+    char       *word       = (char*)malloc(strlen(command) + 1);
+    const char *p          = command;
+    size_t      num_words  = 0;
+    int         need_shell = false;
+
+    while (!need_shell) {
+        size_t len = 0;
+
+        while (*p == ' ' || *p == '\t') { p++; }
+        if (*p == '\0') { break; }
+
+        while (!need_shell && *p != '\0' && *p != ' ' && *p != '\t') {
+            if (*p == '\'') {
+                const char *end = strchr(p + 1, '\'');
+                if (end == NULL) {
+                    need_shell = true;
+                    break;
+                }
+                memcpy(word + len, p + 1, end - p - 1);
+                len += end - p - 1;
+                p = end + 1;
+            }
+            else if (*p == '"') {
+                for (p++; *p != '"'; p++) {
+                    if (*p == '\0' || *p == '$' || *p == '`') {
+                        need_shell = true;
+                        break;
+                    }
+                    if (*p == '\\' && p[1] != '\0'
+                        && strchr("\"\\$`", p[1]) != NULL
+                       ) {
+                        p++;
+                    }
+                    word[len++] = *p;
+                }
+                if (!need_shell) { p++; }
+            }
+            else if (*p == '\\') {
+                if (p[1] == '\0' || p[1] == '\n') {
+                    need_shell = true;
+                    break;
+                }
+                word[len++] = p[1];
+                p += 2;
+            }
+            else if (strchr(shell_chars, *p) != NULL) {
+                need_shell = true;
+            }
+            else {
+                word[len++] = *p++;
+            }
+        }
+
+        /* A leading "NAME=value" word is a variable assignment. */
+        word[len] = '\0';
+        if (num_words == 0 && strchr(word, '=') != NULL) {
+            need_shell = true;
+        }
+        words[num_words++] = chaz_Util_strdup(word);
+    }
+
+    free(word);
+    if (need_shell || num_words == 0) {
+        chaz_OS_free_words(words);
+        return NULL;
+    }
+    return words;
+}
+
+static void
+chaz_OS_free_words(char **words) {
+    char **word;
+    for (word = words; *word != NULL; word++) {
+        free(*word);
+    }
+    free(words);
+}
+
+static int
+chaz_OS_exec(char **argv, const char *path, int *status) {
+    double deadline = chaz_OS_deadline();
+    int    fd = -1;
+    int    wait_status;
+    pid_t  pid;
+
+    if (path != NULL) {
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd < 0) { return false; }
+    }
+
+    /* Keep our own output in order with the child's. */
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0) {
+        if (fd >= 0) { close(fd); }
+        return false;
+    }
+    if (pid == 0) {
+        if (fd >= 0) {
+            dup2(fd, 1);
+            dup2(fd, 2);
+            if (fd > 2) { close(fd); }
+        }
+        if (chaz_OS.child_dir != NULL && chdir(chaz_OS.child_dir) != 0) {
+            _exit(127);
+        }
+        if (chaz_OS.supervise) {
+            chaz_OS_limit_child(fd >= 0);
+        }
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+    if (chaz_OS.supervise) {
+        setpgid(pid, pid);
+    }
+    if (fd >= 0) { close(fd); }
+
+    if (!chaz_OS_wait_for(pid, &wait_status, deadline)) {
+        *status = -1;
+        return true;
+    }
+    chaz_OS_check_signal(wait_status);
+    *status = WIFEXITED(wait_status) ? WEXITSTATUS(wait_status) : -1;
+    return true;
+}
+
+static void
+chaz_OS_limit_child(int to_file) {
+    struct rlimit limit;
+
+    /* A process group of its own lets the whole lot be killed at once. */
+    setpgid(0, 0);
+    if (chaz_OS.run_cpu > 0) {
+        /* SIGXCPU at the soft limit, SIGKILL a second later. */
+        limit.rlim_cur = (rlim_t)chaz_OS.run_cpu;
+        limit.rlim_max = (rlim_t)chaz_OS.run_cpu + 1;
+        setrlimit(RLIMIT_CPU, &limit);
+    }
+    if (chaz_OS.run_memory > 0) {
+        limit.rlim_cur = (rlim_t)chaz_OS.run_memory * 1024 * 1024;
+        limit.rlim_max = limit.rlim_cur;
+        setrlimit(RLIMIT_AS, &limit);
+    }
+    if (to_file && chaz_OS.run_max_output > 0) {
+        limit.rlim_cur = (rlim_t)chaz_OS.run_max_output;
+        limit.rlim_max = limit.rlim_cur;
+        setrlimit(RLIMIT_FSIZE, &limit);
+    }
+}
+
+static double
+chaz_OS_deadline(void) {
+    if (!chaz_OS.supervise || chaz_OS.run_timeout <= 0) {
+        return 0;
+    }
+    return chaz_Trace_now() + chaz_OS.run_timeout;
+}
+
+static int
+chaz_OS_wait_for(pid_t pid, int *wait_status, double deadline) {
+    long  interval = 1000;
+    pid_t waited;
+
+    /* Without a deadline, block.  With one, poll, backing off from a
+     * millisecond to 50. */
+    while (1) {
+        waited = waitpid(pid, wait_status, deadline > 0 ? WNOHANG : 0);
+        if (waited == pid) {
+            return true;
+        }
+        if (waited < 0 && errno != EINTR) {
+            return false;
+        }
+        if (waited == 0 && chaz_Trace_now() >= deadline) {
+            chaz_OS_stop_child(pid, "timed out after %ld seconds",
+                               (long)chaz_OS.run_timeout);
+            deadline = 0;
+        }
+        else if (waited == 0) {
+            struct timeval tv;
+            tv.tv_sec  = 0;
+            tv.tv_usec = interval;
+            select(0, NULL, NULL, NULL, &tv);
+            if (interval < 50000) { interval *= 2; }
+        }
+    }
+}
+
+static void
+chaz_OS_stop_child(pid_t pid, const char *format, long value) {
+    kill(-pid, SIGKILL);
+    kill(pid, SIGKILL);
+    chaz_OS_note_stopped(format, value);
+}
+
+static void
+chaz_OS_note_stopped(const char *format, long value) {
+    if (chaz_OS.stopped[0] == '\0') {
+        sprintf(chaz_OS.stopped, format, value);
+    }
+}
+
+static void
+chaz_OS_check_signal(int wait_status) {
+    if (!chaz_OS.supervise || !WIFSIGNALED(wait_status)) {
+        return;
+    }
+    if (WTERMSIG(wait_status) == SIGXFSZ) {
+        chaz_OS_note_stopped("wrote more than %ld bytes",
+                             chaz_OS.run_max_output);
+    }
+    else if (chaz_OS.run_cpu > 0
+             && (WTERMSIG(wait_status) == SIGXCPU
+                 || WTERMSIG(wait_status) == SIGKILL)
+            ) {
+        chaz_OS_note_stopped("used more than %ld seconds of CPU time",
+                             chaz_OS.run_cpu);
+    }
+}
+
+static int
+chaz_OS_pipe_command(const char *command, const char *input,
+                     size_t input_len, char **output, size_t *output_len) {
+    char  **argv      = chaz_OS_split_command(command);
+    char   *sh_argv[4];
+    int     in_pipe[2]  = { -1, -1 };
+    int     out_pipe[2] = { -1, -1 };
+    char   *buf       = NULL;
+    size_t  buf_len   = 0;
+    size_t  buf_cap   = 0;
+    size_t  written   = 0;
+    double  deadline  = chaz_OS_deadline();
+    int     in_fd, out_fd;
+    int     wait_status;
+    int     reaped;
+    pid_t   pid;
+    void  (*old_handler)(int);
+
+    /* Commands which need a shell get one, but still no redirection. */
+    sh_argv[0] = (char*)"/bin/sh";
+    sh_argv[1] = (char*)"-c";
+    sh_argv[2] = (char*)command;
+    sh_argv[3] = NULL;
+
+    if ((input != NULL && pipe(in_pipe) != 0)
+        || (output != NULL && pipe(out_pipe) != 0)
+       ) {
+        chaz_Util_die("Can't create pipe: %s", strerror(errno));
+    }
+
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0) {
+        chaz_Util_die("Can't fork: %s", strerror(errno));
+    }
+    if (pid == 0) {
+        int out = out_pipe[1];
+        if (in_pipe[0] >= 0) {
+            dup2(in_pipe[0], 0);
+            close(in_pipe[0]);
+            close(in_pipe[1]);
+        }
+        if (out < 0) {
+            out = open(chaz_OS.dev_null, O_WRONLY);
+        }
+        else {
+            close(out_pipe[0]);
+        }
+        dup2(out, 1);
+        dup2(out, 2);
+        if (out > 2) { close(out); }
+        if (chaz_OS.child_dir != NULL && chdir(chaz_OS.child_dir) != 0) {
+            _exit(127);
+        }
+        if (chaz_OS.supervise) {
+            chaz_OS_limit_child(false);
+        }
+        if (argv != NULL) {
+            execvp(argv[0], argv);
+        }
+        else {
+            execv(sh_argv[0], sh_argv);
+        }
+        _exit(127);
+    }
+    if (argv != NULL) {
+        chaz_OS_free_words(argv);
+    }
+    if (chaz_OS.supervise) {
+        setpgid(pid, pid);
+    }
+
+    /* A child which quits early must not take us down with SIGPIPE. */
+    old_handler = signal(SIGPIPE, SIG_IGN);
+    in_fd  = in_pipe[1];
+    out_fd = out_pipe[0];
+    if (in_fd >= 0) {
+        close(in_pipe[0]);
+        fcntl(in_fd, F_SETFL, fcntl(in_fd, F_GETFL) | O_NONBLOCK);
+    }
+    if (out_fd >= 0) {
+        close(out_pipe[1]);
+    }
+
+    /* Feed the input and drain the output at the same time, so that neither
+     * side can fill up a pipe and stall. */
+    while (in_fd >= 0 || out_fd >= 0) {
+        fd_set          read_fds, write_fds;
+        struct timeval  timeout;
+        struct timeval *timeout_ptr = NULL;
+        int             max_fd = in_fd > out_fd ? in_fd : out_fd;
+        int             ready;
+
+        /* A supervised child which overstays is killed, which closes its
+         * end of the pipes. */
+        if (deadline > 0) {
+            double left = deadline - chaz_Trace_now();
+            if (left <= 0) {
+                chaz_OS_stop_child(pid, "timed out after %ld seconds",
+                                   (long)chaz_OS.run_timeout);
+                deadline = 0;
+                continue;
+            }
+            timeout.tv_sec  = (long)left;
+            timeout.tv_usec = (long)((left - (long)left) * 1000000);
+            timeout_ptr = &timeout;
+        }
+
+        FD_ZERO(&read_fds);
+        FD_ZERO(&write_fds);
+        if (in_fd >= 0)  { FD_SET(in_fd, &write_fds); }
+        if (out_fd >= 0) { FD_SET(out_fd, &read_fds); }
+        ready = select(max_fd + 1, &read_fds, &write_fds, NULL, timeout_ptr);
+        if (ready < 0) {
+            if (errno == EINTR) { continue; }
+            chaz_Util_die("select failed: %s", strerror(errno));
+        }
+        if (ready == 0) {
+            continue;
+        }
+
+        if (in_fd >= 0 && FD_ISSET(in_fd, &write_fds)) {
+            ssize_t count = write(in_fd, input + written,
+                                  input_len - written);
+            if (count > 0) {
+                written += (size_t)count;
+            }
+            if ((count < 0 && errno != EAGAIN && errno != EINTR)
+                || written == input_len
+               ) {
+                close(in_fd);
+                in_fd = -1;
+            }
+        }
+        if (out_fd >= 0 && FD_ISSET(out_fd, &read_fds)) {
+            ssize_t count;
+            if (buf_cap - buf_len < 1024) {
+                buf_cap = buf_cap ? buf_cap * 2 : 4096;
+                buf = (char*)realloc(buf, buf_cap + 1);
+            }
+            count = read(out_fd, buf + buf_len, buf_cap - buf_len);
+            if (count > 0) {
+                buf_len += (size_t)count;
+            }
+            else if (count == 0 || errno != EINTR) {
+                close(out_fd);
+                out_fd = -1;
+            }
+            if (out_fd >= 0
+                && chaz_OS.supervise
+                && chaz_OS.run_max_output > 0
+                && buf_len > (size_t)chaz_OS.run_max_output
+               ) {
+                chaz_OS_stop_child(pid, "wrote more than %ld bytes",
+                                   chaz_OS.run_max_output);
+                close(out_fd);
+                out_fd = -1;
+            }
+        }
+    }
+    signal(SIGPIPE, old_handler);
+
+    reaped = chaz_OS_wait_for(pid, &wait_status, deadline);
+    if (reaped) {
+        chaz_OS_check_signal(wait_status);
+    }
+
+    /* Mimic chaz_Util_slurp_file, which returns NULL for empty files. */
+    if (output != NULL) {
+        if (buf_len == 0) {
+            free(buf);
+            buf = NULL;
+        }
+        else {
+            buf[buf_len] = '\0';
+        }
+        *output     = buf;
+        *output_len = buf_len;
+    }
+
+    return reaped && WIFEXITED(wait_status)
+           ? WEXITSTATUS(wait_status)
+           : -1;
+}
+
+#endif /* CHAZ_HAS_POSIX_API */
+
 char*
 chaz_OS_run_and_capture(const char *command, size_t *output_len) {
+    int status;
+    return chaz_OS_run_and_capture_status(command, output_len, &status);
+}
+
+char*
+chaz_OS_run_and_capture_status(const char *command, size_t *output_len,
+                               int *status) {
+    char *output;
+    char *target_path;
+    if (chaz_OS_can_pipe()) {
+        *status = chaz_OS_run_piped(command, NULL, 0, &output, output_len);
+        return output;
+    }
+    target_path = chaz_Scratch_path(CHAZ_OS_TARGET_NAME);
+    *status = chaz_OS_run_redirected(command, target_path);
+    output = chaz_Util_slurp_file(target_path, output_len);
+    chaz_Util_remove_and_verify(target_path);
+    free(target_path);
+    return output;
+}
+
+char*
+chaz_OS_run_local_and_capture(const char *command, size_t *output_len) {
+    double start = chaz_Trace_now();
+    char *local_command = chaz_OS_local_command(command);
+    int   status;
     char *output;
-    chaz_OS_run_redirected(command, CHAZ_OS_TARGET_PATH);
-    output = chaz_Util_slurp_file(CHAZ_OS_TARGET_PATH, output_len);
-    chaz_Util_remove_and_verify(CHAZ_OS_TARGET_PATH);
+
+    chaz_OS.supervise = true;
+    output = chaz_OS_run_and_capture_status(local_command, output_len,
+                                            &status);
+    chaz_OS.supervise = false;
+    chaz_OS.child_dir = NULL;
+    if (chaz_OS_report_stopped(command)) {
+        free(output);
+        output      = NULL;
+        *output_len = 0;
+        status      = -1;
+    }
+    chaz_Trace_event(CHAZ_TRACE_RUN, command, start, status);
+    free(local_command);
     return output;
 }
 
+int
+chaz_OS_can_pipe(void) {
+#ifdef CHAZ_HAS_POSIX_API
+    return chaz_OS.shell_type == CHAZ_OS_POSIX;
+#else
+    return false;
+#endif
+}
+
+int
+chaz_OS_run_piped(const char *command, const char *input, size_t input_len,
+                  char **output, size_t *output_len) {
+    double start = chaz_Trace_now();
+    int    status;
+#ifdef CHAZ_HAS_POSIX_API
+    status = chaz_OS_pipe_command(command, input, input_len, output,
+                                  output_len);
+#else
+    (void)input;
+    (void)input_len;
+    (void)output;
+    (void)output_len;
+    status = -1;
+    chaz_Util_die("Can't run '%s' through pipes on this system", command);
+#endif
+    chaz_Trace_event(CHAZ_TRACE_EXEC, command, start, status);
+    if (chaz_Util_verbosity >= 2) {
+        printf("Exit status %d after %.3f seconds: %s\n", status,
+               chaz_Trace_now() - start, command);
+    }
+    return status;
+}
+
+int
+chaz_OS_pid(void) {
+#ifdef CHAZ_HAS_POSIX_API
+    return (int)getpid();
+#else
+    return 0;
+#endif
+}
+
+int
+chaz_OS_start_child(chaz_OS_child_func_t func, void *arg) {
+#ifdef CHAZ_HAS_POSIX_API
+    pid_t pid;
+
+    /* Flush stdio buffers so that the child doesn't write them out again. */
+    fflush(NULL);
+    pid = fork();
+    if (pid == 0) {
+        _exit(func(arg));
+    }
+    else if (pid < 0) {
+        return 0;
+    }
+    return (int)pid;
+#else
+    (void)func;
+    (void)arg;
+    return 0;
+#endif
+}
+
+int
+chaz_OS_wait_child(int *status) {
+#ifdef CHAZ_HAS_POSIX_API
+    int   wait_status;
+    pid_t pid;
+
+    do {
+        pid = waitpid(-1, &wait_status, 0);
+    } while (pid < 0 && errno == EINTR);
+    if (pid <= 0) {
+        return 0;
+    }
+    *status = WIFEXITED(wait_status) ? WEXITSTATUS(wait_status) : -1;
+    return (int)pid;
+#else
+    *status = -1;
+    return 0;
+#endif
+}
+
+int
+chaz_OS_make_token_pool(int count) {
+#ifdef CHAZ_HAS_POSIX_API
+    int i;
+
+    if (chaz_OS.token_fds[0] >= 0 || pipe(chaz_OS.token_fds) != 0) {
+        return false;
+    }
+    /* Takers mustn't block, and compilers needn't see the pipe. */
+    fcntl(chaz_OS.token_fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(chaz_OS.token_fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(chaz_OS.token_fds[1], F_SETFD, FD_CLOEXEC);
+    for (i = 0; i < count; i++) {
+        chaz_OS_give_token();
+    }
+    return true;
+#else
+    (void)count;
+    return false;
+#endif
+}
+
+int
+chaz_OS_take_token(void) {
+#ifdef CHAZ_HAS_POSIX_API
+    char    token;
+    ssize_t got;
+
+    if (chaz_OS.token_fds[0] < 0) { return false; }
+    do {
+        got = read(chaz_OS.token_fds[0], &token, 1);
+    } while (got < 0 && errno == EINTR);
+    return got == 1;
+#else
+    return false;
+#endif
+}
+
+void
+chaz_OS_give_token(void) {
+#ifdef CHAZ_HAS_POSIX_API
+    char    token = '+';
+    ssize_t put;
+
+    if (chaz_OS.token_fds[1] < 0) { return; }
+    do {
+        put = write(chaz_OS.token_fds[1], &token, 1);
+    } while (put < 0 && errno == EINTR);
+    if (put != 1) {
+        chaz_Util_die("Can't return a job token: %s", strerror(errno));
+    }
+#endif
+}
+
 void
 chaz_OS_mkdir(const char *filepath) {
     char *command = NULL;
@@ -42,10 +42,21 @@ int
 chaz_OS_run_quietly(const char *command);
 
 /* Capture both stdout and stderr for a command to the supplied filepath.
+ * Return the exit status of the command, or -1 if it couldn't be run or
+ * didn't exit normally.
+ *
+ * On POSIX hosts, commands made of plain words and quotes are run directly
+ * rather than through the shell.
  */
 int
 chaz_OS_run_redirected(const char *command, const char *path);
 
+/* Run a command without redirecting its output.  Return the exit status as
+ * chaz_OS_run_redirected does.
+ */
+int
+chaz_OS_run(const char *command);
+
 /* Run a command beginning with the name of an executable in the current
  * working directory and capture both stdout and stderr to the supplied
  * filepath.
@@ -53,11 +64,111 @@ chaz_OS_run_redirected(const char *command, const char *path);
 int
 chaz_OS_run_local_redirected(const char *command, const char *path);
 
-/* Run a command and return the output from stdout.
+/* Run a command and return the output from stdout and stderr, or NULL if
+ * there was none.
  */
 char*
 chaz_OS_run_and_capture(const char *command, size_t *output_len);
 
+/* Like chaz_OS_run_and_capture, also storing the exit status in [status].
+ */
+char*
+chaz_OS_run_and_capture_status(const char *command, size_t *output_len,
+                               int *status);
+
+/* Like chaz_OS_run_and_capture, for an executable in the current working
+ * directory.
+ */
+char*
+chaz_OS_run_local_and_capture(const char *command, size_t *output_len);
+
+/* Set a command, such as an emulator, which runs the executables started by
+ * chaz_OS_run_local_redirected and chaz_OS_run_local_and_capture.  The path
+ * of the executable and its arguments are appended to [wrapper].  NULL or an
+ * empty string runs executables directly.
+ */
+void
+chaz_OS_set_run_wrapper(const char *wrapper);
+
+/* Return the command set by chaz_OS_set_run_wrapper, or NULL.
+ */
+const char*
+chaz_OS_run_wrapper(void);
+
+/* Limit the executables started by chaz_OS_run_local_redirected and
+ * chaz_OS_run_local_and_capture, so that a probe which hangs or runs away
+ * can't stall or swamp the host.  An executable is stopped, along with any
+ * processes it started, once it has run for [timeout] seconds, used
+ * [cpu_seconds] of CPU time or written [max_output] bytes of output.  It
+ * can't grow beyond [memory_mb] megabytes of address space.  A stopped
+ * executable is reported and counts as failed, as if it had printed
+ * nothing.
+ *
+ * Zero means no limit and a negative value keeps the current one.  The
+ * defaults are a timeout of 60 seconds and 16 MB of output.  Limits only
+ * apply on POSIX hosts.
+ */
+void
+chaz_OS_set_run_limits(int timeout, long cpu_seconds, long memory_mb,
+                       long max_output);
+
+/* Return true if chaz_OS_run_piped is available on this system.
+ */
+int
+chaz_OS_can_pipe(void);
+
+/* Run a command without any temporary files.  [input_len] bytes of [input]
+ * are fed to its stdin, unless [input] is NULL.  If [output] isn't NULL,
+ * stdout and stderr are captured into a newly allocated buffer stored there
+ * -- or NULL if there was no output -- and otherwise discarded.  Return the
+ * exit status, as chaz_OS_run_redirected does.
+ */
+int
+chaz_OS_run_piped(const char *command, const char *input, size_t input_len,
+                  char **output, size_t *output_len);
+
+/* Return the id of the current process, or 0 if it can't be determined.
+ */
+int
+chaz_OS_pid(void);
+
+/* Function run by chaz_OS_start_child.  Its return value becomes the exit
+ * status of the child process.
+ */
+typedef int (*chaz_OS_child_func_t)(void *arg);
+
+/* Run [func] in a child process which executes concurrently with the caller.
+ * Return a positive id for the child, or 0 if the host doesn't support child
+ * processes -- in which case nothing has been run.
+ */
+int
+chaz_OS_start_child(chaz_OS_child_func_t func, void *arg);
+
+/* Wait until one of the children started by chaz_OS_start_child exits.
+ * Return its id and store its exit status in [status], or return 0 if there
+ * are no children left to wait for.
+ */
+int
+chaz_OS_wait_child(int *status);
+
+/* Create a pool of [count] tokens shared by this process and every process
+ * it starts from now on, which lets them all keep to one budget of
+ * concurrent work.  Return false if the host can't share one.
+ */
+int
+chaz_OS_make_token_pool(int count);
+
+/* Take a token from the pool without waiting.  Return false if there is no
+ * pool or it's empty.
+ */
+int
+chaz_OS_take_token(void);
+
+/* Put a token taken with chaz_OS_take_token back into the pool.
+ */
+void
+chaz_OS_give_token(void);
+
 /* Attempt to create a directory.
  */
 void
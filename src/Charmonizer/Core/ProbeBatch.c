@@ -0,0 +1,400 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Charmonizer/Core/ProbeBatch.h"
+#include "Charmonizer/Core/Compiler.h"
+#include "Charmonizer/Core/HeaderChecker.h"
+#include "Charmonizer/Core/ProbeQueue.h"
+#include "Charmonizer/Core/Util.h"
+
+#define CHAZ_PROBEBATCH_PENDING    0
+#define CHAZ_PROBEBATCH_SUCCEEDED  1
+#define CHAZ_PROBEBATCH_FAILED     2
+
+/* A failing unit with no more than this many probes is split straight into
+ * single probes.  Bisecting further can't save any compiles.
+ */
+#define CHAZ_PROBEBATCH_LINEAR_MAX 4
+
+typedef struct chaz_BatchProbe {
+    char *includes;
+    char *body;
+    char *header;
+    int   group;
+    int   state;
+    int   alone;
+} chaz_BatchProbe;
+
+/* A run of consecutive probe ids which get compiled together. */
+typedef struct chaz_BatchUnit {
+    int start;
+    int count;
+} chaz_BatchUnit;
+
+struct chaz_ProbeBatch {
+    chaz_BatchProbe *probes;
+    int              num_probes;
+    int              cap;
+    int              group;
+};
+
+/* Settle header probes which the HeadCheck register already knows about.
+ */
+static void
+chaz_ProbeBatch_resolve_known(chaz_ProbeBatch *batch);
+
+/* Build a translation unit containing probes ids[0] through ids[count-1].
+ */
+static char*
+chaz_ProbeBatch_source(chaz_ProbeBatch *batch, const int *ids, int count);
+
+/* Add a job for probes ids[0] through ids[count-1] to [queue].  Return the
+ * index of the job.
+ */
+static int
+chaz_ProbeBatch_queue(chaz_ProbeBatch *batch, chaz_ProbeQueue *queue,
+                      const int *ids, int count);
+
+/* Record the result of compiling probes ids[0] through ids[count-1]
+ * together.
+ */
+static void
+chaz_ProbeBatch_settle(chaz_ProbeBatch *batch, const int *ids, int count,
+                       int succeeded);
+
+chaz_ProbeBatch*
+chaz_ProbeBatch_new(void) {
+    chaz_ProbeBatch *batch = (chaz_ProbeBatch*)malloc(sizeof(chaz_ProbeBatch));
+    batch->probes     = NULL;
+    batch->num_probes = 0;
+    batch->cap        = 0;
+    batch->group      = 0;
+    return batch;
+}
+
+void
+chaz_ProbeBatch_destroy(chaz_ProbeBatch *batch) {
+    int i;
+    for (i = 0; i < batch->num_probes; i++) {
+        free(batch->probes[i].includes);
+        free(batch->probes[i].body);
+        free(batch->probes[i].header);
+    }
+    free(batch->probes);
+    free(batch);
+}
+
+void
+chaz_ProbeBatch_new_group(chaz_ProbeBatch *batch) {
+    batch->group++;
+}
+
+int
+chaz_ProbeBatch_add(chaz_ProbeBatch *batch, const char *includes,
+                    const char *body) {
+    chaz_BatchProbe *probe;
+
+    if (batch->num_probes == batch->cap) {
+        batch->cap = batch->cap ? batch->cap * 2 : 8;
+        batch->probes = (chaz_BatchProbe*)realloc(
+                            batch->probes,
+                            batch->cap * sizeof(chaz_BatchProbe));
+    }
+    probe = &batch->probes[batch->num_probes];
+    probe->includes = chaz_Util_strdup(includes ? includes : "");
+    probe->body     = chaz_Util_strdup(body);
+    probe->header   = NULL;
+    probe->group    = batch->group;
+    probe->state    = CHAZ_PROBEBATCH_PENDING;
+    probe->alone    = false;
+
+    return batch->num_probes++;
+}
+
+int
+chaz_ProbeBatch_add_header(chaz_ProbeBatch *batch, const char *header_name) {
+    char *includes = chaz_Util_join("", "#include <", header_name, ">", NULL);
+    int probe = chaz_ProbeBatch_add(batch, includes, "return 0;");
+    batch->probes[probe].header = chaz_Util_strdup(header_name);
+    free(includes);
+    return probe;
+}
+
+int
+chaz_ProbeBatch_add_member(chaz_ProbeBatch *batch, const char *struct_name,
+                           const char *member, const char *includes) {
+    char *all_includes = chaz_Util_join("\n", "#include <stddef.h>",
+                                        includes, NULL);
+    char *body = chaz_Util_join("", "return (int)offsetof(", struct_name,
+                                ", ", member, ");", NULL);
+    int probe = chaz_ProbeBatch_add(batch, all_includes, body);
+    free(all_includes);
+    free(body);
+    return probe;
+}
+
+void
+chaz_ProbeBatch_run(chaz_ProbeBatch *batch) {
+    int            *ids   = (int*)malloc((batch->num_probes + 1) * sizeof(int));
+    chaz_BatchUnit *units = (chaz_BatchUnit*)malloc(
+                                (batch->num_probes + 1) * sizeof(chaz_BatchUnit));
+    chaz_BatchUnit *next  = (chaz_BatchUnit*)malloc(
+                                (batch->num_probes + 1) * sizeof(chaz_BatchUnit));
+    int num_ids   = 0;
+    int num_units = 0;
+    int i;
+
+    chaz_ProbeBatch_resolve_known(batch);
+
+    /* Start with one unit per group of pending probes. */
+    for (i = 0; i < batch->num_probes; i++) {
+        if (batch->probes[i].state != CHAZ_PROBEBATCH_PENDING) { continue; }
+        if (num_units == 0
+            || batch->probes[ids[num_ids - 1]].group != batch->probes[i].group
+           ) {
+            units[num_units].start = num_ids;
+            units[num_units].count = 0;
+            num_units++;
+        }
+        ids[num_ids++] = i;
+        units[num_units - 1].count++;
+    }
+
+    /* Compile every unit of a round concurrently, then split the failures
+     * for the next round. */
+    while (num_units > 0) {
+        chaz_ProbeQueue *queue = chaz_ProbeQueue_new();
+        chaz_BatchUnit  *temp;
+        int num_next = 0;
+
+        for (i = 0; i < num_units; i++) {
+            chaz_ProbeBatch_queue(batch, queue, ids + units[i].start,
+                                  units[i].count);
+        }
+        chaz_ProbeQueue_run(queue);
+
+        for (i = 0; i < num_units; i++) {
+            chaz_BatchUnit unit = units[i];
+            int succeeded = chaz_ProbeQueue_succeeded(queue, i);
+            if (succeeded || unit.count == 1) {
+                chaz_ProbeBatch_settle(batch, ids + unit.start, unit.count,
+                                       succeeded);
+            }
+            else if (unit.count <= CHAZ_PROBEBATCH_LINEAR_MAX) {
+                int j;
+                for (j = 0; j < unit.count; j++) {
+                    next[num_next].start = unit.start + j;
+                    next[num_next].count = 1;
+                    num_next++;
+                }
+            }
+            else {
+                next[num_next].start = unit.start;
+                next[num_next].count = unit.count / 2;
+                num_next++;
+                next[num_next].start = unit.start + unit.count / 2;
+                next[num_next].count = unit.count - unit.count / 2;
+                num_next++;
+            }
+        }
+        chaz_ProbeQueue_destroy(queue);
+
+        temp      = units;
+        units     = next;
+        next      = temp;
+        num_units = num_next;
+    }
+
+    free(ids);
+    free(units);
+    free(next);
+}
+
+int
+chaz_ProbeBatch_run_first(chaz_ProbeBatch *batch) {
+    int i;
+
+    chaz_ProbeBatch_resolve_known(batch);
+
+    /* Compile every alternative at once if that doesn't cost any time. */
+    if (chaz_ProbeQueue_get_max_jobs() > 1) {
+        chaz_ProbeQueue *queue = chaz_ProbeQueue_new();
+        int *jobs = (int*)malloc((batch->num_probes + 1) * sizeof(int));
+        for (i = 0; i < batch->num_probes; i++) {
+            jobs[i] = -1;
+            if (batch->probes[i].state == CHAZ_PROBEBATCH_PENDING) {
+                jobs[i] = chaz_ProbeBatch_queue(batch, queue, &i, 1);
+            }
+        }
+        chaz_ProbeQueue_run(queue);
+        for (i = 0; i < batch->num_probes; i++) {
+            if (jobs[i] >= 0) {
+                chaz_ProbeBatch_settle(batch, &i, 1,
+                    chaz_ProbeQueue_succeeded(queue, jobs[i]));
+            }
+        }
+        chaz_ProbeQueue_destroy(queue);
+        free(jobs);
+    }
+
+    for (i = 0; i < batch->num_probes; i++) {
+        if (chaz_ProbeBatch_confirm(batch, i)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int
+chaz_ProbeBatch_succeeded(chaz_ProbeBatch *batch, int probe) {
+    return batch->probes[probe].state == CHAZ_PROBEBATCH_SUCCEEDED;
+}
+
+int
+chaz_ProbeBatch_confirm(chaz_ProbeBatch *batch, int probe) {
+    chaz_BatchProbe *p = &batch->probes[probe];
+    if (p->state == CHAZ_PROBEBATCH_FAILED) {
+        return false;
+    }
+    if (p->state == CHAZ_PROBEBATCH_PENDING || !p->alone) {
+        char *source = chaz_ProbeBatch_source(batch, &probe, 1);
+        int succeeded = chaz_CC_test_compile(source);
+        chaz_ProbeBatch_settle(batch, &probe, 1, succeeded);
+        free(source);
+    }
+    return p->state == CHAZ_PROBEBATCH_SUCCEEDED;
+}
+
+static void
+chaz_ProbeBatch_resolve_known(chaz_ProbeBatch *batch) {
+    const char **headers
+        = (const char**)malloc((batch->num_probes + 1) * sizeof(char*));
+    int num_headers = 0;
+    int i;
+
+    /* Ask about all the headers at once, if the compiler lets us. */
+    for (i = 0; i < batch->num_probes; i++) {
+        if (batch->probes[i].state == CHAZ_PROBEBATCH_PENDING
+            && batch->probes[i].header != NULL
+           ) {
+            headers[num_headers++] = batch->probes[i].header;
+        }
+    }
+    headers[num_headers] = NULL;
+    if (num_headers > 0) {
+        chaz_HeadCheck_discover_headers(headers);
+    }
+    free(headers);
+
+    for (i = 0; i < batch->num_probes; i++) {
+        chaz_BatchProbe *probe = &batch->probes[i];
+        int exists;
+        if (probe->state == CHAZ_PROBEBATCH_PENDING
+            && probe->header != NULL
+            && chaz_HeadCheck_lookup(probe->header, &exists)
+           ) {
+            probe->state = exists
+                           ? CHAZ_PROBEBATCH_SUCCEEDED
+                           : CHAZ_PROBEBATCH_FAILED;
+            probe->alone = true;
+        }
+    }
+}
+
+static char*
+chaz_ProbeBatch_source(chaz_ProbeBatch *batch, const int *ids, int count) {
+    static const char func_code[] =
+        "static int chaz_probe_%d(void) {\n%s\n}\n";
+    static const char call_code[] =
+        "    result += chaz_probe_%d();\n";
+    size_t needed = 200;
+    char *source;
+    char *end;
+    int i, j;
+
+    for (i = 0; i < count; i++) {
+        chaz_BatchProbe *probe = &batch->probes[ids[i]];
+        needed += strlen(probe->includes) + strlen(probe->body)
+                  + sizeof(func_code) + sizeof(call_code) + 40;
+    }
+    source = (char*)malloc(needed);
+    end = source;
+    *end = '\0';
+
+    /* Includes first, skipping exact repeats. */
+    for (i = 0; i < count; i++) {
+        const char *includes = batch->probes[ids[i]].includes;
+        int seen = false;
+        for (j = 0; j < i; j++) {
+            if (strcmp(batch->probes[ids[j]].includes, includes) == 0) {
+                seen = true;
+                break;
+            }
+        }
+        if (!seen && includes[0] != '\0') {
+            sprintf(end, "%s\n", includes);
+            end += strlen(end);
+        }
+    }
+
+    /* Function names depend only on position, so the source for a single
+     * probe is the same no matter which batch it came from. */
+    for (i = 0; i < count; i++) {
+        sprintf(end, func_code, i, batch->probes[ids[i]].body);
+        end += strlen(end);
+    }
+    strcpy(end, "int main() {\n    int result = 0;\n");
+    end += strlen(end);
+    for (i = 0; i < count; i++) {
+        sprintf(end, call_code, i);
+        end += strlen(end);
+    }
+    strcpy(end, "    return result;\n}\n");
+
+    return source;
+}
+
+static int
+chaz_ProbeBatch_queue(chaz_ProbeBatch *batch, chaz_ProbeQueue *queue,
+                      const int *ids, int count) {
+    char *source = chaz_ProbeBatch_source(batch, ids, count);
+    int job = chaz_ProbeQueue_add_compile(queue, source);
+    free(source);
+    return job;
+}
+
+static void
+chaz_ProbeBatch_settle(chaz_ProbeBatch *batch, const int *ids, int count,
+                       int succeeded) {
+    int i;
+    for (i = 0; i < count; i++) {
+        chaz_BatchProbe *probe = &batch->probes[ids[i]];
+        probe->state = succeeded
+                       ? CHAZ_PROBEBATCH_SUCCEEDED
+                       : CHAZ_PROBEBATCH_FAILED;
+        probe->alone = count == 1;
+
+        /* A header counts as present once it has compiled in a passing
+         * group, as with chaz_HeadCheck_discover_headers. */
+        if (probe->header != NULL) {
+            chaz_HeadCheck_record(probe->header, succeeded);
+        }
+    }
+}
+
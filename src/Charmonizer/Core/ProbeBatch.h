@@ -0,0 +1,107 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Charmonizer/Core/ProbeBatch.h -- many compile probes in few compiles.
+ *
+ * Each probe is a set of #include lines plus a function body.  Probes are
+ * organized into groups; every group is first compiled as a single
+ * translation unit.  A group which fails is split in half and each half is
+ * retried, until every failing probe has been pinned down on its own.  When
+ * failures are rare, K failures among N probes cost O(K log N) compiles
+ * rather than N.
+ *
+ * A probe which only ever succeeded as part of a larger unit may owe its
+ * success to something another probe pulled in.  Callers which care (e.g.
+ * when choosing between alternatives) should use chaz_ProbeBatch_confirm.
+ */
+
+#ifndef H_CHAZ_PROBE_BATCH
+#define H_CHAZ_PROBE_BATCH
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "Charmonizer/Core/Defines.h"
+
+typedef struct chaz_ProbeBatch chaz_ProbeBatch;
+
+chaz_ProbeBatch*
+chaz_ProbeBatch_new(void);
+
+void
+chaz_ProbeBatch_destroy(chaz_ProbeBatch *batch);
+
+/* Start a new group.  Probes added afterwards are compiled apart from those
+ * added before.  Put probes which are expected to succeed or fail together
+ * in the same group.
+ */
+void
+chaz_ProbeBatch_new_group(chaz_ProbeBatch *batch);
+
+/* Add a probe which succeeds if [body] compiles as the body of a function
+ * returning int, after [includes] (which may be NULL).  Return the index of
+ * the probe.
+ */
+int
+chaz_ProbeBatch_add(chaz_ProbeBatch *batch, const char *includes,
+                    const char *body);
+
+/* Add a probe for the existence of a header.  Headers already in the
+ * HeadCheck register aren't compiled again, and results are added to the
+ * register when the batch is run.
+ */
+int
+chaz_ProbeBatch_add_header(chaz_ProbeBatch *batch, const char *header_name);
+
+/* Add a probe for the presence of [member] in [struct_name], like
+ * chaz_HeadCheck_contains_member.
+ */
+int
+chaz_ProbeBatch_add_member(chaz_ProbeBatch *batch, const char *struct_name,
+                           const char *member, const char *includes);
+
+/* Resolve every probe in the batch, running independent compiles
+ * concurrently if the ProbeQueue allows it.
+ */
+void
+chaz_ProbeBatch_run(chaz_ProbeBatch *batch);
+
+/* Treat the probes in the batch as alternatives in order of preference.
+ * Each one is compiled on its own; return the index of the first which
+ * succeeds, or -1 if none do.  Later alternatives are compiled up front only
+ * if jobs can run concurrently.
+ */
+int
+chaz_ProbeBatch_run_first(chaz_ProbeBatch *batch);
+
+/* Return true if probe [probe] succeeded.
+ */
+int
+chaz_ProbeBatch_succeeded(chaz_ProbeBatch *batch, int probe);
+
+/* Return true if probe [probe] succeeds when compiled on its own.  Costs a
+ * compile only if the probe has so far succeeded only in company.
+ */
+int
+chaz_ProbeBatch_confirm(chaz_ProbeBatch *batch, int probe);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H_CHAZ_PROBE_BATCH */
+
@@ -0,0 +1,876 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Charmonizer/Core/ProbeProgram.h"
+#include "Charmonizer/Core/Compiler.h"
+#include "Charmonizer/Core/ProbeQueue.h"
+#include "Charmonizer/Core/Util.h"
+
+#define CHAZ_PROBEPROG_PENDING    0
+#define CHAZ_PROBEPROG_SUCCEEDED  1
+#define CHAZ_PROBEPROG_FAILED     2
+#define CHAZ_PROBEPROG_SEARCHING  3
+
+#define CHAZ_PROBEPROG_INT        1
+#define CHAZ_PROBEPROG_COMPILES   2
+#define CHAZ_PROBEPROG_OUTPUT     3
+#define CHAZ_PROBEPROG_BYTE_ORDER 4
+
+/* Steps of the compile-time search for the value of an integer query. */
+#define CHAZ_PROBEPROG_FIND_SIGN  1
+#define CHAZ_PROBEPROG_NEGATIVE   2
+#define CHAZ_PROBEPROG_BOUND      3
+#define CHAZ_PROBEPROG_BISECT     4
+
+/* A failing unit with no more than this many queries is split straight into
+ * single queries.
+ */
+#define CHAZ_PROBEPROG_LINEAR_MAX 4
+
+/* Every record starts with this marker, followed by the query's position in
+ * the program and '='.  A record ends where the next marker starts.
+ */
+#define CHAZ_PROBEPROG_MARKER     "\n#chaz:"
+
+typedef struct chaz_ProbeQuery {
+    int     kind;
+    char   *prelude;
+    char   *body;
+    char   *expr;
+    int     is_const;
+    int     group;
+    int     state;
+    char   *output;
+    size_t  output_len;
+
+    /* State of the compile-time search. */
+    int     step;
+    int     negative;
+    int     bound;
+    long    low;
+    long    high;
+} chaz_ProbeQuery;
+
+/* A run of consecutive query ids which get built together. */
+typedef struct chaz_ProgUnit {
+    int start;
+    int count;
+} chaz_ProgUnit;
+
+struct chaz_ProbeProg {
+    chaz_ProbeQuery *queries;
+    int              num_queries;
+    int              cap;
+    int              group;
+};
+
+static int
+chaz_ProbeProg_add(chaz_ProbeProg *prog, int kind, const char *prelude,
+                   const char *body);
+
+/* Answer every pending integer query which can be read out of an object
+ * file, one object per group.
+ */
+static void
+chaz_ProbeProg_extract(chaz_ProbeProg *prog);
+
+/* Build an object file which embeds the values of queries ids[0] through
+ * ids[count-1] as marker strings.
+ */
+static char*
+chaz_ProbeProg_extract_source(chaz_ProbeProg *prog, const int *ids,
+                              int count);
+
+/* Pick the values for queries ids[0] through ids[count-1] out of the
+ * markers found in their object file.
+ */
+static void
+chaz_ProbeProg_parse_markers(chaz_ProbeProg *prog, const int *ids, int count,
+                             const char *markers);
+
+/* Build (and run, if [can_run]) programs for every pending query, bisecting
+ * programs which fail.
+ */
+static void
+chaz_ProbeProg_build(chaz_ProbeProg *prog, int can_run);
+
+/* Find the values of integer queries without running anything, by compiling
+ * a series of assertions about each value.
+ */
+static void
+chaz_ProbeProg_search(chaz_ProbeProg *prog);
+
+/* Return the condition whose truth is to be established by the next step of
+ * the search for [query], or NULL if the search is over.
+ */
+static char*
+chaz_ProbeProg_next_condition(chaz_ProbeQuery *query);
+
+/* Advance the search for [query], given whether the last condition held.
+ */
+static void
+chaz_ProbeProg_advance(chaz_ProbeQuery *query, int holds);
+
+/* Build a program which runs queries ids[0] through ids[count-1].
+ */
+static char*
+chaz_ProbeProg_source(chaz_ProbeProg *prog, const int *ids, int count);
+
+/* Pick the records for queries ids[0] through ids[count-1] out of the
+ * output of their program.  Return the number of queries left without a
+ * record.
+ */
+static int
+chaz_ProbeProg_parse(chaz_ProbeProg *prog, const int *ids, int count,
+                     const char *output, size_t output_len);
+
+chaz_ProbeProg*
+chaz_ProbeProg_new(void) {
+    chaz_ProbeProg *prog = (chaz_ProbeProg*)malloc(sizeof(chaz_ProbeProg));
+    prog->queries     = NULL;
+    prog->num_queries = 0;
+    prog->cap         = 0;
+    prog->group       = 0;
+    return prog;
+}
+
+void
+chaz_ProbeProg_destroy(chaz_ProbeProg *prog) {
+    int i;
+    for (i = 0; i < prog->num_queries; i++) {
+        free(prog->queries[i].prelude);
+        free(prog->queries[i].body);
+        free(prog->queries[i].expr);
+        free(prog->queries[i].output);
+    }
+    free(prog->queries);
+    free(prog);
+}
+
+void
+chaz_ProbeProg_new_group(chaz_ProbeProg *prog) {
+    prog->group++;
+}
+
+int
+chaz_ProbeProg_add_int(chaz_ProbeProg *prog, const char *prelude,
+                       const char *expr) {
+    char *body = chaz_Util_join("", "    printf(\"%ld\", (long)(", expr,
+                                "));", NULL);
+    int query = chaz_ProbeProg_add(prog, CHAZ_PROBEPROG_INT, prelude, body);
+    prog->queries[query].expr = chaz_Util_strdup(expr);
+    free(body);
+    return query;
+}
+
+int
+chaz_ProbeProg_add_const(chaz_ProbeProg *prog, const char *prelude,
+                         const char *expr) {
+    int query = chaz_ProbeProg_add_int(prog, prelude, expr);
+    prog->queries[query].is_const = true;
+    return query;
+}
+
+int
+chaz_ProbeProg_add_big_endian(chaz_ProbeProg *prog) {
+    static const char body[] =
+        "    long one = 1;\n"
+        "    printf(\"%d\", !*((char*)(&one)));";
+    return chaz_ProbeProg_add(prog, CHAZ_PROBEPROG_BYTE_ORDER, NULL, body);
+}
+
+int
+chaz_ProbeProg_add_compiles(chaz_ProbeProg *prog, const char *prelude,
+                            const char *body) {
+    return chaz_ProbeProg_add(prog, CHAZ_PROBEPROG_COMPILES, prelude, body);
+}
+
+int
+chaz_ProbeProg_add_output(chaz_ProbeProg *prog, const char *prelude,
+                          const char *body) {
+    return chaz_ProbeProg_add(prog, CHAZ_PROBEPROG_OUTPUT, prelude, body);
+}
+
+static int
+chaz_ProbeProg_add(chaz_ProbeProg *prog, int kind, const char *prelude,
+                   const char *body) {
+    chaz_ProbeQuery *query;
+
+    if (prog->num_queries == prog->cap) {
+        prog->cap = prog->cap ? prog->cap * 2 : 8;
+        prog->queries = (chaz_ProbeQuery*)realloc(
+                            prog->queries,
+                            prog->cap * sizeof(chaz_ProbeQuery));
+    }
+    query = &prog->queries[prog->num_queries];
+    memset(query, 0, sizeof(chaz_ProbeQuery));
+    query->kind       = kind;
+    query->prelude    = chaz_Util_strdup(prelude ? prelude : "");
+    query->body       = chaz_Util_strdup(body);
+    query->group      = prog->group;
+    query->state      = CHAZ_PROBEPROG_PENDING;
+    query->output     = NULL;
+    query->output_len = 0;
+
+    return prog->num_queries++;
+}
+
+void
+chaz_ProbeProg_run(chaz_ProbeProg *prog) {
+    int can_run = chaz_CC_can_run();
+    int i;
+
+    /* Values which can be read out of an object file need neither a link
+     * step nor a process. */
+    chaz_ProbeProg_extract(prog);
+
+    if (can_run) {
+        chaz_ProbeProg_build(prog, true);
+        return;
+    }
+
+    /* Output can't be had without running something.  Everything else can
+     * at least be linked. */
+    for (i = 0; i < prog->num_queries; i++) {
+        chaz_ProbeQuery *query = &prog->queries[i];
+        if (query->state == CHAZ_PROBEPROG_PENDING
+            && query->kind == CHAZ_PROBEPROG_OUTPUT
+           ) {
+            query->state = CHAZ_PROBEPROG_FAILED;
+        }
+    }
+    chaz_ProbeProg_build(prog, false);
+    chaz_ProbeProg_search(prog);
+}
+
+static void
+chaz_ProbeProg_extract(chaz_ProbeProg *prog) {
+    int           *ids   = (int*)malloc((prog->num_queries + 1) * sizeof(int));
+    chaz_ProgUnit *units = (chaz_ProgUnit*)malloc(
+                               (prog->num_queries + 1) * sizeof(chaz_ProgUnit));
+    chaz_ProgUnit *next  = (chaz_ProgUnit*)malloc(
+                               (prog->num_queries + 1) * sizeof(chaz_ProgUnit));
+    int num_ids   = 0;
+    int num_units = 0;
+    int i;
+
+    for (i = 0; i < prog->num_queries; i++) {
+        chaz_ProbeQuery *query = &prog->queries[i];
+        if (query->state != CHAZ_PROBEPROG_PENDING
+            || (query->kind != CHAZ_PROBEPROG_INT
+                && query->kind != CHAZ_PROBEPROG_BYTE_ORDER)
+           ) {
+            continue;
+        }
+        if (num_units == 0
+            || prog->queries[ids[num_ids - 1]].group != query->group
+           ) {
+            units[num_units].start = num_ids;
+            units[num_units].count = 0;
+            num_units++;
+        }
+        ids[num_ids++] = i;
+        units[num_units - 1].count++;
+    }
+
+    while (num_units > 0) {
+        chaz_ProbeQueue *queue = chaz_ProbeQueue_new();
+        chaz_ProgUnit   *temp;
+        int num_next = 0;
+
+        for (i = 0; i < num_units; i++) {
+            char *source = chaz_ProbeProg_extract_source(prog,
+                                                         ids + units[i].start,
+                                                         units[i].count);
+            chaz_ProbeQueue_add_extract(queue, source);
+            free(source);
+        }
+        chaz_ProbeQueue_run(queue);
+
+        /* Queries without a marker are left for the other strategies --
+         * unless they are constant, in which case a unit which doesn't
+         * compile is split up, and a lone query which doesn't compile has
+         * failed. */
+        for (i = 0; i < num_units; i++) {
+            chaz_ProgUnit unit = units[i];
+            const int *unit_ids = ids + unit.start;
+            int all_const = true;
+            int j;
+
+            if (chaz_ProbeQueue_succeeded(queue, i)) {
+                size_t      len;
+                const char *markers = chaz_ProbeQueue_output(queue, i, &len);
+                if (markers != NULL) {
+                    chaz_ProbeProg_parse_markers(prog, unit_ids, unit.count,
+                                                 markers);
+                }
+                continue;
+            }
+            for (j = 0; j < unit.count; j++) {
+                if (!prog->queries[unit_ids[j]].is_const) {
+                    all_const = false;
+                }
+            }
+            if (!all_const) {
+                continue;
+            }
+            else if (unit.count == 1) {
+                prog->queries[unit_ids[0]].state = CHAZ_PROBEPROG_FAILED;
+            }
+            else if (unit.count <= CHAZ_PROBEPROG_LINEAR_MAX) {
+                for (j = 0; j < unit.count; j++) {
+                    next[num_next].start = unit.start + j;
+                    next[num_next].count = 1;
+                    num_next++;
+                }
+            }
+            else {
+                next[num_next].start = unit.start;
+                next[num_next].count = unit.count / 2;
+                num_next++;
+                next[num_next].start = unit.start + unit.count / 2;
+                next[num_next].count = unit.count - unit.count / 2;
+                num_next++;
+            }
+        }
+        chaz_ProbeQueue_destroy(queue);
+
+        temp      = units;
+        units     = next;
+        next      = temp;
+        num_units = num_next;
+    }
+
+    free(ids);
+    free(units);
+    free(next);
+}
+
+static char*
+chaz_ProbeProg_append_chars(char *end, const char *text) {
+    for (; *text; text++) {
+        sprintf(end, "'%c', ", *text);
+        end += strlen(end);
+    }
+    return end;
+}
+
+/* Append an array of 16-bit words whose bytes spell out [text] on a
+ * machine of the given byte order, and something else on the other kind.
+ */
+static char*
+chaz_ProbeProg_append_words(char *end, const char *name, const char *text,
+                            int big_endian) {
+    size_t len = strlen(text);
+    size_t i;
+
+    sprintf(end, "const unsigned short %s[] = { ", name);
+    end += strlen(end);
+    for (i = 0; i < len; i += 2) {
+        unsigned first  = (unsigned char)text[i];
+        unsigned second = i + 1 < len ? (unsigned char)text[i + 1] : 0;
+        sprintf(end, "0x%04X, ", big_endian
+                                 ? (first << 8) | second
+                                 : (second << 8) | first);
+        end += strlen(end);
+    }
+    strcpy(end, "0 };\n");
+    return end + strlen(end);
+}
+
+static char*
+chaz_ProbeProg_extract_source(chaz_ProbeProg *prog, const int *ids,
+                              int count) {
+    static const char value_code[] =
+        "#define CHAZ_VALUE_%d ((long)(%s))\n"
+        "#define CHAZ_MAGNITUDE_%d (CHAZ_VALUE_%d < 0 \\\n"
+        "    ? -(unsigned long)CHAZ_VALUE_%d : (unsigned long)CHAZ_VALUE_%d)\n"
+        "const char chaz_value_%d[] = {\n    ";
+    size_t needed = 200;
+    char *source;
+    char *end;
+    int i, j, k;
+
+    for (i = 0; i < count; i++) {
+        chaz_ProbeQuery *query = &prog->queries[ids[i]];
+        needed += strlen(query->prelude) + 2500
+                  + (query->expr ? strlen(query->expr) : 0);
+    }
+    source = (char*)malloc(needed);
+    strcpy(source, "#include <stdio.h>\n");
+    end = source + strlen(source);
+
+    for (i = 0; i < count; i++) {
+        const char *prelude = prog->queries[ids[i]].prelude;
+        int seen = false;
+        for (j = 0; j < i; j++) {
+            if (strcmp(prog->queries[ids[j]].prelude, prelude) == 0) {
+                seen = true;
+                break;
+            }
+        }
+        if (!seen && prelude[0] != '\0') {
+            sprintf(end, "%s\n", prelude);
+            end += strlen(end);
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        chaz_ProbeQuery *query = &prog->queries[ids[i]];
+        char marker[40];
+
+        if (query->kind == CHAZ_PROBEPROG_BYTE_ORDER) {
+            /* Only the array matching the target's byte order yields a
+             * marker. */
+            char name[40];
+            sprintf(name, "chaz_big_endian_%d", i);
+            sprintf(marker, "%s%d=1]", CHAZ_CC_MARKER, i);
+            end = chaz_ProbeProg_append_words(end, name, marker, true);
+            sprintf(name, "chaz_little_endian_%d", i);
+            sprintf(marker, "%s%d=0]", CHAZ_CC_MARKER, i);
+            end = chaz_ProbeProg_append_words(end, name, marker, false);
+            continue;
+        }
+
+        /* The value is spelled out as a sign and twenty digits, computed
+         * by the compiler. */
+        sprintf(end, value_code, i, query->expr, i, i, i, i, i);
+        end += strlen(end);
+        sprintf(marker, "%s%d=", CHAZ_CC_MARKER, i);
+        end = chaz_ProbeProg_append_chars(end, marker);
+        sprintf(end, "CHAZ_VALUE_%d < 0 ? '-' : '+',\n", i);
+        end += strlen(end);
+        for (j = 19; j >= 0; j--) {
+            sprintf(end, "    (char)('0' + CHAZ_MAGNITUDE_%d", i);
+            end += strlen(end);
+            for (k = 0; k < j; k++) {
+                strcpy(end, " / 10");
+                end += strlen(end);
+            }
+            strcpy(end, " % 10),\n");
+            end += strlen(end);
+        }
+        strcpy(end, "    ']', '\\0'\n};\n");
+        end += strlen(end);
+    }
+
+    return source;
+}
+
+static void
+chaz_ProbeProg_parse_markers(chaz_ProbeProg *prog, const int *ids, int count,
+                             const char *markers) {
+    size_t      mark_len = strlen(CHAZ_CC_MARKER);
+    const char *ptr      = markers;
+
+    while ((ptr = strstr(ptr, CHAZ_CC_MARKER)) != NULL) {
+        char *num_end;
+        long  pos;
+        long  value;
+        char  buf[30];
+
+        ptr += mark_len;
+        pos = strtol(ptr, &num_end, 10);
+        if (num_end == ptr || *num_end != '=' || pos < 0 || pos >= count) {
+            continue;
+        }
+        value = strtol(num_end + 1, NULL, 10);
+        if (prog->queries[ids[pos]].state == CHAZ_PROBEPROG_PENDING) {
+            chaz_ProbeQuery *query = &prog->queries[ids[pos]];
+            sprintf(buf, "%ld", value);
+            query->output     = chaz_Util_strdup(buf);
+            query->output_len = strlen(buf);
+            query->state      = CHAZ_PROBEPROG_SUCCEEDED;
+        }
+    }
+}
+
+static void
+chaz_ProbeProg_build(chaz_ProbeProg *prog, int can_run) {
+    int           *ids   = (int*)malloc((prog->num_queries + 1) * sizeof(int));
+    chaz_ProgUnit *units = (chaz_ProgUnit*)malloc(
+                               (prog->num_queries + 1) * sizeof(chaz_ProgUnit));
+    chaz_ProgUnit *next  = (chaz_ProgUnit*)malloc(
+                               (prog->num_queries + 1) * sizeof(chaz_ProgUnit));
+    int num_ids   = 0;
+    int num_units = 0;
+    int i;
+
+    /* Start with one unit per group of pending queries. */
+    for (i = 0; i < prog->num_queries; i++) {
+        if (prog->queries[i].state != CHAZ_PROBEPROG_PENDING) { continue; }
+        if (num_units == 0
+            || prog->queries[ids[num_ids - 1]].group != prog->queries[i].group
+           ) {
+            units[num_units].start = num_ids;
+            units[num_units].count = 0;
+            num_units++;
+        }
+        ids[num_ids++] = i;
+        units[num_units - 1].count++;
+    }
+
+    /* Build and run every unit of a round concurrently, then split up the
+     * failures for the next round. */
+    while (num_units > 0) {
+        chaz_ProbeQueue *queue = chaz_ProbeQueue_new();
+        chaz_ProgUnit   *temp;
+        int num_next = 0;
+
+        for (i = 0; i < num_units; i++) {
+            char *source = chaz_ProbeProg_source(prog, ids + units[i].start,
+                                                 units[i].count);
+            if (can_run) {
+                chaz_ProbeQueue_add_capture(queue, source);
+            }
+            else {
+                chaz_ProbeQueue_add_link(queue, source);
+            }
+            free(source);
+        }
+        chaz_ProbeQueue_run(queue);
+
+        for (i = 0; i < num_units; i++) {
+            chaz_ProgUnit unit = units[i];
+            const int *unit_ids = ids + unit.start;
+            int j;
+
+            if (chaz_ProbeQueue_succeeded(queue, i) && !can_run) {
+                /* Values still have to be found. */
+                for (j = 0; j < unit.count; j++) {
+                    chaz_ProbeQuery *query = &prog->queries[unit_ids[j]];
+                    if (query->kind == CHAZ_PROBEPROG_INT) {
+                        query->state = CHAZ_PROBEPROG_SEARCHING;
+                        query->step  = CHAZ_PROBEPROG_FIND_SIGN;
+                    }
+                    else if (query->kind == CHAZ_PROBEPROG_BYTE_ORDER) {
+                        query->state = CHAZ_PROBEPROG_FAILED;
+                    }
+                    else {
+                        query->state = CHAZ_PROBEPROG_SUCCEEDED;
+                    }
+                }
+            }
+            else if (chaz_ProbeQueue_succeeded(queue, i)) {
+                size_t      output_len;
+                const char *output = chaz_ProbeQueue_output(queue, i,
+                                                            &output_len);
+                int missing = chaz_ProbeProg_parse(prog, unit_ids,
+                                                   unit.count, output,
+                                                   output_len);
+                if (missing == 0) { continue; }
+
+                /* Something went wrong at run time.  Give each query
+                 * without a record a program of its own. */
+                for (j = 0; j < unit.count; j++) {
+                    chaz_ProbeQuery *query = &prog->queries[unit_ids[j]];
+                    if (query->state != CHAZ_PROBEPROG_PENDING) { continue; }
+                    if (unit.count == 1) {
+                        query->state = CHAZ_PROBEPROG_FAILED;
+                    }
+                    else {
+                        next[num_next].start = unit.start + j;
+                        next[num_next].count = 1;
+                        num_next++;
+                    }
+                }
+            }
+            else if (unit.count == 1) {
+                prog->queries[unit_ids[0]].state = CHAZ_PROBEPROG_FAILED;
+            }
+            else if (unit.count <= CHAZ_PROBEPROG_LINEAR_MAX) {
+                for (j = 0; j < unit.count; j++) {
+                    next[num_next].start = unit.start + j;
+                    next[num_next].count = 1;
+                    num_next++;
+                }
+            }
+            else {
+                next[num_next].start = unit.start;
+                next[num_next].count = unit.count / 2;
+                num_next++;
+                next[num_next].start = unit.start + unit.count / 2;
+                next[num_next].count = unit.count - unit.count / 2;
+                num_next++;
+            }
+        }
+        chaz_ProbeQueue_destroy(queue);
+
+        temp      = units;
+        units     = next;
+        next      = temp;
+        num_units = num_next;
+    }
+
+    free(ids);
+    free(units);
+    free(next);
+}
+
+static void
+chaz_ProbeProg_search(chaz_ProbeProg *prog) {
+    int *jobs = (int*)malloc((prog->num_queries + 1) * sizeof(int));
+    int  i;
+
+    /* Every search takes one step per round, and the compiles for a round
+     * run concurrently. */
+    while (1) {
+        chaz_ProbeQueue *queue = chaz_ProbeQueue_new();
+        int num_jobs = 0;
+
+        for (i = 0; i < prog->num_queries; i++) {
+            chaz_ProbeQuery *query = &prog->queries[i];
+            char *condition;
+            char *source;
+
+            jobs[i] = -1;
+            if (query->state != CHAZ_PROBEPROG_SEARCHING) { continue; }
+            condition = chaz_ProbeProg_next_condition(query);
+            if (condition == NULL) { continue; }
+            source = chaz_Util_join("", "#include <stdio.h>\n",
+                                    query->prelude,
+                                    "\ntypedef char chaz_probe_cond[(",
+                                    condition, ") ? 1 : -1];\n", NULL);
+            jobs[i] = chaz_ProbeQueue_add_compile(queue, source);
+            num_jobs++;
+            free(source);
+            free(condition);
+        }
+        if (num_jobs == 0) {
+            chaz_ProbeQueue_destroy(queue);
+            break;
+        }
+
+        chaz_ProbeQueue_run(queue);
+        for (i = 0; i < prog->num_queries; i++) {
+            if (jobs[i] >= 0) {
+                chaz_ProbeProg_advance(&prog->queries[i],
+                    chaz_ProbeQueue_succeeded(queue, jobs[i]));
+            }
+        }
+        chaz_ProbeQueue_destroy(queue);
+    }
+
+    free(jobs);
+}
+
+/* Magnitudes are bracketed by these, smallest first, before bisecting. */
+static const long chaz_ProbeProg_bounds[] = {
+    1L, 3L, 15L, 255L, 65535L, 2147483647L
+};
+#define CHAZ_PROBEPROG_NUM_BOUNDS 6
+
+static char*
+chaz_ProbeProg_next_condition(chaz_ProbeQuery *query) {
+    const char *sign = query->negative ? "-" : "";
+    char limit[30];
+
+    switch (query->step) {
+        case CHAZ_PROBEPROG_FIND_SIGN:
+            return chaz_Util_join("", "(long)(", query->expr, ") >= 0", NULL);
+        case CHAZ_PROBEPROG_NEGATIVE:
+            return chaz_Util_join("", "(long)(", query->expr, ") < 0", NULL);
+        case CHAZ_PROBEPROG_BOUND:
+            sprintf(limit, "%ld", chaz_ProbeProg_bounds[query->bound]);
+            break;
+        default:
+            if (query->low == query->high) {
+                /* Found it. */
+                char value[30];
+                sprintf(value, "%ld",
+                        query->negative ? -query->low : query->low);
+                query->output     = chaz_Util_strdup(value);
+                query->output_len = strlen(value);
+                query->state      = CHAZ_PROBEPROG_SUCCEEDED;
+                return NULL;
+            }
+            sprintf(limit, "%ld",
+                    query->low + (query->high - query->low) / 2);
+            break;
+    }
+    return chaz_Util_join("", sign, "(long)(", query->expr, ") <= ", limit,
+                          NULL);
+}
+
+static void
+chaz_ProbeProg_advance(chaz_ProbeQuery *query, int holds) {
+    switch (query->step) {
+        case CHAZ_PROBEPROG_FIND_SIGN:
+            query->step = holds
+                          ? CHAZ_PROBEPROG_BOUND
+                          : CHAZ_PROBEPROG_NEGATIVE;
+            break;
+        case CHAZ_PROBEPROG_NEGATIVE:
+            /* Neither negative nor not: the expression isn't constant. */
+            if (!holds) {
+                query->state = CHAZ_PROBEPROG_FAILED;
+            }
+            query->negative = true;
+            query->step     = CHAZ_PROBEPROG_BOUND;
+            break;
+        case CHAZ_PROBEPROG_BOUND:
+            if (holds) {
+                query->low  = query->bound
+                              ? chaz_ProbeProg_bounds[query->bound - 1] + 1
+                              : 0;
+                query->high = chaz_ProbeProg_bounds[query->bound];
+                query->step = CHAZ_PROBEPROG_BISECT;
+            }
+            else if (++query->bound == CHAZ_PROBEPROG_NUM_BOUNDS) {
+                query->state = CHAZ_PROBEPROG_FAILED;
+            }
+            break;
+        default: {
+            long middle = query->low + (query->high - query->low) / 2;
+            if (holds) {
+                query->high = middle;
+            }
+            else {
+                query->low = middle + 1;
+            }
+            break;
+        }
+    }
+}
+
+int
+chaz_ProbeProg_succeeded(chaz_ProbeProg *prog, int query) {
+    return prog->queries[query].state == CHAZ_PROBEPROG_SUCCEEDED;
+}
+
+long
+chaz_ProbeProg_int_value(chaz_ProbeProg *prog, int query, long fallback) {
+    chaz_ProbeQuery *q = &prog->queries[query];
+    if (q->state != CHAZ_PROBEPROG_SUCCEEDED || q->output == NULL) {
+        return fallback;
+    }
+    return strtol(q->output, NULL, 10);
+}
+
+const char*
+chaz_ProbeProg_output(chaz_ProbeProg *prog, int query, size_t *output_len) {
+    chaz_ProbeQuery *q = &prog->queries[query];
+    if (q->state != CHAZ_PROBEPROG_SUCCEEDED) {
+        *output_len = 0;
+        return NULL;
+    }
+    *output_len = q->output_len;
+    return q->output ? q->output : "";
+}
+
+static char*
+chaz_ProbeProg_source(chaz_ProbeProg *prog, const int *ids, int count) {
+    static const char func_code[] =
+        "static void chaz_query_%d(void) {\n%s\n}\n";
+    static const char call_code[] =
+        "    printf(\"\\n#chaz:%d=\");\n"
+        "    chaz_query_%d();\n"
+        "    fflush(stdout);\n";
+    size_t needed = 200;
+    char *source;
+    char *end;
+    int i, j;
+
+    for (i = 0; i < count; i++) {
+        chaz_ProbeQuery *query = &prog->queries[ids[i]];
+        needed += strlen(query->prelude) + strlen(query->body)
+                  + sizeof(func_code) + sizeof(call_code) + 60;
+    }
+    source = (char*)malloc(needed);
+    strcpy(source, "#include <stdio.h>\n");
+    end = source + strlen(source);
+
+    /* Preludes first, skipping exact repeats. */
+    for (i = 0; i < count; i++) {
+        const char *prelude = prog->queries[ids[i]].prelude;
+        int seen = false;
+        for (j = 0; j < i; j++) {
+            if (strcmp(prog->queries[ids[j]].prelude, prelude) == 0) {
+                seen = true;
+                break;
+            }
+        }
+        if (!seen && prelude[0] != '\0') {
+            sprintf(end, "%s\n", prelude);
+            end += strlen(end);
+        }
+    }
+
+    /* As with chaz_ProbeBatch, names depend only on position, so a lone
+     * query always produces the same source. */
+    for (i = 0; i < count; i++) {
+        sprintf(end, func_code, i, prog->queries[ids[i]].body);
+        end += strlen(end);
+    }
+    strcpy(end, "int main() {\n");
+    end += strlen(end);
+    for (i = 0; i < count; i++) {
+        sprintf(end, call_code, i, i);
+        end += strlen(end);
+    }
+    strcpy(end, "    printf(\"\\n#chaz:end\\n\");\n    return 0;\n}\n");
+
+    return source;
+}
+
+static int
+chaz_ProbeProg_parse(chaz_ProbeProg *prog, const int *ids, int count,
+                     const char *output, size_t output_len) {
+    const char *limit   = output ? output + output_len : NULL;
+    const char *ptr     = output;
+    size_t      mark_len = strlen(CHAZ_PROBEPROG_MARKER);
+    int         missing = count;
+
+    while (ptr != NULL && ptr < limit) {
+        const char *start;
+        const char *stop;
+        char       *num_end;
+        long        pos;
+
+        /* Find the start of the next record. */
+        ptr = strstr(ptr, CHAZ_PROBEPROG_MARKER);
+        if (ptr == NULL) { break; }
+        ptr += mark_len;
+        pos = strtol(ptr, &num_end, 10);
+        if (num_end == ptr || *num_end != '=') { continue; }
+        start = num_end + 1;
+
+        /* A record only counts if another marker follows it.  Otherwise the
+         * program died before it was done. */
+        stop = strstr(start, CHAZ_PROBEPROG_MARKER);
+        if (stop == NULL) { break; }
+
+        if (pos >= 0 && pos < count) {
+            chaz_ProbeQuery *query = &prog->queries[ids[pos]];
+            if (query->state == CHAZ_PROBEPROG_PENDING) {
+                size_t len = (size_t)(stop - start);
+                query->output = (char*)malloc(len + 1);
+                memcpy(query->output, start, len);
+                query->output[len] = '\0';
+                query->output_len = len;
+                query->state = CHAZ_PROBEPROG_SUCCEEDED;
+                missing--;
+            }
+        }
+        ptr = stop;
+    }
+
+    return missing;
+}
+
@@ -0,0 +1,132 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Charmonizer/Core/ProbeProgram.h -- many value queries in one executable.
+ *
+ * Each query is a small piece of code whose result is printed as a record
+ * by a shared probe program.  All queries in a program are compiled, linked
+ * and run together, so a module which needs dozens of answers pays for one
+ * build and one run.  If the program doesn't compile, it is split in half
+ * and each half is retried, as chaz_ProbeBatch does.  A query whose record
+ * is missing from the output -- because the program crashed, for instance
+ * -- is rerun on its own.
+ *
+ * Before any of that, integer queries which are constant expressions are
+ * read out of an object file: the compiler spells each value out as a
+ * marker string in a character array, so nothing has to be linked or run.
+ * Whatever can't be found that way goes through the probe program.
+ *
+ * When probe executables may not be run (see chaz_CC_set_can_run), programs
+ * are only linked.  Integer queries are then answered by compiling a series
+ * of assertions about their values, and output queries fail.
+ */
+
+#ifndef H_CHAZ_PROBE_PROGRAM
+#define H_CHAZ_PROBE_PROGRAM
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "Charmonizer/Core/Defines.h"
+
+typedef struct chaz_ProbeProg chaz_ProbeProg;
+
+chaz_ProbeProg*
+chaz_ProbeProg_new(void);
+
+void
+chaz_ProbeProg_destroy(chaz_ProbeProg *prog);
+
+/* Start a new group.  Queries added afterwards are built into a different
+ * program than those added before.  Queries which might not compile are
+ * best kept apart from those which surely do.
+ */
+void
+chaz_ProbeProg_new_group(chaz_ProbeProg *prog);
+
+/* Add a query for the value of [expr], an integer expression which fits in
+ * a long.  [prelude] (which may be NULL) is file-scope code such as
+ * #include lines; identical preludes are emitted only once.  Return the
+ * index of the query.
+ *
+ * If probe executables may not be run, only integer constant expressions
+ * with a magnitude below 2**31 can be answered.
+ */
+int
+chaz_ProbeProg_add_int(chaz_ProbeProg *prog, const char *prelude,
+                       const char *expr);
+
+/* Like chaz_ProbeProg_add_int, for an [expr] which is an integer constant
+ * expression whenever it compiles, such as sizeof(T).  If the object file
+ * which should hold its value doesn't compile, the query fails without a
+ * program being built for it.
+ */
+int
+chaz_ProbeProg_add_const(chaz_ProbeProg *prog, const char *prelude,
+                         const char *expr);
+
+/* Add a query whose value is 1 if the target is big-endian and 0 if it's
+ * little-endian.
+ */
+int
+chaz_ProbeProg_add_big_endian(chaz_ProbeProg *prog);
+
+/* Add a query which succeeds if [body] compiles, links and runs as the body
+ * of a function returning void.  [body] can make the query fail at run time
+ * by calling exit().  If probe executables may not be run, the query
+ * succeeds if it links.
+ */
+int
+chaz_ProbeProg_add_compiles(chaz_ProbeProg *prog, const char *prelude,
+                            const char *body);
+
+/* Add a query whose result is whatever [body] prints to stdout.  <stdio.h>
+ * is always included.
+ */
+int
+chaz_ProbeProg_add_output(chaz_ProbeProg *prog, const char *prelude,
+                          const char *body);
+
+/* Answer every query, running independent programs concurrently if the
+ * ProbeQueue allows it.
+ */
+void
+chaz_ProbeProg_run(chaz_ProbeProg *prog);
+
+/* Return true if query [query] compiled and produced a record.
+ */
+int
+chaz_ProbeProg_succeeded(chaz_ProbeProg *prog, int query);
+
+/* Return the value of an integer query, or [fallback] if it failed.
+ */
+long
+chaz_ProbeProg_int_value(chaz_ProbeProg *prog, int query, long fallback);
+
+/* Return the output of query [query], or NULL if it failed.  The buffer
+ * belongs to the program.
+ */
+const char*
+chaz_ProbeProg_output(chaz_ProbeProg *prog, int query, size_t *output_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H_CHAZ_PROBE_PROGRAM */
+
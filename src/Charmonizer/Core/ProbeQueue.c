@@ -0,0 +1,338 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Charmonizer/Core/ProbeQueue.h"
+#include "Charmonizer/Core/Compiler.h"
+#include "Charmonizer/Core/OperatingSystem.h"
+#include "Charmonizer/Core/Scratch.h"
+#include "Charmonizer/Core/Util.h"
+
+#define CHAZ_PROBEQUEUE_COMPILE     1
+#define CHAZ_PROBEQUEUE_CAPTURE     2
+#define CHAZ_PROBEQUEUE_LINK        3
+#define CHAZ_PROBEQUEUE_EXTRACT     4
+
+typedef struct chaz_ProbeJob {
+    int     kind;
+    int     started;
+    int     pid;
+    int     succeeded;
+    char   *source;
+    char   *basename;
+    char   *output_path;
+    char   *output;
+    size_t  output_len;
+} chaz_ProbeJob;
+
+struct chaz_ProbeQueue {
+    chaz_ProbeJob *jobs;
+    int            num_jobs;
+    int            cap;
+};
+
+static struct {
+    int max_jobs;
+    int serial;
+} chaz_ProbeQueue_globals = { 1, 0 };
+
+/* Add a job of the given kind and assign it unique scratch file names.
+ */
+static int
+chaz_ProbeQueue_add(chaz_ProbeQueue *queue, int kind, const char *source);
+
+/* Run a single job.  Called either in a child process or, when jobs can't
+ * run concurrently, in-process.  Return 0 if the compilation succeeded.
+ */
+static int
+chaz_ProbeQueue_run_job(void *arg);
+
+/* Run a single job in-process, capturing output without scratch files where
+ * possible.
+ */
+static void
+chaz_ProbeQueue_run_inline(chaz_ProbeJob *job);
+
+/* Fill in the results of a job from the probe cache.  Return true on a hit.
+ */
+static int
+chaz_ProbeQueue_fetch_cached(chaz_ProbeJob *job);
+
+/* Record the results of a job which exited with [status].
+ */
+static void
+chaz_ProbeQueue_finish_job(chaz_ProbeJob *job, int status);
+
+void
+chaz_ProbeQueue_set_max_jobs(int max_jobs) {
+    if (max_jobs < 1) { max_jobs = 1; }
+    /* Without a shared pool, nested queues would multiply the limit. */
+    if (max_jobs > 1 && !chaz_OS_make_token_pool(max_jobs - 1)) {
+        max_jobs = 1;
+    }
+    chaz_ProbeQueue_globals.max_jobs = max_jobs;
+}
+
+int
+chaz_ProbeQueue_get_max_jobs(void) {
+    return chaz_ProbeQueue_globals.max_jobs;
+}
+
+chaz_ProbeQueue*
+chaz_ProbeQueue_new(void) {
+    chaz_ProbeQueue *queue = (chaz_ProbeQueue*)malloc(sizeof(chaz_ProbeQueue));
+    queue->jobs     = NULL;
+    queue->num_jobs = 0;
+    queue->cap      = 0;
+    return queue;
+}
+
+void
+chaz_ProbeQueue_destroy(chaz_ProbeQueue *queue) {
+    int i;
+    for (i = 0; i < queue->num_jobs; i++) {
+        chaz_ProbeJob *job = &queue->jobs[i];
+        free(job->source);
+        free(job->basename);
+        free(job->output_path);
+        free(job->output);
+    }
+    free(queue->jobs);
+    free(queue);
+}
+
+int
+chaz_ProbeQueue_add_compile(chaz_ProbeQueue *queue, const char *source) {
+    return chaz_ProbeQueue_add(queue, CHAZ_PROBEQUEUE_COMPILE, source);
+}
+
+int
+chaz_ProbeQueue_add_link(chaz_ProbeQueue *queue, const char *source) {
+    return chaz_ProbeQueue_add(queue, CHAZ_PROBEQUEUE_LINK, source);
+}
+
+int
+chaz_ProbeQueue_add_capture(chaz_ProbeQueue *queue, const char *source) {
+    return chaz_ProbeQueue_add(queue, CHAZ_PROBEQUEUE_CAPTURE, source);
+}
+
+int
+chaz_ProbeQueue_add_extract(chaz_ProbeQueue *queue, const char *source) {
+    return chaz_ProbeQueue_add(queue, CHAZ_PROBEQUEUE_EXTRACT, source);
+}
+
+static int
+chaz_ProbeQueue_add(chaz_ProbeQueue *queue, int kind, const char *source) {
+    chaz_ProbeJob *job;
+    char name[50];
+
+    if (queue->num_jobs == queue->cap) {
+        queue->cap = queue->cap ? queue->cap * 2 : 8;
+        queue->jobs = (chaz_ProbeJob*)realloc(queue->jobs,
+                                              queue->cap * sizeof(chaz_ProbeJob));
+    }
+    job = &queue->jobs[queue->num_jobs];
+    memset(job, 0, sizeof(chaz_ProbeJob));
+    job->kind   = kind;
+    job->source = chaz_Util_strdup(source);
+
+    /* Unique names keep concurrent jobs from clobbering each other. */
+    chaz_ProbeQueue_globals.serial++;
+    sprintf(name, "_charmonizer_try_%d", chaz_ProbeQueue_globals.serial);
+    job->basename = chaz_Scratch_path(name);
+    sprintf(name, "_charmonizer_target_%d", chaz_ProbeQueue_globals.serial);
+    job->output_path = chaz_Scratch_path(name);
+
+    return queue->num_jobs++;
+}
+
+void
+chaz_ProbeQueue_run(chaz_ProbeQueue *queue) {
+    int max_jobs = chaz_ProbeQueue_globals.max_jobs;
+    int running  = 0;
+    int next     = 0;
+
+    while (1) {
+        /* Start as many jobs as the pool allows. */
+        while (next < queue->num_jobs && running < max_jobs) {
+            chaz_ProbeJob *job = &queue->jobs[next];
+            if (job->started) {
+                next++;
+                continue;
+            }
+            /* The first job gets this process's slot, others need a token.
+             * Without one, wait for a running job to finish. */
+            if (running > 0 && !chaz_OS_take_token()) { break; }
+            next++;
+            job->started = true;
+            if (chaz_ProbeQueue_fetch_cached(job)) {
+                if (running > 0) { chaz_OS_give_token(); }
+                continue;
+            }
+            job->pid = max_jobs > 1
+                       ? chaz_OS_start_child(chaz_ProbeQueue_run_job, job)
+                       : 0;
+            if (job->pid) {
+                running++;
+            }
+            else {
+                /* No child processes available, so run the job here. */
+                if (running > 0) { chaz_OS_give_token(); }
+                chaz_ProbeQueue_run_inline(job);
+            }
+        }
+        if (!running) { break; }
+
+        /* Wait for any job to finish and file its results. */
+        {
+            int status;
+            int pid = chaz_OS_wait_child(&status);
+            int i;
+            if (!pid) {
+                chaz_Util_die("Lost track of %d running probe jobs", running);
+            }
+            for (i = 0; i < queue->num_jobs; i++) {
+                if (queue->jobs[i].pid == pid) {
+                    chaz_ProbeQueue_finish_job(&queue->jobs[i], status);
+                    queue->jobs[i].pid = 0;
+                    running--;
+                    if (running > 0) { chaz_OS_give_token(); }
+                    break;
+                }
+            }
+        }
+    }
+}
+
+static int
+chaz_ProbeQueue_run_job(void *arg) {
+    chaz_ProbeJob *job = (chaz_ProbeJob*)arg;
+    int succeeded;
+    if (job->kind == CHAZ_PROBEQUEUE_COMPILE) {
+        succeeded = chaz_CC_test_compile_named(job->basename, job->source);
+    }
+    else if (job->kind == CHAZ_PROBEQUEUE_LINK) {
+        succeeded = chaz_CC_test_link_named(job->basename, job->source);
+    }
+    else if (job->kind == CHAZ_PROBEQUEUE_EXTRACT) {
+        /* Hand the markers to the parent through the output file. */
+        char   *output;
+        size_t  output_len;
+        succeeded = chaz_CC_compile_and_extract(job->basename, job->source,
+                                                &output, &output_len);
+        if (succeeded) {
+            chaz_Util_write_file(job->output_path, output ? output : "");
+        }
+        free(output);
+    }
+    else {
+        succeeded = chaz_CC_compile_and_run(job->basename, job->source,
+                                            job->output_path);
+    }
+    return succeeded ? 0 : 1;
+}
+
+static void
+chaz_ProbeQueue_run_inline(chaz_ProbeJob *job) {
+    if (job->kind == CHAZ_PROBEQUEUE_CAPTURE) {
+        job->succeeded = chaz_CC_compile_and_capture(job->basename,
+                                                     job->source,
+                                                     &job->output,
+                                                     &job->output_len);
+        chaz_CC_cache_store(CHAZ_CC_PROBE_CAPTURE, job->source,
+                            job->succeeded, job->output, job->output_len);
+    }
+    else if (job->kind == CHAZ_PROBEQUEUE_EXTRACT) {
+        job->succeeded = chaz_CC_compile_and_extract(job->basename,
+                                                     job->source,
+                                                     &job->output,
+                                                     &job->output_len);
+    }
+    else {
+        job->succeeded = chaz_ProbeQueue_run_job(job) == 0;
+    }
+}
+
+static int
+chaz_ProbeQueue_fetch_cached(chaz_ProbeJob *job) {
+    if (job->kind == CHAZ_PROBEQUEUE_COMPILE) {
+        return chaz_CC_cache_fetch(CHAZ_CC_PROBE_COMPILE, job->source,
+                                   &job->succeeded, NULL, NULL);
+    }
+    if (job->kind == CHAZ_PROBEQUEUE_LINK) {
+        return chaz_CC_cache_fetch(CHAZ_CC_PROBE_LINK, job->source,
+                                   &job->succeeded, NULL, NULL);
+    }
+    if (job->kind == CHAZ_PROBEQUEUE_EXTRACT) {
+        return chaz_CC_cache_fetch(CHAZ_CC_PROBE_EXTRACT, job->source,
+                                   &job->succeeded, &job->output,
+                                   &job->output_len);
+    }
+    return chaz_CC_cache_fetch(CHAZ_CC_PROBE_CAPTURE, job->source,
+                               &job->succeeded, &job->output,
+                               &job->output_len);
+}
+
+static void
+chaz_ProbeQueue_finish_job(chaz_ProbeJob *job, int status) {
+    job->succeeded = status == 0;
+    if (job->kind == CHAZ_PROBEQUEUE_CAPTURE) {
+        if (job->succeeded && chaz_CC_can_run()) {
+            job->output = chaz_Util_slurp_file(job->output_path,
+                                               &job->output_len);
+        }
+        chaz_Util_remove_and_verify(job->output_path);
+
+        /* Other jobs are cached by the child, capture jobs here. */
+        chaz_CC_cache_store(CHAZ_CC_PROBE_CAPTURE, job->source,
+                            job->succeeded, job->output, job->output_len);
+    }
+    else if (job->kind == CHAZ_PROBEQUEUE_EXTRACT) {
+        if (job->succeeded) {
+            job->output = chaz_Util_slurp_file(job->output_path,
+                                               &job->output_len);
+            if (job->output_len == 0) {
+                free(job->output);
+                job->output = NULL;
+            }
+        }
+        chaz_Util_remove_and_verify(job->output_path);
+    }
+}
+
+int
+chaz_ProbeQueue_succeeded(chaz_ProbeQueue *queue, int job) {
+    return queue->jobs[job].succeeded;
+}
+
+const char*
+chaz_ProbeQueue_output(chaz_ProbeQueue *queue, int job, size_t *output_len) {
+    if (output_len) {
+        *output_len = queue->jobs[job].output_len;
+    }
+    return queue->jobs[job].output;
+}
+
+int
+chaz_ProbeQueue_passed(chaz_ProbeQueue *queue, int job) {
+    if (!chaz_CC_can_run()) {
+        return queue->jobs[job].succeeded;
+    }
+    return queue->jobs[job].output != NULL;
+}
+
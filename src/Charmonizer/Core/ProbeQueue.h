@@ -0,0 +1,111 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Charmonizer/Core/ProbeQueue.h -- run independent probes concurrently.
+ *
+ * Probes are added to a queue, then the whole queue is run by a bounded pool
+ * of child processes.  Each job uses its own scratch files.  Results are
+ * collected by job index, so callers see them in the order they were added
+ * no matter which job finished first.
+ */
+
+#ifndef H_CHAZ_PROBE_QUEUE
+#define H_CHAZ_PROBE_QUEUE
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "Charmonizer/Core/Defines.h"
+
+typedef struct chaz_ProbeQueue chaz_ProbeQueue;
+
+/* Set the maximum number of probe jobs which may run at once.  The default
+ * is 1, which runs every job in-process, one after another.
+ *
+ * The limit holds for the whole run, not just for one queue: a process
+ * which runs children of its own, such as a probe module started by
+ * chaz_Probe_run_modules, passes its own slot to the first of them, and
+ * every further child takes a token from a pool of [max_jobs] - 1 shared
+ * by all processes.  Should be called once, before any children start.
+ */
+void
+chaz_ProbeQueue_set_max_jobs(int max_jobs);
+
+int
+chaz_ProbeQueue_get_max_jobs(void);
+
+chaz_ProbeQueue*
+chaz_ProbeQueue_new(void);
+
+void
+chaz_ProbeQueue_destroy(chaz_ProbeQueue *queue);
+
+/* Add a job which test-compiles [source] as chaz_CC_test_compile would.
+ * Return the index of the job.
+ */
+int
+chaz_ProbeQueue_add_compile(chaz_ProbeQueue *queue, const char *source);
+
+/* Add a job which checks that [source] compiles and links as
+ * chaz_CC_test_link would.  Return the index of the job.
+ */
+int
+chaz_ProbeQueue_add_link(chaz_ProbeQueue *queue, const char *source);
+
+/* Add a job which compiles and runs [source] as chaz_CC_capture_output
+ * would.  Return the index of the job.
+ */
+int
+chaz_ProbeQueue_add_capture(chaz_ProbeQueue *queue, const char *source);
+
+/* Add a job which compiles [source] into an object file and collects the
+ * marker strings in it as chaz_CC_compile_and_extract would.  They serve as
+ * the output of the job.  Return the index of the job.
+ */
+int
+chaz_ProbeQueue_add_extract(chaz_ProbeQueue *queue, const char *source);
+
+/* Run every job which hasn't been run yet and wait for all of them to
+ * finish.
+ */
+void
+chaz_ProbeQueue_run(chaz_ProbeQueue *queue);
+
+/* Return true if the compilation for job [job] succeeded.
+ */
+int
+chaz_ProbeQueue_succeeded(chaz_ProbeQueue *queue, int job);
+
+/* Return the output captured by job [job], or NULL if the compilation failed
+ * or the program printed nothing.  The buffer belongs to the queue.
+ */
+const char*
+chaz_ProbeQueue_output(chaz_ProbeQueue *queue, int job, size_t *output_len);
+
+/* Return true if capture job [job] printed something.  If probe executables
+ * may not be run, return true if it built.
+ */
+int
+chaz_ProbeQueue_passed(chaz_ProbeQueue *queue, int job);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H_CHAZ_PROBE_QUEUE */
+
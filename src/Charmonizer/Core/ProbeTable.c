@@ -0,0 +1,302 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "Charmonizer/Core/ProbeTable.h"
+#include "Charmonizer/Core/Compiler.h"
+#include "Charmonizer/Core/ConfWriter.h"
+#include "Charmonizer/Core/HeaderChecker.h"
+#include "Charmonizer/Core/ProbeBatch.h"
+#include "Charmonizer/Core/ProbeQueue.h"
+#include "Charmonizer/Core/Scratch.h"
+#include "Charmonizer/Core/Util.h"
+
+/* Return true if every header in a space-separated list exists.
+ */
+static int
+chaz_ProbeTable_has_headers(const char *headers);
+
+/* Return #include lines for a space-separated list of headers, followed by
+ * [prelude].
+ */
+static char*
+chaz_ProbeTable_includes(const char *headers, const char *prelude);
+
+/* Return [code] with $1, $2 and $3 replaced by [args].
+ */
+static char*
+chaz_ProbeTable_expand(const char *code, const char *const *args);
+
+/* Find the winner of a COMPILES table with a ProbeBatch.  The eligible
+ * candidates are listed in [order], in the order they are to be tested.
+ */
+static int
+chaz_ProbeTable_resolve_compiles(const chaz_ProbeTable *table,
+                                 const int *order, int num_eligible,
+                                 const char *prelude);
+
+/* Find the winner of a LINKS or RUNS table with ProbeQueues.
+ */
+static int
+chaz_ProbeTable_resolve_programs(const chaz_ProbeTable *table,
+                                 const int *order, int num_eligible,
+                                 const char *prelude);
+
+/* Return true if the program built by job [job] meets the table's
+ * criterion.
+ */
+static int
+chaz_ProbeTable_passed(const chaz_ProbeTable *table, chaz_ProbeQueue *queue,
+                       int job);
+
+int
+chaz_ProbeTable_resolve(const chaz_ProbeTable *table, const char *prelude) {
+    int  traits = chaz_CC_traits();
+    int *order;
+    int  num_candidates;
+    int  num_eligible = 0;
+    int  winner;
+    int  pass;
+    int  i;
+
+    for (num_candidates = 0;
+         table->candidates[num_candidates].headers != NULL;
+         num_candidates++
+        ) {}
+
+    /* Likely winners go first, and impossible candidates not at all, which
+     * also spares checking their headers. */
+    order = (int*)malloc((num_candidates + 1) * sizeof(int));
+    for (pass = 0; pass < 2; pass++) {
+        for (i = 0; i < num_candidates; i++) {
+            const chaz_ProbeCandidate *candidate = &table->candidates[i];
+            int likely = (candidate->likely & traits) != 0;
+            if ((pass == 0) != likely
+                || (candidate->impossible & traits)
+                || !chaz_ProbeTable_has_headers(candidate->headers)
+               ) {
+                continue;
+            }
+            order[num_eligible++] = i;
+        }
+    }
+
+    if (table->criterion == CHAZ_PROBETABLE_COMPILES) {
+        winner = chaz_ProbeTable_resolve_compiles(table, order, num_eligible,
+                                                  prelude);
+    }
+    else {
+        winner = chaz_ProbeTable_resolve_programs(table, order, num_eligible,
+                                                  prelude);
+    }
+    free(order);
+
+    if (table->scratch_file) {
+        char *path = chaz_Scratch_path(table->scratch_file);
+        if (!chaz_Util_remove_and_verify(path)) {
+            chaz_Util_die("Failed to remove '%s'", path);
+        }
+        free(path);
+    }
+
+    if (winner >= 0) {
+        const chaz_ProbeDef *defs = table->candidates[winner].defs;
+        for (i = 0; i < CHAZ_PROBETABLE_MAX_DEFS && defs[i].name; i++) {
+            chaz_ConfWriter_add_def(defs[i].name, defs[i].value);
+        }
+    }
+    return winner;
+}
+
+static int
+chaz_ProbeTable_resolve_compiles(const chaz_ProbeTable *table,
+                                 const int *order, int num_eligible,
+                                 const char *prelude) {
+    chaz_ProbeBatch *batch = chaz_ProbeBatch_new();
+    int winner;
+    int i;
+
+    for (i = 0; i < num_eligible; i++) {
+        const chaz_ProbeCandidate *candidate = &table->candidates[order[i]];
+        char *includes = chaz_ProbeTable_includes(candidate->headers,
+                                                  prelude);
+        char *body     = chaz_ProbeTable_expand(table->code, candidate->args);
+        chaz_ProbeBatch_add(batch, includes, body);
+        free(includes);
+        free(body);
+    }
+
+    winner = chaz_ProbeBatch_run_first(batch);
+    winner = winner >= 0 ? order[winner] : -1;
+
+    chaz_ProbeBatch_destroy(batch);
+    return winner;
+}
+
+static int
+chaz_ProbeTable_resolve_programs(const chaz_ProbeTable *table,
+                                 const int *order, int num_eligible,
+                                 const char *prelude) {
+    int *jobs   = (int*)malloc((num_eligible + 1) * sizeof(int));
+    int  winner = -1;
+    int  step;
+    int  start;
+    int  i;
+
+    /* Test every candidate at once if that doesn't cost any time.
+     * Otherwise, stop at the first winner. */
+    step = chaz_ProbeQueue_get_max_jobs() > 1 ? num_eligible : 1;
+
+    for (start = 0; start < num_eligible && winner < 0; start += step) {
+        chaz_ProbeQueue *queue = chaz_ProbeQueue_new();
+        int end = start + step < num_eligible
+                  ? start + step
+                  : num_eligible;
+
+        for (i = start; i < end; i++) {
+            const chaz_ProbeCandidate *candidate
+                = &table->candidates[order[i]];
+            char *includes;
+            char *code;
+            char *source;
+            includes = chaz_ProbeTable_includes(candidate->headers, prelude);
+            code     = chaz_ProbeTable_expand(table->code, candidate->args);
+            source   = chaz_Util_join("\n", includes, code, NULL);
+            if (table->criterion == CHAZ_PROBETABLE_LINKS) {
+                jobs[i] = chaz_ProbeQueue_add_link(queue, source);
+            }
+            else {
+                jobs[i] = chaz_ProbeQueue_add_capture(queue, source);
+            }
+            free(includes);
+            free(code);
+            free(source);
+        }
+        chaz_ProbeQueue_run(queue);
+
+        for (i = start; i < end && winner < 0; i++) {
+            if (chaz_ProbeTable_passed(table, queue, jobs[i])) {
+                winner = order[i];
+            }
+        }
+        chaz_ProbeQueue_destroy(queue);
+    }
+
+    free(jobs);
+    return winner;
+}
+
+static int
+chaz_ProbeTable_passed(const chaz_ProbeTable *table, chaz_ProbeQueue *queue,
+                       int job) {
+    const char *output;
+    size_t      output_len;
+
+    if (table->criterion == CHAZ_PROBETABLE_LINKS) {
+        return chaz_ProbeQueue_succeeded(queue, job);
+    }
+    if (!chaz_CC_can_run() || table->expected == NULL) {
+        return chaz_ProbeQueue_passed(queue, job);
+    }
+    output = chaz_ProbeQueue_output(queue, job, &output_len);
+    return output != NULL
+           && strncmp(output, table->expected, strlen(table->expected)) == 0;
+}
+
+static int
+chaz_ProbeTable_has_headers(const char *headers) {
+    const char *ptr = headers + strspn(headers, " ");
+
+    /* Checking a header may compile something, so no strtok here. */
+    while (*ptr != '\0') {
+        size_t  len    = strcspn(ptr, " ");
+        char   *header = (char*)malloc(len + 1);
+        int     found;
+        memcpy(header, ptr, len);
+        header[len] = '\0';
+        found = chaz_HeadCheck_check_header(header);
+        free(header);
+        if (!found) {
+            return false;
+        }
+        ptr += len;
+        ptr += strspn(ptr, " ");
+    }
+    return true;
+}
+
+static char*
+chaz_ProbeTable_includes(const char *headers, const char *prelude) {
+    char *copy     = chaz_Util_strdup(headers);
+    char *includes = chaz_Util_strdup("");
+    char *header   = strtok(copy, " ");
+
+    while (header != NULL) {
+        char *temp = chaz_Util_join("", includes, "#include <", header, ">\n",
+                                    NULL);
+        free(includes);
+        includes = temp;
+        header   = strtok(NULL, " ");
+    }
+    if (prelude) {
+        char *temp = chaz_Util_join("", includes, prelude, "\n", NULL);
+        free(includes);
+        includes = temp;
+    }
+    free(copy);
+    return includes;
+}
+
+static char*
+chaz_ProbeTable_expand(const char *code, const char *const *args) {
+    size_t      needed = 1;
+    const char *ptr;
+    char       *expanded = NULL;
+    char       *end;
+    int         pass;
+
+    /* Measure, then copy. */
+    for (pass = 0; pass < 2; pass++) {
+        end = expanded;
+        for (ptr = code; *ptr != '\0'; ptr++) {
+            const char *arg = NULL;
+            if (ptr[0] == '$' && ptr[1] >= '1'
+                && ptr[1] < '1' + CHAZ_PROBETABLE_MAX_ARGS
+               ) {
+                arg = args[ptr[1] - '1'] ? args[ptr[1] - '1'] : "";
+                ptr++;
+            }
+            if (pass == 0) {
+                needed += arg ? strlen(arg) : 1;
+            }
+            else if (arg) {
+                strcpy(end, arg);
+                end += strlen(arg);
+            }
+            else {
+                *end++ = *ptr;
+            }
+        }
+        if (pass == 0) {
+            expanded = (char*)malloc(needed);
+        }
+    }
+    *end = '\0';
+
+    return expanded;
+}
+
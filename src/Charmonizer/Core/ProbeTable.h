@@ -0,0 +1,112 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Charmonizer/Core/ProbeTable.h -- choose between alternatives, declared.
+ *
+ * Many probes try a list of alternatives -- different names for the same
+ * function, say -- and settle on the first one which works.  A
+ * chaz_ProbeTable describes such a probe as data: a code template, the
+ * criterion which decides whether a candidate works, and a static array of
+ * candidates in order of preference, each with the headers it needs, the
+ * words to fill into the template and the defines it stands for.
+ *
+ * Since the evaluator sees every candidate at once, it can skip candidates
+ * whose headers are missing without compiling anything, and test all the
+ * others concurrently when probe jobs may run in parallel.  Otherwise, it
+ * tests them one by one and stops at the first winner.
+ *
+ * Candidates may also be marked with the compiler traits (see
+ * chaz_CC_traits) under which they can't work, so that they are skipped
+ * outright, and those under which they are the likely winner, so that they
+ * are tested first.
+ */
+
+#ifndef H_CHAZ_PROBE_TABLE
+#define H_CHAZ_PROBE_TABLE
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "Charmonizer/Core/Defines.h"
+
+#define CHAZ_PROBETABLE_MAX_ARGS  3
+#define CHAZ_PROBETABLE_MAX_DEFS  4
+
+/* Criteria.  The code of a COMPILES table is the body of a function
+ * returning int, which has to compile.  The code of the other tables is a
+ * whole program, which has to link, or has to run and print the expected
+ * output.  If probe executables may not be run, linking is enough for RUNS
+ * tables, too.
+ */
+#define CHAZ_PROBETABLE_COMPILES  1
+#define CHAZ_PROBETABLE_LINKS     2
+#define CHAZ_PROBETABLE_RUNS      3
+
+/* A define written to the config when its candidate wins.  [value] may be
+ * NULL.
+ */
+typedef struct chaz_ProbeDef {
+    const char *name;
+    const char *value;
+} chaz_ProbeDef;
+
+/* [headers] is a space-separated list of headers which the candidate
+ * #includes ahead of the code; a candidate whose headers don't all exist
+ * loses without a probe.  $1, $2 and $3 in the code are replaced by the
+ * candidate's [args].  Arrays of candidates end with one whose [headers]
+ * is NULL.
+ *
+ * [impossible] and [likely] are masks of CHAZ_CC_* traits.  A candidate
+ * loses without a probe if the compiler has any of the traits in
+ * [impossible].  If it has any in [likely], the candidate is tested ahead
+ * of the others and wins if it works, so it may only be marked likely
+ * where none of the candidates preferred to it can work.
+ */
+typedef struct chaz_ProbeCandidate {
+    const char    *headers;
+    const char    *args[CHAZ_PROBETABLE_MAX_ARGS];
+    chaz_ProbeDef  defs[CHAZ_PROBETABLE_MAX_DEFS];
+    int            likely;
+    int            impossible;
+} chaz_ProbeCandidate;
+
+/* [expected] is what a RUNS program must print first, or NULL if any
+ * output will do.  [scratch_file] (which may be NULL) names a file which
+ * the programs leave behind in the scratch directory, to be removed.
+ */
+typedef struct chaz_ProbeTable {
+    int                        criterion;
+    const char                *code;
+    const char                *expected;
+    const char                *scratch_file;
+    const chaz_ProbeCandidate *candidates;
+} chaz_ProbeTable;
+
+/* Find the first candidate in [table] which works and write its defines.
+ * [prelude] (which may be NULL) is inserted after each candidate's #include
+ * lines, for code which depends on what earlier probes found.  Return the
+ * index of the winner, or -1 if no candidate works.
+ */
+int
+chaz_ProbeTable_resolve(const chaz_ProbeTable *table, const char *prelude);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H_CHAZ_PROBE_TABLE */
+
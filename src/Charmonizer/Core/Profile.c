@@ -0,0 +1,571 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Charmonizer/Core/Profile.h"
+#include "Charmonizer/Core/Compiler.h"
+#include "Charmonizer/Core/ConfWriter.h"
+#include "Charmonizer/Core/OperatingSystem.h"
+#include "Charmonizer/Core/Types.h"
+#include "Charmonizer/Core/Util.h"
+
+/* A growing string.
+ */
+typedef struct chaz_ProfileText {
+    char   *ptr;
+    size_t  len;
+    size_t  cap;
+} chaz_ProfileText;
+
+typedef struct chaz_ProfileModule {
+    char             *name;
+    chaz_ProfileText  ops;
+} chaz_ProfileModule;
+
+static struct {
+    char               *key;
+    int                 active;
+    chaz_ProfileModule *modules;
+    int                 num_modules;
+    int                 cap;
+    char               *write_path;
+    chaz_ProfileText    recorded;
+    /* Where chaz_Profile_append_op writes. */
+    chaz_ProfileText   *target;
+} chaz_Profile = {
+    NULL, false, NULL, 0, 0, NULL, { NULL, 0, 0 }, NULL
+};
+
+/* Return the key of the current platform, e.g.
+ * "linux x86_64 le glibc gcc-12 64", or NULL if the target can't be told
+ * apart from others well enough.
+ */
+static char*
+chaz_Profile_platform_key(void);
+
+/* Return the name of the target's CPU architecture, or NULL.
+ */
+static const char*
+chaz_Profile_arch(void);
+
+/* Return "le" or "be" for the target's byte order, or NULL.
+ */
+static const char*
+chaz_Profile_byte_order(void);
+
+/* Return the name of the target's C library.
+ */
+static const char*
+chaz_Profile_libc(void);
+
+/* Read the profile matching the current platform from the file at [path].
+ */
+static void
+chaz_Profile_load(const char *path);
+
+static chaz_ProfileModule*
+chaz_Profile_add_module(const char *name);
+
+static chaz_ProfileModule*
+chaz_Profile_find(const char *name);
+
+static void
+chaz_Profile_append(chaz_ProfileText *text, const char *str, size_t len);
+
+/* Serialize the operations in the log at [log_path] which are listed in
+ * [ops], or all of them if [ops] is NULL, onto [text].
+ */
+static void
+chaz_Profile_serialize(const char *log_path, const char *ops,
+                       chaz_ProfileText *text);
+
+/* OpLog handler which serializes an operation onto chaz_Profile.target.
+ */
+static void
+chaz_Profile_append_op(char op, const char **fields, int num_fields);
+
+/* Copy the lines of [source] whose operation is listed in [ops] onto
+ * [text].
+ */
+static void
+chaz_Profile_filter(const chaz_ProfileText *source, const char *ops,
+                    chaz_ProfileText *text);
+
+/* Undo the escaping of a field in place.
+ */
+static void
+chaz_Profile_unescape(char *field);
+
+void
+chaz_Profile_init(const char *load_path, const char *write_path) {
+    int loading = load_path != NULL && load_path[0] != '\0';
+    int writing = write_path != NULL && write_path[0] != '\0';
+
+    if (!loading && !writing) { return; }
+
+    chaz_Profile.key = chaz_Profile_platform_key();
+    if (chaz_Profile.key == NULL) {
+        chaz_Util_warn("Can't identify the target well enough to use a "
+                       "platform profile");
+        return;
+    }
+    if (chaz_Util_verbosity) {
+        printf("Platform profile key: %s\n", chaz_Profile.key);
+    }
+    if (writing) {
+        chaz_Profile.write_path = chaz_Util_strdup(write_path);
+    }
+    if (loading) {
+        chaz_Profile_load(load_path);
+    }
+}
+
+void
+chaz_Profile_clean_up(void) {
+    int i;
+
+    if (chaz_Profile.write_path) {
+        FILE *file = fopen(chaz_Profile.write_path, "w");
+        if (file == NULL) {
+            chaz_Util_die("Can't write profile '%s': %s",
+                          chaz_Profile.write_path, strerror(errno));
+        }
+        fprintf(file, "# Charmonizer platform profile\n\nprofile %s\n",
+                chaz_Profile.key);
+        if (chaz_Profile.recorded.len) {
+            fwrite(chaz_Profile.recorded.ptr, 1, chaz_Profile.recorded.len,
+                   file);
+        }
+        if (fclose(file) != 0) {
+            chaz_Util_die("Error when closing '%s': %s",
+                          chaz_Profile.write_path, strerror(errno));
+        }
+    }
+
+    for (i = 0; i < chaz_Profile.num_modules; i++) {
+        free(chaz_Profile.modules[i].name);
+        free(chaz_Profile.modules[i].ops.ptr);
+    }
+    free(chaz_Profile.modules);
+    free(chaz_Profile.key);
+    free(chaz_Profile.write_path);
+    free(chaz_Profile.recorded.ptr);
+    memset(&chaz_Profile, 0, sizeof(chaz_Profile));
+}
+
+int
+chaz_Profile_active(void) {
+    return chaz_Profile.active;
+}
+
+int
+chaz_Profile_covers(const char *name) {
+    return chaz_Profile.active && chaz_Profile_find(name) != NULL;
+}
+
+int
+chaz_Profile_verify(const char *name, const char *log_path) {
+    chaz_ProfileModule *module   = chaz_Profile_find(name);
+    chaz_ProfileText    actual   = { NULL, 0, 0 };
+    chaz_ProfileText    expected = { NULL, 0, 0 };
+    int                 matches;
+
+    if (module == NULL) { return false; }
+    chaz_Profile_serialize(log_path, CHAZ_CONFWRITER_OPS, &actual);
+    chaz_Profile_filter(&module->ops, CHAZ_CONFWRITER_OPS, &expected);
+    matches = actual.len == expected.len
+              && (actual.len == 0
+                  || memcmp(actual.ptr, expected.ptr, actual.len) == 0);
+
+    free(actual.ptr);
+    free(expected.ptr);
+    return matches;
+}
+
+void
+chaz_Profile_replay(const char *name, chaz_OpLog_handler_t handler) {
+    chaz_ProfileModule *module = chaz_Profile_find(name);
+    char               *copy;
+    char               *line;
+
+    if (module == NULL || module->ops.len == 0) { return; }
+
+    copy = (char*)malloc(module->ops.len + 1);
+    memcpy(copy, module->ops.ptr, module->ops.len);
+    copy[module->ops.len] = '\0';
+
+    for (line = copy; *line != '\0'; ) {
+        const char *fields[CHAZ_OPLOG_MAX_FIELDS];
+        int         num_fields = 0;
+        char       *next = strchr(line, '\n');
+        char       *field;
+        char        op;
+
+        *next = '\0';
+        op    = line[2];
+        field = strchr(line + 2, '\t');
+        while (field != NULL) {
+            char *tab;
+            *field++ = '\0';
+            tab = strchr(field, '\t');
+            if (num_fields == CHAZ_OPLOG_MAX_FIELDS) {
+                chaz_Util_die("Too many fields in profile of module %s",
+                              name);
+            }
+            if (field[0] == 'S') {
+                if (tab) { *tab = '\0'; }
+                chaz_Profile_unescape(field + 1);
+                fields[num_fields++] = field + 1;
+            }
+            else if (field[0] == 'N' && (field[1] == '\0' || tab)) {
+                fields[num_fields++] = NULL;
+            }
+            else {
+                chaz_Util_die("Corrupt field in profile of module %s", name);
+            }
+            field = tab;
+        }
+        handler(op, fields, num_fields);
+        line = next + 1;
+    }
+
+    free(copy);
+}
+
+int
+chaz_Profile_recording(void) {
+    return chaz_Profile.write_path != NULL;
+}
+
+void
+chaz_Profile_record(const char *name, const char *log_path) {
+    if (!chaz_Profile.write_path) { return; }
+    chaz_Profile_append(&chaz_Profile.recorded, "module ", 7);
+    chaz_Profile_append(&chaz_Profile.recorded, name, strlen(name));
+    chaz_Profile_append(&chaz_Profile.recorded, "\n", 1);
+    chaz_Profile_serialize(log_path, NULL, &chaz_Profile.recorded);
+}
+
+static char*
+chaz_Profile_platform_key(void) {
+    const char *clang_major = chaz_CC_macro_value("__clang_major__");
+    const char *arch        = chaz_Profile_arch();
+    const char *byte_order  = chaz_Profile_byte_order();
+    char        compiler[40];
+    char        bits[20];
+
+    /* The key has to tell apart every target whose answers may differ,
+     * above all those for byte order, which no spot check may cover. */
+    if (arch == NULL || byte_order == NULL) {
+        return NULL;
+    }
+
+    /* Minor releases rarely change any answers, and the spot checks catch
+     * those which do. */
+    if (clang_major != NULL) {
+        sprintf(compiler, "clang-%.20s", clang_major);
+    }
+    else if (chaz_CC_gcc_version_num()) {
+        sprintf(compiler, "gcc-%d", chaz_CC_gcc_version_num() / 10000);
+    }
+    else if (chaz_CC_msvc_version_num()) {
+        sprintf(compiler, "msvc-%d", chaz_CC_msvc_version_num() / 100);
+    }
+    else if (chaz_CC_sun_c_version_num()) {
+        sprintf(compiler, "sunc-%x", chaz_CC_sun_c_version_num() >> 4);
+    }
+    else {
+        strcpy(compiler, "cc");
+    }
+    sprintf(bits, "%d", 8 * chaz_Types_sizeof("void*", NULL));
+
+    return chaz_Util_join(" ", chaz_OS_name(), arch, byte_order,
+                          chaz_Profile_libc(), compiler, bits, NULL);
+}
+
+static const char*
+chaz_Profile_arch(void) {
+    /* Pairs of macro and architecture, most specific first. */
+    static const char *const arches[] = {
+        "__x86_64__",    "x86_64",
+        "_M_X64",        "x86_64",
+        "__i386__",      "x86",
+        "_M_IX86",       "x86",
+        "__aarch64__",   "aarch64",
+        "_M_ARM64",      "aarch64",
+        "__arm__",       "arm",
+        "_M_ARM",        "arm",
+        "__powerpc64__", "ppc64",
+        "__powerpc__",   "ppc",
+        "__s390x__",     "s390x",
+        "__s390__",      "s390",
+        "__sparc",       "sparc",
+        "__mips__",      "mips",
+        "__riscv",       "riscv",
+        NULL
+    };
+    int i;
+
+    for (i = 0; arches[i] != NULL; i += 2) {
+        if (chaz_CC_macro_value(arches[i]) != NULL) {
+            return arches[i + 1];
+        }
+    }
+    return NULL;
+}
+
+static const char*
+chaz_Profile_byte_order(void) {
+    const char *order  = chaz_CC_macro_value("__BYTE_ORDER__");
+    const char *little = chaz_CC_macro_value("__ORDER_LITTLE_ENDIAN__");
+    const char *big    = chaz_CC_macro_value("__ORDER_BIG_ENDIAN__");
+
+    /* Identification may have captured the value of __BYTE_ORDER__ either
+     * expanded or as the name of the __ORDER_*__ macro. */
+    if (order != NULL) {
+        if (strcmp(order, "__ORDER_LITTLE_ENDIAN__") == 0
+            || (little != NULL && strcmp(order, little) == 0)
+           ) {
+            return "le";
+        }
+        if (strcmp(order, "__ORDER_BIG_ENDIAN__") == 0
+            || (big != NULL && strcmp(order, big) == 0)
+           ) {
+            return "be";
+        }
+    }
+
+    /* Every target of MSVC is little-endian. */
+    if (chaz_CC_msvc_version_num()) {
+        return "le";
+    }
+    return NULL;
+}
+
+static const char*
+chaz_Profile_libc(void) {
+    /* Pairs of macro and C library.  musl doesn't announce itself. */
+    static const char *const libcs[] = {
+        "__GLIBC__",   "glibc",
+        "__UCLIBC__",  "uclibc",
+        "__BIONIC__",  "bionic",
+        "__NEWLIB__",  "newlib",
+        NULL
+    };
+    static const char test_code[] =
+        "#include <stdio.h>\n"
+        "#ifndef %s\n"
+        "#error %s\n"
+        "#endif\n";
+    char code[sizeof(test_code) + 40];
+    int  i;
+
+    for (i = 0; libcs[i] != NULL; i += 2) {
+        sprintf(code, test_code, libcs[i], libcs[i]);
+        if (chaz_CC_test_preprocess(code)) {
+            return libcs[i + 1];
+        }
+    }
+    return "libc";
+}
+
+static void
+chaz_Profile_load(const char *path) {
+    FILE               *file = fopen(path, "r");
+    chaz_ProfileModule *module   = NULL;
+    int                 matching = false;
+    char               *line;
+    size_t              line_cap = 256;
+
+    if (file == NULL) {
+        chaz_Util_warn("Can't read profile '%s': %s", path, strerror(errno));
+        return;
+    }
+
+    /* Only the first profile with our key counts. */
+    line = (char*)malloc(line_cap);
+    while (fgets(line, (int)line_cap, file) != NULL) {
+        size_t len = strlen(line);
+
+        /* Lines may be longer than the buffer. */
+        while (len > 0 && line[len-1] != '\n' && !feof(file)) {
+            line_cap *= 2;
+            line = (char*)realloc(line, line_cap);
+            if (fgets(line + len, (int)(line_cap - len), file) == NULL) {
+                break;
+            }
+            len += strlen(line + len);
+        }
+        while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r')) {
+            line[--len] = '\0';
+        }
+
+        if (memcmp(line, "  ", 2) == 0 && len > 2) {
+            if (module != NULL) {
+                chaz_Profile_append(&module->ops, line, len);
+                chaz_Profile_append(&module->ops, "\n", 1);
+            }
+            else if (matching) {
+                chaz_Util_die("Operation outside of a module in profile "
+                              "'%s'", path);
+            }
+        }
+        else if (memcmp(line, "profile ", 8) == 0) {
+            if (chaz_Profile.active) { break; }
+            matching = strcmp(line + 8, chaz_Profile.key) == 0;
+            chaz_Profile.active = matching;
+            module = NULL;
+        }
+        else if (memcmp(line, "module ", 7) == 0) {
+            module = matching ? chaz_Profile_add_module(line + 7) : NULL;
+        }
+        else if (len > 0 && line[0] != '#') {
+            chaz_Util_die("Malformed line in profile '%s': %s", path, line);
+        }
+    }
+
+    free(line);
+    fclose(file);
+    if (chaz_Util_verbosity) {
+        if (chaz_Profile.active) {
+            printf("Using profile '%s' for %d modules\n", path,
+                   chaz_Profile.num_modules);
+        }
+        else {
+            printf("No profile for this platform in '%s'\n", path);
+        }
+    }
+}
+
+static chaz_ProfileModule*
+chaz_Profile_add_module(const char *name) {
+    chaz_ProfileModule *module;
+
+    if (chaz_Profile.num_modules == chaz_Profile.cap) {
+        chaz_Profile.cap = chaz_Profile.cap ? chaz_Profile.cap * 2 : 16;
+        chaz_Profile.modules = (chaz_ProfileModule*)realloc(
+                                   chaz_Profile.modules,
+                                   chaz_Profile.cap
+                                   * sizeof(chaz_ProfileModule));
+    }
+    module = &chaz_Profile.modules[chaz_Profile.num_modules++];
+    module->name    = chaz_Util_strdup(name);
+    module->ops.ptr = NULL;
+    module->ops.len = 0;
+    module->ops.cap = 0;
+    return module;
+}
+
+static chaz_ProfileModule*
+chaz_Profile_find(const char *name) {
+    int i;
+    for (i = 0; i < chaz_Profile.num_modules; i++) {
+        if (strcmp(chaz_Profile.modules[i].name, name) == 0) {
+            return &chaz_Profile.modules[i];
+        }
+    }
+    return NULL;
+}
+
+static void
+chaz_Profile_append(chaz_ProfileText *text, const char *str, size_t len) {
+    if (text->len + len + 1 > text->cap) {
+        text->cap = (text->len + len + 1) * 2;
+        text->ptr = (char*)realloc(text->ptr, text->cap);
+    }
+    memcpy(text->ptr + text->len, str, len);
+    text->len += len;
+    text->ptr[text->len] = '\0';
+}
+
+static void
+chaz_Profile_serialize(const char *log_path, const char *ops,
+                       chaz_ProfileText *text) {
+    chaz_Profile.target = text;
+    chaz_OpLog_replay(log_path, ops, chaz_Profile_append_op);
+    chaz_Profile.target = NULL;
+}
+
+static void
+chaz_Profile_append_op(char op, const char **fields, int num_fields) {
+    chaz_ProfileText *text = chaz_Profile.target;
+    int i;
+
+    chaz_Profile_append(text, "  ", 2);
+    chaz_Profile_append(text, &op, 1);
+    for (i = 0; i < num_fields; i++) {
+        const char *ptr;
+        if (fields[i] == NULL) {
+            chaz_Profile_append(text, "\tN", 2);
+            continue;
+        }
+        chaz_Profile_append(text, "\tS", 2);
+        for (ptr = fields[i]; *ptr != '\0'; ptr++) {
+            switch (*ptr) {
+                case '\\': chaz_Profile_append(text, "\\\\", 2); break;
+                case '\t': chaz_Profile_append(text, "\\t", 2);  break;
+                case '\n': chaz_Profile_append(text, "\\n", 2);  break;
+                case '\r': chaz_Profile_append(text, "\\r", 2);  break;
+                default:   chaz_Profile_append(text, ptr, 1);    break;
+            }
+        }
+    }
+    chaz_Profile_append(text, "\n", 1);
+}
+
+static void
+chaz_Profile_filter(const chaz_ProfileText *source, const char *ops,
+                    chaz_ProfileText *text) {
+    const char *line = source->ptr;
+    const char *end  = source->ptr + source->len;
+
+    while (line < end) {
+        const char *next = (const char*)memchr(line, '\n',
+                                               (size_t)(end - line));
+        next = next ? next + 1 : end;
+        if (strchr(ops, line[2]) != NULL) {
+            chaz_Profile_append(text, line, (size_t)(next - line));
+        }
+        line = next;
+    }
+}
+
+static void
+chaz_Profile_unescape(char *field) {
+    char *src  = field;
+    char *dest = field;
+
+    while (*src != '\0') {
+        if (*src == '\\' && src[1] != '\0') {
+            src++;
+            switch (*src) {
+                case 't': *dest++ = '\t'; break;
+                case 'n': *dest++ = '\n'; break;
+                case 'r': *dest++ = '\r'; break;
+                default:  *dest++ = *src; break;
+            }
+            src++;
+        }
+        else {
+            *dest++ = *src++;
+        }
+    }
+    *dest = '\0';
+}
+
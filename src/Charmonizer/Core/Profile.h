@@ -0,0 +1,103 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Charmonizer/Core/Profile.h -- known answers for known platforms.
+ *
+ * A platform profile holds what each probe module wrote to the config files
+ * on one platform, identified by the name of the OS, the CPU architecture,
+ * the byte order, the C library, the compiler family and major version,
+ * and the width of a pointer -- e.g. "linux x86_64 le glibc gcc-12 64".
+ * Targets whose architecture or byte order can't be read from the
+ * compiler's predefined macros get no profile at all.  A file may hold
+ * profiles for any number of platforms.
+ *
+ * When the profile for the current platform is loaded, the modules it covers
+ * needn't be run at all: their operations are replayed from the profile
+ * instead.  A few of them are still run as spot checks, and if any of those
+ * disagrees with the profile, it can't be trusted and everything is probed
+ * after all.  Modules the profile doesn't cover are always run.
+ *
+ * The file is text.  Each profile begins with a "profile" line holding its
+ * key, and each module within a profile with a "module" line holding its
+ * name.  The module's operations follow, one per line, indented by two
+ * spaces: the operation's character, then a tab before each field, which
+ * is 'N' for NULL or 'S' followed by the string, with backslashes, tabs,
+ * newlines and carriage returns escaped as in C.  Blank lines and lines
+ * starting with '#' are ignored.
+ */
+
+#ifndef H_CHAZ_PROFILE
+#define H_CHAZ_PROFILE
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "Charmonizer/Core/Defines.h"
+#include "Charmonizer/Core/OpLog.h"
+
+/* Load the profile for the current platform from the file at [load_path],
+ * and/or prepare to write a profile of this run to [write_path].  Either
+ * may be NULL or empty.  Must be called after chaz_CC_init.
+ */
+void
+chaz_Profile_init(const char *load_path, const char *write_path);
+
+/* Write the recorded profile, if one was asked for, and free everything.
+ */
+void
+chaz_Profile_clean_up(void);
+
+/* Return true if a profile for the current platform was loaded.
+ */
+int
+chaz_Profile_active(void);
+
+/* Return true if the loaded profile has results for the module [name].
+ */
+int
+chaz_Profile_covers(const char *name);
+
+/* Return true if what the module [name] wrote to its operation log at
+ * [log_path] matches the loaded profile.  Only operations on the config
+ * files count.
+ */
+int
+chaz_Profile_verify(const char *name, const char *log_path);
+
+/* Pass the operations of the module [name] in the loaded profile to
+ * [handler], in order.
+ */
+void
+chaz_Profile_replay(const char *name, chaz_OpLog_handler_t handler);
+
+/* Return true if a profile of this run is being recorded.
+ */
+int
+chaz_Profile_recording(void);
+
+/* Add the operations which the module [name] recorded in the log at
+ * [log_path] to the profile being recorded, if any.
+ */
+void
+chaz_Profile_record(const char *name, const char *log_path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H_CHAZ_PROFILE */
+
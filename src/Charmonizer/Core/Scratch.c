@@ -0,0 +1,257 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Charmonizer/Core/Scratch.h"
+#include "Charmonizer/Core/OperatingSystem.h"
+#include "Charmonizer/Core/Util.h"
+
+#ifdef CHAZ_HAS_POSIX_API
+  #include <sys/types.h>
+  #include <sys/stat.h>
+  #include <dirent.h>
+  #include <unistd.h>
+  #ifdef __STRICT_ANSI__
+    /* Strict ANSI modes hide lstat() in <sys/stat.h>. */
+    extern int lstat(const char *path, struct stat *buf);
+  #endif
+#endif
+
+static struct {
+    char *run_dir;
+    char *dir;
+    int   owner_pid;
+} chaz_Scratch = { NULL, NULL, 0 };
+
+#ifdef CHAZ_HAS_POSIX_API
+/* Return true if [base] is a directory where we can create files and run
+ * executables.
+ */
+static int
+chaz_Scratch_usable(const char *base);
+
+/* Remove [path] and, if it's a directory, everything below it.
+ */
+static void
+chaz_Scratch_remove_tree(const char *path);
+#endif
+
+/* Remove the scratch directory even if the run ends with chaz_Util_die.
+ */
+static void
+chaz_Scratch_clean_up_at_exit(void);
+
+void
+chaz_Scratch_init(void) {
+#ifdef CHAZ_HAS_POSIX_API
+    const char *candidates[3];
+    const char *base = NULL;
+    char       *cwd  = NULL;
+    int         i;
+
+    candidates[0] = getenv("TMPDIR");
+    candidates[1] = "/dev/shm";
+    candidates[2] = "/tmp";
+    for (i = 0; i < 3; i++) {
+        if (candidates[i] != NULL
+            && candidates[i][0] != '\0'
+            && chaz_Scratch_usable(candidates[i])
+           ) {
+            base = candidates[i];
+            break;
+        }
+    }
+
+    if (base != NULL) {
+        char name[60];
+        int  attempt;
+
+        /* Probe executables get run from elsewhere, so the path has to be
+         * absolute. */
+        if (base[0] != '/') {
+            size_t size = 256;
+            cwd = (char*)malloc(size);
+            while (getcwd(cwd, size) == NULL && errno == ERANGE) {
+                size *= 2;
+                cwd = (char*)realloc(cwd, size);
+            }
+        }
+
+        for (attempt = 0; attempt < 100; attempt++) {
+            char *path;
+            sprintf(name, "charmonizer-%d-%d", chaz_OS_pid(), attempt);
+            path = cwd
+                   ? chaz_Util_join("/", cwd, base, name, NULL)
+                   : chaz_Util_join("/", base, name, NULL);
+            if (mkdir(path, 0700) == 0) {
+                chaz_Scratch.run_dir = path;
+                break;
+            }
+            free(path);
+            if (errno != EEXIST) { break; }
+        }
+        free(cwd);
+    }
+
+    if (chaz_Scratch.run_dir != NULL) {
+        chaz_Scratch.dir       = chaz_Util_strdup(chaz_Scratch.run_dir);
+        chaz_Scratch.owner_pid = chaz_OS_pid();
+        atexit(chaz_Scratch_clean_up_at_exit);
+    }
+#endif
+
+    if (chaz_Scratch.dir == NULL) {
+        chaz_Scratch.dir = chaz_Util_strdup("");
+    }
+    if (chaz_Util_verbosity) {
+        printf("Scratch directory: %s\n",
+               chaz_Scratch.dir[0] ? chaz_Scratch.dir : "(current)");
+    }
+}
+
+void
+chaz_Scratch_clean_up(void) {
+    if (chaz_Scratch.run_dir != NULL
+        && chaz_Scratch.owner_pid == chaz_OS_pid()
+       ) {
+#ifdef CHAZ_HAS_POSIX_API
+        chaz_Scratch_remove_tree(chaz_Scratch.run_dir);
+#endif
+        free(chaz_Scratch.run_dir);
+        chaz_Scratch.run_dir = NULL;
+    }
+    free(chaz_Scratch.dir);
+    chaz_Scratch.dir = NULL;
+}
+
+static void
+chaz_Scratch_clean_up_at_exit(void) {
+    chaz_Scratch_clean_up();
+}
+
+const char*
+chaz_Scratch_dir(void) {
+    return chaz_Scratch.dir ? chaz_Scratch.dir : "";
+}
+
+char*
+chaz_Scratch_path(const char *name) {
+    const char *dir = chaz_Scratch_dir();
+    if (dir[0] == '\0') {
+        return chaz_Util_strdup(name);
+    }
+    return chaz_Util_join(chaz_OS_dir_sep(), dir, name, NULL);
+}
+
+void
+chaz_Scratch_enter_worker(int worker) {
+    char  name[30];
+    char *path;
+
+    if (chaz_Scratch.run_dir == NULL) {
+        return;
+    }
+    sprintf(name, "w%d", worker);
+    path = chaz_Util_join("/", chaz_Scratch.run_dir, name, NULL);
+#ifdef CHAZ_HAS_POSIX_API
+    if (mkdir(path, 0700) != 0 && errno != EEXIST) {
+        chaz_Util_die("Can't create '%s': %s", path, strerror(errno));
+    }
+#endif
+    free(chaz_Scratch.dir);
+    chaz_Scratch.dir = path;
+}
+
+#ifdef CHAZ_HAS_POSIX_API
+
+static int
+chaz_Scratch_usable(const char *base) {
+    char  name[40];
+    char *path;
+    FILE *file;
+    int   usable;
+
+    /* Paths end up in commands, so stay clear of anything the shell would
+     * treat specially. */
+    if (base[strspn(base, "abcdefghijklmnopqrstuvwxyz"
+                          "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                          "0123456789/._-")] != '\0'
+       ) {
+        return false;
+    }
+
+    /* Try to create an executable file.  access() reports filesystems
+     * mounted noexec. */
+    sprintf(name, "_charm_exec_check_%d", chaz_OS_pid());
+    path = chaz_Util_join("/", base, name, NULL);
+    file = fopen(path, "w");
+    if (file == NULL) {
+        free(path);
+        return false;
+    }
+    fclose(file);
+    usable = chmod(path, 0700) == 0 && access(path, X_OK) == 0;
+    remove(path);
+    free(path);
+    return usable;
+}
+
+static void
+chaz_Scratch_remove_tree(const char *path) {
+    struct stat  info;
+    DIR         *dir;
+
+    /* Never follow a symlink out of the tree: remove the link itself. */
+    if (lstat(path, &info) != 0) {
+        if (errno != ENOENT) {
+            chaz_Util_warn("Failed to stat '%s': %s", path, strerror(errno));
+        }
+        return;
+    }
+    if (!S_ISDIR(info.st_mode)) {
+        if (unlink(path) != 0 && errno != ENOENT) {
+            chaz_Util_warn("Failed to remove '%s': %s", path,
+                           strerror(errno));
+        }
+        return;
+    }
+
+    dir = opendir(path);
+    if (dir != NULL) {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            char *child;
+            if (strcmp(entry->d_name, ".") == 0
+                || strcmp(entry->d_name, "..") == 0
+               ) {
+                continue;
+            }
+            child = chaz_Util_join("/", path, entry->d_name, NULL);
+            chaz_Scratch_remove_tree(child);
+            free(child);
+        }
+        closedir(dir);
+    }
+    if (rmdir(path) != 0 && errno != ENOENT) {
+        chaz_Util_warn("Failed to remove '%s': %s", path, strerror(errno));
+    }
+}
+
+#endif /* CHAZ_HAS_POSIX_API */
+
@@ -0,0 +1,70 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Charmonizer/Core/Scratch.h -- private workspace for probe files.
+ *
+ * Source files, objects, executables and captured output from probes all
+ * live in a directory which belongs to the current run, so that the source
+ * tree is left alone.  On POSIX hosts the directory goes under $TMPDIR,
+ * /dev/shm or /tmp, whichever is usable first; probe executables must be
+ * able to run there, so filesystems mounted noexec are skipped.  Elsewhere,
+ * scratch files stay in the current working directory.
+ */
+
+#ifndef H_CHAZ_SCRATCH
+#define H_CHAZ_SCRATCH
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "Charmonizer/Core/Defines.h"
+
+/* Create the scratch directory for this run.
+ */
+void
+chaz_Scratch_init(void);
+
+/* Remove the scratch directory along with everything in it.  Only the
+ * process which called chaz_Scratch_init does anything.
+ */
+void
+chaz_Scratch_clean_up(void);
+
+/* Return the current scratch directory, or an empty string if scratch files
+ * go into the current working directory.
+ */
+const char*
+chaz_Scratch_dir(void);
+
+/* Return a newly allocated path for a scratch file named [name].
+ */
+char*
+chaz_Scratch_path(const char *name);
+
+/* Give the calling process a scratch directory of its own, nested in the
+ * run directory, so that it can use fixed file names without colliding with
+ * other workers.  Meant to be called in child processes.
+ */
+void
+chaz_Scratch_enter_worker(int worker);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H_CHAZ_SCRATCH */
+
@@ -0,0 +1,409 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "Charmonizer/Core/Trace.h"
+#include "Charmonizer/Core/OperatingSystem.h"
+#include "Charmonizer/Core/Scratch.h"
+#include "Charmonizer/Core/Util.h"
+
+#ifdef CHAZ_HAS_POSIX_API
+  #include <sys/time.h>
+#endif
+
+/* Longest event name recorded; command lines get cut off beyond this. */
+#define CHAZ_TRACE_MAX_NAME 200
+
+/* Number of events listed in the summary. */
+#define CHAZ_TRACE_TOP_EVENTS 20
+
+typedef struct chaz_TraceEvent {
+    const char *category;
+    const char *module;
+    const char *name;
+    int         pid;
+    int         status;
+    double      start; /* microseconds since chaz_Trace_init */
+    double      dur;
+} chaz_TraceEvent;
+
+/* Events go to a record file opened in append mode, one line each, so that
+ * child processes -- which inherit the stream -- can add theirs without
+ * clobbering anybody else's.
+ */
+static struct {
+    FILE   *events;
+    char   *events_path;
+    char   *path;
+    int     owner_pid;
+    double  epoch;
+    char   *module;
+    double  module_start;
+} chaz_Trace = { NULL, NULL, NULL, 0, 0.0, NULL, 0.0 };
+
+/* Copy at most [max] characters of [text] into [buf], replacing characters
+ * which would break up a record with spaces.
+ */
+static void
+chaz_Trace_copy_field(char *buf, const char *text, size_t max);
+
+/* Read the record file back.  Returns the number of events; [buf] must be
+ * freed along with the array.
+ */
+static int
+chaz_Trace_read_events(chaz_TraceEvent **events_ptr, char **buf_ptr);
+
+static void
+chaz_Trace_write_json(const char *path, chaz_TraceEvent *events,
+                      int num_events);
+
+static void
+chaz_Trace_write_summary(const char *path, chaz_TraceEvent *events,
+                         int num_events);
+
+/* Write [text] as a JSON string.
+ */
+static void
+chaz_Trace_write_json_string(FILE *file, const char *text);
+
+/* Return true for the categories which make up an individual probe.
+ */
+static int
+chaz_Trace_is_probe(const chaz_TraceEvent *event);
+
+/* qsort comparison, longest duration first.
+ */
+static int
+chaz_Trace_compare_dur(const void *va, const void *vb);
+
+void
+chaz_Trace_init(const char *path) {
+    if (path == NULL || path[0] == '\0' || chaz_Trace.events != NULL) {
+        return;
+    }
+    chaz_Trace.events_path = chaz_Scratch_path("_charm_trace.events");
+    chaz_Util_remove_and_verify(chaz_Trace.events_path);
+    chaz_Trace.events = fopen(chaz_Trace.events_path, "a");
+    if (chaz_Trace.events == NULL) {
+        chaz_Util_die("Can't open '%s': %s", chaz_Trace.events_path,
+                      strerror(errno));
+    }
+    chaz_Trace.path      = chaz_Util_strdup(path);
+    chaz_Trace.owner_pid = chaz_OS_pid();
+    chaz_Trace.epoch     = chaz_Trace_now();
+}
+
+void
+chaz_Trace_clean_up(void) {
+    chaz_TraceEvent *events;
+    char            *buf;
+    char            *summary_path;
+    int              num_events;
+
+    if (chaz_Trace.events == NULL
+        || chaz_Trace.owner_pid != chaz_OS_pid()
+       ) {
+        return;
+    }
+    fclose(chaz_Trace.events);
+    chaz_Trace.events = NULL;
+
+    num_events = chaz_Trace_read_events(&events, &buf);
+    chaz_Trace_write_json(chaz_Trace.path, events, num_events);
+    summary_path = chaz_Util_join("", chaz_Trace.path, ".txt", NULL);
+    chaz_Trace_write_summary(summary_path, events, num_events);
+    if (chaz_Util_verbosity) {
+        printf("Wrote trace of %d events to %s\n", num_events,
+               chaz_Trace.path);
+    }
+
+    chaz_Util_remove_and_verify(chaz_Trace.events_path);
+    free(summary_path);
+    free(events);
+    free(buf);
+    free(chaz_Trace.events_path);
+    free(chaz_Trace.path);
+    free(chaz_Trace.module);
+    chaz_Trace.events_path = NULL;
+    chaz_Trace.path        = NULL;
+    chaz_Trace.module      = NULL;
+}
+
+int
+chaz_Trace_enabled(void) {
+    return chaz_Trace.events != NULL;
+}
+
+double
+chaz_Trace_now(void) {
+#if defined(CHAZ_HAS_POSIX_API) && defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+        return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+    }
+#endif
+#ifdef CHAZ_HAS_POSIX_API
+    {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+    }
+#else
+    /* Elapsed time on Windows, which is where this matters. */
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+void
+chaz_Trace_event(const char *category, const char *name, double start,
+                 int status) {
+    char   record[CHAZ_TRACE_MAX_NAME * 2 + 100];
+    char   module[CHAZ_TRACE_MAX_NAME + 1];
+    char   clean_name[CHAZ_TRACE_MAX_NAME + 1];
+    double end;
+
+    if (chaz_Trace.events == NULL) {
+        return;
+    }
+    end = chaz_Trace_now();
+    chaz_Trace_copy_field(module, chaz_Trace.module ? chaz_Trace.module : "",
+                          CHAZ_TRACE_MAX_NAME);
+    chaz_Trace_copy_field(clean_name, name ? name : "", CHAZ_TRACE_MAX_NAME);
+    sprintf(record, "%s\t%d\t%.0f\t%.0f\t%d\t%s\t%s\n", category,
+            chaz_OS_pid(), (start - chaz_Trace.epoch) * 1000000.0,
+            (end - start) * 1000000.0, status, module, clean_name);
+
+    /* Flush right away so that each record is a single append. */
+    fputs(record, chaz_Trace.events);
+    fflush(chaz_Trace.events);
+}
+
+void
+chaz_Trace_start_module(const char *module_name) {
+    if (chaz_Trace.events == NULL) {
+        return;
+    }
+    free(chaz_Trace.module);
+    chaz_Trace.module       = chaz_Util_strdup(module_name);
+    chaz_Trace.module_start = chaz_Trace_now();
+}
+
+void
+chaz_Trace_end_module(void) {
+    if (chaz_Trace.module == NULL) {
+        return;
+    }
+    chaz_Trace_event(CHAZ_TRACE_MODULE, chaz_Trace.module,
+                     chaz_Trace.module_start, -1);
+    free(chaz_Trace.module);
+    chaz_Trace.module = NULL;
+}
+
+static void
+chaz_Trace_copy_field(char *buf, const char *text, size_t max) {
+    size_t i;
+    for (i = 0; i < max && text[i] != '\0'; i++) {
+        char c = text[i];
+        buf[i] = c == '\t' || c == '\n' || c == '\r' ? ' ' : c;
+    }
+    buf[i] = '\0';
+}
+
+static int
+chaz_Trace_read_events(chaz_TraceEvent **events_ptr, char **buf_ptr) {
+    size_t           len;
+    char            *buf = chaz_Util_slurp_file(chaz_Trace.events_path, &len);
+    char            *line = buf;
+    int              num_events = 0;
+    int              cap = 0;
+    chaz_TraceEvent *events = NULL;
+
+    while (line < buf + len) {
+        char *fields[7];
+        char *end = strchr(line, '\n');
+        int   num_fields = 1;
+        char *ptr;
+
+        if (end == NULL) { break; }
+        *end = '\0';
+        fields[0] = line;
+        for (ptr = line; *ptr != '\0' && num_fields < 7; ptr++) {
+            if (*ptr == '\t') {
+                *ptr = '\0';
+                fields[num_fields++] = ptr + 1;
+            }
+        }
+        line = end + 1;
+        if (num_fields != 7) { continue; }
+
+        if (num_events == cap) {
+            cap = cap ? cap * 2 : 256;
+            events = (chaz_TraceEvent*)realloc(events,
+                                               cap * sizeof(chaz_TraceEvent));
+        }
+        events[num_events].category = fields[0];
+        events[num_events].pid      = (int)strtol(fields[1], NULL, 10);
+        events[num_events].start    = strtod(fields[2], NULL);
+        events[num_events].dur      = strtod(fields[3], NULL);
+        events[num_events].status   = (int)strtol(fields[4], NULL, 10);
+        events[num_events].module   = fields[5];
+        events[num_events].name     = fields[6];
+        num_events++;
+    }
+
+    *events_ptr = events;
+    *buf_ptr    = buf;
+    return num_events;
+}
+
+static void
+chaz_Trace_write_json(const char *path, chaz_TraceEvent *events,
+                      int num_events) {
+    FILE *file = fopen(path, "w");
+    int   i;
+
+    if (file == NULL) {
+        chaz_Util_warn("Can't write trace to '%s': %s", path,
+                       strerror(errno));
+        return;
+    }
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (i = 0; i < num_events; i++) {
+        chaz_TraceEvent *event = &events[i];
+        fprintf(file, "{\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.0f,"
+                "\"dur\":%.0f,\"cat\":", chaz_Trace.owner_pid, event->pid,
+                event->start, event->dur);
+        chaz_Trace_write_json_string(file, event->category);
+        fprintf(file, ",\"name\":");
+        chaz_Trace_write_json_string(file, event->name);
+        fprintf(file, ",\"args\":{\"module\":");
+        chaz_Trace_write_json_string(file, event->module);
+        fprintf(file, ",\"status\":%d}}%s\n", event->status,
+                i + 1 < num_events ? "," : "");
+    }
+    fprintf(file, "]}\n");
+    if (fclose(file) != 0) {
+        chaz_Util_warn("Error when writing '%s': %s", path, strerror(errno));
+    }
+}
+
+static void
+chaz_Trace_write_json_string(FILE *file, const char *text) {
+    const unsigned char *ptr;
+    fputc('"', file);
+    for (ptr = (const unsigned char*)text; *ptr != '\0'; ptr++) {
+        if (*ptr == '"' || *ptr == '\\') {
+            fputc('\\', file);
+            fputc(*ptr, file);
+        }
+        else if (*ptr < 0x20) {
+            fprintf(file, "\\u%04x", (unsigned)*ptr);
+        }
+        else {
+            fputc(*ptr, file);
+        }
+    }
+    fputc('"', file);
+}
+
+static void
+chaz_Trace_write_summary(const char *path, chaz_TraceEvent *events,
+                         int num_events) {
+    static const char *const categories[] = {
+        CHAZ_TRACE_COMPILE, CHAZ_TRACE_LINK, CHAZ_TRACE_RUN, CHAZ_TRACE_FS,
+        CHAZ_TRACE_EXEC, CHAZ_TRACE_MODULE, NULL
+    };
+    FILE   *file = fopen(path, "w");
+    double  first = 0.0;
+    double  last  = 0.0;
+    int     num_probes = 0;
+    int     i, j;
+
+    if (file == NULL) {
+        chaz_Util_warn("Can't write trace summary to '%s': %s", path,
+                       strerror(errno));
+        return;
+    }
+
+    for (i = 0; i < num_events; i++) {
+        if (i == 0 || events[i].start < first) {
+            first = events[i].start;
+        }
+        if (events[i].start + events[i].dur > last) {
+            last = events[i].start + events[i].dur;
+        }
+    }
+    fprintf(file, "%d events over %.3f seconds\n\n", num_events,
+            (last - first) / 1000000.0);
+
+    /* Totals by category. */
+    fprintf(file, "Time by category (events overlap when probes run in "
+            "parallel, and each\nexec lies within the compile, link or run "
+            "that started it):\n\n");
+    fprintf(file, "    %-10s %10s %8s\n", "category", "seconds", "events");
+    for (i = 0; categories[i] != NULL; i++) {
+        double total = 0.0;
+        int    count = 0;
+        for (j = 0; j < num_events; j++) {
+            if (strcmp(events[j].category, categories[i]) == 0) {
+                total += events[j].dur;
+                count++;
+            }
+        }
+        fprintf(file, "    %-10s %10.3f %8d\n", categories[i],
+                total / 1000000.0, count);
+    }
+
+    /* The slowest individual compiles, links and runs. */
+    qsort(events, (size_t)num_events, sizeof(chaz_TraceEvent),
+          chaz_Trace_compare_dur);
+    fprintf(file, "\nSlowest probes:\n\n");
+    fprintf(file, "    %8s  %-8s %6s  %-18s %s\n", "seconds", "category",
+            "status", "module", "name");
+    for (i = 0; i < num_events && num_probes < CHAZ_TRACE_TOP_EVENTS; i++) {
+        chaz_TraceEvent *event = &events[i];
+        if (!chaz_Trace_is_probe(event)) { continue; }
+        fprintf(file, "    %8.3f  %-8s %6d  %-18s %s\n",
+                event->dur / 1000000.0, event->category, event->status,
+                event->module[0] ? event->module : "-", event->name);
+        num_probes++;
+    }
+
+    if (fclose(file) != 0) {
+        chaz_Util_warn("Error when writing '%s': %s", path, strerror(errno));
+    }
+}
+
+static int
+chaz_Trace_is_probe(const chaz_TraceEvent *event) {
+    return strcmp(event->category, CHAZ_TRACE_COMPILE) == 0
+           || strcmp(event->category, CHAZ_TRACE_LINK) == 0
+           || strcmp(event->category, CHAZ_TRACE_RUN) == 0;
+}
+
+static int
+chaz_Trace_compare_dur(const void *va, const void *vb) {
+    const chaz_TraceEvent *a = (const chaz_TraceEvent*)va;
+    const chaz_TraceEvent *b = (const chaz_TraceEvent*)vb;
+    if (a->dur > b->dur) { return -1; }
+    if (a->dur < b->dur) { return 1; }
+    return 0;
+}
+
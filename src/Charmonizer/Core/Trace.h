@@ -0,0 +1,95 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Charmonizer/Core/Trace.h -- time the steps of a configuration run.
+ *
+ * When tracing is enabled, every compile, link, probe run, external command
+ * and file removal is recorded along with its start time, its duration, its
+ * exit status and the module which was running at the time.  At the end of
+ * the run the events are written out in Chrome's trace event format, which
+ * chrome://tracing and Perfetto can display, and summarized in a plain text
+ * report next to it.
+ *
+ * Events may be recorded by child processes; they all end up in the same
+ * report.
+ */
+
+#ifndef H_CHAZ_TRACE
+#define H_CHAZ_TRACE
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "Charmonizer/Core/Defines.h"
+
+/* Event categories.
+ */
+#define CHAZ_TRACE_COMPILE "compile"
+#define CHAZ_TRACE_LINK    "link"
+#define CHAZ_TRACE_RUN     "run"
+#define CHAZ_TRACE_EXEC    "exec"
+#define CHAZ_TRACE_FS      "fs"
+#define CHAZ_TRACE_MODULE  "module"
+
+/* Start tracing.  The trace is written to [path] and the summary to
+ * [path].txt by chaz_Trace_clean_up.  Does nothing if [path] is NULL or
+ * empty.  Must be called after chaz_Scratch_init.
+ */
+void
+chaz_Trace_init(const char *path);
+
+/* Write the reports and stop tracing.  Only the process which called
+ * chaz_Trace_init does anything.
+ */
+void
+chaz_Trace_clean_up(void);
+
+/* Return true if events are being recorded.
+ */
+int
+chaz_Trace_enabled(void);
+
+/* Return the time in seconds from a monotonic clock where one is available.
+ * Only differences between return values are meaningful.
+ */
+double
+chaz_Trace_now(void);
+
+/* Record an event of [category] which started at [start], as returned by
+ * chaz_Trace_now, and ends now.  [name] describes the event -- a command
+ * line, a file name -- and [status] is its exit status, or -1 if there is
+ * none.
+ */
+void
+chaz_Trace_event(const char *category, const char *name, double start,
+                 int status);
+
+/* Make [module_name] the owner of the events which follow, until
+ * chaz_Trace_end_module records the module itself as an event.
+ */
+void
+chaz_Trace_start_module(const char *module_name);
+
+void
+chaz_Trace_end_module(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H_CHAZ_TRACE */
+
@@ -0,0 +1,154 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include "Charmonizer/Core/Types.h"
+#include "Charmonizer/Core/Memo.h"
+#include "Charmonizer/Core/ProbeProgram.h"
+#include "Charmonizer/Core/Util.h"
+
+/* Look up a size or alignment found earlier.  Return true if there is one.
+ */
+static int
+chaz_Types_recall(int kind, const char *type, const char *includes,
+                  int *value);
+
+/* Add a query for the size or alignment of [type] to [prog].
+ */
+static int
+chaz_Types_add_query(chaz_ProbeProg *prog, int kind, const char *type,
+                     const char *includes);
+
+static char*
+chaz_Types_key(const char *type, const char *includes);
+
+int
+chaz_Types_sizeof(const char *type, const char *includes) {
+    const char *types[2];
+    int size;
+    types[0] = type;
+    types[1] = NULL;
+    chaz_Types_check_many(types, includes, &size, NULL);
+    return size;
+}
+
+int
+chaz_Types_alignof(const char *type, const char *includes) {
+    const char *types[2];
+    int size;
+    int alignment;
+    types[0] = type;
+    types[1] = NULL;
+    chaz_Types_check_many(types, includes, &size, &alignment);
+    return alignment;
+}
+
+int
+chaz_Types_check_many(const char **types, const char *includes,
+                      int *sizes, int *alignments) {
+    chaz_ProbeProg *prog = NULL;
+    int *size_queries;
+    int *align_queries;
+    int  num_types;
+    int  all_exist = true;
+    int  i;
+
+    for (num_types = 0; types[num_types] != NULL; num_types++) {}
+    size_queries  = (int*)malloc((num_types + 1) * sizeof(int));
+    align_queries = (int*)malloc((num_types + 1) * sizeof(int));
+
+    /* Everything which isn't known yet goes into a single program. */
+    for (i = 0; i < num_types; i++) {
+        size_queries[i]  = -1;
+        align_queries[i] = -1;
+        if (!chaz_Types_recall(CHAZ_MEMO_SIZEOF, types[i], includes,
+                               &sizes[i])) {
+            if (!prog) { prog = chaz_ProbeProg_new(); }
+            size_queries[i] = chaz_Types_add_query(prog, CHAZ_MEMO_SIZEOF,
+                                                   types[i], includes);
+        }
+        if (alignments
+            && !chaz_Types_recall(CHAZ_MEMO_ALIGNOF, types[i], includes,
+                                  &alignments[i])
+           ) {
+            if (!prog) { prog = chaz_ProbeProg_new(); }
+            align_queries[i] = chaz_Types_add_query(prog, CHAZ_MEMO_ALIGNOF,
+                                                    types[i], includes);
+        }
+    }
+
+    if (prog) {
+        chaz_ProbeProg_run(prog);
+        for (i = 0; i < num_types; i++) {
+            char *key = chaz_Types_key(types[i], includes);
+            if (size_queries[i] != -1) {
+                sizes[i] = (int)chaz_ProbeProg_int_value(prog,
+                                                         size_queries[i], -1);
+                chaz_Memo_store(CHAZ_MEMO_SIZEOF, key, sizes[i], NULL, 0);
+            }
+            if (align_queries[i] != -1) {
+                alignments[i]
+                    = (int)chaz_ProbeProg_int_value(prog, align_queries[i],
+                                                    -1);
+                chaz_Memo_store(CHAZ_MEMO_ALIGNOF, key, alignments[i], NULL,
+                                0);
+            }
+            free(key);
+        }
+        chaz_ProbeProg_destroy(prog);
+    }
+
+    for (i = 0; i < num_types; i++) {
+        if (sizes[i] == -1) { all_exist = false; }
+    }
+    free(size_queries);
+    free(align_queries);
+    return all_exist;
+}
+
+static int
+chaz_Types_recall(int kind, const char *type, const char *includes,
+                  int *value) {
+    char *key   = chaz_Types_key(type, includes);
+    int   found = chaz_Memo_fetch(kind, key, value, NULL, NULL);
+    free(key);
+    return found;
+}
+
+static int
+chaz_Types_add_query(chaz_ProbeProg *prog, int kind, const char *type,
+                     const char *includes) {
+    char *expr;
+    int   query;
+
+    if (kind == CHAZ_MEMO_SIZEOF) {
+        expr = chaz_Util_join("", "sizeof(", type, ")", NULL);
+    }
+    else {
+        /* The padding in front of a member which follows a char. */
+        expr = chaz_Util_join("", "sizeof(struct { char chaz_c; ", type,
+                              " chaz_x; }) - sizeof(", type, ")", NULL);
+    }
+    query = chaz_ProbeProg_add_const(prog, includes, expr);
+    free(expr);
+    return query;
+}
+
+static char*
+chaz_Types_key(const char *type, const char *includes) {
+    return chaz_Util_join("\t", type, includes ? includes : "", NULL);
+}
+
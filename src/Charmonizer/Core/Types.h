@@ -0,0 +1,65 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Charmonizer/Core/Types.h -- find the size and alignment of types.
+ *
+ * Sizes and alignments are integer constant expressions, so they are read
+ * out of an object file which the compiler spells them out in, with no
+ * link step and no process.  All types of a request share one object file.
+ * If it doesn't compile because one of the types doesn't exist, the batch
+ * is split until the culprits are found.  Should a compiler's object files
+ * keep the values from being read, they are found by compiling a series of
+ * assertions or by running a program, as chaz_ProbeProg does.
+ *
+ * Every answer is remembered for the rest of the run.
+ */
+
+#ifndef H_CHAZ_TYPES
+#define H_CHAZ_TYPES
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "Charmonizer/Core/Defines.h"
+
+/* Return sizeof([type]), or -1 if there's no such type.  [includes] (which
+ * may be NULL) holds the #include lines which define it.
+ */
+int
+chaz_Types_sizeof(const char *type, const char *includes);
+
+/* Return the alignment of [type], or -1 if there's no such type.  [type]
+ * must be usable as in "type member;".
+ */
+int
+chaz_Types_alignof(const char *type, const char *includes);
+
+/* Find the sizes of all types in a null-terminated array and store them in
+ * [sizes].  If [alignments] is not NULL, also find their alignments.  As
+ * above, -1 stands for a type which doesn't exist.  Return true if every
+ * type exists.
+ */
+int
+chaz_Types_check_many(const char **types, const char *includes,
+                      int *sizes, int *alignments);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* H_CHAZ_TYPES */
+
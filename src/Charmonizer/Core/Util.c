@@ -20,12 +20,14 @@
 #include <string.h>
 #include "Charmonizer/Core/Util.h"
 #include "Charmonizer/Core/OperatingSystem.h"
+#include "Charmonizer/Core/Trace.h"
 
 /* Global verbosity setting. */
 int chaz_Util_verbosity = 1;
 
 void
 chaz_Util_write_file(const char *filename, const char *content) {
+    double start = chaz_Trace_now();
     FILE *fh = fopen(filename, "w+");
     size_t content_len = strlen(content);
     if (fh == NULL) {
@@ -36,6 +38,87 @@ chaz_Util_write_file(const char *filename, const char *content) {
         chaz_Util_die("Error when closing '%s': %s", filename,
                       strerror(errno));
     }
+    chaz_Trace_event(CHAZ_TRACE_FS, filename, start, 0);
+}
+
+/* Return the name of the temporary file used by chaz_Util_open_output.
+ */
+static char*
+chaz_Util_output_temp_path(const char *path);
+
+/* Return true if the files at [path_a] and [path_b] both exist and have
+ * the same content.
+ */
+static int
+chaz_Util_same_content(const char *path_a, const char *path_b);
+
+static char*
+chaz_Util_output_temp_path(const char *path) {
+    return chaz_Util_join("", path, ".tmp", NULL);
+}
+
+FILE*
+chaz_Util_open_output(const char *path) {
+    char *temp_path = chaz_Util_output_temp_path(path);
+    FILE *file      = fopen(temp_path, "w");
+    if (file == NULL) {
+        chaz_Util_die("Can't open '%s': %s", temp_path, strerror(errno));
+    }
+    free(temp_path);
+    return file;
+}
+
+int
+chaz_Util_close_output(FILE *file, const char *path) {
+    char *temp_path = chaz_Util_output_temp_path(path);
+    int   replaced  = true;
+
+    if (fclose(file)) {
+        chaz_Util_die("Couldn't close '%s': %s", temp_path, strerror(errno));
+    }
+    if (chaz_Util_same_content(temp_path, path)) {
+        chaz_Util_remove_and_verify(temp_path);
+        replaced = false;
+        if (chaz_Util_verbosity) {
+            printf("%s is unchanged\n", path);
+        }
+    }
+    else if (rename(temp_path, path) != 0) {
+        /* Windows won't rename over an existing file. */
+        if (!chaz_Util_remove_and_verify(path)
+            || rename(temp_path, path) != 0
+           ) {
+            chaz_Util_die("Can't rename '%s' to '%s': %s", temp_path, path,
+                          strerror(errno));
+        }
+    }
+
+    free(temp_path);
+    return replaced;
+}
+
+static int
+chaz_Util_same_content(const char *path_a, const char *path_b) {
+    FILE *file_a = fopen(path_a, "rb");
+    FILE *file_b = fopen(path_b, "rb");
+    int   same   = file_a != NULL && file_b != NULL;
+
+    while (same) {
+        char   buf_a[4096];
+        char   buf_b[4096];
+        size_t len_a = fread(buf_a, 1, sizeof(buf_a), file_a);
+        size_t len_b = fread(buf_b, 1, sizeof(buf_b), file_b);
+        if (len_a != len_b || memcmp(buf_a, buf_b, len_a) != 0) {
+            same = false;
+        }
+        else if (len_a == 0) {
+            break;
+        }
+    }
+
+    if (file_a != NULL) { fclose(file_a); }
+    if (file_b != NULL) { fclose(file_b); }
+    return same;
 }
 
 char*
@@ -185,14 +268,18 @@ chaz_Util_remove_and_verify(const char *file_path) {
     /* Attempt to delete the file.  If it's gone after the attempt, return
      * success, whether or not it was there to begin with.
      * (ENOENT is POSIX not C89, but let's go with it for now.) */
-    int result = chaz_OS_remove(file_path);
-    if (result || errno == ENOENT) {
+    double start  = chaz_Trace_now();
+    int    result = chaz_OS_remove(file_path);
+    int    error  = result ? 0 : errno;
+    chaz_Trace_event(CHAZ_TRACE_FS, file_path, start,
+                     error == ENOENT ? 0 : error);
+    if (result || error == ENOENT) {
         return 1;
     }
 
     /* Issue a warning and return failure. */
     chaz_Util_warn("Failed to remove '%s': %s at %s line %d",
-                   file_path, strerror(errno), __FILE__, __LINE__);
+                   file_path, strerror(error), __FILE__, __LINE__);
     return 0;
 }
 
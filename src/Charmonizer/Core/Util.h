@@ -36,6 +36,20 @@ extern int chaz_Util_verbosity;
 void
 chaz_Util_write_file(const char *filename, const char *content);
 
+/* Open a temporary file next to [path] for writing its new content to.
+ * Util_die() if an error occurs.
+ */
+FILE*
+chaz_Util_open_output(const char *path);
+
+/* Close a file opened by chaz_Util_open_output and move it into place at
+ * [path] -- unless [path] already holds the same content, in which case it
+ * is left alone so that its modification time doesn't trigger rebuilds.
+ * Return true if [path] was replaced.
+ */
+int
+chaz_Util_close_output(FILE *file, const char *path);
+
 /* Read an entire file into memory.
  */
 char*
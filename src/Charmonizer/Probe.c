@@ -18,6 +18,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
 #include "Charmonizer/Probe.h"
 #include "Charmonizer/Core/HeaderChecker.h"
 #include "Charmonizer/Core/ConfWriter.h"
@@ -26,9 +27,86 @@
 #include "Charmonizer/Core/ConfWriterPython.h"
 #include "Charmonizer/Core/ConfWriterRuby.h"
 #include "Charmonizer/Core/Util.h"
+#include "Charmonizer/Core/Cache.h"
 #include "Charmonizer/Core/Compiler.h"
 #include "Charmonizer/Core/Make.h"
+#include "Charmonizer/Core/Memo.h"
 #include "Charmonizer/Core/OperatingSystem.h"
+#include "Charmonizer/Core/OpLog.h"
+#include "Charmonizer/Core/ProbeQueue.h"
+#include "Charmonizer/Core/Profile.h"
+#include "Charmonizer/Core/Scratch.h"
+#include "Charmonizer/Core/Trace.h"
+
+#define CHAZ_PROBE_WAITING  0
+#define CHAZ_PROBE_RUNNING  1
+#define CHAZ_PROBE_DONE     2
+#define CHAZ_PROBE_FLUSHED  3
+
+/* How many of the modules covered by a platform profile still run. */
+#define CHAZ_PROBE_SPOT_CHECKS  2
+
+typedef struct chaz_ProbeModule {
+    char                *name;
+    chaz_Probe_module_t  run;
+    int                 *deps;
+    int                  num_deps;
+    int                  state;
+    int                  pid;
+    int                  worker;
+    int                  profiled;
+    char                *log_path;
+} chaz_ProbeModule;
+
+/* Registered probe modules, in the order they write to the config files. */
+static struct {
+    chaz_ProbeModule *modules;
+    int               num_modules;
+    int               cap;
+} chaz_Probe = { NULL, 0, 0 };
+
+/* Return true if every module [module] depends on has finished.
+ */
+static int
+chaz_Probe_module_ready(chaz_ProbeModule *module);
+
+/* Start [module] in a child process, or run it here if that's impossible.
+ * Return true if a child was started.
+ */
+static int
+chaz_Probe_start_module(chaz_ProbeModule *module, int can_inline);
+
+/* Body of the child process for a module.
+ */
+static int
+chaz_Probe_module_child(void *arg);
+
+/* Run [module] here, recording what it does in its log.
+ */
+static void
+chaz_Probe_run_logged(chaz_ProbeModule *module);
+
+/* Replay what a finished module wrote to the config files and dispose of
+ * its log.
+ */
+static void
+chaz_Probe_flush_module(chaz_ProbeModule *module);
+
+/* Take results from the platform profile where possible.  Return false,
+ * having written nothing, if a spot check disagrees with the profile.
+ */
+static int
+chaz_Probe_run_profiled(void);
+
+/* Pass an operation read back from a module's log to whoever handles it.
+ */
+static void
+chaz_Probe_replay_op(char op, const char **fields, int num_fields);
+
+/* Forget about all registered modules.
+ */
+static void
+chaz_Probe_clear_modules(void);
 
 int
 chaz_Probe_parse_cli_args(int argc, const char *argv[],
@@ -38,6 +116,10 @@ chaz_Probe_parse_cli_args(int argc, const char *argv[],
 
     /* Zero out args struct. */
     memset(args, 0, sizeof(struct chaz_CLIArgs));
+    args->probe_timeout = -1;
+    args->probe_cpu     = -1;
+    args->probe_memory  = -1;
+    args->probe_output  = -1;
 
     /* Parse most args. */
     for (i = 1; i < argc; i++) {
@@ -69,6 +151,83 @@ chaz_Probe_parse_cli_args(int argc, const char *argv[],
         else if (strcmp(arg, "--enable-coverage") == 0) {
             args->code_coverage = 1;
         }
+        else if (memcmp(arg, "--jobs=", 7) == 0) {
+            args->jobs = (int)strtol(arg + 7, NULL, 10);
+            if (args->jobs < 1) {
+                fprintf(stderr, "Invalid value for --jobs: '%s'\n", arg + 7);
+                return false;
+            }
+        }
+        else if (memcmp(arg, "--cache-dir=", 12) == 0) {
+            if (strlen(arg + 12) > CHAZ_PROBE_MAX_PATH_LEN) {
+                fprintf(stderr, "Exceeded max length for cache dir");
+                exit(1);
+            }
+            strcpy(args->cache_dir, arg + 12);
+        }
+        else if (memcmp(arg, "--run-wrapper=", 14) == 0) {
+            if (strlen(arg + 14) > CHAZ_PROBE_MAX_WRAPPER_LEN) {
+                fprintf(stderr, "Exceeded max length for run wrapper");
+                exit(1);
+            }
+            strcpy(args->run_wrapper, arg + 14);
+        }
+        else if (strcmp(arg, "--no-run") == 0) {
+            args->no_run = 1;
+        }
+        else if (memcmp(arg, "--trace=", 8) == 0) {
+            if (strlen(arg + 8) > CHAZ_PROBE_MAX_PATH_LEN) {
+                fprintf(stderr, "Exceeded max length for trace path");
+                exit(1);
+            }
+            strcpy(args->trace_path, arg + 8);
+        }
+        else if (memcmp(arg, "--profile=", 10) == 0) {
+            if (strlen(arg + 10) > CHAZ_PROBE_MAX_PATH_LEN) {
+                fprintf(stderr, "Exceeded max length for profile path");
+                exit(1);
+            }
+            strcpy(args->profile_path, arg + 10);
+        }
+        else if (memcmp(arg, "--write-profile=", 16) == 0) {
+            if (strlen(arg + 16) > CHAZ_PROBE_MAX_PATH_LEN) {
+                fprintf(stderr, "Exceeded max length for profile path");
+                exit(1);
+            }
+            strcpy(args->write_profile_path, arg + 16);
+        }
+        else if (memcmp(arg, "--probe-timeout=", 16) == 0) {
+            args->probe_timeout = (int)strtol(arg + 16, NULL, 10);
+            if (args->probe_timeout < 0) {
+                fprintf(stderr, "Invalid value for --probe-timeout: '%s'\n",
+                        arg + 16);
+                return false;
+            }
+        }
+        else if (memcmp(arg, "--probe-cpu=", 12) == 0) {
+            args->probe_cpu = strtol(arg + 12, NULL, 10);
+            if (args->probe_cpu < 0) {
+                fprintf(stderr, "Invalid value for --probe-cpu: '%s'\n",
+                        arg + 12);
+                return false;
+            }
+        }
+        else if (memcmp(arg, "--probe-memory=", 15) == 0) {
+            args->probe_memory = strtol(arg + 15, NULL, 10);
+            if (args->probe_memory < 0) {
+                fprintf(stderr, "Invalid value for --probe-memory: '%s'\n",
+                        arg + 15);
+                return false;
+            }
+        }
+        else if (memcmp(arg, "--probe-output=", 15) == 0) {
+            args->probe_output = strtol(arg + 15, NULL, 10);
+            if (args->probe_output < 0) {
+                fprintf(stderr, "Invalid value for --probe-output: '%s'\n",
+                        arg + 15);
+                return false;
+            }
+        }
         else if (memcmp(arg, "--cc=", 5) == 0) {
             size_t len = strlen(arg);
             size_t l   = 5;
@@ -117,7 +276,71 @@ chaz_Probe_parse_cli_args(int argc, const char *argv[],
         }
     }
 
+    /* Process CHARM_JOBS environment variable. */
+    if (!args->jobs) {
+        const char *jobs_env = getenv("CHARM_JOBS");
+        if (jobs_env && strlen(jobs_env)) {
+            args->jobs = (int)strtol(jobs_env, NULL, 10);
+        }
+    }
+
+    /* Process CHARM_CACHE_DIR environment variable. */
+    if (!args->cache_dir[0]) {
+        const char *cache_dir_env = getenv("CHARM_CACHE_DIR");
+        if (cache_dir_env && strlen(cache_dir_env)) {
+            if (strlen(cache_dir_env) > CHAZ_PROBE_MAX_PATH_LEN) {
+                fprintf(stderr, "Exceeded max length for cache dir");
+                exit(1);
+            }
+            strcpy(args->cache_dir, cache_dir_env);
+        }
+    }
+
+    /* Process CHARM_RUN_WRAPPER environment variable. */
+    if (!args->run_wrapper[0]) {
+        const char *wrapper_env = getenv("CHARM_RUN_WRAPPER");
+        if (wrapper_env && strlen(wrapper_env)) {
+            if (strlen(wrapper_env) > CHAZ_PROBE_MAX_WRAPPER_LEN) {
+                fprintf(stderr, "Exceeded max length for run wrapper");
+                exit(1);
+            }
+            strcpy(args->run_wrapper, wrapper_env);
+        }
+    }
+
+    /* Process CHARM_TRACE environment variable. */
+    if (!args->trace_path[0]) {
+        const char *trace_env = getenv("CHARM_TRACE");
+        if (trace_env && strlen(trace_env)) {
+            if (strlen(trace_env) > CHAZ_PROBE_MAX_PATH_LEN) {
+                fprintf(stderr, "Exceeded max length for trace path");
+                exit(1);
+            }
+            strcpy(args->trace_path, trace_env);
+        }
+    }
+
+    /* Process CHARM_PROFILE environment variable. */
+    if (!args->profile_path[0] && !args->write_profile_path[0]) {
+        const char *profile_env = getenv("CHARM_PROFILE");
+        if (profile_env && strlen(profile_env)) {
+            if (strlen(profile_env) > CHAZ_PROBE_MAX_PATH_LEN) {
+                fprintf(stderr, "Exceeded max length for profile path");
+                exit(1);
+            }
+            strcpy(args->profile_path, profile_env);
+        }
+    }
+
     /* Validate. */
+    if (args->no_run && args->run_wrapper[0]) {
+        fprintf(stderr, "--no-run and --run-wrapper can't be combined\n");
+        return false;
+    }
+    if (args->profile_path[0] && args->write_profile_path[0]) {
+        fprintf(stderr, "--profile and --write-profile can't be combined\n");
+        return false;
+    }
     if (!strlen(args->cc) || !output_enabled) {
         return false;
     }
@@ -129,7 +352,13 @@ void
 chaz_Probe_die_usage(void) {
     fprintf(stderr,
             "Usage: ./charmonize --cc=CC_COMMAND [--enable-c] "
-            "[--enable-perl] [--enable-python] [--enable-ruby] -- CFLAGS\n");
+            "[--enable-perl] [--enable-python] [--enable-ruby] "
+            "[--jobs=N] [--cache-dir=DIR] "
+            "[--run-wrapper=COMMAND | --no-run] [--trace=PATH] "
+            "[--probe-timeout=SECONDS] [--probe-cpu=SECONDS] "
+            "[--probe-memory=MB] [--probe-output=BYTES] "
+            "[--profile=PATH | --write-profile=PATH] "
+            "-- CFLAGS\n");
     exit(1);
 }
 
@@ -145,12 +374,27 @@ chaz_Probe_init(struct chaz_CLIArgs *args) {
         }
     }
 
+    /* Size the pool of concurrent probe jobs. */
+    if (args->jobs > 0) {
+        chaz_ProbeQueue_set_max_jobs(args->jobs);
+    }
+
     /* Dispatch other initializers. */
     chaz_OS_init();
+    chaz_OS_set_run_wrapper(args->run_wrapper);
+    chaz_OS_set_run_limits(args->probe_timeout, args->probe_cpu,
+                           args->probe_memory, args->probe_output);
+    chaz_Scratch_init();
+    chaz_Trace_init(args->trace_path);
+    chaz_Cache_init(args->cache_dir);
+    if (args->no_run) {
+        chaz_CC_set_can_run(false);
+    }
     chaz_CC_init(args->cc, args->cflags);
     chaz_ConfWriter_init();
     chaz_HeadCheck_init();
     chaz_Make_init();
+    chaz_Profile_init(args->profile_path, args->write_profile_path);
 
     /* Enable output. */
     if (args->charmony_h) {
@@ -177,14 +421,322 @@ chaz_Probe_init(struct chaz_CLIArgs *args) {
     if (chaz_Util_verbosity) { printf("Initialization complete.\n"); }
 }
 
+void
+chaz_Probe_add_module(const char *name, chaz_Probe_module_t run,
+                      const char *deps) {
+    chaz_ProbeModule *module;
+    const char       *ptr = deps ? deps : "";
+
+    if (chaz_Probe.num_modules == chaz_Probe.cap) {
+        chaz_Probe.cap = chaz_Probe.cap ? chaz_Probe.cap * 2 : 16;
+        chaz_Probe.modules = (chaz_ProbeModule*)realloc(
+                                 chaz_Probe.modules,
+                                 chaz_Probe.cap * sizeof(chaz_ProbeModule));
+    }
+    module = &chaz_Probe.modules[chaz_Probe.num_modules];
+    memset(module, 0, sizeof(chaz_ProbeModule));
+    module->name   = chaz_Util_strdup(name);
+    module->run    = run;
+    module->state  = CHAZ_PROBE_WAITING;
+    module->worker = chaz_Probe.num_modules + 1;
+    module->deps   = (int*)malloc((strlen(ptr) / 2 + 1) * sizeof(int));
+
+    /* Dependencies must already be registered, which rules out cycles. */
+    while (*ptr) {
+        size_t len;
+        int    i;
+        while (isspace((unsigned char)*ptr)) { ptr++; }
+        len = strcspn(ptr, " \t\n");
+        if (len == 0) { break; }
+        for (i = 0; i < chaz_Probe.num_modules; i++) {
+            const char *dep_name = chaz_Probe.modules[i].name;
+            if (strlen(dep_name) == len && memcmp(dep_name, ptr, len) == 0) {
+                break;
+            }
+        }
+        if (i == chaz_Probe.num_modules) {
+            chaz_Util_die("Module '%s' depends on unknown module '%.*s'",
+                          name, (int)len, ptr);
+        }
+        module->deps[module->num_deps++] = i;
+        ptr += len;
+    }
+
+    chaz_Probe.num_modules++;
+}
+
+void
+chaz_Probe_run_modules(void) {
+    chaz_ProbeModule *modules     = chaz_Probe.modules;
+    int               num_modules = chaz_Probe.num_modules;
+    int               max_jobs    = chaz_ProbeQueue_get_max_jobs();
+    int               next_flush  = 0;
+    int               running     = 0;
+    int               i;
+
+    if (chaz_Profile_active() && chaz_Probe_run_profiled()) {
+        chaz_Probe_clear_modules();
+        return;
+    }
+
+    if (max_jobs <= 1) {
+        for (i = 0; i < num_modules; i++) {
+            /* A profile needs every module's log. */
+            if (chaz_Profile_recording()) {
+                chaz_Probe_run_logged(&modules[i]);
+                chaz_Probe_flush_module(&modules[i]);
+            }
+            else {
+                modules[i].run();
+            }
+        }
+        chaz_Probe_clear_modules();
+        return;
+    }
+
+    while (next_flush < num_modules) {
+        /* Start whatever is ready, in registration order. */
+        for (i = 0; i < num_modules && running < max_jobs; i++) {
+            chaz_ProbeModule *module = &modules[i];
+            if (module->state != CHAZ_PROBE_WAITING
+                || !chaz_Probe_module_ready(module)
+               ) {
+                continue;
+            }
+            /* As in chaz_ProbeQueue_run, the first module gets this
+             * process's slot and the others need a token. */
+            if (running > 0 && !chaz_OS_take_token()) { break; }
+            if (chaz_Probe_start_module(module, running == 0)) {
+                running++;
+                continue;
+            }
+            if (running > 0) { chaz_OS_give_token(); }
+            if (module->state == CHAZ_PROBE_WAITING) {
+                /* Let the running children finish first. */
+                break;
+            }
+        }
+
+        /* Replay finished modules, in order. */
+        while (next_flush < num_modules
+               && modules[next_flush].state == CHAZ_PROBE_DONE
+              ) {
+            chaz_Probe_flush_module(&modules[next_flush]);
+            next_flush++;
+        }
+        if (running == 0) { continue; }
+
+        /* Wait for a module to finish.  Headers it checked become known
+         * right away, since other modules may be waiting for them. */
+        {
+            int status;
+            int pid = chaz_OS_wait_child(&status);
+            if (!pid) {
+                chaz_Util_die("Lost track of %d running probe modules",
+                              running);
+            }
+            for (i = 0; i < num_modules; i++) {
+                chaz_ProbeModule *module = &modules[i];
+                if (module->state != CHAZ_PROBE_RUNNING
+                    || module->pid != pid
+                   ) {
+                    continue;
+                }
+                if (status != 0) {
+                    chaz_Util_die("Probe module %s failed", module->name);
+                }
+                chaz_OpLog_replay(module->log_path, "H",
+                                  chaz_Probe_replay_op);
+                module->state = CHAZ_PROBE_DONE;
+                running--;
+                if (running > 0) { chaz_OS_give_token(); }
+                break;
+            }
+        }
+    }
+
+    chaz_Probe_clear_modules();
+}
+
+static int
+chaz_Probe_module_ready(chaz_ProbeModule *module) {
+    int i;
+    for (i = 0; i < module->num_deps; i++) {
+        int state = chaz_Probe.modules[module->deps[i]].state;
+        if (state != CHAZ_PROBE_DONE && state != CHAZ_PROBE_FLUSHED) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int
+chaz_Probe_start_module(chaz_ProbeModule *module, int can_inline) {
+    char name[40];
+
+    sprintf(name, "_charm_module_%d.log", module->worker);
+    free(module->log_path);
+    module->log_path = chaz_Scratch_path(name);
+
+    module->pid = chaz_OS_start_child(chaz_Probe_module_child, module);
+    if (module->pid) {
+        module->state = CHAZ_PROBE_RUNNING;
+        return true;
+    }
+
+    /* No child process to be had.  Run the module here, but only once no
+     * other module is running, since its probes wait for children of
+     * their own.  The log still keeps its output in order. */
+    if (can_inline) {
+        chaz_Probe_run_logged(module);
+    }
+    return false;
+}
+
+static void
+chaz_Probe_run_logged(chaz_ProbeModule *module) {
+    if (module->log_path == NULL) {
+        char name[40];
+        sprintf(name, "_charm_module_%d.log", module->worker);
+        module->log_path = chaz_Scratch_path(name);
+    }
+    chaz_OpLog_open(module->log_path);
+    module->run();
+    chaz_OpLog_close();
+    module->state = CHAZ_PROBE_DONE;
+}
+
+static void
+chaz_Probe_flush_module(chaz_ProbeModule *module) {
+    chaz_OpLog_replay(module->log_path, CHAZ_CONFWRITER_OPS,
+                      chaz_Probe_replay_op);
+    chaz_Profile_record(module->name, module->log_path);
+    chaz_Util_remove_and_verify(module->log_path);
+    module->state = CHAZ_PROBE_FLUSHED;
+}
+
+static int
+chaz_Probe_run_profiled(void) {
+    chaz_ProbeModule *modules     = chaz_Probe.modules;
+    int               num_modules = chaz_Probe.num_modules;
+    int               num_covered = 0;
+    int               num_checks;
+    int               agreed = true;
+    int               i;
+
+    for (i = 0; i < num_modules; i++) {
+        modules[i].profiled = chaz_Profile_covers(modules[i].name);
+        if (modules[i].profiled) { num_covered++; }
+    }
+
+    /* Pick the spot checks at random, so that over many runs every module
+     * gets checked. */
+    srand((unsigned)time(NULL) ^ (unsigned)chaz_OS_pid());
+    num_checks = num_covered < CHAZ_PROBE_SPOT_CHECKS
+                 ? num_covered
+                 : CHAZ_PROBE_SPOT_CHECKS;
+    while (num_checks-- > 0) {
+        int pick = rand() % num_covered--;
+        for (i = 0; !modules[i].profiled || pick-- > 0; i++) {}
+        modules[i].profiled = false;
+    }
+    if (chaz_Util_verbosity) {
+        printf("Taking the results of %d modules from the profile\n",
+               num_covered);
+    }
+
+    /* Run the spot checks, and the modules the profile doesn't cover.
+     * Their results are held back until all of them agree. */
+    for (i = 0; i < num_modules && agreed; i++) {
+        chaz_ProbeModule *module = &modules[i];
+        if (module->profiled) { continue; }
+        chaz_Probe_run_logged(module);
+        if (chaz_Profile_covers(module->name)
+            && !chaz_Profile_verify(module->name, module->log_path)
+           ) {
+            chaz_Util_warn("Module %s disagrees with the platform profile; "
+                           "probing everything", module->name);
+            agreed = false;
+        }
+    }
+    if (!agreed) {
+        for (i = 0; i < num_modules; i++) {
+            if (modules[i].state == CHAZ_PROBE_DONE) {
+                chaz_Util_remove_and_verify(modules[i].log_path);
+            }
+            modules[i].state    = CHAZ_PROBE_WAITING;
+            modules[i].profiled = false;
+        }
+        return false;
+    }
+
+    for (i = 0; i < num_modules; i++) {
+        chaz_ProbeModule *module = &modules[i];
+        if (module->profiled) {
+            chaz_Profile_replay(module->name, chaz_Probe_replay_op);
+            module->state = CHAZ_PROBE_FLUSHED;
+        }
+        else {
+            chaz_Probe_flush_module(module);
+        }
+    }
+    return true;
+}
+
+static int
+chaz_Probe_module_child(void *arg) {
+    chaz_ProbeModule *module = (chaz_ProbeModule*)arg;
+
+    /* Probes use fixed file names, so each module needs its own scratch
+     * directory. */
+    chaz_Scratch_enter_worker(module->worker);
+    chaz_OpLog_open(module->log_path);
+    module->run();
+    chaz_OpLog_close();
+    fflush(NULL);
+    return 0;
+}
+
+static void
+chaz_Probe_replay_op(char op, const char **fields, int num_fields) {
+    if (!chaz_ConfWriter_replay(op, fields, num_fields)
+        && !chaz_HeadCheck_replay(op, fields, num_fields)
+       ) {
+        chaz_Util_die("Unknown operation '%c' in module log", op);
+    }
+}
+
+static void
+chaz_Probe_clear_modules(void) {
+    int i;
+    for (i = 0; i < chaz_Probe.num_modules; i++) {
+        free(chaz_Probe.modules[i].name);
+        free(chaz_Probe.modules[i].deps);
+        free(chaz_Probe.modules[i].log_path);
+    }
+    free(chaz_Probe.modules);
+    chaz_Probe.modules     = NULL;
+    chaz_Probe.num_modules = 0;
+    chaz_Probe.cap         = 0;
+}
+
 void
 chaz_Probe_clean_up(void) {
-    if (chaz_Util_verbosity) { printf("Cleaning up...\n"); }
+    if (chaz_Util_verbosity) {
+        printf("Cleaning up...\n");
+        printf("Probe results remembered: %ld hits, %ld misses\n",
+               chaz_Memo_hits(), chaz_Memo_misses());
+    }
 
     /* Dispatch various clean up routines. */
+    chaz_Trace_clean_up();
+    chaz_Profile_clean_up();
     chaz_ConfWriter_clean_up();
     chaz_CC_clean_up();
     chaz_Make_clean_up();
+    chaz_Cache_clean_up();
+    chaz_Memo_clean_up();
+    chaz_Scratch_clean_up();
 
     if (chaz_Util_verbosity) { printf("Cleanup complete.\n"); }
 }
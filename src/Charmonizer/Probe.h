@@ -26,6 +26,8 @@ extern "C" {
 
 #define CHAZ_PROBE_MAX_CC_LEN 100
 #define CHAZ_PROBE_MAX_CFLAGS_LEN 2000
+#define CHAZ_PROBE_MAX_PATH_LEN 500
+#define CHAZ_PROBE_MAX_WRAPPER_LEN 500
 
 struct chaz_CLIArgs {
     char cc[CHAZ_PROBE_MAX_CC_LEN + 1];
@@ -37,6 +39,17 @@ struct chaz_CLIArgs {
     int  verbosity;
     int  write_makefile;
     int  code_coverage;
+    int  jobs;
+    char cache_dir[CHAZ_PROBE_MAX_PATH_LEN + 1];
+    char run_wrapper[CHAZ_PROBE_MAX_WRAPPER_LEN + 1];
+    int  no_run;
+    char trace_path[CHAZ_PROBE_MAX_PATH_LEN + 1];
+    int  probe_timeout;
+    long probe_cpu;
+    long probe_memory;
+    long probe_output;
+    char profile_path[CHAZ_PROBE_MAX_PATH_LEN + 1];
+    char write_profile_path[CHAZ_PROBE_MAX_PATH_LEN + 1];
 };
 
 /* Parse command line arguments, initializing and filling in the supplied
@@ -47,8 +60,42 @@ struct chaz_CLIArgs {
  *              [--enable-perl]
  *              [--enable-python]
  *              [--enable-ruby]
+ *              [--jobs=N]
+ *              [--cache-dir=DIR]
+ *              [--run-wrapper=COMMAND | --no-run]
+ *              [--trace=PATH]
+ *              [--probe-timeout=SECONDS]
+ *              [--probe-cpu=SECONDS]
+ *              [--probe-memory=MB]
+ *              [--probe-output=BYTES]
+ *              [--profile=PATH | --write-profile=PATH]
  *              [-- [CFLAGS]]
  *
+ * If --jobs is not given, the environment variable CHARM_JOBS supplies the
+ * maximum number of probes which may run at once.  Likewise, CHARM_CACHE_DIR
+ * stands in for --cache-dir, the directory of the persistent probe cache.
+ *
+ * When cross-compiling, --run-wrapper names a command (an emulator, or a
+ * script which copies the executable to the target) which runs probe
+ * executables; CHARM_RUN_WRAPPER may be used instead.  --no-run forbids
+ * running probe executables at all, so that values are worked out at
+ * compile time where possible.
+ *
+ * --trace, or CHARM_TRACE, writes a timeline of every compile, link and
+ * probe run to PATH in Chrome's trace event format, along with a summary of
+ * where the time went to PATH.txt.
+ *
+ * The --probe-* options limit the wall-clock time, CPU time, address space
+ * and output of each probe executable; one which exceeds them is killed and
+ * counts as failed.  0 lifts a limit.  Options which aren't given are left
+ * at -1, which keeps the defaults of chaz_OS_set_run_limits.
+ *
+ * --profile, or CHARM_PROFILE, names a file of platform profiles (see
+ * Charmonizer/Core/Profile.h), such as the one in the profiles directory.
+ * If it has a profile for this platform, most modules take their results
+ * from it instead of probing.  --write-profile writes a profile of this run
+ * to PATH.
+ *
  * @return true if argument parsing proceeds without incident, false if
  * unexpected arguments are encountered or values are missing or invalid.
  */
@@ -73,6 +120,36 @@ chaz_Probe_die_usage(void);
 void
 chaz_Probe_init(struct chaz_CLIArgs *args);
 
+/* Function which runs a probe module, e.g. chaz_Integers_run.
+ */
+typedef void
+(*chaz_Probe_module_t)(void);
+
+/* Register a probe module to be run by chaz_Probe_run_modules.  [deps] is
+ * a space-separated list naming the modules, registered earlier, whose
+ * results [run] consumes -- at present, that means headers they have
+ * checked -- or NULL if there are none.
+ */
+void
+chaz_Probe_add_module(const char *name, chaz_Probe_module_t run,
+                      const char *deps);
+
+/* Run every registered module, then forget about them.
+ *
+ * If more than one probe job may run at once (see --jobs), modules whose
+ * dependencies have finished run concurrently in child processes.  What
+ * they write to the config files is held back and replayed in the order the
+ * modules were registered, so the output is the same as running them one
+ * after another.
+ *
+ * If a platform profile was loaded (see --profile), the modules it covers
+ * replay their results from it, except for a couple of them, picked at
+ * random, which run as spot checks.  Should a spot check disagree with the
+ * profile, every module runs after all.
+ */
+void
+chaz_Probe_run_modules(void);
+
 /* Clean up the Charmonizer environment -- deleting tempfiles, etc.  This
  * should be called only after everything else finishes.
  */
@@ -19,6 +19,9 @@
 #include "Charmonizer/Core/OperatingSystem.h"
 #include "Charmonizer/Core/Util.h"
 #include "Charmonizer/Core/HeaderChecker.h"
+#include "Charmonizer/Core/ProbeBatch.h"
+#include "Charmonizer/Core/ProbeTable.h"
+#include "Charmonizer/Core/Scratch.h"
 #include "Charmonizer/Probe/DirManip.h"
 #include <string.h>
 #include <stdio.h>
@@ -29,106 +32,87 @@ static struct {
     char mkdir_command[7];
 } chaz_DirManip = { 0, "" };
 
-/* Source code for rmdir. */
-static int
-chaz_DirManip_compile_posix_mkdir(const char *header) {
-    static const char posix_mkdir_code[] =
-        CHAZ_QUOTE(  #include <%s>                                      )
-        CHAZ_QUOTE(  int main(int argc, char **argv) {                  )
-        CHAZ_QUOTE(      if (argc != 2) { return 1; }                   )
-        CHAZ_QUOTE(      if (mkdir(argv[1], 0777) != 0) { return 2; }   )
-        CHAZ_QUOTE(      return 0;                                      )
-        CHAZ_QUOTE(  }                                                  );
-    char code_buf[sizeof(posix_mkdir_code) + 30];
-    int mkdir_available;
-    if (strlen(header) > 25) {
-        chaz_Util_die("Header name too long: '%s'", header);
-    }
-
-    /* Attempt compilation. */
-    sprintf(code_buf, posix_mkdir_code, header);
-    mkdir_available = chaz_CC_test_compile(code_buf);
-
-    /* Set vars on success. */
-    if (mkdir_available) {
-        strcpy(chaz_DirManip.mkdir_command, "mkdir");
-        if (strcmp(header, "direct.h") == 0) {
-            chaz_DirManip.mkdir_num_args = 1;
-        }
-        else {
-            chaz_DirManip.mkdir_num_args = 2;
-        }
-    }
+/* A function body which exercises POSIX mkdir. */
+static const char chaz_DirManip_posix_mkdir_code[] =
+    "return mkdir(\"_charm_mkdir\", 0777);";
+
+/* The mkdir variants offered by direct.h, in order of preference. */
+static const chaz_ProbeCandidate chaz_DirManip_win_mkdir_candidates[] = {
+    { "direct.h", { "_mkdir", "" },      { { NULL, NULL } },
+      0, CHAZ_CC_NO_MS_EXT },
+    { "direct.h", { "mkdir", ", 0777" }, { { NULL, NULL } },
+      0, CHAZ_CC_NO_MS_EXT },
+    { NULL }
+};
+static const chaz_ProbeTable chaz_DirManip_win_mkdir_table = {
+    CHAZ_PROBETABLE_COMPILES, "return $1(\"_charm_mkdir\"$2);", NULL, NULL,
+    chaz_DirManip_win_mkdir_candidates
+};
+
+/* Includes needed for struct dirent. */
+static const char chaz_DirManip_dirent_includes[] =
+    "#include <sys/types.h>\n#include <dirent.h>";
 
-    return mkdir_available;
+static void
+chaz_DirManip_set_mkdir(const char *command, int num_args) {
+    strcpy(chaz_DirManip.mkdir_command, command);
+    chaz_DirManip.mkdir_num_args = num_args;
 }
 
+/* Look for the mkdir variants offered by direct.h.  Return true if one was
+ * found.
+ */
 static int
-chaz_DirManip_compile_win_mkdir(void) {
-    static const char win_mkdir_code[] =
-        CHAZ_QUOTE(  #include <direct.h>                                )
-        CHAZ_QUOTE(  int main(int argc, char **argv) {                  )
-        CHAZ_QUOTE(      if (argc != 2) { return 1; }                   )
-        CHAZ_QUOTE(      if (_mkdir(argv[1]) != 0) { return 2; }        )
-        CHAZ_QUOTE(      return 0;                                      )
-        CHAZ_QUOTE(  }                                                  );
-    int mkdir_available;
-
-    mkdir_available = chaz_CC_test_compile(win_mkdir_code);
-    if (mkdir_available) {
-        strcpy(chaz_DirManip.mkdir_command, "_mkdir");
-        chaz_DirManip.mkdir_num_args = 1;
-    }
-    return mkdir_available;
-}
+chaz_DirManip_try_win_mkdir(void) {
+    int winner = chaz_ProbeTable_resolve(&chaz_DirManip_win_mkdir_table,
+                                         NULL);
 
-static void
-chaz_DirManip_try_mkdir(void) {
-    if (chaz_HeadCheck_check_header("windows.h")) {
-        if (chaz_DirManip_compile_win_mkdir())               { return; }
-        if (chaz_DirManip_compile_posix_mkdir("direct.h"))   { return; }
+    if (winner == 0) {
+        chaz_DirManip_set_mkdir("_mkdir", 1);
     }
-    if (chaz_DirManip_compile_posix_mkdir("sys/stat.h")) { return; }
-}
-
-static int
-chaz_DirManip_compile_rmdir(const char *header) {
-    static const char rmdir_code[] =
-        CHAZ_QUOTE(  #include <%s>                                      )
-        CHAZ_QUOTE(  int main(int argc, char **argv) {                  )
-        CHAZ_QUOTE(      if (argc != 2) { return 1; }                   )
-        CHAZ_QUOTE(      if (rmdir(argv[1]) != 0) { return 2; }         )
-        CHAZ_QUOTE(      return 0;                                      )
-        CHAZ_QUOTE(  }                                                  );
-    char code_buf[sizeof(rmdir_code) + 30];
-    int rmdir_available;
-    if (strlen(header) > 25) {
-        chaz_Util_die("Header name too long: '%s'", header);
+    else if (winner == 1) {
+        chaz_DirManip_set_mkdir("mkdir", 1);
     }
-    sprintf(code_buf, rmdir_code, header);
-    rmdir_available = chaz_CC_test_compile(code_buf);
-    return rmdir_available;
-}
-
-static void
-chaz_DirManip_try_rmdir(void) {
-    if (chaz_DirManip_compile_rmdir("unistd.h"))   { return; }
-    if (chaz_DirManip_compile_rmdir("dirent.h"))   { return; }
-    if (chaz_DirManip_compile_rmdir("direct.h"))   { return; }
+    return winner >= 0;
 }
 
 void
 chaz_DirManip_run(void) {
     const char *dir_sep = chaz_OS_dir_sep();
     int remove_zaps_dirs = false;
-    int has_dirent_h = chaz_HeadCheck_check_header("dirent.h");
-    int has_direct_h = chaz_HeadCheck_check_header("direct.h");
-    int has_dirent_d_namlen = false;
-    int has_dirent_d_type   = false;
+    chaz_ProbeBatch *batch = chaz_ProbeBatch_new();
+    int has_dirent_h, has_direct_h, has_windows_h;
+    int dirent_h, direct_h, windows_h;
+    int d_namlen, d_type, posix_mkdir;
+    char *remove_me;
 
     chaz_ConfWriter_start_module("DirManip");
-    chaz_DirManip_try_mkdir();
-    chaz_DirManip_try_rmdir();
+
+    /* What a POSIX system should have goes in one group, the rest apart. */
+    dirent_h    = chaz_ProbeBatch_add_header(batch, "dirent.h");
+    d_type      = chaz_ProbeBatch_add_member(batch, "struct dirent", "d_type",
+                                             chaz_DirManip_dirent_includes);
+    posix_mkdir = chaz_ProbeBatch_add(batch, "#include <sys/stat.h>",
+                                      chaz_DirManip_posix_mkdir_code);
+    chaz_ProbeBatch_new_group(batch);
+    d_namlen    = chaz_ProbeBatch_add_member(batch, "struct dirent",
+                                             "d_namlen",
+                                             chaz_DirManip_dirent_includes);
+    chaz_ProbeBatch_new_group(batch);
+    windows_h   = chaz_ProbeBatch_add_header(batch, "windows.h");
+    direct_h    = chaz_ProbeBatch_add_header(batch, "direct.h");
+    chaz_ProbeBatch_run(batch);
+
+    has_dirent_h  = chaz_ProbeBatch_succeeded(batch, dirent_h);
+    has_direct_h  = chaz_ProbeBatch_succeeded(batch, direct_h);
+    has_windows_h = chaz_ProbeBatch_succeeded(batch, windows_h);
+
+    /* Prefer the Windows variants of mkdir where they exist. */
+    if (!(has_windows_h && chaz_DirManip_try_win_mkdir())
+        && chaz_ProbeBatch_succeeded(batch, posix_mkdir)
+       ) {
+        chaz_DirManip_set_mkdir("mkdir", 2);
+    }
 
     /* Header checks. */
     if (has_dirent_h) {
@@ -140,21 +124,14 @@ chaz_DirManip_run(void) {
 
     /* Check for members in struct dirent. */
     if (has_dirent_h) {
-        has_dirent_d_namlen = chaz_HeadCheck_contains_member(
-                                  "struct dirent", "d_namlen",
-                                  "#include <sys/types.h>\n#include <dirent.h>"
-                              );
-        if (has_dirent_d_namlen) {
+        if (chaz_ProbeBatch_succeeded(batch, d_namlen)) {
             chaz_ConfWriter_add_def("HAS_DIRENT_D_NAMLEN", NULL);
         }
-        has_dirent_d_type = chaz_HeadCheck_contains_member(
-                                "struct dirent", "d_type",
-                                "#include <sys/types.h>\n#include <dirent.h>"
-                            );
-        if (has_dirent_d_type) {
+        if (chaz_ProbeBatch_succeeded(batch, d_type)) {
             chaz_ConfWriter_add_def("HAS_DIRENT_D_TYPE", NULL);
         }
     }
+    chaz_ProbeBatch_destroy(batch);
 
     if (chaz_DirManip.mkdir_num_args == 2) {
         /* It's two args, but the command isn't "mkdir". */
@@ -190,12 +167,14 @@ chaz_DirManip_run(void) {
     }
 
     /* See whether remove works on directories. */
-    chaz_OS_mkdir("_charm_test_remove_me");
-    if (0 == remove("_charm_test_remove_me")) {
+    remove_me = chaz_Scratch_path("_charm_test_remove_me");
+    chaz_OS_mkdir(remove_me);
+    if (0 == remove(remove_me)) {
         remove_zaps_dirs = true;
         chaz_ConfWriter_add_def("REMOVE_ZAPS_DIRS", NULL);
     }
-    chaz_OS_rmdir("_charm_test_remove_me");
+    chaz_OS_rmdir(remove_me);
+    free(remove_me);
 
     chaz_ConfWriter_end_module();
 }
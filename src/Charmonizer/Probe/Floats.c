@@ -15,9 +15,8 @@
  */
 
 #include "Charmonizer/Core/HeaderChecker.h"
-#include "Charmonizer/Core/CFlags.h"
-#include "Charmonizer/Core/Compiler.h"
 #include "Charmonizer/Core/ConfWriter.h"
+#include "Charmonizer/Core/FuncCheck.h"
 #include "Charmonizer/Core/Util.h"
 #include "Charmonizer/Probe/Floats.h"
 #include <string.h>
@@ -71,35 +70,13 @@ chaz_Floats_run(void) {
 
 const char*
 chaz_Floats_math_library(void) {
-    static const char sqrt_code[] =
-        CHAZ_QUOTE(  #include <math.h>                              )
-        CHAZ_QUOTE(  #include <stdio.h>                             )
-        CHAZ_QUOTE(  typedef double (*sqrt_t)(double);              )
-        CHAZ_QUOTE(  int main(void) {                               )
-        CHAZ_QUOTE(      printf("%p\n", (sqrt_t)sqrt);              )
-        CHAZ_QUOTE(      return 0;                                  )
-        CHAZ_QUOTE(  }                                              );
-    chaz_CFlags *temp_cflags = chaz_CC_get_temp_cflags();
-    char        *output = NULL;
-    size_t       output_len;
-
-    output = chaz_CC_capture_output(sqrt_code, &output_len);
-    if (output != NULL) {
+    if (chaz_FuncCheck_has("sqrt", "#include <math.h>", NULL)) {
         /* Linking against libm not needed. */
-        free(output);
         return NULL;
     }
-
-    chaz_CFlags_add_external_library(temp_cflags, "m");
-    output = chaz_CC_capture_output(sqrt_code, &output_len);
-    chaz_CFlags_clear(temp_cflags);
-
-    if (output == NULL) {
+    if (!chaz_FuncCheck_has("sqrt", "#include <math.h>", "m")) {
         chaz_Util_die("Don't know how to use math library.");
     }
-
-    free(output);
     return "m";
 }
 
-
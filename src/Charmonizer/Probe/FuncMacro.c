@@ -16,112 +16,94 @@
 
 #include "Charmonizer/Core/Compiler.h"
 #include "Charmonizer/Core/ConfWriter.h"
+#include "Charmonizer/Core/ProbeQueue.h"
 #include "Charmonizer/Core/Util.h"
 #include "Charmonizer/Probe/FuncMacro.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-/* Probe for ISO func macro. */
-static int
-chaz_FuncMacro_probe_iso() {
-    static const char iso_func_code[] =
-        CHAZ_QUOTE(  #include <stdio.h>                )
-        CHAZ_QUOTE(  int main() {                      )
-        CHAZ_QUOTE(      printf("%s", __func__);       )
-        CHAZ_QUOTE(      return 0;                     )
-        CHAZ_QUOTE(  }                                 );
-    size_t output_len;
-    char *output;
-    int success = false;
-
-    output = chaz_CC_capture_output(iso_func_code, &output_len);
-    if (output != NULL && strncmp(output, "main", 4) == 0) {
-        success = true;
-    }
-    free(output);
-
-    return success;
-}
-
+/* Code for verifying ISO func macro. */
+static const char chaz_FuncMacro_iso_code[] =
+    CHAZ_QUOTE(  #include <stdio.h>                )
+    CHAZ_QUOTE(  int main() {                      )
+    CHAZ_QUOTE(      printf("%s", __func__);       )
+    CHAZ_QUOTE(      return 0;                     )
+    CHAZ_QUOTE(  }                                 );
+
+/* Code for verifying GNU func macro. */
+static const char chaz_FuncMacro_gnu_code[] =
+    CHAZ_QUOTE(  #include <stdio.h>                )
+    CHAZ_QUOTE(  int main() {                      )
+    CHAZ_QUOTE(      printf("%s", __FUNCTION__);   )
+    CHAZ_QUOTE(      return 0;                     )
+    CHAZ_QUOTE(  }                                 );
+
+/* Code for verifying inline keyword. */
+static const char chaz_FuncMacro_inline_code[] =
+    CHAZ_QUOTE(  #include <stdio.h>                )
+    CHAZ_QUOTE(  static %s int foo() { return 1; } )
+    CHAZ_QUOTE(  int main() {                      )
+    CHAZ_QUOTE(      printf("%%d", foo());         )
+    CHAZ_QUOTE(      return 0;                     )
+    CHAZ_QUOTE(  }                                 );
+
+static const char* chaz_FuncMacro_inline_options[] = {
+    "__inline",
+    "__inline__",
+    "inline"
+};
+
+/* Return true if a func macro probe printed the name of the function.  If
+ * probe executables may not be run, settle for the probe building.
+ */
 static int
-chaz_FuncMacro_probe_gnu() {
-    /* Code for verifying GNU func macro. */
-    static const char gnu_func_code[] =
-        CHAZ_QUOTE(  #include <stdio.h>                )
-        CHAZ_QUOTE(  int main() {                      )
-        CHAZ_QUOTE(      printf("%s", __FUNCTION__);   )
-        CHAZ_QUOTE(      return 0;                     )
-        CHAZ_QUOTE(  }                                 );
+chaz_FuncMacro_printed_main(chaz_ProbeQueue *queue, int job) {
     size_t output_len;
-    char *output;
-    int success = false;
-
-    output = chaz_CC_capture_output(gnu_func_code, &output_len);
-    if (output != NULL && strncmp(output, "main", 4) == 0) {
-        success = true;
-    }
-    free(output);
-
-    return success;
-}
-
-/* Attempt to verify inline keyword. */
-static char*
-chaz_FuncMacro_try_inline(const char *keyword, size_t *output_len) {
-    static const char inline_code[] =
-        CHAZ_QUOTE(  #include <stdio.h>                )
-        CHAZ_QUOTE(  static %s int foo() { return 1; } )
-        CHAZ_QUOTE(  int main() {                      )
-        CHAZ_QUOTE(      printf("%%d", foo());         )
-        CHAZ_QUOTE(      return 0;                     )
-        CHAZ_QUOTE(  }                                 );
-    char code[sizeof(inline_code) + 30];
-    sprintf(code, inline_code, keyword);
-    return chaz_CC_capture_output(code, output_len);
-}
-
-static void
-chaz_FuncMacro_probe_inline(void) {
-    static const char* inline_options[] = {
-        "__inline",
-        "__inline__",
-        "inline"
-    };
-    const int num_inline_options = sizeof(inline_options) / sizeof(void*);
-    int has_inline = false;
-    int i;
-
-    for (i = 0; i < num_inline_options; i++) {
-        const char *inline_option = inline_options[i];
-        size_t output_len;
-        char *output = chaz_FuncMacro_try_inline(inline_option, &output_len);
-        if (output != NULL) {
-            has_inline = true;
-            chaz_ConfWriter_add_def("INLINE", inline_option);
-            free(output);
-            break;
-        }
-    }
-    if (!has_inline) {
-        chaz_ConfWriter_add_def("INLINE", NULL);
+    const char *output = chaz_ProbeQueue_output(queue, job, &output_len);
+    if (!chaz_CC_can_run()) {
+        return chaz_ProbeQueue_succeeded(queue, job);
     }
+    return output != NULL && strncmp(output, "main", 4) == 0;
 }
 
 void
 chaz_FuncMacro_run(void) {
+    const int num_inline_options = sizeof(chaz_FuncMacro_inline_options)
+                                   / sizeof(void*);
+    chaz_ProbeQueue *queue = chaz_ProbeQueue_new();
+    char code[sizeof(chaz_FuncMacro_inline_code) + 30];
+    int iso_job, gnu_job, first_inline_job;
     int has_funcmac      = false;
     int has_iso_funcmac  = false;
     int has_gnuc_funcmac = false;
+    int has_inline       = false;
+    int inline_known;
+    int i;
 
     chaz_ConfWriter_start_module("FuncMacro");
 
+    /* GCC, Clang and MSVC all take the first inline option, as their
+     * version macros tell without a probe. */
+    inline_known = chaz_CC_gcc_version_num() || chaz_CC_msvc_version_num();
+
+    /* Queue up all probes so that they can run at the same time. */
+    iso_job = chaz_ProbeQueue_add_capture(queue, chaz_FuncMacro_iso_code);
+    gnu_job = chaz_ProbeQueue_add_capture(queue, chaz_FuncMacro_gnu_code);
+    first_inline_job = gnu_job + 1;
+    for (i = 0; i < num_inline_options && !inline_known; i++) {
+        sprintf(code, chaz_FuncMacro_inline_code,
+                chaz_FuncMacro_inline_options[i]);
+        chaz_ProbeQueue_add_capture(queue, code);
+    }
+    chaz_ProbeQueue_run(queue);
+
     /* Check for func macros. */
-    if (chaz_FuncMacro_probe_iso()) {
+    if (chaz_FuncMacro_printed_main(queue, iso_job)) {
         has_funcmac     = true;
         has_iso_funcmac = true;
     }
-    if (chaz_FuncMacro_probe_gnu()) {
+    if (chaz_FuncMacro_printed_main(queue, gnu_job)) {
         has_funcmac      = true;
         has_gnuc_funcmac = true;
     }
@@ -144,7 +126,23 @@ chaz_FuncMacro_run(void) {
     }
 
     /* Check for inline keyword. */
-    chaz_FuncMacro_probe_inline();
+    if (inline_known) {
+        has_inline = true;
+        chaz_ConfWriter_add_def("INLINE", chaz_FuncMacro_inline_options[0]);
+    }
+    for (i = 0; i < num_inline_options && !inline_known; i++) {
+        if (chaz_ProbeQueue_passed(queue, first_inline_job + i)) {
+            has_inline = true;
+            chaz_ConfWriter_add_def("INLINE",
+                                    chaz_FuncMacro_inline_options[i]);
+            break;
+        }
+    }
+    if (!has_inline) {
+        chaz_ConfWriter_add_def("INLINE", NULL);
+    }
+
+    chaz_ProbeQueue_destroy(queue);
 
     chaz_ConfWriter_end_module();
 }
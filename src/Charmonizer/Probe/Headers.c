@@ -16,6 +16,7 @@
 
 #include "Charmonizer/Core/HeaderChecker.h"
 #include "Charmonizer/Core/ConfWriter.h"
+#include "Charmonizer/Core/ProbeBatch.h"
 #include "Charmonizer/Core/Util.h"
 #include "Charmonizer/Probe/Headers.h"
 #include <ctype.h>
@@ -43,17 +44,15 @@ static void
 chaz_Headers_encode_affirmation(const char *header_name, char *buffer,
                                 size_t buf_size);
 
-/* Probe for all C89 headers. */
+/* Add one probe group per list of headers to [batch]. */
 static void
-chaz_Headers_probe_c89(void);
+chaz_Headers_add_group(chaz_ProbeBatch *batch, const char **header_names);
 
-/* Probe for all POSIX headers. */
-static void
-chaz_Headers_probe_posix(void);
-
-/* Prove for selected Windows headers. */
-static void
-chaz_Headers_probe_win(void);
+/* Keep every header in the list which was found.  Return true if all of
+ * them were.
+ */
+static int
+chaz_Headers_keep_found(const char **header_names);
 
 int
 chaz_Headers_check(const char *header_name) {
@@ -62,18 +61,75 @@ chaz_Headers_check(const char *header_name) {
 
 void
 chaz_Headers_run(void) {
+    static const char *c89_headers[] = {
+        "assert.h",
+        "ctype.h",
+        "errno.h",
+        "float.h",
+        "limits.h",
+        "locale.h",
+        "math.h",
+        "setjmp.h",
+        "signal.h",
+        "stdarg.h",
+        "stddef.h",
+        "stdio.h",
+        "stdlib.h",
+        "string.h",
+        "time.h",
+        NULL
+    };
+    static const char *posix_headers[] = {
+        "cpio.h",
+        "dirent.h",
+        "fcntl.h",
+        "grp.h",
+        "pwd.h",
+        "regex.h",
+        "sys/stat.h",
+        "sys/times.h",
+        "sys/types.h",
+        "sys/utsname.h",
+        "sys/wait.h",
+        "tar.h",
+        "termios.h",
+        "unistd.h",
+        "utime.h",
+        NULL
+    };
+    static const char *win_headers[] = {
+        "io.h",
+        "windows.h",
+        "process.h",
+        NULL
+    };
+    static const char *one_offs[] = {
+        "pthread.h",
+        NULL
+    };
+    chaz_ProbeBatch *batch = chaz_ProbeBatch_new();
     int i;
 
     chaz_ConfWriter_start_module("Headers");
 
-    chaz_Headers_probe_posix();
-    chaz_Headers_probe_c89();
-    chaz_Headers_probe_win();
+    /* Try each family of headers in one blast, narrowing down only the
+     * families which fail.  The results land in the HeadCheck register. */
+    chaz_Headers_add_group(batch, posix_headers);
+    chaz_Headers_add_group(batch, c89_headers);
+    chaz_Headers_add_group(batch, win_headers);
+    chaz_Headers_add_group(batch, one_offs);
+    chaz_ProbeBatch_run(batch);
+    chaz_ProbeBatch_destroy(batch);
 
-    /* One-offs. */
-    if (chaz_HeadCheck_check_header("pthread.h")) {
-        chaz_Headers_keep("pthread.h");
+    if (chaz_Headers_keep_found(posix_headers)) {
+        chaz_ConfWriter_add_def("HAS_POSIX", NULL);
     }
+    if (chaz_Headers_keep_found(c89_headers)) {
+        chaz_ConfWriter_add_def("HAS_C89", NULL);
+        chaz_ConfWriter_add_def("HAS_C90", NULL);
+    }
+    chaz_Headers_keep_found(win_headers);
+    chaz_Headers_keep_found(one_offs);
 
     /* Append the config with every header detected so far. */
     for (i = 0; chaz_Headers.keepers[i] != NULL; i++) {
@@ -85,6 +141,30 @@ chaz_Headers_run(void) {
     chaz_ConfWriter_end_module();
 }
 
+static void
+chaz_Headers_add_group(chaz_ProbeBatch *batch, const char **header_names) {
+    int i;
+    chaz_ProbeBatch_new_group(batch);
+    for (i = 0; header_names[i] != NULL; i++) {
+        chaz_ProbeBatch_add_header(batch, header_names[i]);
+    }
+}
+
+static int
+chaz_Headers_keep_found(const char **header_names) {
+    int found_all = true;
+    int i;
+    for (i = 0; header_names[i] != NULL; i++) {
+        if (chaz_HeadCheck_check_header(header_names[i])) {
+            chaz_Headers_keep(header_names[i]);
+        }
+        else {
+            found_all = false;
+        }
+    }
+    return found_all;
+}
+
 static void
 chaz_Headers_keep(const char *header_name) {
     if (chaz_Headers.keeper_count >= CHAZ_HEADERS_MAX_KEEPERS) {
@@ -123,109 +203,3 @@ chaz_Headers_encode_affirmation(const char *header_name, char *buffer, size_t bu
     }
 }
 
-static void
-chaz_Headers_probe_c89(void) {
-    const char *c89_headers[] = {
-        "assert.h",
-        "ctype.h",
-        "errno.h",
-        "float.h",
-        "limits.h",
-        "locale.h",
-        "math.h",
-        "setjmp.h",
-        "signal.h",
-        "stdarg.h",
-        "stddef.h",
-        "stdio.h",
-        "stdlib.h",
-        "string.h",
-        "time.h",
-        NULL
-    };
-    int i;
-
-    /* Test for all c89 headers in one blast. */
-    if (chaz_HeadCheck_check_many_headers((const char**)c89_headers)) {
-        chaz_ConfWriter_add_def("HAS_C89", NULL);
-        chaz_ConfWriter_add_def("HAS_C90", NULL);
-        for (i = 0; c89_headers[i] != NULL; i++) {
-            chaz_Headers_keep(c89_headers[i]);
-        }
-    }
-    /* Test one-at-a-time. */
-    else {
-        for (i = 0; c89_headers[i] != NULL; i++) {
-            if (chaz_HeadCheck_check_header(c89_headers[i])) {
-                chaz_Headers_keep(c89_headers[i]);
-            }
-        }
-    }
-}
-
-static void
-chaz_Headers_probe_posix(void) {
-    const char *posix_headers[] = {
-        "cpio.h",
-        "dirent.h",
-        "fcntl.h",
-        "grp.h",
-        "pwd.h",
-        "regex.h",
-        "sys/stat.h",
-        "sys/times.h",
-        "sys/types.h",
-        "sys/utsname.h",
-        "sys/wait.h",
-        "tar.h",
-        "termios.h",
-        "unistd.h",
-        "utime.h",
-        NULL
-    };
-    int i;
-
-    /* Try for all POSIX headers in one blast. */
-    if (chaz_HeadCheck_check_many_headers((const char**)posix_headers)) {
-        chaz_ConfWriter_add_def("HAS_POSIX", NULL);
-        for (i = 0; posix_headers[i] != NULL; i++) {
-            chaz_Headers_keep(posix_headers[i]);
-        }
-    }
-    /* Test one-at-a-time. */
-    else {
-        for (i = 0; posix_headers[i] != NULL; i++) {
-            if (chaz_HeadCheck_check_header(posix_headers[i])) {
-                chaz_Headers_keep(posix_headers[i]);
-            }
-        }
-    }
-}
-
-
-static void
-chaz_Headers_probe_win(void) {
-    const char *win_headers[] = {
-        "io.h",
-        "windows.h",
-        "process.h",
-        NULL
-    };
-    int i;
-
-    /* Test for all Windows headers in one blast */
-    if (chaz_HeadCheck_check_many_headers((const char**)win_headers)) {
-        for (i = 0; win_headers[i] != NULL; i++) {
-            chaz_Headers_keep(win_headers[i]);
-        }
-    }
-    /* Test one-at-a-time. */
-    else {
-        for (i = 0; win_headers[i] != NULL; i++) {
-            if (chaz_HeadCheck_check_header(win_headers[i])) {
-                chaz_Headers_keep(win_headers[i]);
-            }
-        }
-    }
-}
-
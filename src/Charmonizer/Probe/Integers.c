@@ -17,62 +17,34 @@
 #include "Charmonizer/Core/HeaderChecker.h"
 #include "Charmonizer/Core/Compiler.h"
 #include "Charmonizer/Core/ConfWriter.h"
+#include "Charmonizer/Core/ProbeProgram.h"
+#include "Charmonizer/Core/Types.h"
 #include "Charmonizer/Core/Util.h"
 #include "Charmonizer/Probe/Integers.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-/* Determine endian-ness of this machine.
- */
-static int
-chaz_Integers_machine_is_big_endian(void);
-
-static const char chaz_Integers_sizes_code[] =
-    CHAZ_QUOTE(  #include <stdio.h>                        )
-    CHAZ_QUOTE(  int main () {                             )
-    CHAZ_QUOTE(      printf("%d ", (int)sizeof(char));     )
-    CHAZ_QUOTE(      printf("%d ", (int)sizeof(short));    )
-    CHAZ_QUOTE(      printf("%d ", (int)sizeof(int));      )
-    CHAZ_QUOTE(      printf("%d ", (int)sizeof(long));     )
-    CHAZ_QUOTE(      printf("%d ", (int)sizeof(void*));    )
-    CHAZ_QUOTE(      printf("%d ", (int)sizeof(size_t));   )
-    CHAZ_QUOTE(      return 0;                             )
-    CHAZ_QUOTE(  }                                         );
-
-static const char chaz_Integers_type64_code[] =
-    CHAZ_QUOTE(  #include <stdio.h>                        )
-    CHAZ_QUOTE(  int main()                                )
-    CHAZ_QUOTE(  {                                         )
-    CHAZ_QUOTE(      printf("%%d", (int)sizeof(%s));       )
-    CHAZ_QUOTE(      return 0;                             )
-    CHAZ_QUOTE(  }                                         );
-
-static const char chaz_Integers_literal64_code[] =
-    CHAZ_QUOTE(  #include <stdio.h>                        )
-    CHAZ_QUOTE(  #define big 9000000000000000000%s         )
-    CHAZ_QUOTE(  int main()                                )
-    CHAZ_QUOTE(  {                                         )
-    CHAZ_QUOTE(      int truncated = (int)big;             )
-    CHAZ_QUOTE(      printf("%%d\n", truncated);           )
-    CHAZ_QUOTE(      return 0;                             )
-    CHAZ_QUOTE(  }                                         );
-
+/* Statements which convert an unsigned 64-bit integer to double. */
 static const char chaz_Integers_u64_to_double_code[] =
-    CHAZ_QUOTE(  #include <stdio.h>                        )
-    CHAZ_QUOTE(  int main()                                )
-    CHAZ_QUOTE(  {                                         )
     CHAZ_QUOTE(      unsigned %s int_num = 0;              )
     CHAZ_QUOTE(      double float_num;                     )
     CHAZ_QUOTE(      float_num = (double)int_num;          )
-    CHAZ_QUOTE(      printf("%%f\n", float_num);           )
-    CHAZ_QUOTE(      return 0;                             )
-    CHAZ_QUOTE(  }                                         );
+    CHAZ_QUOTE(      printf("%%f\n", float_num);           );
+
+/* Types whose sizes are recorded.  Only long long might be missing.
+ */
+static const char *chaz_Integers_types[] = {
+    "char", "short", "int", "long", "void*", "size_t", "long long", NULL
+};
 
 void
 chaz_Integers_run(void) {
-    char *output;
+    chaz_ProbeProg *prog;
+    const char *output;
     size_t output_len;
+    int sizes[sizeof(chaz_Integers_types) / sizeof(chaz_Integers_types[0])];
+    int big_end_query;
     int sizeof_char       = -1;
     int sizeof_short      = -1;
     int sizeof_int        = -1;
@@ -90,6 +62,8 @@ chaz_Integers_run(void) {
     int has_inttypes      = chaz_HeadCheck_check_header("inttypes.h");
     int has_stdint        = chaz_HeadCheck_check_header("stdint.h");
     int can_convert_u64_to_double = true;
+    int literal_queries[4];
+    int u64_to_double_query;
     char i32_t_type[10];
     char i32_t_postfix[10];
     char u32_t_postfix[10];
@@ -101,52 +75,41 @@ chaz_Integers_run(void) {
 
     chaz_ConfWriter_start_module("Integers");
 
-    /* Document endian-ness. */
-    if (chaz_Integers_machine_is_big_endian()) {
-        chaz_ConfWriter_add_def("BIG_END", NULL);
-    }
-    else {
-        chaz_ConfWriter_add_def("LITTLE_END", NULL);
-    }
-
-    /* Record sizeof() for several common integer types. */
-    output = chaz_CC_capture_output(chaz_Integers_sizes_code, &output_len);
-    if (output != NULL) {
-        char *ptr     = output;
-        char *end_ptr = output;
+    /* Find out the byte order of the target. */
+    prog = chaz_ProbeProg_new();
+    big_end_query = chaz_ProbeProg_add_big_endian(prog);
+    chaz_ProbeProg_run(prog);
 
-        sizeof_char   = strtol(ptr, &end_ptr, 10);
-        ptr           = end_ptr;
-        sizeof_short  = strtol(ptr, &end_ptr, 10);
-        ptr           = end_ptr;
-        sizeof_int    = strtol(ptr, &end_ptr, 10);
-        ptr           = end_ptr;
-        sizeof_long   = strtol(ptr, &end_ptr, 10);
-        ptr           = end_ptr;
-        sizeof_ptr    = strtol(ptr, &end_ptr, 10);
-        ptr           = end_ptr;
-        sizeof_size_t = strtol(ptr, &end_ptr, 10);
-
-        free(output);
-    }
-
-    /* Determine whether long longs are available. */
-    sprintf(code_buf, chaz_Integers_type64_code, "long long");
-    output = chaz_CC_capture_output(code_buf, &output_len);
-    if (output != NULL) {
-        has_long_long    = true;
-        sizeof_long_long = strtol(output, NULL, 10);
-        free(output);
-    }
-
-    /* Determine whether the __int64 type is available. */
-    sprintf(code_buf, chaz_Integers_type64_code, "__int64");
-    output = chaz_CC_capture_output(code_buf, &output_len);
-    if (output != NULL) {
-        has___int64 = true;
-        sizeof___int64 = strtol(output, NULL, 10);
-        free(output);
-    }
+    /* Document endian-ness. */
+    switch (chaz_ProbeProg_int_value(prog, big_end_query, -1)) {
+        case 1:
+            chaz_ConfWriter_add_def("BIG_END", NULL);
+            break;
+        case 0:
+            chaz_ConfWriter_add_def("LITTLE_END", NULL);
+            break;
+        default:
+            chaz_Util_die("Can't determine the byte order of the target");
+    }
+    chaz_ProbeProg_destroy(prog);
+
+    /* Record sizeof() for several common integer types and find out
+     * whether long long and __int64 are available.  __int64 is rare outside
+     * of Windows, so it is measured on its own rather than spoiling the
+     * batch, and not at all by compilers which can't know it. */
+    chaz_Types_check_many(chaz_Integers_types, NULL, sizes, NULL);
+    sizeof_char      = sizes[0];
+    sizeof_short     = sizes[1];
+    sizeof_int       = sizes[2];
+    sizeof_long      = sizes[3];
+    sizeof_ptr       = sizes[4];
+    sizeof_size_t    = sizes[5];
+    sizeof_long_long = sizes[6];
+    if (!(chaz_CC_traits() & CHAZ_CC_NO_MS_EXT)) {
+        sizeof___int64 = chaz_Types_sizeof("__int64", NULL);
+    }
+    has_long_long    = sizeof_long_long != -1;
+    has___int64      = sizeof___int64 != -1;
 
     /* Figure out which integer types are available. */
     if (sizeof_char == 1) {
@@ -180,47 +143,60 @@ chaz_Integers_run(void) {
         strcpy(i64_t_type, "__int64");
     }
 
-    /* Probe for 64-bit literal syntax. */
+    /* Probe for 64-bit literal syntax, and whether unsigned 64-bit integers
+     * can be converted to double -- older MSVC versions can't. */
+    prog = chaz_ProbeProg_new();
     if (has_64 && sizeof_long == 8) {
         strcpy(i64_t_postfix, "L");
         strcpy(u64_t_postfix, "UL");
     }
     else if (has_64) {
-        sprintf(code_buf, chaz_Integers_literal64_code, "LL");
-        output = chaz_CC_capture_output(code_buf, &output_len);
-        if (output != NULL) {
+        static const char *postfixes[] = { "LL", "ULL", "i64", "Ui64" };
+        int num_postfixes = chaz_CC_traits() & CHAZ_CC_NO_MS_EXT ? 2 : 4;
+        int i;
+        for (i = 0; i < 4; i++) {
+            literal_queries[i] = -1;
+            if (i >= num_postfixes) { continue; }
+            /* The Microsoft suffixes go together in a group of their own. */
+            if (i == 2) { chaz_ProbeProg_new_group(prog); }
+            sprintf(code_buf, "(int)9000000000000000000%s", postfixes[i]);
+            literal_queries[i] = chaz_ProbeProg_add_int(prog, NULL, code_buf);
+        }
+        chaz_ProbeProg_new_group(prog);
+    }
+    if (has_64) {
+        sprintf(code_buf, chaz_Integers_u64_to_double_code, i64_t_type);
+        u64_to_double_query = chaz_ProbeProg_add_compiles(prog, NULL,
+                                                          code_buf);
+        chaz_ProbeProg_run(prog);
+        can_convert_u64_to_double
+            = chaz_ProbeProg_succeeded(prog, u64_to_double_query);
+    }
+    if (has_64 && sizeof_long != 8) {
+        if (chaz_ProbeProg_succeeded(prog, literal_queries[0])) {
             strcpy(i64_t_postfix, "LL");
-            free(output);
+        }
+        else if (literal_queries[2] != -1
+                 && chaz_ProbeProg_succeeded(prog, literal_queries[2])
+                ) {
+            strcpy(i64_t_postfix, "i64");
         }
         else {
-            sprintf(code_buf, chaz_Integers_literal64_code, "i64");
-            output = chaz_CC_capture_output(code_buf, &output_len);
-            if (output != NULL) {
-                strcpy(i64_t_postfix, "i64");
-                free(output);
-            }
-            else {
-                chaz_Util_die("64-bit types, but no literal syntax found");
-            }
+            chaz_Util_die("64-bit types, but no literal syntax found");
         }
-        sprintf(code_buf, chaz_Integers_literal64_code, "ULL");
-        output = chaz_CC_capture_output(code_buf, &output_len);
-        if (output != NULL) {
+        if (chaz_ProbeProg_succeeded(prog, literal_queries[1])) {
             strcpy(u64_t_postfix, "ULL");
-            free(output);
+        }
+        else if (literal_queries[3] != -1
+                 && chaz_ProbeProg_succeeded(prog, literal_queries[3])
+                ) {
+            strcpy(u64_t_postfix, "Ui64");
         }
         else {
-            sprintf(code_buf, chaz_Integers_literal64_code, "Ui64");
-            output = chaz_CC_capture_output(code_buf, &output_len);
-            if (output != NULL) {
-                strcpy(u64_t_postfix, "Ui64");
-                free(output);
-            }
-            else {
-                chaz_Util_die("64-bit types, but no literal syntax found");
-            }
+            chaz_Util_die("64-bit types, but no literal syntax found");
         }
     }
+    chaz_ProbeProg_destroy(prog);
 
     /* Write out some conditional defines. */
     if (has_inttypes) {
@@ -286,15 +262,8 @@ chaz_Integers_run(void) {
 
     /* Create macro for converting uint64_t to double. */
     if (has_64) {
-        /*
-         * Determine whether unsigned 64-bit integers can be converted to
-         * double. Older MSVC versions don't support this conversion.
-         */
-        sprintf(code_buf, chaz_Integers_u64_to_double_code, i64_t_type);
-        output = chaz_CC_capture_output(code_buf, &output_len);
-        if (output != NULL) {
+        if (can_convert_u64_to_double) {
             chaz_ConfWriter_add_def("U64_TO_DOUBLE(num)", "((double)(num))");
-            free(output);
         }
         else {
             chaz_ConfWriter_add_def(
@@ -456,19 +425,20 @@ chaz_Integers_run(void) {
                 NULL,
             };
 
-            /* Buffer to hold the code, and its start and end. */
             static const char format_64_code[] =
-                CHAZ_QUOTE(  #include <stdio.h>                            )
-                CHAZ_QUOTE(  int main() {                                  )
-                CHAZ_QUOTE(      printf("%%%su", 18446744073709551615%s);  )
-                CHAZ_QUOTE(      return 0;                                 )
-                CHAZ_QUOTE( }                                              );
+                CHAZ_QUOTE(      printf("%%%su", 18446744073709551615%s);  );
 
+            /* Try to print 2**64-1 with every option in one program, and
+             * take the first one which gives it back intact. */
+            prog = chaz_ProbeProg_new();
             for (i = 0; options[i] != NULL; i++) {
-                /* Try to print 2**64-1, and see if we get it back intact. */
                 sprintf(code_buf, format_64_code, options[i], u64_t_postfix);
-                output = chaz_CC_capture_output(code_buf, &output_len);
+                chaz_ProbeProg_add_output(prog, NULL, code_buf);
+            }
+            chaz_ProbeProg_run(prog);
 
+            for (i = 0; options[i] != NULL; i++) {
+                output = chaz_ProbeProg_output(prog, i, &output_len);
                 if (output != NULL
                     && strcmp(output, "18446744073709551615") == 0
                    ) {
@@ -476,20 +446,14 @@ chaz_Integers_run(void) {
                     chaz_ConfWriter_add_global_def("PRId64", scratch);
                     sprintf(scratch, "\"%su\"", options[i]);
                     chaz_ConfWriter_add_global_def("PRIu64", scratch);
-                    free(output);
                     break;
                 }
             }
+            chaz_ProbeProg_destroy(prog);
         }
     }
 
     chaz_ConfWriter_end_module();
 }
 
-static int
-chaz_Integers_machine_is_big_endian(void) {
-    long one = 1;
-    return !(*((char*)(&one)));
-}
-
 
@@ -17,6 +17,9 @@
 #include "Charmonizer/Core/HeaderChecker.h"
 #include "Charmonizer/Core/Compiler.h"
 #include "Charmonizer/Core/ConfWriter.h"
+#include "Charmonizer/Core/ProbeBatch.h"
+#include "Charmonizer/Core/ProbeTable.h"
+#include "Charmonizer/Core/Types.h"
 #include "Charmonizer/Core/Util.h"
 #include "Charmonizer/Probe/LargeFiles.h"
 #include <errno.h>
@@ -29,53 +32,118 @@ static struct {
     char off64_type[10];
 } chaz_LargeFiles = { "" };
 
-/* Sets of symbols which might provide large file support for stdio. */
-typedef struct chaz_LargeFiles_stdio64_combo {
-    const char *includes;
-    const char *fopen_command;
-    const char *ftell_command;
-    const char *fseek_command;
-} chaz_LargeFiles_stdio64_combo;
-
-/* Sets of symbols which might provide large file support for unbuffered i/o.
+/* Sets of symbols which might provide large file support for stdio.  The
+ * offset type found by chaz_LargeFiles_probe_off64 goes by chaz_off64_t.
+ */
+static const char chaz_LargeFiles_stdio64_code[] =
+    "#include <stdio.h>\n"
+    "int main() {\n"
+    "    chaz_off64_t pos;\n"
+    "    FILE *f;\n"
+    "    f = $1(\"_charm_stdio64\", \"w\");\n"
+    "    if (f == NULL) return -1;\n"
+    "    printf(\"%d\", (int)sizeof(chaz_off64_t));\n"
+    "    pos = $2(stdout);\n"
+    "    $3(stdout, 0, SEEK_SET);\n"
+    "    return 0;\n"
+    "}\n";
+static const chaz_ProbeCandidate chaz_LargeFiles_stdio64_candidates[] = {
+    { "sys/types.h", { "fopen64", "ftello64", "fseeko64" },
+      { { "HAS_64BIT_STDIO", NULL }, { "fopen64", "fopen64" },
+        { "ftello64", "ftello64" }, { "fseeko64", "fseeko64" } },
+      0, CHAZ_CC_MSVC },
+    { "sys/types.h", { "fopen", "ftello64", "fseeko64" },
+      { { "HAS_64BIT_STDIO", NULL }, { "fopen64", "fopen" },
+        { "ftello64", "ftello64" }, { "fseeko64", "fseeko64" } },
+      0, CHAZ_CC_MSVC },
+    { "sys/types.h", { "fopen", "ftello", "fseeko" },
+      { { "HAS_64BIT_STDIO", NULL }, { "fopen64", "fopen" },
+        { "ftello64", "ftello" }, { "fseeko64", "fseeko" } },
+      0, CHAZ_CC_MSVC },
+    { "", { "fopen", "ftell", "fseek" },
+      { { "HAS_64BIT_STDIO", NULL }, { "fopen64", "fopen" },
+        { "ftello64", "ftell" }, { "fseeko64", "fseek" } },
+      0, 0 },
+    { "", { "fopen", "_ftelli64", "_fseeki64" },
+      { { "HAS_64BIT_STDIO", NULL }, { "fopen64", "fopen" },
+        { "ftello64", "_ftelli64" }, { "fseeko64", "_fseeki64" } },
+      0, CHAZ_CC_NO_MS_EXT },
+    { NULL }
+};
+static const chaz_ProbeTable chaz_LargeFiles_stdio64_table = {
+    CHAZ_PROBETABLE_RUNS, chaz_LargeFiles_stdio64_code, "8",
+    "_charm_stdio64", chaz_LargeFiles_stdio64_candidates
+};
+
+/* Symbols which might provide large file support for unbuffered i/o.
  */
-typedef struct chaz_LargeFiles_unbuff_combo {
-    const char *includes;
-    const char *lseek_command;
-    const char *pread64_command;
-} chaz_LargeFiles_unbuff_combo;
+static const char chaz_LargeFiles_lseek_code[] =
+    "#include <stdio.h>\n"
+    "int main() {\n"
+    "    int fd;\n"
+    "    fd = open(\"_charm_lseek\", O_WRONLY | O_CREAT, 0666);\n"
+    "    if (fd == -1) { return -1; }\n"
+    "    $1(fd, 0, SEEK_SET);\n"
+    "    printf(\"%d\", 1);\n"
+    "    if (close(fd)) { return -1; }\n"
+    "    return 0;\n"
+    "}\n";
+static const chaz_ProbeCandidate chaz_LargeFiles_lseek_candidates[] = {
+    { "unistd.h fcntl.h", { "lseek64" },
+      { { "HAS_64BIT_LSEEK", NULL }, { "lseek64", "lseek64" } },
+      0, CHAZ_CC_MSVC },
+    { "unistd.h fcntl.h", { "lseek" },
+      { { "HAS_64BIT_LSEEK", NULL }, { "lseek64", "lseek" } },
+      0, CHAZ_CC_MSVC },
+    { "io.h fcntl.h", { "_lseeki64" },
+      { { "HAS_64BIT_LSEEK", NULL }, { "lseek64", "_lseeki64" } },
+      CHAZ_CC_MSVC, CHAZ_CC_NO_MS_EXT },
+    { NULL }
+};
+static const chaz_ProbeTable chaz_LargeFiles_lseek_table = {
+    CHAZ_PROBETABLE_RUNS, chaz_LargeFiles_lseek_code, NULL, "_charm_lseek",
+    chaz_LargeFiles_lseek_candidates
+};
+
+/* The pread call will fail, but that's fine as long as it runs. */
+static const char chaz_LargeFiles_pread64_code[] =
+    "#include <stdio.h>\n"
+    "int main() {\n"
+    "    int fd = 20;\n"
+    "    char buf[1];\n"
+    "    printf(\"1\");\n"
+    "    $1(fd, buf, 1, 1);\n"
+    "    return 0;\n"
+    "}\n";
+static const chaz_ProbeCandidate chaz_LargeFiles_pread64_candidates[] = {
+    { "unistd.h fcntl.h", { "pread64" },
+      { { "HAS_64BIT_PREAD", NULL }, { "pread64", "pread64" } },
+      0, CHAZ_CC_MSVC },
+    { "unistd.h fcntl.h", { "pread" },
+      { { "HAS_64BIT_PREAD", NULL }, { "pread64", "pread" } },
+      0, CHAZ_CC_MSVC },
+    { "io.h fcntl.h", { "NO_PREAD64" },
+      { { "HAS_64BIT_PREAD", NULL }, { "pread64", "NO_PREAD64" } },
+      CHAZ_CC_MSVC, CHAZ_CC_NO_MS_EXT },
+    { NULL }
+};
+static const chaz_ProbeTable chaz_LargeFiles_pread64_table = {
+    CHAZ_PROBETABLE_RUNS, chaz_LargeFiles_pread64_code, NULL, NULL,
+    chaz_LargeFiles_pread64_candidates
+};
 
 /* Check for a 64-bit file pointer type.
  */
 static int
 chaz_LargeFiles_probe_off64(void);
 
-/* Check what name 64-bit ftell, fseek go by.
- */
-static void
-chaz_LargeFiles_probe_stdio64(void);
-static int
-chaz_LargeFiles_try_stdio64(chaz_LargeFiles_stdio64_combo *combo);
-
-/* Probe for 64-bit unbuffered i/o.
- */
-static void
-chaz_LargeFiles_probe_unbuff(void);
-
-/* Check for a 64-bit lseek.
- */
-static int
-chaz_LargeFiles_probe_lseek(chaz_LargeFiles_unbuff_combo *combo);
-
-/* Check for a 64-bit pread.
- */
-static int
-chaz_LargeFiles_probe_pread64(chaz_LargeFiles_unbuff_combo *combo);
-
 void
 chaz_LargeFiles_run(void) {
     int found_off64_t = false;
     const char *stat_includes = "#include <stdio.h>\n#include <sys/stat.h>";
+    chaz_ProbeBatch *batch = chaz_ProbeBatch_new();
+    int sys_stat_h, io_h, fcntl_h, st_size, st_blocks;
+    char *prelude;
 
     chaz_ConfWriter_start_module("LargeFiles");
 
@@ -87,46 +155,49 @@ chaz_LargeFiles_run(void) {
     }
 
     /* See if stdio variants with 64-bit support exist. */
-    chaz_LargeFiles_probe_stdio64();
+    prelude = chaz_Util_join("", "#define chaz_off64_t ",
+                             chaz_LargeFiles.off64_type, NULL);
+    chaz_ProbeTable_resolve(&chaz_LargeFiles_stdio64_table, prelude);
+    free(prelude);
 
     /* Probe for 64-bit versions of lseek and pread (if we have an off64_t). */
     if (found_off64_t) {
-        chaz_LargeFiles_probe_unbuff();
+        chaz_ProbeTable_resolve(&chaz_LargeFiles_lseek_table, NULL);
+        chaz_ProbeTable_resolve(&chaz_LargeFiles_pread64_table, NULL);
     }
 
     /* Make checks needed for testing. */
-    if (chaz_HeadCheck_check_header("sys/stat.h")) {
+    sys_stat_h = chaz_ProbeBatch_add_header(batch, "sys/stat.h");
+    fcntl_h    = chaz_ProbeBatch_add_header(batch, "fcntl.h");
+    st_size    = chaz_ProbeBatch_add_member(batch, "struct stat", "st_size",
+                                            stat_includes);
+    st_blocks  = chaz_ProbeBatch_add_member(batch, "struct stat", "st_blocks",
+                                            stat_includes);
+    chaz_ProbeBatch_new_group(batch);
+    io_h       = chaz_ProbeBatch_add_header(batch, "io.h");
+    chaz_ProbeBatch_run(batch);
+    if (chaz_ProbeBatch_succeeded(batch, sys_stat_h)) {
         chaz_ConfWriter_append_conf("#define CHAZ_HAS_SYS_STAT_H\n");
     }
-    if (chaz_HeadCheck_check_header("io.h")) {
+    if (chaz_ProbeBatch_succeeded(batch, io_h)) {
         chaz_ConfWriter_append_conf("#define CHAZ_HAS_IO_H\n");
     }
-    if (chaz_HeadCheck_check_header("fcntl.h")) {
+    if (chaz_ProbeBatch_succeeded(batch, fcntl_h)) {
         chaz_ConfWriter_append_conf("#define CHAZ_HAS_FCNTL_H\n");
     }
-    if (chaz_HeadCheck_contains_member("struct stat", "st_size", stat_includes)) {
+    if (chaz_ProbeBatch_succeeded(batch, st_size)) {
         chaz_ConfWriter_append_conf("#define CHAZ_HAS_STAT_ST_SIZE\n");
     }
-    if (chaz_HeadCheck_contains_member("struct stat", "st_blocks", stat_includes)) {
+    if (chaz_ProbeBatch_succeeded(batch, st_blocks)) {
         chaz_ConfWriter_append_conf("#define CHAZ_HAS_STAT_ST_BLOCKS\n");
     }
+    chaz_ProbeBatch_destroy(batch);
 
     chaz_ConfWriter_end_module();
 }
 
 static int
 chaz_LargeFiles_probe_off64(void) {
-    static const char off64_code[] =
-        CHAZ_QUOTE(  %s                                        )
-        CHAZ_QUOTE(  #include <stdio.h>                        )
-        CHAZ_QUOTE(  int main()                                )
-        CHAZ_QUOTE(  {                                         )
-        CHAZ_QUOTE(      printf("%%d", (int)sizeof(%s));       )
-        CHAZ_QUOTE(      return 0;                             )
-        CHAZ_QUOTE(  }                                         );
-    char code_buf[sizeof(off64_code) + 100];
-    int i;
-    int success = false;
     static const char* off64_options[] = {
         "off64_t",
         "off_t",
@@ -134,189 +205,24 @@ chaz_LargeFiles_probe_off64(void) {
         "long"
     };
     int num_off64_options = sizeof(off64_options) / sizeof(off64_options[0]);
+    int no_ms_ext = chaz_CC_traits() & CHAZ_CC_NO_MS_EXT;
+    int has_sys_types_h = chaz_HeadCheck_check_header("sys/types.h");
+    const char *sys_types_include = has_sys_types_h
+                                    ? "#include <sys/types.h>"
+                                    : NULL;
+    int i;
 
+    /* Most systems are satisfied by one of the first two candidates, so
+     * they are measured one at a time, in order of preference. */
     for (i = 0; i < num_off64_options; i++) {
-        const char *candidate = off64_options[i];
-        char *output;
-        size_t output_len;
-        int has_sys_types_h = chaz_HeadCheck_check_header("sys/types.h");
-        const char *sys_types_include = has_sys_types_h
-                                        ? "#include <sys/types.h>"
-                                        : "";
-
-        /* Execute the probe. */
-        sprintf(code_buf, off64_code, sys_types_include, candidate);
-        output = chaz_CC_capture_output(code_buf, &output_len);
-        if (output != NULL) {
-            long sizeof_candidate = strtol(output, NULL, 10);
-            free(output);
-            if (sizeof_candidate == 8) {
-                strcpy(chaz_LargeFiles.off64_type, candidate);
-                success = true;
-                break;
-            }
+        if (no_ms_ext && strcmp(off64_options[i], "__int64") == 0) {
+            continue;
         }
-    }
-    return success;
-}
-
-static int
-chaz_LargeFiles_try_stdio64(chaz_LargeFiles_stdio64_combo *combo) {
-    static const char stdio64_code[] =
-        CHAZ_QUOTE(  %s                                         )
-        CHAZ_QUOTE(  #include <stdio.h>                         )
-        CHAZ_QUOTE(  int main() {                               )
-        CHAZ_QUOTE(      %s pos;                                )
-        CHAZ_QUOTE(      FILE *f;                               )
-        CHAZ_QUOTE(      f = %s("_charm_stdio64", "w");         )
-        CHAZ_QUOTE(      if (f == NULL) return -1;              )
-        CHAZ_QUOTE(      printf("%%d", (int)sizeof(%s));        )
-        CHAZ_QUOTE(      pos = %s(stdout);                      )
-        CHAZ_QUOTE(      %s(stdout, 0, SEEK_SET);               )
-        CHAZ_QUOTE(      return 0;                              )
-        CHAZ_QUOTE(  }                                          );
-    char *output = NULL;
-    size_t output_len;
-    char code_buf[sizeof(stdio64_code) + 200];
-    int success = false;
-
-    /* Prepare the source code. */
-    sprintf(code_buf, stdio64_code, combo->includes,
-            chaz_LargeFiles.off64_type, combo->fopen_command,
-            chaz_LargeFiles.off64_type, combo->ftell_command,
-            combo->fseek_command);
-
-    /* Verify compilation and that the offset type has 8 bytes. */
-    output = chaz_CC_capture_output(code_buf, &output_len);
-    if (output != NULL) {
-        long size = strtol(output, NULL, 10);
-        if (size == 8) {
-            success = true;
+        if (chaz_Types_sizeof(off64_options[i], sys_types_include) == 8) {
+            strcpy(chaz_LargeFiles.off64_type, off64_options[i]);
+            return true;
         }
-        free(output);
-    }
-
-    if (!chaz_Util_remove_and_verify("_charm_stdio64")) {
-        chaz_Util_die("Failed to remove '_charm_stdio64'");
     }
 
-    return success;
+    return false;
 }
-
-static void
-chaz_LargeFiles_probe_stdio64(void) {
-    int i;
-    static chaz_LargeFiles_stdio64_combo stdio64_combos[] = {
-        { "#include <sys/types.h>\n", "fopen64",   "ftello64",  "fseeko64"  },
-        { "#include <sys/types.h>\n", "fopen",     "ftello64",  "fseeko64"  },
-        { "#include <sys/types.h>\n", "fopen",     "ftello",    "fseeko"    },
-        { "",                         "fopen",     "ftell",     "fseek"     },
-        { "",                         "fopen",     "_ftelli64", "_fseeki64" },
-        { "",                         "fopen",     "ftell",     "fseek"     },
-        { NULL, NULL, NULL, NULL }
-    };
-
-    for (i = 0; stdio64_combos[i].includes != NULL; i++) {
-        chaz_LargeFiles_stdio64_combo combo = stdio64_combos[i];
-        if (chaz_LargeFiles_try_stdio64(&combo)) {
-            chaz_ConfWriter_add_def("HAS_64BIT_STDIO", NULL);
-            chaz_ConfWriter_add_def("fopen64",  combo.fopen_command);
-            chaz_ConfWriter_add_def("ftello64", combo.ftell_command);
-            chaz_ConfWriter_add_def("fseeko64", combo.fseek_command);
-            break;
-        }
-    }
-}
-
-static int
-chaz_LargeFiles_probe_lseek(chaz_LargeFiles_unbuff_combo *combo) {
-    static const char lseek_code[] =
-        CHAZ_QUOTE( %s                                                       )
-        CHAZ_QUOTE( #include <stdio.h>                                       )
-        CHAZ_QUOTE( int main() {                                             )
-        CHAZ_QUOTE(     int fd;                                              )
-        CHAZ_QUOTE(     fd = open("_charm_lseek", O_WRONLY | O_CREAT, 0666); )
-        CHAZ_QUOTE(     if (fd == -1) { return -1; }                         )
-        CHAZ_QUOTE(     %s(fd, 0, SEEK_SET);                                 )
-        CHAZ_QUOTE(     printf("%%d", 1);                                    )
-        CHAZ_QUOTE(     if (close(fd)) { return -1; }                        )
-        CHAZ_QUOTE(     return 0;                                            )
-        CHAZ_QUOTE( }                                                        );
-    char code_buf[sizeof(lseek_code) + 100];
-    char *output = NULL;
-    size_t output_len;
-    int success = false;
-
-    /* Verify compilation. */
-    sprintf(code_buf, lseek_code, combo->includes, combo->lseek_command);
-    output = chaz_CC_capture_output(code_buf, &output_len);
-    if (output != NULL) {
-        success = true;
-        free(output);
-    }
-
-    if (!chaz_Util_remove_and_verify("_charm_lseek")) {
-        chaz_Util_die("Failed to remove '_charm_lseek'");
-    }
-
-    return success;
-}
-
-static int
-chaz_LargeFiles_probe_pread64(chaz_LargeFiles_unbuff_combo *combo) {
-    /* Code for checking 64-bit pread.  The pread call will fail, but that's
-     * fine as long as it compiles. */
-    static const char pread64_code[] =
-        CHAZ_QUOTE(  %s                                     )
-        CHAZ_QUOTE(  #include <stdio.h>                     )
-        CHAZ_QUOTE(  int main() {                           )
-        CHAZ_QUOTE(      int fd = 20;                       )
-        CHAZ_QUOTE(      char buf[1];                       )
-        CHAZ_QUOTE(      printf("1");                       )
-        CHAZ_QUOTE(      %s(fd, buf, 1, 1);                 )
-        CHAZ_QUOTE(      return 0;                          )
-        CHAZ_QUOTE(  }                                      );
-    char code_buf[sizeof(pread64_code) + 100];
-    char *output = NULL;
-    size_t output_len;
-    int success = false;
-
-    /* Verify compilation. */
-    sprintf(code_buf, pread64_code, combo->includes, combo->pread64_command);
-    output = chaz_CC_capture_output(code_buf, &output_len);
-    if (output != NULL) {
-        success = true;
-        free(output);
-    }
-
-    return success;
-}
-
-static void
-chaz_LargeFiles_probe_unbuff(void) {
-    static chaz_LargeFiles_unbuff_combo unbuff_combos[] = {
-        { "#include <unistd.h>\n#include <fcntl.h>\n", "lseek64",   "pread64" },
-        { "#include <unistd.h>\n#include <fcntl.h>\n", "lseek",     "pread"      },
-        { "#include <io.h>\n#include <fcntl.h>\n",     "_lseeki64", "NO_PREAD64" },
-        { NULL, NULL, NULL }
-    };
-    int i;
-
-    for (i = 0; unbuff_combos[i].lseek_command != NULL; i++) {
-        chaz_LargeFiles_unbuff_combo combo = unbuff_combos[i];
-        if (chaz_LargeFiles_probe_lseek(&combo)) {
-            chaz_ConfWriter_add_def("HAS_64BIT_LSEEK", NULL);
-            chaz_ConfWriter_add_def("lseek64", combo.lseek_command);
-            break;
-        }
-    }
-    for (i = 0; unbuff_combos[i].pread64_command != NULL; i++) {
-        chaz_LargeFiles_unbuff_combo combo = unbuff_combos[i];
-        if (chaz_LargeFiles_probe_pread64(&combo)) {
-            chaz_ConfWriter_add_def("HAS_64BIT_PREAD", NULL);
-            chaz_ConfWriter_add_def("pread64", combo.pread64_command);
-            break;
-        }
-    }
-}
-
@@ -18,11 +18,43 @@
 #include "Charmonizer/Core/Compiler.h"
 #include "Charmonizer/Core/HeaderChecker.h"
 #include "Charmonizer/Core/ConfWriter.h"
+#include "Charmonizer/Core/ProbeTable.h"
 #include "Charmonizer/Core/Util.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+/* Candidates for alloca() or equivalent, in order of preference. */
+static const chaz_ProbeCandidate chaz_Memory_alloca_candidates[] = {
+    /* Unixen. */
+    { "alloca.h", { "alloca" },
+      { { "HAS_ALLOCA_H", NULL }, { "alloca", "alloca" } },
+      0, CHAZ_CC_MSVC },
+    /*
+     * FIXME: Under MinGW, alloca is defined in malloc.h. This probe
+     * produces compiler warnings but works regardless. These warnings
+     * are subsequently repeated during the build.
+     */
+    { "stdlib.h", { "alloca" },
+      { { "ALLOCA_IN_STDLIB_H", NULL }, { "alloca", "alloca" } },
+      0, 0 },
+    { "", { "__builtin_alloca" },
+      { { "alloca", "__builtin_alloca" } },
+      0, CHAZ_CC_MSVC },
+    /* Windows. */
+    { "malloc.h", { "alloca" },
+      { { "HAS_MALLOC_H", NULL }, { "alloca", "alloca" } },
+      0, 0 },
+    { "malloc.h", { "_alloca" },
+      { { "HAS_MALLOC_H", NULL }, { "chy_alloca", "_alloca" } },
+      0, CHAZ_CC_NO_MS_EXT },
+    { NULL }
+};
+static const chaz_ProbeTable chaz_Memory_alloca_table = {
+    CHAZ_PROBETABLE_COMPILES, "void *foo = $1(1);\nreturn 0;", NULL, NULL,
+    chaz_Memory_alloca_candidates
+};
+
 /* Probe for alloca() or equivalent. */
 static void
 chaz_Memory_probe_alloca(void);
@@ -38,21 +70,6 @@ chaz_Memory_run(void) {
 
 static void
 chaz_Memory_probe_alloca(void) {
-    static const char alloca_code[] =
-        "#include <%s>\n"
-        CHAZ_QUOTE(  int main() {                   )
-        CHAZ_QUOTE(      void *foo = %s(1);         )
-        CHAZ_QUOTE(      return 0;                  )
-        CHAZ_QUOTE(  }                              );
-    int has_sys_mman_h = false;
-    int has_alloca_h   = false;
-    int has_malloc_h   = false;
-    int need_stdlib_h  = false;
-    int has_alloca     = false;
-    int has_builtin_alloca    = false;
-    int has_underscore_alloca = false;
-    char code_buf[sizeof(alloca_code) + 100];
-
     {
         /* OpenBSD needs sys/types.h for sys/mman.h to work and mmap() to be
          * available. Everybody else that has sys/mman.h should have
@@ -63,61 +80,9 @@ chaz_Memory_probe_alloca(void) {
             NULL
         };
         if (chaz_HeadCheck_check_many_headers((const char**)mman_headers)) {
-            has_sys_mman_h = true;
             chaz_ConfWriter_add_def("HAS_SYS_MMAN_H", NULL);
         }
     }
 
-    /* Unixen. */
-    sprintf(code_buf, alloca_code, "alloca.h", "alloca");
-    if (chaz_CC_test_compile(code_buf)) {
-        has_alloca_h = true;
-        has_alloca   = true;
-        chaz_ConfWriter_add_def("HAS_ALLOCA_H", NULL);
-        chaz_ConfWriter_add_def("alloca", "alloca");
-    }
-    if (!has_alloca) {
-        /*
-         * FIXME: Under MinGW, alloca is defined in malloc.h. This probe
-         * produces compiler warnings but works regardless. These warnings
-         * are subsequently repeated during the build.
-         */
-        sprintf(code_buf, alloca_code, "stdlib.h", "alloca");
-        if (chaz_CC_test_compile(code_buf)) {
-            has_alloca    = true;
-            need_stdlib_h = true;
-            chaz_ConfWriter_add_def("ALLOCA_IN_STDLIB_H", NULL);
-            chaz_ConfWriter_add_def("alloca", "alloca");
-        }
-    }
-    if (!has_alloca) {
-        sprintf(code_buf, alloca_code, "stdio.h", /* stdio.h is filler */
-                "__builtin_alloca");
-        if (chaz_CC_test_compile(code_buf)) {
-            has_builtin_alloca = true;
-            chaz_ConfWriter_add_def("alloca", "__builtin_alloca");
-        }
-    }
-
-    /* Windows. */
-    if (!(has_alloca || has_builtin_alloca)) {
-        sprintf(code_buf, alloca_code, "malloc.h", "alloca");
-        if (chaz_CC_test_compile(code_buf)) {
-            has_malloc_h = true;
-            has_alloca   = true;
-            chaz_ConfWriter_add_def("HAS_MALLOC_H", NULL);
-            chaz_ConfWriter_add_def("alloca", "alloca");
-        }
-    }
-    if (!(has_alloca || has_builtin_alloca)) {
-        sprintf(code_buf, alloca_code, "malloc.h", "_alloca");
-        if (chaz_CC_test_compile(code_buf)) {
-            has_malloc_h = true;
-            has_underscore_alloca = true;
-            chaz_ConfWriter_add_def("HAS_MALLOC_H", NULL);
-            chaz_ConfWriter_add_def("chy_alloca", "_alloca");
-        }
-    }
+    chaz_ProbeTable_resolve(&chaz_Memory_alloca_table, NULL);
 }
-
-
@@ -16,6 +16,7 @@
 
 #include "Charmonizer/Core/Compiler.h"
 #include "Charmonizer/Core/ConfWriter.h"
+#include "Charmonizer/Core/ProbeQueue.h"
 #include "Charmonizer/Probe/Strings.h"
 
 #include <stdlib.h>
@@ -63,33 +64,48 @@ chaz_Strings_probe_c99_snprintf(void) {
         CHAZ_QUOTE(      printf("%d", result);                      )
         CHAZ_QUOTE(      return 0;                                  )
         CHAZ_QUOTE(  }                                              );
-    char   *output = NULL;
-    size_t  output_len;
+    chaz_ProbeQueue *queue = chaz_ProbeQueue_new();
+    const char *output = NULL;
+    size_t      output_len;
+    int snprintf_job, scprintf_job, underscore_snprintf_job;
+
+    snprintf_job = chaz_ProbeQueue_add_capture(queue, snprintf_code);
+    scprintf_job = chaz_ProbeQueue_add_capture(queue, detect__scprintf_code);
+    underscore_snprintf_job
+        = chaz_ProbeQueue_add_capture(queue, detect__snprintf_code);
+    chaz_ProbeQueue_run(queue);
 
     /* If the buffer passed to snprintf is too small, verify that snprintf
      * returns the length of the untruncated string which would have been
      * written to a large enough buffer.
      */
-    output = chaz_CC_capture_output(snprintf_code, &output_len);
-    if (output != NULL) {
+    output = chaz_ProbeQueue_output(queue, snprintf_job, &output_len);
+    if (!chaz_CC_can_run()) {
+        /* Only the MSVC runtime before Visual Studio 2015 is known to get
+         * this wrong. */
+        int msvc_version = chaz_CC_msvc_version_num();
+        if (chaz_ProbeQueue_succeeded(queue, snprintf_job)
+            && (msvc_version == 0 || msvc_version >= 1900)
+           ) {
+            chaz_ConfWriter_add_def("HAS_C99_SNPRINTF", NULL);
+        }
+    }
+    else if (output != NULL) {
         long result = strtol(output, NULL, 10);
         if (result == 5) {
             chaz_ConfWriter_add_def("HAS_C99_SNPRINTF", NULL);
         }
-        free(output);
     }
 
     /* Test for _scprintf and _snprintf found in the MSVCRT.
      */
-    output = chaz_CC_capture_output(detect__scprintf_code, &output_len);
-    if (output != NULL) {
+    if (chaz_ProbeQueue_passed(queue, scprintf_job)) {
         chaz_ConfWriter_add_def("HAS__SCPRINTF", NULL);
-        free(output);
     }
-    output = chaz_CC_capture_output(detect__snprintf_code, &output_len);
-    if (output != NULL) {
+    if (chaz_ProbeQueue_passed(queue, underscore_snprintf_job)) {
         chaz_ConfWriter_add_def("HAS__SNPRINTF", NULL);
-        free(output);
     }
+
+    chaz_ProbeQueue_destroy(queue);
 }
 
@@ -17,6 +17,7 @@
 #include "Charmonizer/Probe/SymbolVisibility.h"
 #include "Charmonizer/Core/Compiler.h"
 #include "Charmonizer/Core/ConfWriter.h"
+#include "Charmonizer/Core/Features.h"
 #include "Charmonizer/Core/Util.h"
 #include <string.h>
 #include <stdio.h>
@@ -33,14 +34,36 @@ static const char chaz_SymbolVisibility_symbol_exporting_code[] =
 void
 chaz_SymbolVisibility_run(void) {
     chaz_CFlags *temp_cflags = chaz_CC_get_temp_cflags();
+    int traits = chaz_CC_traits();
     int can_control_visibility = false;
     char code_buf[sizeof(chaz_SymbolVisibility_symbol_exporting_code) + 100];
 
     chaz_ConfWriter_start_module("SymbolVisibility");
     chaz_CFlags_set_warnings_as_errors(temp_cflags);
 
-    /* Sun C. */
-    if (!can_control_visibility) {
+    /* Compilers which know __has_attribute can vouch for GCC's visibility
+     * attribute without compiling anything.  Sun C and Windows compilers
+     * try their own syntax first. */
+    if (!chaz_CC_sun_c_version_num()
+        && chaz_CC_macro_value("_WIN32") == NULL
+        && chaz_CC_macro_value("__CYGWIN__") == NULL
+       ) {
+        chaz_Features *features = chaz_Features_new();
+        int visibility = chaz_Features_add_attribute(features, "visibility");
+        chaz_Features_run(features);
+        if (chaz_Features_answer(features, visibility) == CHAZ_FEATURES_YES) {
+            can_control_visibility = true;
+            chaz_ConfWriter_add_def("EXPORT",
+                "__attribute__ ((visibility (\"default\")))");
+            chaz_ConfWriter_add_def("IMPORT", NULL);
+        }
+        chaz_Features_destroy(features);
+    }
+
+    /* Sun C.  GCC, clang and MSVC don't know __global. */
+    if (!can_control_visibility
+        && !(traits & (CHAZ_CC_GNU | CHAZ_CC_MSVC))
+       ) {
         char export_sun[] = "__global";
         sprintf(code_buf, chaz_SymbolVisibility_symbol_exporting_code,
                 export_sun);
@@ -52,7 +75,7 @@ chaz_SymbolVisibility_run(void) {
     }
 
     /* Windows. */
-    if (!can_control_visibility) {
+    if (!can_control_visibility && !(traits & CHAZ_CC_NO_MS_EXT)) {
         char export_win[] = "__declspec(dllexport)";
         sprintf(code_buf, chaz_SymbolVisibility_symbol_exporting_code,
                 export_win);
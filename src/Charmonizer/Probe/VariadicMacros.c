@@ -16,6 +16,7 @@
 
 #include "Charmonizer/Core/Compiler.h"
 #include "Charmonizer/Core/ConfWriter.h"
+#include "Charmonizer/Core/ProbeQueue.h"
 #include "Charmonizer/Core/Util.h"
 #include "Charmonizer/Probe/VariadicMacros.h"
 #include <string.h>
@@ -44,36 +45,40 @@ static const char chaz_VariadicMacros_gnuc_code[] =
 
 void
 chaz_VariadicMacros_run(void) {
-    char *output;
-    size_t output_len;
+    chaz_ProbeQueue *queue = chaz_ProbeQueue_new();
+    int iso_job, gnuc_job;
     int has_varmacros      = false;
     int has_iso_varmacros  = false;
     int has_gnuc_varmacros = false;
 
     chaz_ConfWriter_start_module("VariadicMacros");
 
+    iso_job  = chaz_ProbeQueue_add_capture(queue,
+                                           chaz_VariadicMacros_iso_code);
+    gnuc_job = chaz_ProbeQueue_add_capture(queue,
+                                           chaz_VariadicMacros_gnuc_code);
+    chaz_ProbeQueue_run(queue);
+
     /* Test for ISO-style variadic macros. */
-    output = chaz_CC_capture_output(chaz_VariadicMacros_iso_code, &output_len);
-    if (output != NULL) {
+    if (chaz_ProbeQueue_passed(queue, iso_job)) {
         has_varmacros = true;
         has_iso_varmacros = true;
         chaz_ConfWriter_add_def("HAS_VARIADIC_MACROS", NULL);
         chaz_ConfWriter_add_def("HAS_ISO_VARIADIC_MACROS", NULL);
-        free(output);
     }
 
     /* Test for GNU-style variadic macros. */
-    output = chaz_CC_capture_output(chaz_VariadicMacros_gnuc_code, &output_len);
-    if (output != NULL) {
+    if (chaz_ProbeQueue_passed(queue, gnuc_job)) {
         has_gnuc_varmacros = true;
         if (has_varmacros == false) {
             has_varmacros = true;
             chaz_ConfWriter_add_def("HAS_VARIADIC_MACROS", NULL);
         }
         chaz_ConfWriter_add_def("HAS_GNUC_VARIADIC_MACROS", NULL);
-        free(output);
     }
 
+    chaz_ProbeQueue_destroy(queue);
+
     chaz_ConfWriter_end_module();
 }
 
@@ -0,0 +1,134 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define CHAZ_USE_SHORT_NAMES
+
+#include "charmony.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Charmonizer/Core/Cache.h"
+#include "Charmonizer/Core/OperatingSystem.h"
+#include "Charmonizer/Core/Util.h"
+#include "Charmonizer/Test.h"
+
+#define TEST_DIR "_cache_test"
+
+/* Return true if [key] is a hit with [result] and exactly [len] bytes of
+ * [expected] as its output.
+ */
+static int
+S_fetches(const char *key, int result, const char *expected, size_t len) {
+    char   *output     = NULL;
+    size_t  output_len = 0;
+    int     got_result = -1;
+    int     matches;
+
+    if (!chaz_Cache_fetch(key, &got_result, &output, &output_len)) {
+        return 0;
+    }
+    matches = got_result == result
+              && output != NULL
+              && output_len == len
+              && memcmp(output, expected, len) == 0
+              && output[len] == '\0';
+    free(output);
+    return matches;
+}
+
+static void
+S_remove_entry(const char *key) {
+    char *path = chaz_Util_join("/", TEST_DIR, key, NULL);
+    remove(path);
+    free(path);
+}
+
+static void
+S_run_tests(void) {
+    static const char binary[] = "two\nlines\0and a NUL";
+    char   *key_full    = chaz_Cache_key("output", "full", NULL);
+    char   *key_binary  = chaz_Cache_key("output", "binary", NULL);
+    char   *key_empty   = chaz_Cache_key("output", "empty", NULL);
+    char   *key_none    = chaz_Cache_key("output", "none", NULL);
+    char   *key_missing = chaz_Cache_key("output", "missing", NULL);
+    char   *key_split   = chaz_Cache_key("outp", "utfull", NULL);
+    char   *output;
+    size_t  output_len;
+    int     result;
+
+    chaz_Util_verbosity = 0;
+    chaz_OS_init();
+
+    OK(!chaz_Cache_fetch(key_full, &result, &output, &output_len),
+       "Nothing is found before the cache is enabled");
+    chaz_Cache_init(TEST_DIR);
+    OK(chaz_Cache_enabled(), "Cache enabled");
+    OK(strcmp(key_full, key_split) != 0,
+       "Keys depend on where the parts are split");
+    /* 64-bit FNV-1a of "output\0full\0". */
+    STR_EQ(key_full, "0af4c7299c233bc3", "Keys are 64-bit FNV-1a hashes");
+
+    chaz_Cache_store(key_full, 1, "output\n", 7);
+    chaz_Cache_store(key_binary, 1, binary, sizeof(binary) - 1);
+    chaz_Cache_store(key_empty, 1, "", 0);
+    chaz_Cache_store(key_none, 0, NULL, 0);
+
+    OK(S_fetches(key_full, 1, "output\n", 7), "Output round-trips");
+    OK(S_fetches(key_binary, 1, binary, sizeof(binary) - 1),
+       "Newlines and NULs round-trip");
+    OK(S_fetches(key_empty, 1, "", 0),
+       "Empty output comes back as an empty string");
+
+    output = (char*)"junk";
+    result = -1;
+    OK(chaz_Cache_fetch(key_none, &result, &output, &output_len)
+       && result == 0 && output == NULL && output_len == 0,
+       "Missing output comes back as NULL");
+    OK(!chaz_Cache_fetch(key_missing, &result, &output, &output_len),
+       "Unknown key misses");
+
+    chaz_Cache_store(key_full, 2, "changed", 7);
+    OK(S_fetches(key_full, 2, "changed", 7), "Entries can be replaced");
+
+    chaz_Cache_clean_up();
+    OK(!chaz_Cache_fetch(key_full, &result, &output, &output_len),
+       "Nothing is found after clean up");
+
+    /* The entries live on in the directory. */
+    chaz_Cache_init(TEST_DIR);
+    OK(S_fetches(key_empty, 1, "", 0), "Entries persist");
+    chaz_Cache_clean_up();
+
+    S_remove_entry(key_full);
+    S_remove_entry(key_binary);
+    S_remove_entry(key_empty);
+    S_remove_entry(key_none);
+    chaz_OS_rmdir(TEST_DIR);
+
+    free(key_full);
+    free(key_binary);
+    free(key_empty);
+    free(key_none);
+    free(key_missing);
+    free(key_split);
+}
+
+int main(int argc, char **argv) {
+    Test_start(12);
+    S_run_tests();
+    return !Test_finish();
+}
+
@@ -0,0 +1,119 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define CHAZ_USE_SHORT_NAMES
+
+#include "charmony.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Charmonizer/Core/Compiler.h"
+#include "Charmonizer/Core/OperatingSystem.h"
+#include "Charmonizer/Core/Scratch.h"
+#include "Charmonizer/Core/Util.h"
+#include "Charmonizer/Test.h"
+
+/* More than fits into a pipe at once, so that reading and writing have to
+ * take turns.
+ */
+#define BIG_LEN 300000
+
+static void
+S_test_pipes(void) {
+    char   *input = (char*)malloc(BIG_LEN);
+    char   *output;
+    size_t  output_len;
+    int     status;
+    size_t  i;
+
+    output = chaz_OS_run_and_capture("echo hello", &output_len);
+    STR_EQ(output, "hello\n", "Capture stdout");
+    LONG_EQ((long)output_len, 6, "Output length");
+    free(output);
+
+    output = chaz_OS_run_and_capture_status("false", &output_len, &status);
+    OK(output == NULL && status != 0,
+       "No output and the exit status of a failing command");
+
+    status = chaz_OS_run_piped("cat", "a\0b\n", 4, &output, &output_len);
+    OK(status == 0 && output_len == 4 && memcmp(output, "a\0b\n", 4) == 0,
+       "Input with a NUL goes through stdin and back unchanged");
+    free(output);
+
+    /* Feeding a large input while the output piles up must not deadlock. */
+    for (i = 0; i < BIG_LEN; i++) {
+        input[i] = (char)('a' + i % 26);
+    }
+    status = chaz_OS_run_piped("cat", input, BIG_LEN, &output, &output_len);
+    OK(status == 0 && output_len == BIG_LEN
+       && memcmp(output, input, BIG_LEN) == 0,
+       "Large input and output through pipes");
+    free(output);
+
+    status = chaz_OS_run_piped("cat", input, BIG_LEN, NULL, NULL);
+    LONG_EQ(status, 0, "Output can be discarded");
+
+    free(input);
+}
+
+static void
+S_test_probe_output(void) {
+    static const char code[] =
+        "#include <stdio.h>\n"
+        "int main() {\n"
+        "    printf(\"line 1\\nline 2\");\n"
+        "    fflush(stdout);\n"
+        "    fprintf(stderr, \"!\");\n"
+        "    return 0;\n"
+        "}\n";
+    char   *output;
+    size_t  output_len;
+
+    chaz_CC_init("cc", "");
+    OK(chaz_CC_test_compile("int main() { return 0; }\n"),
+       "Compile a source fed through stdin");
+    OK(!chaz_CC_test_compile("int main() { return chaz_no_such_var; }\n"),
+       "Failures are still noticed");
+
+    output = chaz_CC_capture_output(code, &output_len);
+    STR_EQ(output, "line 1\nline 2!", "Capture a probe's stdout and stderr");
+    free(output);
+    chaz_CC_clean_up();
+}
+
+static void
+S_run_tests(void) {
+    chaz_Util_verbosity = 0;
+    chaz_OS_init();
+    if (!chaz_OS_can_pipe()) {
+        SKIP_REMAINING("No pipes on this system");
+        return;
+    }
+    chaz_Scratch_init();
+
+    S_test_pipes();
+    S_test_probe_output();
+
+    chaz_Scratch_clean_up();
+}
+
+int main(int argc, char **argv) {
+    Test_start(9);
+    S_run_tests();
+    return !Test_finish();
+}
+
@@ -0,0 +1,107 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define CHAZ_USE_SHORT_NAMES
+
+#include "charmony.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Charmonizer/Test.h"
+
+#define TEST_DIR "_fakecc_test"
+
+/* A Sun C compiler on a platform without long long or the C99 integer
+ * headers.
+ */
+static const char S_rules[] =
+    "style sun\n"
+    "define __SUNPRO_C 0x5130\n"
+    "hide __GNUC__\n"
+    "fail long long\n"
+    "fail <stdint.h>\n"
+    "fail <inttypes.h>\n";
+
+static char*
+S_slurp(const char *path) {
+    FILE   *file = fopen(path, "rb");
+    char   *content;
+    size_t  len;
+
+    if (file == NULL) { return NULL; }
+    content = (char*)malloc(100000);
+    len = fread(content, 1, 99999, file);
+    content[len] = '\0';
+    fclose(file);
+    return content;
+}
+
+static void
+S_run_tests(void) {
+    FILE *file;
+    char *header;
+    char *log;
+    int   status;
+
+#ifndef HAS_UNISTD_H
+    SKIP_REMAINING("fakecc needs a POSIX shell");
+    return;
+#endif
+    file = fopen("fakecc", "r");
+    if (file == NULL) {
+        SKIP_REMAINING("fakecc hasn't been built");
+        return;
+    }
+    fclose(file);
+
+    system("rm -rf " TEST_DIR " && mkdir " TEST_DIR);
+    file = fopen(TEST_DIR "/rules", "w");
+    if (file == NULL) {
+        SKIP_REMAINING("Can't create " TEST_DIR);
+        return;
+    }
+    fputs(S_rules, file);
+    fclose(file);
+
+    status = system("cd " TEST_DIR " && FAKECC_RULES=rules FAKECC_LOG=log "
+                    "../charmonize --cc=../fakecc --enable-c >out.txt 2>&1");
+    OK(status == 0, "charmonize runs against fakecc");
+
+    header = S_slurp(TEST_DIR "/charmony.h");
+    log    = S_slurp(TEST_DIR "/log");
+    if (header == NULL || log == NULL) {
+        SKIP_REMAINING("No output from charmonize");
+        return;
+    }
+
+    OK(strstr(log, " -xe") != NULL, "Sun C options are used");
+    OK(strstr(log, "failed by rule") != NULL, "Rules reject probes");
+    OK(strstr(header, "CHY_HAS_LONG_LONG") == NULL, "No long long");
+    OK(strstr(header, "CHY_HAS_STDINT_H") == NULL, "No stdint.h");
+    OK(strstr(header, "typedef signed char chy_int8_t;") != NULL,
+       "Integer types are defined without stdint.h");
+
+    free(header);
+    free(log);
+    system("rm -rf " TEST_DIR);
+}
+
+int main(int argc, char **argv) {
+    Test_start(6);
+    S_run_tests();
+    return !Test_finish();
+}
+
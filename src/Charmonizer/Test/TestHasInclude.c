@@ -0,0 +1,149 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define CHAZ_USE_SHORT_NAMES
+
+#include "charmony.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Charmonizer/Core/Compiler.h"
+#include "Charmonizer/Core/HeaderChecker.h"
+#include "Charmonizer/Core/OperatingSystem.h"
+#include "Charmonizer/Core/Scratch.h"
+#include "Charmonizer/Core/Trace.h"
+#include "Charmonizer/Core/Util.h"
+#include "Charmonizer/Test.h"
+
+#define TEST_DIR    "_hasinclude_test"
+#define BROKEN_H    TEST_DIR "/chaz_broken.h"
+#define TRACE_PATH  "_hasinclude_trace.json"
+
+/* Return the number of compiles in the trace at [path].
+ */
+static int
+S_count_compiles(const char *path) {
+    size_t  len;
+    char   *trace = chaz_Util_slurp_file(path, &len);
+    char   *ptr   = trace;
+    int     count = 0;
+
+    while (ptr != NULL && (ptr = strstr(ptr, "\"cat\":\"compile\"")) != NULL) {
+        count++;
+        ptr++;
+    }
+    free(trace);
+    return count;
+}
+
+/* Return 1 or 0 if the register knows whether [header] exists, -1 if it
+ * doesn't know.
+ */
+static int
+S_known(const char *header) {
+    int exists;
+    if (!chaz_HeadCheck_lookup(header, &exists)) { return -1; }
+    return exists ? 1 : 0;
+}
+
+/* Return false if the compiler doesn't support __has_include.
+ */
+static int
+S_test_discovery(void) {
+    const char *headers[4];
+    int discovered;
+
+    headers[0] = "stddef.h";
+    headers[1] = "limits.h";
+    headers[2] = "chaz_no_such_header.h";
+    headers[3] = NULL;
+
+    chaz_Trace_init(TRACE_PATH);
+    discovered = chaz_HeadCheck_discover_headers(headers);
+    chaz_Trace_clean_up();
+    if (!discovered) {
+        SKIP_REMAINING("The compiler doesn't support __has_include");
+        return 0;
+    }
+    PASS("Compiler supports __has_include");
+
+    LONG_EQ(S_known("stddef.h"), 1, "Existing header is found");
+    LONG_EQ(S_known("limits.h"), 1, "Another existing header is found");
+    LONG_EQ(S_known("chaz_no_such_header.h"), 0, "Missing header is known");
+    OK(S_count_compiles(TRACE_PATH) <= 2,
+       "One preprocessor run and one confirming compile");
+    remove(TRACE_PATH);
+    remove(TRACE_PATH ".txt");
+    return 1;
+}
+
+static void
+S_test_fallback(void) {
+    const char *headers[3];
+
+    /* __has_include finds the broken header, but it doesn't compile, so
+     * the confirming batch fails and gets bisected. */
+    headers[0] = "chaz_broken.h";
+    headers[1] = "stdlib.h";
+    headers[2] = NULL;
+    OK(chaz_HeadCheck_discover_headers(headers),
+       "Discovery runs with a broken header");
+    LONG_EQ(S_known("chaz_broken.h"), 0,
+            "Broken header is registered as missing");
+    LONG_EQ(S_known("stdlib.h"), 1,
+            "Header found next to it is registered as present");
+    OK(!chaz_HeadCheck_check_header("chaz_broken.h"),
+       "Checking the broken header agrees");
+    OK(chaz_HeadCheck_check_header("stdlib.h"),
+       "Checking the good header agrees");
+}
+
+static void
+S_run_tests(void) {
+    FILE *file;
+
+    chaz_Util_verbosity = 0;
+    chaz_OS_init();
+    chaz_Scratch_init();
+    chaz_OS_mkdir(TEST_DIR);
+    file = fopen(BROKEN_H, "w");
+    if (file == NULL) {
+        SKIP_REMAINING("Can't create " BROKEN_H);
+        return;
+    }
+    fputs("#error This header doesn't compile\n", file);
+    fclose(file);
+    chaz_CC_init("cc", "-I" TEST_DIR);
+
+    /* chaz_HeadCheck_init isn't called, since it would discover the usual
+     * headers before the tests get to. */
+
+    if (S_test_discovery()) {
+        S_test_fallback();
+    }
+
+    chaz_CC_clean_up();
+    chaz_Scratch_clean_up();
+    remove(BROKEN_H);
+    chaz_OS_rmdir(TEST_DIR);
+}
+
+int main(int argc, char **argv) {
+    Test_start(10);
+    S_run_tests();
+    return !Test_finish();
+}
+
@@ -0,0 +1,111 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define CHAZ_USE_SHORT_NAMES
+
+#include "charmony.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Charmonizer/Core/Memo.h"
+#include "Charmonizer/Test.h"
+
+/* Enough entries for the table to double several times. */
+#define NUM_KEYS 1000
+
+static void
+S_test_growth(void) {
+    char    key[40];
+    char   *output;
+    size_t  output_len;
+    int     result;
+    int     num_wrong = 0;
+    int     i;
+
+    for (i = 0; i < NUM_KEYS; i++) {
+        sprintf(key, "key %d", i);
+        chaz_Memo_store(1, key, i, key, strlen(key));
+    }
+    for (i = 0; i < NUM_KEYS; i++) {
+        sprintf(key, "key %d", i);
+        if (!chaz_Memo_fetch(1, key, &result, &output, &output_len)
+            || result != i
+            || output == NULL
+            || output_len != strlen(key)
+            || strcmp(output, key) != 0
+           ) {
+            num_wrong++;
+        }
+        free(output);
+    }
+    LONG_EQ(num_wrong, 0, "Every entry survives the table growing");
+    LONG_EQ(chaz_Memo_hits(), NUM_KEYS, "Every lookup counts as a hit");
+    LONG_EQ(chaz_Memo_misses(), 0, "No misses so far");
+
+    OK(!chaz_Memo_fetch(2, "key 1", &result, NULL, NULL),
+       "Kinds keep keys apart");
+    OK(!chaz_Memo_fetch(1, "key 1000", &result, NULL, NULL),
+       "Unknown key misses");
+    LONG_EQ(chaz_Memo_misses(), 2, "Misses are counted");
+}
+
+static void
+S_test_entries(void) {
+    char   *output;
+    size_t  output_len;
+    int     result;
+
+    chaz_Memo_store(2, "replaced", 1, "old", 3);
+    chaz_Memo_store(2, "replaced", 0, NULL, 0);
+    OK(chaz_Memo_fetch(2, "replaced", &result, &output, &output_len)
+       && result == 0 && output == NULL && output_len == 0,
+       "Results can be replaced, and NULL output stays NULL");
+
+    chaz_Memo_store(2, "empty", 1, "", 0);
+    OK(chaz_Memo_fetch(2, "empty", &result, &output, &output_len)
+       && result == 1 && output != NULL && output[0] == '\0'
+       && output_len == 0,
+       "Empty output comes back as an empty string");
+    free(output);
+
+    OK(chaz_Memo_fetch(2, "empty", &result, NULL, NULL) && result == 1,
+       "Output is optional when fetching");
+}
+
+static void
+S_run_tests(void) {
+    int result;
+
+    OK(!chaz_Memo_fetch(1, "key 1", &result, NULL, NULL),
+       "Empty memo misses");
+    chaz_Memo_clean_up();
+    LONG_EQ(chaz_Memo_misses(), 0, "Clean up resets the counters");
+
+    S_test_growth();
+    S_test_entries();
+
+    chaz_Memo_clean_up();
+    OK(!chaz_Memo_fetch(1, "key 1", &result, NULL, NULL),
+       "Clean up forgets everything");
+    LONG_EQ(chaz_Memo_hits(), 0, "Clean up resets the hits");
+}
+
+int main(int argc, char **argv) {
+    Test_start(13);
+    S_run_tests();
+    return !Test_finish();
+}
+
@@ -0,0 +1,154 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define CHAZ_USE_SHORT_NAMES
+
+#include "charmony.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Charmonizer/Core/Compiler.h"
+#include "Charmonizer/Core/HeaderChecker.h"
+#include "Charmonizer/Core/OperatingSystem.h"
+#include "Charmonizer/Core/ProbeBatch.h"
+#include "Charmonizer/Core/Scratch.h"
+#include "Charmonizer/Core/Trace.h"
+#include "Charmonizer/Core/Util.h"
+#include "Charmonizer/Test.h"
+
+#define TRACE_PATH "_probebatch_trace.json"
+#define NUM_PROBES 16
+#define BAD_PROBE  11
+
+/* Return the number of compiles in the trace at [path].
+ */
+static int
+S_count_compiles(const char *path) {
+    size_t  len;
+    char   *trace = chaz_Util_slurp_file(path, &len);
+    char   *ptr   = trace;
+    int     count = 0;
+
+    while (ptr != NULL && (ptr = strstr(ptr, "\"cat\":\"compile\"")) != NULL) {
+        count++;
+        ptr++;
+    }
+    free(trace);
+    return count;
+}
+
+static void
+S_test_bisection(void) {
+    chaz_ProbeBatch *batch = chaz_ProbeBatch_new();
+    int num_succeeded = 0;
+    int compiles;
+    int i;
+
+    /* One bad probe among many good ones. */
+    chaz_Trace_init(TRACE_PATH);
+    for (i = 0; i < NUM_PROBES; i++) {
+        chaz_ProbeBatch_add(batch, NULL, i == BAD_PROBE
+                                         ? "return chaz_no_such_var;"
+                                         : "return 0;");
+    }
+    chaz_ProbeBatch_run(batch);
+    chaz_Trace_clean_up();
+
+    for (i = 0; i < NUM_PROBES; i++) {
+        if (chaz_ProbeBatch_succeeded(batch, i)) { num_succeeded++; }
+    }
+    OK(!chaz_ProbeBatch_succeeded(batch, BAD_PROBE),
+       "Bisection pins down the failing probe");
+    LONG_EQ(num_succeeded, NUM_PROBES - 1, "All other probes succeed");
+    compiles = S_count_compiles(TRACE_PATH);
+    OK(compiles > 1 && compiles < NUM_PROBES,
+       "Bisection takes fewer compiles than probing one at a time");
+    remove(TRACE_PATH);
+    remove(TRACE_PATH ".txt");
+
+    chaz_ProbeBatch_destroy(batch);
+}
+
+static void
+S_test_groups(void) {
+    chaz_ProbeBatch *batch = chaz_ProbeBatch_new();
+    int first_bad, second_bad, good, other_good;
+
+    /* Failures in different groups and at both ends of a group. */
+    first_bad  = chaz_ProbeBatch_add(batch, NULL, "return chaz_bad_1;");
+    good       = chaz_ProbeBatch_add(batch, NULL, "return 1;");
+    chaz_ProbeBatch_new_group(batch);
+    other_good = chaz_ProbeBatch_add(batch, NULL, "return 2;");
+    second_bad = chaz_ProbeBatch_add(batch, NULL, "return chaz_bad_2;");
+    chaz_ProbeBatch_run(batch);
+
+    OK(!chaz_ProbeBatch_succeeded(batch, first_bad), "First probe fails");
+    OK(!chaz_ProbeBatch_succeeded(batch, second_bad), "Last probe fails");
+    OK(chaz_ProbeBatch_succeeded(batch, good)
+       && chaz_ProbeBatch_succeeded(batch, other_good),
+       "Good probes next to bad ones succeed");
+
+    chaz_ProbeBatch_destroy(batch);
+}
+
+static void
+S_test_confirm(void) {
+    chaz_ProbeBatch *batch = chaz_ProbeBatch_new();
+    int provider, borrower, header, no_header;
+
+    /* The second probe only compiles thanks to the first one's include. */
+    provider = chaz_ProbeBatch_add(batch, "#include <stddef.h>",
+                                   "size_t n = 0; return (int)n;");
+    borrower = chaz_ProbeBatch_add(batch, NULL,
+                                   "size_t n = 1; return (int)n;");
+    header    = chaz_ProbeBatch_add_header(batch, "stddef.h");
+    no_header = chaz_ProbeBatch_add_header(batch, "chaz_no_such_header.h");
+    chaz_ProbeBatch_run(batch);
+
+    OK(chaz_ProbeBatch_succeeded(batch, borrower),
+       "Probe succeeds in company");
+    OK(!chaz_ProbeBatch_confirm(batch, borrower),
+       "Confirming it on its own fails");
+    OK(chaz_ProbeBatch_confirm(batch, provider), "Provider is confirmed");
+    OK(chaz_ProbeBatch_succeeded(batch, header)
+       && !chaz_ProbeBatch_succeeded(batch, no_header),
+       "Header probes");
+
+    chaz_ProbeBatch_destroy(batch);
+}
+
+static void
+S_run_tests(void) {
+    chaz_Util_verbosity = 0;
+    chaz_OS_init();
+    chaz_Scratch_init();
+    chaz_CC_init("cc", "");
+    chaz_HeadCheck_init();
+
+    S_test_bisection();
+    S_test_groups();
+    S_test_confirm();
+
+    chaz_CC_clean_up();
+    chaz_Scratch_clean_up();
+}
+
+int main(int argc, char **argv) {
+    Test_start(10);
+    S_run_tests();
+    return !Test_finish();
+}
+
@@ -0,0 +1,77 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define CHAZ_USE_SHORT_NAMES
+
+#include "charmony.h"
+#include <stddef.h>
+#include <stdio.h>
+#include "Charmonizer/Core/Compiler.h"
+#include "Charmonizer/Core/OperatingSystem.h"
+#include "Charmonizer/Core/Scratch.h"
+#include "Charmonizer/Core/Util.h"
+#include "Charmonizer/Test.h"
+
+/* Only builds when the optimizer is on, as the user's flags ask for. */
+static const char needs_optimizer[] =
+    "#ifndef __OPTIMIZE__\n"
+    "#error Not optimizing\n"
+    "#endif\n"
+    "int main(void) { return 0; }\n";
+
+static void
+S_test_modes(void) {
+    LONG_EQ(chaz_CC_get_probe_mode(), CHAZ_CC_PROBE_MODE_FAST,
+            "Fast probe mode is the default");
+
+    chaz_CC_set_probe_mode(CHAZ_CC_PROBE_MODE_FULL);
+    if (!chaz_CC_test_link(needs_optimizer)) {
+        SKIP_REMAINING("The compiler doesn't define __OPTIMIZE__");
+        return;
+    }
+    PASS("Full mode links with the user's optimization flags");
+    OK(chaz_CC_test_compile(needs_optimizer),
+       "Full mode compiles with the user's optimization flags");
+
+    /* The same source must not be answered from the full mode's result. */
+    chaz_CC_set_probe_mode(CHAZ_CC_PROBE_MODE_FAST);
+    OK(!chaz_CC_test_link(needs_optimizer),
+       "Fast mode links without optimization");
+    chaz_CC_set_probe_mode(CHAZ_CC_PROBE_MODE_FULL);
+    OK(chaz_CC_test_link(needs_optimizer),
+       "Results are remembered per mode");
+}
+
+static void
+S_run_tests(void) {
+    chaz_Util_verbosity = 0;
+    chaz_OS_init();
+    chaz_Scratch_init();
+    chaz_CC_init("cc", "-O2");
+
+    S_test_modes();
+    chaz_CC_set_probe_mode(CHAZ_CC_PROBE_MODE_FAST);
+
+    chaz_CC_clean_up();
+    chaz_Scratch_clean_up();
+}
+
+int main(int argc, char **argv) {
+    Test_start(5);
+    S_run_tests();
+    return !Test_finish();
+}
+
@@ -0,0 +1,208 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define CHAZ_USE_SHORT_NAMES
+
+#include "charmony.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "Charmonizer/Core/Compiler.h"
+#include "Charmonizer/Core/OperatingSystem.h"
+#include "Charmonizer/Core/Scratch.h"
+#include "Charmonizer/Core/Util.h"
+#include "Charmonizer/Test.h"
+
+#define NUM_TESTS    10
+#define SLEEPER      "_supervise_sleeper"
+#define SPAWNER      "_supervise_spawner"
+#define GUSHER       "_supervise_gusher"
+#define LATE_NAME    "_supervise_late.txt"
+#define OUTPUT_NAME  "_supervise_output.txt"
+
+/* A probe should be stopped after a second; anything near this long means
+ * it wasn't.
+ */
+#define TOO_LONG     20
+
+static const char sleeper_code[] =
+    "#!/bin/sh\n"
+    "exec sleep 1000\n";
+
+/* The background job outlives its parent unless the whole process group is
+ * stopped. */
+static const char spawner_code[] =
+    "#!/bin/sh\n"
+    "(sleep 3; echo late > " LATE_NAME ") &\n"
+    "wait\n";
+
+static const char gusher_code[] =
+    "#!/bin/sh\n"
+    "exec yes\n";
+
+static const char hanging_probe[] =
+    "int main(void) {\n"
+    "    volatile int spin = 1;\n"
+    "    while (spin) {}\n"
+    "    return 0;\n"
+    "}\n";
+
+static const char quick_probe[] =
+    "#include <stdio.h>\n"
+    "int main(void) {\n"
+    "    printf(\"done\");\n"
+    "    return 0;\n"
+    "}\n";
+
+/* Write an executable shell script named [name] to the scratch directory,
+ * where local executables are run.  Return false on failure.
+ */
+static int
+S_write_script(const char *name, const char *code) {
+    char *path    = chaz_Scratch_path(name);
+    char *command = chaz_Util_join("", "chmod +x ", path, NULL);
+    FILE *file    = fopen(path, "w");
+    int   success = false;
+
+    if (file != NULL) {
+        fputs(code, file);
+        fclose(file);
+        success = system(command) == 0;
+    }
+    free(command);
+    free(path);
+    return success;
+}
+
+/* Return true if the scratch file [name] exists, and remove it.
+ */
+static int
+S_take_scratch_file(const char *name) {
+    char *path = chaz_Scratch_path(name);
+    FILE *file = fopen(path, "r");
+    int   exists = file != NULL;
+
+    if (file != NULL) { fclose(file); }
+    remove(path);
+    free(path);
+    return exists;
+}
+
+static void
+S_test_timeout(void) {
+    char   *output_path = chaz_Scratch_path(OUTPUT_NAME);
+    size_t  len         = 1;
+    time_t  start       = time(NULL);
+    char   *output      = chaz_OS_run_local_and_capture(SLEEPER, &len);
+    int     status;
+
+    OK(output == NULL && len == 0,
+       "Captured probe that hangs counts as failed");
+    OK(time(NULL) - start < TOO_LONG, "Captured probe is stopped on time");
+    free(output);
+
+    start  = time(NULL);
+    status = chaz_OS_run_local_redirected(SLEEPER, output_path);
+    LONG_EQ(status, -1, "Redirected probe that hangs counts as failed");
+    OK(time(NULL) - start < TOO_LONG, "Redirected probe is stopped on time");
+    S_take_scratch_file(OUTPUT_NAME);
+    free(output_path);
+}
+
+static void
+S_test_process_group(void) {
+    size_t  len;
+    char   *output = chaz_OS_run_local_and_capture(SPAWNER, &len);
+
+    free(output);
+    /* Give the background job time to write, had it survived. */
+    system("sleep 4");
+    OK(!S_take_scratch_file(LATE_NAME),
+       "Processes started by a probe are stopped too");
+}
+
+static void
+S_test_output_cap(void) {
+    char   *output_path = chaz_Scratch_path(OUTPUT_NAME);
+    size_t  len         = 1;
+    char   *output      = chaz_OS_run_local_and_capture(GUSHER, &len);
+    int     status;
+
+    OK(output == NULL && len == 0,
+       "Captured probe with too much output counts as failed");
+    free(output);
+
+    status = chaz_OS_run_local_redirected(GUSHER, output_path);
+    LONG_EQ(status, -1,
+            "Redirected probe with too much output counts as failed");
+    OK(!S_take_scratch_file(OUTPUT_NAME), "Its output is thrown away");
+    free(output_path);
+}
+
+static void
+S_test_compiled_probes(void) {
+    size_t  len;
+    char   *output = chaz_CC_capture_output(hanging_probe, &len);
+
+    OK(output == NULL, "Compiled probe that hangs counts as failed");
+    free(output);
+
+    output = chaz_CC_capture_output(quick_probe, &len);
+    STR_EQ(output ? output : "", "done",
+           "Quick probes still run under the limits");
+    free(output);
+}
+
+static void
+S_run_tests(void) {
+    chaz_Util_verbosity = 0;
+    chaz_OS_init();
+    chaz_Scratch_init();
+    chaz_CC_init("cc", "");
+
+    if (!chaz_OS_can_pipe()) {
+        SKIP_REMAINING("Probes are only supervised on POSIX hosts");
+    }
+    else if (!S_write_script(SLEEPER, sleeper_code)
+             || !S_write_script(SPAWNER, spawner_code)
+             || !S_write_script(GUSHER, gusher_code)
+            ) {
+        SKIP_REMAINING("Can't write test scripts");
+    }
+    else {
+        chaz_OS_set_run_limits(1, -1, -1, 64 * 1024);
+        S_test_timeout();
+        S_test_process_group();
+        S_test_output_cap();
+        S_test_compiled_probes();
+        chaz_OS_set_run_limits(60, -1, -1, 16 * 1024 * 1024);
+    }
+
+    S_take_scratch_file(SLEEPER);
+    S_take_scratch_file(SPAWNER);
+    S_take_scratch_file(GUSHER);
+    chaz_CC_clean_up();
+    chaz_Scratch_clean_up();
+}
+
+int main(int argc, char **argv) {
+    Test_start(NUM_TESTS);
+    S_run_tests();
+    return !Test_finish();
+}
+
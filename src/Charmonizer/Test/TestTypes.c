@@ -0,0 +1,211 @@
+/* Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define CHAZ_USE_SHORT_NAMES
+
+#include "charmony.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Charmonizer/Core/Compiler.h"
+#include "Charmonizer/Core/Memo.h"
+#include "Charmonizer/Core/OperatingSystem.h"
+#include "Charmonizer/Core/Scratch.h"
+#include "Charmonizer/Core/Trace.h"
+#include "Charmonizer/Core/Types.h"
+#include "Charmonizer/Core/Util.h"
+#include "Charmonizer/Test.h"
+
+#define TEST_DIR   "_types_test"
+#define TRACE_PATH "_types_trace.json"
+
+/* The alignment of [type], the way a compiler without alignof finds it. */
+#define S_ALIGNOF(type) offsetof(struct { char c; type member; }, member)
+
+/* Return the number of events of [category] in the trace at [path].
+ */
+static int
+S_count_events(const char *path, const char *category) {
+    char    pattern[40];
+    size_t  len;
+    char   *trace = chaz_Util_slurp_file(path, &len);
+    char   *ptr   = trace;
+    int     count = 0;
+
+    sprintf(pattern, "\"cat\":\"%s\"", category);
+    while (ptr != NULL && (ptr = strstr(ptr, pattern)) != NULL) {
+        count++;
+        ptr++;
+    }
+    free(trace);
+    return count;
+}
+
+/* Return the "#define CHY_SIZEOF_..." lines of the header at [path], or NULL
+ * if it can't be read.
+ */
+static char*
+S_sizeof_defs(const char *path) {
+    FILE   *file = fopen(path, "r");
+    char    line[200];
+    char   *defs;
+    size_t  len = 0;
+
+    if (file == NULL) { return NULL; }
+    defs = (char*)malloc(10000);
+    defs[0] = '\0';
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (strncmp(line, "#define CHY_SIZEOF_", 19) == 0
+            && len + strlen(line) < 10000
+           ) {
+            strcpy(defs + len, line);
+            len += strlen(line);
+        }
+    }
+    fclose(file);
+    return defs;
+}
+
+static void
+S_test_queries(void) {
+    const char *types[4];
+    int         sizes[3];
+    int         alignments[3];
+
+    LONG_EQ(chaz_Types_sizeof("int", NULL), (long)sizeof(int), "sizeof int");
+    LONG_EQ(chaz_Types_sizeof("double", NULL), (long)sizeof(double),
+            "sizeof double");
+    LONG_EQ(chaz_Types_sizeof("size_t", "#include <stddef.h>"),
+            (long)sizeof(size_t), "sizeof a type from a header");
+    LONG_EQ(chaz_Types_alignof("double", NULL), (long)S_ALIGNOF(double),
+            "alignof double");
+    LONG_EQ(chaz_Types_sizeof("chaz_no_such_t", NULL), -1,
+            "Missing type");
+
+    /* One missing type mustn't spoil the others. */
+    types[0] = "short";
+    types[1] = "chaz_no_such_t";
+    types[2] = "long";
+    types[3] = NULL;
+    OK(!chaz_Types_check_many(types, NULL, sizes, alignments),
+       "check_many reports a missing type");
+    OK(sizes[0] == (int)sizeof(short) && sizes[1] == -1
+       && sizes[2] == (int)sizeof(long),
+       "check_many sizes");
+    OK(alignments[0] == (int)S_ALIGNOF(short)
+       && alignments[2] == (int)S_ALIGNOF(long),
+       "check_many alignments");
+}
+
+static void
+S_test_extraction(void) {
+    /* Forget the answers so far, and forbid running anything. */
+    chaz_Memo_clean_up();
+    chaz_CC_set_can_run(false);
+    chaz_Trace_init(TRACE_PATH);
+    LONG_EQ(chaz_Types_sizeof("long double", NULL),
+            (long)sizeof(long double),
+            "sizeof read out of an object file");
+    LONG_EQ(chaz_Types_alignof("void*", NULL), (long)S_ALIGNOF(void*),
+            "alignof read out of an object file");
+    chaz_Trace_clean_up();
+    OK(S_count_events(TRACE_PATH, "link") == 0
+       && S_count_events(TRACE_PATH, "run") == 0,
+       "Nothing is linked or run");
+    remove(TRACE_PATH);
+    remove(TRACE_PATH ".txt");
+    chaz_CC_set_can_run(true);
+}
+
+/* Run charmonize against fakecc with object files it can't read values out
+ * of, so that sizes have to be found by running a program or, with
+ * --no-run, by a compile-time search.  The sizes must match those in our
+ * own charmony.h.
+ */
+static void
+S_test_fallbacks(void) {
+    static const char *const modes[2] = { "", " --no-run" };
+    static const char *const names[2] = {
+        "Sizes from a probe program",
+        "Sizes from a compile-time search without running anything"
+    };
+    char *expected = S_sizeof_defs("charmony.h");
+    FILE *file     = fopen("fakecc", "r");
+    int   i;
+
+#ifndef HAS_UNISTD_H
+    if (file != NULL) { fclose(file); }
+    file = NULL;
+#endif
+    if (file == NULL || expected == NULL || expected[0] == '\0') {
+        if (file != NULL) { fclose(file); }
+        free(expected);
+        SKIP("fakecc or charmony.h isn't available");
+        SKIP("fakecc or charmony.h isn't available");
+        return;
+    }
+    fclose(file);
+
+    system("rm -rf " TEST_DIR " && mkdir " TEST_DIR);
+    file = fopen(TEST_DIR "/rules", "w");
+    if (file == NULL) {
+        free(expected);
+        SKIP("Can't create " TEST_DIR);
+        SKIP("Can't create " TEST_DIR);
+        return;
+    }
+    fputs("empty chaz_value_\n", file);
+    fclose(file);
+
+    for (i = 0; i < 2; i++) {
+        char  command[200];
+        char *got;
+        sprintf(command, "cd " TEST_DIR " && rm -f charmony.h && "
+                "FAKECC_RULES=rules ../charmonize --cc=../fakecc "
+                "--enable-c%s >out.txt 2>&1", modes[i]);
+        system(command);
+        got = S_sizeof_defs(TEST_DIR "/charmony.h");
+        STR_EQ(got ? got : "", expected, names[i]);
+        free(got);
+    }
+
+    free(expected);
+    system("rm -rf " TEST_DIR);
+}
+
+static void
+S_run_tests(void) {
+    chaz_Util_verbosity = 0;
+    chaz_OS_init();
+    chaz_Scratch_init();
+    chaz_CC_init("cc", "");
+
+    S_test_queries();
+    S_test_extraction();
+
+    chaz_CC_clean_up();
+    chaz_Scratch_clean_up();
+
+    S_test_fallbacks();
+}
+
+int main(int argc, char **argv) {
+    Test_start(13);
+    S_run_tests();
+    return !Test_finish();
+}
+